@@ -1,6 +1,7 @@
 import bpy
 from mathutils import Vector
 import os
+import math
 
 
 def camera_gaze(cam_obj):
@@ -23,6 +24,39 @@ def plane_corners(obj):
     return result
 
 
+def is_primitive(obj):
+    name = obj.name.lower()
+    return "sphere" in name or "cube" in name or "plane" in name
+
+
+def write_obj(obj, path):
+    """把网格（局部坐标，已应用修改器，三角化）写为 OBJ，物体变换写在场景文件中"""
+    depsgraph = bpy.context.evaluated_depsgraph_get()
+    eval_obj = obj.evaluated_get(depsgraph)
+    mesh = eval_obj.to_mesh()
+    mesh.calc_loop_triangles()
+    uv_layer = mesh.uv_layers.active.data if mesh.uv_layers.active else None
+
+    with open(path, "w") as f:
+        f.write(f"# {obj.name}\n")
+        for v in mesh.vertices:
+            f.write(f"v {v.co.x:.6f} {v.co.y:.6f} {v.co.z:.6f}\n")
+        for v in mesh.vertices:
+            f.write(f"vn {v.normal.x:.6f} {v.normal.y:.6f} {v.normal.z:.6f}\n")
+        if uv_layer:
+            for tri in mesh.loop_triangles:
+                for loop in tri.loops:
+                    uv = uv_layer[loop].uv
+                    f.write(f"vt {uv.x:.6f} {uv.y:.6f}\n")
+        for i, tri in enumerate(mesh.loop_triangles):
+            if uv_layer:
+                a, b, c = (f"{tri.vertices[k] + 1}/{3 * i + k + 1}/{tri.vertices[k] + 1}" for k in range(3))
+            else:
+                a, b, c = (f"{tri.vertices[k] + 1}//{tri.vertices[k] + 1}" for k in range(3))
+            f.write(f"f {a} {b} {c}\n")
+    eval_obj.to_mesh_clear()
+
+
 def get_material_color(obj):
     """获取对象的材质颜色"""
     if obj.active_material:
@@ -221,6 +255,31 @@ def export_scene():
                 f.write(f"shininess {shininess:.6f}\n")
                 f.write("end\n\n")
 
+        # 其他网格：导出为 OBJ，场景中引用文件并记录物体变换
+        for obj in scene.objects:
+            if obj.type == "MESH" and not is_primitive(obj):
+                color = get_material_color(obj)
+                reflectivity, refractivity, ior, shininess = get_material_properties(obj)
+                texture_file = get_texture_filename(obj)
+                mesh_file = f"{bpy.path.clean_name(obj.name)}.obj"
+                write_obj(obj, os.path.join(os.path.dirname(output_path), mesh_file))
+
+                rot = obj.rotation_euler
+                avg_scale = (obj.scale.x + obj.scale.y + obj.scale.z) / 3.0
+                f.write(f"Mesh {obj.name}\n")
+                f.write(f"file {mesh_file}\n")
+                f.write(f"translation {obj.location.x:.6f} {obj.location.y:.6f} {obj.location.z:.6f}\n")
+                f.write(f"rotation {math.degrees(rot.x):.6f} {math.degrees(rot.y):.6f} {math.degrees(rot.z):.6f}\n")
+                f.write(f"scale {avg_scale:.6f}\n")
+                f.write(f"color {color[0]:.6f} {color[1]:.6f} {color[2]:.6f}\n")
+                if texture_file:
+                    f.write(f"texture {texture_file}\n")
+                f.write(f"reflectivity {reflectivity:.6f}\n")
+                f.write(f"refractivity {refractivity:.6f}\n")
+                f.write(f"ior {ior:.6f}\n")
+                f.write(f"shininess {shininess:.6f}\n")
+                f.write("end\n\n")
+
     print(f"Scene exported successfully to: {output_path}")
 
     # 统计信息
@@ -229,6 +288,7 @@ def export_scene():
     spheres = len([obj for obj in scene.objects if obj.type == "MESH" and "sphere" in obj.name.lower()])
     cubes = len([obj for obj in scene.objects if obj.type == "MESH" and "cube" in obj.name.lower()])
     planes = len([obj for obj in scene.objects if obj.type == "MESH" and "plane" in obj.name.lower()])
+    meshes = len([obj for obj in scene.objects if obj.type == "MESH" and not is_primitive(obj)])
 
     print(f"\nExport Summary:")
     print(f"Cameras: {cameras}")
@@ -236,6 +296,7 @@ def export_scene():
     print(f"Spheres: {spheres}")
     print(f"Cubes: {cubes}")
     print(f"Planes: {planes}")
+    print(f"Meshes: {meshes}")
     print(f"Output directory: {output_dir}")
 
 
@@ -0,0 +1,173 @@
+//
+// Created by 31934 on 2025/12/14.
+//
+#include "Accelerator.h"
+#include "UniformGrid.h"
+#include "KdTree.h"
+#include "SceneUtils.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+bool parse_accelerator(const std::string &name, AcceleratorType &type) {
+    if (name == "bvh") type = AcceleratorType::BVH;
+    else if (name == "grid") type = AcceleratorType::GRID;
+    else if (name == "kdtree") type = AcceleratorType::KDTREE;
+    else if (name == "brute") type = AcceleratorType::BRUTE;
+    else if (name == "auto") type = AcceleratorType::AUTO;
+    else return false;
+    return true;
+}
+
+const char *accelerator_name(AcceleratorType type) {
+    switch (type) {
+        case AcceleratorType::BVH: return "bvh";
+        case AcceleratorType::GRID: return "grid";
+        case AcceleratorType::KDTREE: return "kdtree";
+        case AcceleratorType::BRUTE: return "brute";
+        case AcceleratorType::AUTO: return "auto";
+    }
+    return "unknown";
+}
+
+// ====================== BVH ======================
+void BVHAccelerator::build(const Scene &scene) {
+    bvh.build(scene, builder);
+    built_cost = bvh.sah_cost();
+}
+
+const char *BVHAccelerator::update(const Scene &scene) {
+    bvh.refit(scene);
+    if (bvh.sah_cost() > built_cost * REBUILD_RATIO) {
+        build(scene);
+        return "rebuild";
+    }
+    return "refit";
+}
+
+const char *BVHAccelerator::update_objects(const Scene &scene, const std::vector<int> &changed) {
+    int rebuilt = bvh.update_objects(scene, changed);
+    if (rebuilt < 0 || bvh.sah_cost() > built_cost * REBUILD_RATIO) {
+        build(scene);
+        return "rebuild";
+    }
+    return rebuilt > 0 ? "local rebuild" : "refit";
+}
+
+size_t BVHAccelerator::memory_bytes() const {
+    return bvh.memory_bytes();
+}
+
+// ====================== 逐对象 ======================
+bool BruteForceAccelerator::intersect(const Ray &ray, Hit &hit, const Scene &scene) const {
+    return intersect_scene(ray, scene, hit);
+}
+
+bool BruteForceAccelerator::intersect(const Rayf &ray, Hitf &hit, const Scene &scene) const {
+    return intersect_scene(ray, scene, hit);
+}
+
+std::vector<AABB> static_object_bounds(const Scene &scene) {
+    std::vector<AABB> bounds = BVH::object_bounds(scene);
+    double shutter = BVH::motion_shutter(scene);
+    if (shutter > 0.0) {
+        std::vector<AABB> close_bounds = BVH::object_bounds(scene, shutter);
+        for (size_t i = 0; i < bounds.size(); i++) bounds[i].expand(close_bounds[i]);
+    }
+    return bounds;
+}
+
+// ====================== 自动选择 ======================
+namespace {
+// 采样光线：相机主光线（64x64 网格）+ 从主光线交点出发的随机方向光线（近似阴影 / 反射等次级光线）
+std::vector<Ray> sample_rays(const Scene &scene, const Accelerator &reference) {
+    std::vector<Ray> rays;
+    if (!scene.camera) return rays;
+    Camera cam = *scene.camera;
+    cam.compute_basis();
+
+    const int n = 64;
+    std::mt19937 rng(4242);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            rays.push_back(cam.pixel_to_ray((x + u(rng)) * cam.res_x / n, (y + u(rng)) * cam.res_y / n));
+        }
+    }
+    size_t primary = rays.size();
+    for (size_t i = 0; i < primary; i++) {
+        Hit h;
+        if (!reference.intersect(rays[i], h, scene)) continue;
+        double z = 2.0 * u(rng) - 1.0, phi = 2.0 * M_PI * u(rng), r = std::sqrt(1.0 - z * z);
+        Vector3 dir(r * std::cos(phi), r * std::sin(phi), z);
+        if (dir.dot(h.normal) < 0.0) dir = -dir;
+        rays.push_back(spawn_ray(h.pos, h.normal, dir));
+    }
+    return rays;
+}
+
+double trace_sample_ms(const Accelerator &accel, const Scene &scene, const std::vector<Ray> &rays) {
+    auto t0 = std::chrono::high_resolution_clock::now();
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < (int)rays.size(); i++) {
+        Hit h;
+        accel.intersect(rays[i], h, scene);
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+std::unique_ptr<Accelerator> make_single(AcceleratorType type, BVH &bvh, BVHBuilder builder) {
+    switch (type) {
+        case AcceleratorType::GRID: return std::make_unique<UniformGrid>();
+        case AcceleratorType::KDTREE: return std::make_unique<KdTree>();
+        case AcceleratorType::BRUTE: return std::make_unique<BruteForceAccelerator>();
+        default: return std::make_unique<BVHAccelerator>(bvh, builder);
+    }
+}
+} // namespace
+
+std::unique_ptr<Accelerator> make_accelerator(AcceleratorType type, const Scene &scene,
+                                              BVH &bvh, BVHBuilder builder) {
+    if (type != AcceleratorType::AUTO) {
+        auto accel = make_single(type, bvh, builder);
+        // 调用方的 BVH 已构建（或来自缓存），其余结构在这里构建
+        if (type != AcceleratorType::BVH) accel->build(scene);
+        return accel;
+    }
+
+    // 逐对象遍历的代价与对象数成正比，只作为兜底，不参与比较
+    std::unique_ptr<Accelerator> best = make_single(AcceleratorType::BVH, bvh, builder);
+    std::vector<Ray> rays = sample_rays(scene, *best);
+    if (rays.empty()) return best;
+
+    std::cout << "\n=== Accelerator Auto-Selection (" << rays.size() << " sample rays; bvh is prebuilt) ===" << std::endl;
+    std::cout << std::left << std::setw(10) << "accel" << std::setw(12) << "build_ms"
+              << std::setw(12) << "trace_ms" << "memory_MiB" << std::endl;
+
+    double best_ms = 1e30;
+    for (AcceleratorType t : {AcceleratorType::BVH, AcceleratorType::GRID, AcceleratorType::KDTREE}) {
+        auto accel = make_single(t, bvh, builder);
+        auto t0 = std::chrono::high_resolution_clock::now();
+        if (t != AcceleratorType::BVH) accel->build(scene);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        double build_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        // 取 3 次中最快的一次
+        double ms = 1e30;
+        for (int rep = 0; rep < 3; rep++) ms = std::min(ms, trace_sample_ms(*accel, scene, rays));
+
+        std::cout << std::left << std::setw(10) << accel->name()
+                  << std::setw(12) << std::fixed << std::setprecision(3) << build_ms
+                  << std::setw(12) << ms
+                  << std::setprecision(2) << accel->memory_bytes() / (1024.0 * 1024.0) << std::endl;
+        if (ms < best_ms) {
+            best_ms = ms;
+            best = std::move(accel);
+        }
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << "Selected accelerator: " << best->name() << std::endl;
+    return best;
+}
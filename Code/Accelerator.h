@@ -0,0 +1,102 @@
+//
+// Created by 31934 on 2025/12/14.
+//
+
+#ifndef GRAPHIC_CW_ACCELERATOR_H
+#define GRAPHIC_CW_ACCELERATOR_H
+#pragma once
+#include "Scene.h"
+#include "BVH.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// 可选的加速结构
+enum class AcceleratorType {
+    BVH,    // 包围体层次（默认）
+    GRID,   // 均匀网格 + 3D-DDA
+    KDTREE, // SAH kd 树
+    BRUTE,  // 逐对象遍历
+    AUTO,   // 在采样光线上比较上面的候选，保留最快的
+};
+
+// 名字 <-> 类型（用于命令行），未知名字返回 false
+bool parse_accelerator(const std::string &name, AcceleratorType &type);
+const char *accelerator_name(AcceleratorType type);
+
+// 渲染代码使用的统一求交接口
+class Accelerator {
+public:
+    virtual ~Accelerator() {}
+    virtual AcceleratorType type() const = 0;
+    virtual void build(const Scene &scene) = 0;
+    // 最近交点；hit.t 为当前最近距离
+    virtual bool intersect(const Ray &ray, Hit &hit, const Scene &scene) const = 0;
+    // 单精度求交；默认转换为双精度求交
+    virtual bool intersect(const Rayf &ray, Hitf &hit, const Scene &scene) const {
+        Hit hd;
+        hd.t = hit.t;
+        if (!intersect(Ray(ray), hd, scene)) return false;
+        hit = Hitf(hd);
+        return true;
+    }
+    // 物体移动后（多帧序列）更新结构，返回所做的操作
+    virtual const char *update(const Scene &scene) {
+        build(scene);
+        return "rebuild";
+    }
+    // 只有 changed 中的对象几何改变（热重载），对象列表不变；默认同 update
+    virtual const char *update_objects(const Scene &scene, const std::vector<int> & /*changed*/) { return update(scene); }
+    // 结构本身占用的字节数（不含场景几何）
+    virtual size_t memory_bytes() const = 0;
+
+    const char *name() const { return accelerator_name(type()); }
+};
+
+// 包装调用方持有的 BVH（场景缓存加载的 BVH 直接可用，不重复构建）
+class BVHAccelerator : public Accelerator {
+public:
+    // refit 后 SAH 代价劣化超过该倍数时完整重建
+    static constexpr double REBUILD_RATIO = 1.5;
+
+    BVHAccelerator(BVH &bvh, BVHBuilder builder) : bvh(bvh), builder(builder), built_cost(bvh.sah_cost()) {}
+
+    AcceleratorType type() const override { return AcceleratorType::BVH; }
+    void build(const Scene &scene) override;
+    bool intersect(const Ray &ray, Hit &hit, const Scene &scene) const override {
+        return bvh.intersect(ray, hit, scene);
+    }
+    bool intersect(const Rayf &ray, Hitf &hit, const Scene &scene) const override {
+        return bvh.intersect(ray, hit, scene);
+    }
+    // 先 refit，树质量劣化过多时才重建
+    const char *update(const Scene &scene) override;
+    // 只 refit 改变对象的路径，必要时局部重建子树
+    const char *update_objects(const Scene &scene, const std::vector<int> &changed) override;
+    size_t memory_bytes() const override;
+
+private:
+    BVH &bvh;
+    BVHBuilder builder;
+    double built_cost;
+};
+
+class BruteForceAccelerator : public Accelerator {
+public:
+    AcceleratorType type() const override { return AcceleratorType::BRUTE; }
+    void build(const Scene &) override {}
+    bool intersect(const Ray &ray, Hit &hit, const Scene &scene) const override;
+    bool intersect(const Rayf &ray, Hitf &hit, const Scene &scene) const override;
+    const char *update(const Scene &) override { return "none"; }
+    size_t memory_bytes() const override { return 0; }
+};
+
+// 网格、kd 树等静态结构使用的对象包围盒：有运动物体时取快门开启 / 关闭时刻包围盒的并集
+std::vector<AABB> static_object_bounds(const Scene &scene);
+
+// 构建指定类型的加速结构（BVH 类型包装 bvh，不重新构建）。
+// AUTO：在相机主光线和一次随机反弹光线的采样上追踪各候选（BVH / 网格 / kd 树），打印对比并返回最快的
+std::unique_ptr<Accelerator> make_accelerator(AcceleratorType type, const Scene &scene,
+                                              BVH &bvh, BVHBuilder builder);
+
+#endif //GRAPHIC_CW_ACCELERATOR_H
@@ -1,16 +1,25 @@
 #include "BVH.h"
+#include "Scene.h"
+#include "Timeline.h"
 #include <algorithm>
 #include <stack>
 #include <limits>
 #include <cmath>
+#include <functional>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <omp.h>
 
 // AABB 方法实现
-AABB::AABB() {
-    bmin = Vector3(1e30, 1e30, 1e30);
-    bmax = Vector3(-1e30, -1e30, -1e30);
+template <typename T>
+AABBT<T>::AABBT() {
+    bmin = Vec3<T>(T(1e30), T(1e30), T(1e30));
+    bmax = Vec3<T>(T(-1e30), T(-1e30), T(-1e30));
 }
 
-void AABB::expand(const AABB &o) {
+template <typename T>
+void AABBT<T>::expand(const AABBT &o) {
     bmin.x = std::min(bmin.x, o.bmin.x);
     bmin.y = std::min(bmin.y, o.bmin.y);
     bmin.z = std::min(bmin.z, o.bmin.z);
@@ -19,7 +28,8 @@ void AABB::expand(const AABB &o) {
     bmax.z = std::max(bmax.z, o.bmax.z);
 }
 
-void AABB::expand_point(const Vector3 &p) {
+template <typename T>
+void AABBT<T>::expand_point(const Vec3<T> &p) {
     bmin.x = std::min(bmin.x, p.x);
     bmin.y = std::min(bmin.y, p.y);
     bmin.z = std::min(bmin.z, p.z);
@@ -37,22 +47,29 @@ void AABB::expand_point(const Vector3 &p) {
 //     return a;
 // }
 
-bool AABB::intersect(const Ray &ray, double tmin, double tmax) const {
+template <typename T>
+bool AABBT<T>::intersect(const RayT<T> &ray, T tmin, T tmax) const {
+    T t_enter;
+    return intersect(ray, tmin, tmax, t_enter);
+}
+
+template <typename T>
+bool AABBT<T>::intersect(const RayT<T> &ray, T tmin, T tmax, T &t_enter) const {
     // 添加对零方向的容错处理
-    const double epsilon = 1e-8;
+    const T epsilon = T(1e-8);
 
     // X轴
     if (std::abs(ray.dir.x) < epsilon) {
         if (ray.origin.x < bmin.x || ray.origin.x > bmax.x) return false;
     }
     else {
-        double invD = 1.0 / ray.dir.x;
-        double t0 = (bmin.x - ray.origin.x) * invD;
-        double t1 = (bmax.x - ray.origin.x) * invD;
+        T invD = 1 / ray.dir.x;
+        T t0 = (bmin.x - ray.origin.x) * invD;
+        T t1 = (bmax.x - ray.origin.x) * invD;
         if (invD < 0) std::swap(t0, t1);
         tmin = std::max(t0, tmin);
         tmax = std::min(t1, tmax);
-        if (tmax <= tmin) return false;
+        if (tmax < tmin) return false;
     }
 
     // Y轴
@@ -60,13 +77,13 @@ bool AABB::intersect(const Ray &ray, double tmin, double tmax) const {
         if (ray.origin.y < bmin.y || ray.origin.y > bmax.y) return false;
     }
     else {
-        double invD = 1.0 / ray.dir.y;
-        double t0 = (bmin.y - ray.origin.y) * invD;
-        double t1 = (bmax.y - ray.origin.y) * invD;
+        T invD = 1 / ray.dir.y;
+        T t0 = (bmin.y - ray.origin.y) * invD;
+        T t1 = (bmax.y - ray.origin.y) * invD;
         if (invD < 0) std::swap(t0, t1);
         tmin = std::max(t0, tmin);
         tmax = std::min(t1, tmax);
-        if (tmax <= tmin) return false;
+        if (tmax < tmin) return false;
     }
 
     // Z轴
@@ -74,172 +91,1253 @@ bool AABB::intersect(const Ray &ray, double tmin, double tmax) const {
         if (ray.origin.z < bmin.z || ray.origin.z > bmax.z) return false;
     }
     else {
-        double invD = 1.0 / ray.dir.z;
-        double t0 = (bmin.z - ray.origin.z) * invD;
-        double t1 = (bmax.z - ray.origin.z) * invD;
+        T invD = 1 / ray.dir.z;
+        T t0 = (bmin.z - ray.origin.z) * invD;
+        T t1 = (bmax.z - ray.origin.z) * invD;
         if (invD < 0) std::swap(t0, t1);
         tmin = std::max(t0, tmin);
         tmax = std::min(t1, tmax);
-        if (tmax <= tmin) return false;
+        if (tmax < tmin) return false;
     }
 
+    t_enter = tmin;
     return true;
 }
 
-double AABB::surface_area() const {
-    Vector3 d = bmax - bmin;
-    return 2.0 * (d.x * d.y + d.x * d.z + d.y * d.z);
+template <typename T>
+T AABBT<T>::surface_area() const {
+    Vec3<T> d = bmax - bmin;
+    return 2 * (d.x * d.y + d.x * d.z + d.y * d.z);
 }
 
-Vector3 AABB::center() const {
-    return Vector3(
-        (bmin.x + bmax.x) * 0.5,
-        (bmin.y + bmax.y) * 0.5,
-        (bmin.z + bmax.z) * 0.5
+template <typename T>
+Vec3<T> AABBT<T>::center() const {
+    return Vec3<T>(
+        (bmin.x + bmax.x) * T(0.5),
+        (bmin.y + bmax.y) * T(0.5),
+        (bmin.z + bmax.z) * T(0.5)
     );
 }
 
+template <typename T>
+AABBT<T> AABBT<T>::lerp(const AABBT &a, const AABBT &b, double s) {
+    AABBT r;
+    r.bmin = a.bmin * T(1.0 - s) + b.bmin * T(s);
+    r.bmax = a.bmax * T(1.0 - s) + b.bmax * T(s);
+    return r;
+}
+
+template <typename T>
+AABBT<T> AABBT<T>::intersection(const AABBT &a, const AABBT &b) {
+    AABBT r;
+    r.bmin = Vec3<T>(std::max(a.bmin.x, b.bmin.x), std::max(a.bmin.y, b.bmin.y), std::max(a.bmin.z, b.bmin.z));
+    r.bmax = Vec3<T>(std::min(a.bmax.x, b.bmax.x), std::min(a.bmax.y, b.bmax.y), std::min(a.bmax.z, b.bmax.z));
+    return r;
+}
+
+template struct AABBT<double>;
+template struct AABBT<float>;
+
 // BVH 方法实现
-void BVH::build(const Scene &scene) {
+namespace {
+constexpr int SAH_BINS = 16;
+constexpr int MAX_LEAF_PRIMS = 8;
+constexpr int MAX_BUILD_DEPTH = 64;
+// 图元数超过该值的子树作为独立 OpenMP 任务构建
+constexpr int TASK_THRESHOLD = 1024;
+// 图元数超过该值的节点（即树的顶部几层）并行分箱与划分
+constexpr int PARALLEL_THRESHOLD = 1 << 15;
+// 并行分箱/划分时的固定分块数：与线程数无关，保证构建结果确定
+constexpr int PARALLEL_CHUNKS = 64;
+
+inline double axis_value(const Vector3 &v, int axis) {
+    if (axis == 0) return v.x;
+    if (axis == 1) return v.y;
+    return v.z;
+}
+
+inline void set_axis(Vector3 &v, int axis, double value) {
+    if (axis == 0) v.x = value;
+    else if (axis == 1) v.y = value;
+    else v.z = value;
+}
+
+struct SAHBin {
+    AABB box;
+    int count = 0;
+};
+
+// 三个轴各 SAH_BINS 个桶
+struct BinSet {
+    SAHBin bins[3][SAH_BINS];
+
+    void merge(const BinSet &o) {
+        for (int a = 0; a < 3; a++) {
+            for (int b = 0; b < SAH_BINS; b++) {
+                bins[a][b].box.expand(o.bins[a][b].box);
+                bins[a][b].count += o.bins[a][b].count;
+            }
+        }
+    }
+};
+
+inline int bin_index(double c, double lo, double scale) {
+    int b = int((c - lo) * scale);
+    return std::clamp(b, 0, SAH_BINS - 1);
+}
+} // namespace
+
+OBB OBB::from(const Vector3 &center, const Matrix3 &rot, const Vector3 &half) {
+    OBB b;
+    b.center = center;
+    b.to_unit = rot.transpose();
+    // 略微放大，避免舍入误差剔除掉恰好擦边的交点
+    const double inv[3] = {1.0 / (half.x * (1.0 + 1e-7) + 1e-12), 1.0 / (half.y * (1.0 + 1e-7) + 1e-12),
+                           1.0 / (half.z * (1.0 + 1e-7) + 1e-12)};
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) b.to_unit.m[i][j] *= inv[i];
+    b.active = true;
+    return b;
+}
+
+bool OBB::intersect(const Ray &ray, double tmin, double tmax) const {
+    Vector3 lo = to_unit.mul(ray.origin - center);
+    Vector3 ld = to_unit.mul(ray.dir);
+    const double o[3] = {lo.x, lo.y, lo.z};
+    const double d[3] = {ld.x, ld.y, ld.z};
+    for (int a = 0; a < 3; a++) {
+        if (d[a] == 0.0) {
+            if (o[a] < -1.0 || o[a] > 1.0) return false;
+            continue;
+        }
+        double inv = 1.0 / d[a];
+        double t0 = (-1.0 - o[a]) * inv, t1 = (1.0 - o[a]) * inv;
+        if (inv < 0.0) std::swap(t0, t1);
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+        if (tmax < tmin) return false;
+    }
+    return true;
+}
+
+bool clip_polygon_bounds(const Vector3 *verts, int count, const AABB &box, AABB &out) {
+    // Sutherland-Hodgman：依次用包围盒的 6 个面裁剪，凸多边形每裁一次最多多一个顶点
+    constexpr int MAX_VERTS = 16;
+    if (count <= 0 || count > MAX_VERTS - 6) return false;
+    Vector3 a[MAX_VERTS], b[MAX_VERTS];
+    int n = count;
+    for (int i = 0; i < n; i++) a[i] = verts[i];
+
+    for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+            const double plane = axis_value(side == 0 ? box.bmin : box.bmax, axis);
+            auto inside = [&](const Vector3 &p) {
+                return side == 0 ? axis_value(p, axis) >= plane : axis_value(p, axis) <= plane;
+            };
+            int m = 0;
+            for (int i = 0; i < n; i++) {
+                const Vector3 &p = a[i], &q = a[(i + 1) % n];
+                bool p_in = inside(p), q_in = inside(q);
+                if (p_in) b[m++] = p;
+                if (p_in != q_in) {
+                    double pv = axis_value(p, axis), qv = axis_value(q, axis);
+                    Vector3 x = p + (q - p) * ((plane - pv) / (qv - pv));
+                    set_axis(x, axis, plane);
+                    b[m++] = x;
+                }
+            }
+            n = m;
+            if (n == 0) return false;
+            std::copy(b, b + n, a);
+        }
+    }
+
+    out = AABB();
+    for (int i = 0; i < n; i++) out.expand_point(a[i]);
+    out = AABB::intersection(out, box);
+    return out.valid();
+}
+
+struct BVH::BuildContext {
+    const std::vector<AABB> &bounds;
+    std::vector<Vector3> centroids;
+    std::vector<int> scratch; // 并行划分的临时缓冲
+};
+
+// 并行计算全部对象的包围盒（Cube 的 bounds 需要旋转 8 个角点）
+std::vector<AABB> BVH::object_bounds(const Scene &scene, double time) {
+    std::vector<AABB> bounds(scene.objects.size());
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < (int)scene.objects.size(); i++) {
+        scene.objects[i]->bounds_at_time(time, bounds[i].bmin, bounds[i].bmax);
+    }
+    return bounds;
+}
+
+// 取全部相机中最长的快门：批量渲染时同一棵运动 BVH 供每个相机使用
+double BVH::motion_shutter(const Scene &scene) {
+    double shutter = scene.camera ? scene.camera->shutter_speed : 0.0;
+    for (const auto &cam : scene.cameras) shutter = std::max(shutter, cam->shutter_speed);
+    if (shutter <= 0.0) return 0.0;
+    for (const auto &obj : scene.objects) {
+        if (obj->is_moving()) return shutter;
+    }
+    return 0.0;
+}
+
+void BVH::build(const Scene &scene, BVHBuilder builder) {
+    nodes.clear();
+    prim_indices.clear();
+    unbounded.clear();
+    motion_boxes.clear();
+    shutter_time = 0.0;
     if (scene.objects.empty()) return;
 
-    // 初始化对象索引
-    prim_indices.resize(scene.objects.size());
-    for (size_t i = 0; i < scene.objects.size(); i++) {
-        prim_indices[i] = i;
+    double shutter = motion_shutter(scene);
+
+    // SBVH 按对象的实际几何裁剪引用；运动物体按扫掠包围盒参与构建，只做包围盒裁剪
+    ClipFn clip;
+    if (builder == BVHBuilder::SBVH) {
+        clip = [&scene, shutter](int prim, const AABB &box, AABB &out) {
+            const Shape &obj = *scene.objects[prim];
+            if (shutter > 0.0 && obj.is_moving()) {
+                out = box;
+                return true;
+            }
+            return obj.clip_bounds(box.bmin, box.bmax, out.bmin, out.bmax);
+        };
     }
 
-    // 递归构建BVH
-    nodes.reserve(scene.objects.size() * 2);
+    if (shutter <= 0.0) {
+        build(object_bounds(scene), builder, clip);
+        update_leaf_obbs(scene);
+        update_float_nodes();
+        return;
+    }
+
+    // 拓扑按扫掠包围盒划分，节点包围盒则分别在快门开启 / 关闭时刻计算
+    std::vector<AABB> open_bounds = object_bounds(scene, 0.0);
+    std::vector<AABB> close_bounds = object_bounds(scene, shutter);
+    std::vector<AABB> swept = open_bounds;
+    for (size_t i = 0; i < swept.size(); i++) swept[i].expand(close_bounds[i]);
+    build(swept, builder, clip);
+    shutter_time = shutter;
+    refit_motion(open_bounds, close_bounds);
+    update_leaf_obbs(scene);
+    update_float_nodes();
+}
+
+void BVH::refit(const Scene &scene) {
+    TIMELINE_SCOPE("bvh.refit");
+    if (nodes.empty()) return;
+    if (motion_boxes.empty()) refit_bounds(object_bounds(scene));
+    else refit_motion(object_bounds(scene, 0.0), object_bounds(scene, shutter_time));
+    update_leaf_obbs(scene);
+    update_float_nodes();
+}
+
+// ====================== 增量更新 ======================
+namespace {
+// 对象在 time 时刻的包围盒
+AABB object_box(const Scene &scene, int prim, double time) {
+    AABB b;
+    scene.objects[prim]->bounds_at_time(time, b.bmin, b.bmax);
+    return b;
+}
+} // namespace
+
+int BVH::update_objects(const Scene &scene, const std::vector<int> &changed) {
+    TIMELINE_SCOPE("bvh.update", (int)changed.size());
+    if (nodes.empty()) return -1;
+    if (changed.empty()) return 0;
+
+    // 父节点和每个对象所在的叶子；同一对象出现在多个叶子（SBVH）时无法就地更新
+    std::vector<int> parent(nodes.size(), -1);
+    std::vector<int> leaf_of(scene.objects.size(), -1);
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        const BVHNode &n = nodes[i];
+        if (!n.is_leaf()) {
+            parent[n.left] = i;
+            parent[n.right] = i;
+            continue;
+        }
+        for (int k = 0; k < n.prim_count; k++) {
+            int prim = prim_indices[n.first_prim + k];
+            if (prim >= (int)leaf_of.size() || leaf_of[prim] >= 0) return -1;
+            leaf_of[prim] = i;
+        }
+    }
+    // 无界列表中的对象改变时需要重新划分
+    for (int prim : changed)
+        if (prim < 0 || prim >= (int)leaf_of.size() || leaf_of[prim] < 0) return -1;
+    // 阈值与 build 相同：全部图元（含无界列表，运动 BVH 取扫掠包围盒）的包围盒表面积的 unbounded_fraction 倍。
+    // 改变后任一对象应在的一侧（树 / 无界列表）与当前不同时需要重新划分
+    if (unbounded_fraction > 0.0) {
+        std::vector<AABB> bounds = object_bounds(scene, 0.0);
+        if (!motion_boxes.empty()) {
+            std::vector<AABB> close = object_bounds(scene, shutter_time);
+            for (size_t i = 0; i < bounds.size(); i++) bounds[i].expand(close[i]);
+        }
+        AABB all;
+        for (const auto &b : bounds) all.expand(b);
+        const double limit = all.surface_area() * unbounded_fraction;
+        for (int i = 0; i < (int)bounds.size(); i++)
+            if ((bounds[i].surface_area() > limit) != (leaf_of[i] < 0)) return -1;
+    }
+
+    // 节点的包围盒（运动 BVH 同时更新关闭时刻的包围盒），返回更新前后用于比较的表面积
+    auto area = [&](int i) {
+        if (motion_boxes.empty()) return nodes[i].box.surface_area();
+        AABB swept = nodes[i].box;
+        swept.expand(motion_boxes[i]);
+        return swept.surface_area();
+    };
+    auto recompute = [&](int i) {
+        BVHNode &n = nodes[i];
+        AABB open, close;
+        if (n.is_leaf()) {
+            for (int k = 0; k < n.prim_count; k++) {
+                const int prim = prim_indices[n.first_prim + k];
+                open.expand(object_box(scene, prim, 0.0));
+                if (!motion_boxes.empty()) close.expand(object_box(scene, prim, shutter_time));
+            }
+        } else {
+            open = nodes[n.left].box;
+            open.expand(nodes[n.right].box);
+            if (!motion_boxes.empty()) {
+                close = motion_boxes[n.left];
+                close.expand(motion_boxes[n.right]);
+            }
+        }
+        n.box = open;
+        if (!motion_boxes.empty()) motion_boxes[i] = close;
+    };
+
+    // 沿每个改变对象的叶子向上 refit，记录表面积增长过多的最高节点
+    std::vector<double> old_area(nodes.size(), -1.0);
+    std::vector<int> rebuild_roots;
+    for (int prim : changed) {
+        int degraded = -1;
+        for (int i = leaf_of[prim]; i >= 0; i = parent[i]) {
+            if (old_area[i] < 0.0) old_area[i] = area(i);
+            recompute(i);
+            if (area(i) > old_area[i] * LOCAL_REBUILD_GROWTH) degraded = i;
+        }
+        if (degraded == 0) return -1;
+        if (degraded > 0) rebuild_roots.push_back(degraded);
+    }
+
+    // 只保留最外层的子树，按编号从大到小重建：拼接只改变更大编号的节点，不影响尚未处理的子树
+    std::sort(rebuild_roots.begin(), rebuild_roots.end());
+    rebuild_roots.erase(std::unique(rebuild_roots.begin(), rebuild_roots.end()), rebuild_roots.end());
+    std::vector<int> outermost;
+    for (int root : rebuild_roots) {
+        bool nested = false;
+        for (int i = parent[root]; i >= 0 && !nested; i = parent[i])
+            nested = std::binary_search(rebuild_roots.begin(), rebuild_roots.end(), i);
+        if (!nested) outermost.push_back(root);
+    }
+    int rebuilt = 0;
+    for (auto it = outermost.rbegin(); it != outermost.rend(); ++it) {
+        int depth = 0;
+        for (int i = parent[*it]; i >= 0; i = parent[i]) depth++;
+        int count = rebuild_subtree(scene, *it, depth);
+        if (count < 0) return -1;
+        rebuilt += count;
+    }
+
+    update_leaf_obbs(scene);
+    update_float_nodes();
+    return rebuilt;
+}
+
+int BVH::rebuild_subtree(const Scene &scene, int root, int root_depth) {
+    // 深度优先顺序下子树占据连续的节点区间 [root, end)；叶子的图元区间也须连续
+    int end = root, prim_begin = std::numeric_limits<int>::max(), prim_end = 0, prim_total = 0;
+    std::vector<int> stack{root};
+    while (!stack.empty()) {
+        const BVHNode &n = nodes[stack.back()];
+        stack.pop_back();
+        end++;
+        if (n.is_leaf()) {
+            prim_begin = std::min(prim_begin, n.first_prim);
+            prim_end = std::max(prim_end, n.first_prim + n.prim_count);
+            prim_total += n.prim_count;
+        } else {
+            stack.push_back(n.right);
+            stack.push_back(n.left);
+        }
+    }
+    if (prim_end - prim_begin != prim_total) return -1;
+
+    // 运动 BVH 与完整构建一致：拓扑按扫掠包围盒划分
+    std::vector<int> prims(prim_indices.begin() + prim_begin, prim_indices.begin() + prim_end);
+    std::vector<AABB> bounds(prims.size());
+    for (size_t i = 0; i < prims.size(); i++) {
+        bounds[i] = object_box(scene, prims[i], 0.0);
+        if (!motion_boxes.empty()) bounds[i].expand(object_box(scene, prims[i], shutter_time));
+    }
+    BVH sub;
+    sub.build(bounds, BVHBuilder::SAH);
+    // 子树自身最深可达 MAX_BUILD_DEPTH，挂在深处时整棵树可能超过遍历栈；反复热重载后也不能累积
+    std::vector<int> sub_depth(sub.nodes.size(), 0);
+    for (int i = 0; i < (int)sub.nodes.size(); i++) {
+        const BVHNode &n = sub.nodes[i];
+        if (n.is_leaf()) {
+            if (root_depth + sub_depth[i] > MAX_BUILD_DEPTH) return -1;
+        } else {
+            sub_depth[n.left] = sub_depth[n.right] = sub_depth[i] + 1;
+        }
+    }
+
+    // 子树节点编号平移到 root，图元映射回全局编号；子树之后的节点编号整体平移
+    const int delta = (int)sub.nodes.size() - (end - root);
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        if (i >= root && i < end) continue;
+        BVHNode &n = nodes[i];
+        if (n.is_leaf()) continue;
+        if (n.left >= end) n.left += delta;
+        if (n.right >= end) n.right += delta;
+    }
+    for (BVHNode &n : sub.nodes) {
+        if (n.is_leaf()) {
+            n.first_prim += prim_begin;
+        } else {
+            n.left += root;
+            n.right += root;
+        }
+    }
+    for (size_t k = 0; k < sub.prim_indices.size(); k++) prim_indices[prim_begin + k] = prims[sub.prim_indices[k]];
+    nodes.erase(nodes.begin() + root, nodes.begin() + end);
+    nodes.insert(nodes.begin() + root, sub.nodes.begin(), sub.nodes.end());
+    if (motion_boxes.empty()) return prim_total;
+
+    // 运动 BVH：新节点自底向上分别计算开启 / 关闭时刻的包围盒
+    motion_boxes.erase(motion_boxes.begin() + root, motion_boxes.begin() + end);
+    motion_boxes.insert(motion_boxes.begin() + root, sub.nodes.size(), AABB());
+    for (int i = root + (int)sub.nodes.size() - 1; i >= root; i--) {
+        BVHNode &n = nodes[i];
+        AABB open, close;
+        if (n.is_leaf()) {
+            for (int k = 0; k < n.prim_count; k++) {
+                const int prim = prim_indices[n.first_prim + k];
+                open.expand(object_box(scene, prim, 0.0));
+                close.expand(object_box(scene, prim, shutter_time));
+            }
+        } else {
+            open = nodes[n.left].box;
+            open.expand(nodes[n.right].box);
+            close = motion_boxes[n.left];
+            close.expand(motion_boxes[n.right]);
+        }
+        n.box = open;
+        motion_boxes[i] = close;
+    }
+    return prim_total;
+}
+
+void BVH::update_leaf_obbs(const Scene &scene) {
+    leaf_obbs.clear();
+    if (!use_obbs || prim_indices.empty()) return;
+
+    // 每个对象的有向包围盒；运动物体在快门期间位置变化，不做剔除
+    std::vector<OBB> obbs(scene.objects.size());
+    int count = 0;
+#pragma omp parallel for schedule(static) reduction(+:count)
+    for (int i = 0; i < (int)scene.objects.size(); i++) {
+        const Shape &obj = *scene.objects[i];
+        if (shutter_time > 0.0 && obj.is_moving()) continue;
+        Vector3 center, half;
+        Matrix3 rot;
+        if (!obj.oriented_bounds(center, rot, half)) continue;
+        AABB box;
+        obj.bounds(box.bmin, box.bmax);
+        double obb_area = 8.0 * (half.x * half.y + half.x * half.z + half.y * half.z);
+        if (obb_area < OBB_AREA_RATIO * box.surface_area()) {
+            obbs[i] = OBB::from(center, rot, half);
+            count++;
+        }
+    }
+    if (count == 0) return;
+
+    leaf_obbs.resize(prim_indices.size());
+    for (size_t slot = 0; slot < prim_indices.size(); slot++) leaf_obbs[slot] = obbs[prim_indices[slot]];
+}
+
+namespace {
+// double -> float 向外取整：最小值向下、最大值向上，float 包围盒总是包含原包围盒
+inline float round_down(double x) {
+    float f = static_cast<float>(x);
+    return f > x ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+}
+
+inline float round_up(double x) {
+    float f = static_cast<float>(x);
+    return f < x ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+}
+} // namespace
+
+void BVH::update_float_nodes() {
+    float_nodes.clear();
+    if (!use_float_nodes || nodes.empty()) return;
+
+    std::vector<BVHNodef> compact(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        const BVHNode &n = nodes[i];
+        // 紧凑格式依赖深度优先顺序（左子节点紧跟父节点）
+        if (!n.is_leaf() && n.left != (int)i + 1) return;
+        AABB box = n.box;
+        if (!motion_boxes.empty()) box.expand(motion_boxes[i]);
+        compact[i].box.bmin = Vector3f(round_down(box.bmin.x), round_down(box.bmin.y), round_down(box.bmin.z));
+        compact[i].box.bmax = Vector3f(round_up(box.bmax.x), round_up(box.bmax.y), round_up(box.bmax.z));
+        compact[i].offset = n.is_leaf() ? n.first_prim : n.right;
+        compact[i].count = n.is_leaf() ? n.prim_count : 0;
+    }
+    float_nodes.swap(compact);
+}
+
+void BVH::refit_motion(const std::vector<AABB> &open_bounds, const std::vector<AABB> &close_bounds) {
+    refit_bounds(close_bounds);
+    motion_boxes.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) motion_boxes[i] = nodes[i].box;
+    refit_bounds(open_bounds);
+}
+
+void BVH::sweep_motion_bounds() {
+    for (size_t i = 0; i < motion_boxes.size(); i++) nodes[i].box.expand(motion_boxes[i]);
+    motion_boxes.clear();
+    shutter_time = 0.0;
+    update_float_nodes();
+}
+
+void BVH::build(const std::vector<AABB> &prim_bounds, BVHBuilder builder, const ClipFn &clip) {
     nodes.clear();
+    prim_indices.clear();
+    unbounded.clear();
+    leaf_obbs.clear();
+    float_nodes.clear();
+    motion_boxes.clear();
+    shutter_time = 0.0;
+    if (prim_bounds.empty()) return;
+
+    if (unbounded_fraction <= 0.0) {
+        build_tree(prim_bounds, builder, clip);
+        return;
+    }
+
+    // 过大的图元放入无界列表，其余图元建树后把下标映射回原编号
+    AABB all;
+    for (const auto &b : prim_bounds) all.expand(b);
+    const double limit = all.surface_area() * unbounded_fraction;
+    std::vector<int> kept;
+    std::vector<AABB> kept_bounds;
+    for (int i = 0; i < (int)prim_bounds.size(); i++) {
+        if (prim_bounds[i].surface_area() > limit) {
+            unbounded.push_back(i);
+        } else {
+            kept.push_back(i);
+            kept_bounds.push_back(prim_bounds[i]);
+        }
+    }
+    if (kept.empty()) return;
+
+    ClipFn kept_clip;
+    if (clip) {
+        kept_clip = [&](int prim, const AABB &box, AABB &out) { return clip(kept[prim], box, out); };
+    }
+    build_tree(kept_bounds, builder, kept_clip);
+    for (int &idx : prim_indices) idx = kept[idx];
+}
 
-    int root_idx = build_recursive(scene, 0, prim_indices.size(), 0);
-    (void)root_idx; // 根节点已经在nodes[0]
+void BVH::build_tree(const std::vector<AABB> &prim_bounds, BVHBuilder builder, const ClipFn &clip) {
+    TIMELINE_SCOPE("bvh.build", (int)prim_bounds.size());
+    if (builder == BVHBuilder::LBVH) build_lbvh(prim_bounds);
+    else if (builder == BVHBuilder::SBVH) build_sbvh(prim_bounds, clip);
+    else build_sah(prim_bounds);
 }
 
-int BVH::build_recursive(const Scene &scene, int start, int end, int depth) {
-    BVHNode node;
+void BVH::build_sah(const std::vector<AABB> &prim_bounds) {
+    int n = (int)prim_bounds.size();
+
+    // 初始化对象索引
+    prim_indices.resize(n);
+    for (int i = 0; i < n; i++) {
+        prim_indices[i] = i;
+    }
+
+    BuildContext ctx{prim_bounds, std::vector<Vector3>(n), {}};
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+        ctx.centroids[i] = prim_bounds[i].center();
+    }
+    if (n >= PARALLEL_THRESHOLD) ctx.scratch.resize(n);
 
-    // 计算当前节点的AABB（包含所有对象的AABB）
-    for (int i = start; i < end; i++) {
-        int obj_idx = prim_indices[i];
-        const auto& obj = scene.objects[obj_idx];
+    // n 个图元的二叉树最多 2n-1 个节点：预先分配，左子树紧跟父节点，
+    // 右子树从 node_idx + 2*n_left 开始，各任务写互不重叠的区间，节点编号与调度无关
+    std::vector<BVHNode> tmp(2 * n - 1);
+    nodes.swap(tmp);
 
-        // 获取对象的AABB
-        Vector3 obj_bmin, obj_bmax;
-        obj->bounds(obj_bmin, obj_bmax);
+#pragma omp parallel
+#pragma omp single
+    build_recursive(ctx, 0, 0, n, 0);
 
-        // 更新当前节点的AABB
-        node.box.expand_point(obj_bmin);
-        node.box.expand_point(obj_bmax);
+    // 压缩掉叶子留下的空槽
+    reorder_depth_first();
+}
+
+void BVH::reorder_depth_first() {
+    std::vector<BVHNode> ordered;
+    ordered.reserve(nodes.size());
+    std::function<int(int)> emit = [&](int idx) -> int {
+        int out_idx = (int)ordered.size();
+        ordered.push_back(nodes[idx]);
+        if (!nodes[idx].is_leaf()) {
+            int l = emit(nodes[idx].left);
+            int r = emit(nodes[idx].right);
+            ordered[out_idx].left = l;
+            ordered[out_idx].right = r;
+        }
+        return out_idx;
+    };
+    emit(0);
+    nodes.swap(ordered);
+}
+
+void BVH::refit_bounds(const std::vector<AABB> &prim_bounds) {
+    for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+        BVHNode &node = nodes[i];
+        AABB box;
+        if (node.is_leaf()) {
+            for (int k = 0; k < node.prim_count; k++) box.expand(prim_bounds[prim_indices[node.first_prim + k]]);
+        } else {
+            box.expand(nodes[node.left].box);
+            box.expand(nodes[node.right].box);
+        }
+        node.box = box;
     }
+}
 
-    int node_idx = nodes.size();
-    nodes.push_back(node);
+void BVH::build_recursive(BuildContext &ctx, int node_idx, int start, int end, int depth) {
+    const int prim_count = end - start;
+    const bool parallel = prim_count >= PARALLEL_THRESHOLD;
 
-    int prim_count = end - start;
+    // 计算当前节点的AABB（包含所有对象的AABB）以及质心包围盒
+    AABB box, cbox;
+    if (parallel) {
+        std::vector<AABB> chunk_box(PARALLEL_CHUNKS), chunk_cbox(PARALLEL_CHUNKS);
+#pragma omp taskloop grainsize(1) shared(ctx, chunk_box, chunk_cbox)
+        for (int c = 0; c < PARALLEL_CHUNKS; c++) {
+            int s = start + (int)((long long)prim_count * c / PARALLEL_CHUNKS);
+            int e = start + (int)((long long)prim_count * (c + 1) / PARALLEL_CHUNKS);
+            for (int i = s; i < e; i++) {
+                int obj_idx = prim_indices[i];
+                chunk_box[c].expand(ctx.bounds[obj_idx]);
+                chunk_cbox[c].expand_point(ctx.centroids[obj_idx]);
+            }
+        }
+        for (int c = 0; c < PARALLEL_CHUNKS; c++) {
+            box.expand(chunk_box[c]);
+            cbox.expand(chunk_cbox[c]);
+        }
+    } else {
+        for (int i = start; i < end; i++) {
+            int obj_idx = prim_indices[i];
+            box.expand(ctx.bounds[obj_idx]);
+            cbox.expand_point(ctx.centroids[obj_idx]);
+        }
+    }
+
+    BVHNode &node = nodes[node_idx];
+    node.box = box;
 
     // 如果对象数量少或深度太大，创建叶子节点
-    if (prim_count <= 2 || depth > 40) {
-        nodes[node_idx].first_prim = start;
-        nodes[node_idx].prim_count = prim_count;
-        return node_idx;
+    if (prim_count <= 2 || depth >= MAX_BUILD_DEPTH) {
+        node.first_prim = start;
+        node.prim_count = prim_count;
+        return;
     }
 
-    // 选择分割轴和位置
-    Vector3 extent = node.box.bmax - node.box.bmin;
-    int axis = 0;
-    if (extent.y > extent.x) axis = 1;
-    if (extent.z > extent.x && extent.z > extent.y) axis = 2;  // 修正轴选择逻辑
+    // 分箱：按质心把图元分到各轴的桶中
+    Vector3 cext = cbox.bmax - cbox.bmin;
+    double lo[3] = {cbox.bmin.x, cbox.bmin.y, cbox.bmin.z};
+    double scale[3];
+    for (int a = 0; a < 3; a++) {
+        double e = axis_value(cext, a);
+        scale[a] = e > 1e-12 ? SAH_BINS / e : 0.0;
+    }
 
-    double split_pos;
-    if (axis == 0) split_pos = node.box.bmin.x + extent.x * 0.5;
-    else if (axis == 1) split_pos = node.box.bmin.y + extent.y * 0.5;
-    else split_pos = node.box.bmin.z + extent.z * 0.5;
+    auto bin_range = [&](BinSet &bs, int s, int e) {
+        for (int i = s; i < e; i++) {
+            int obj_idx = prim_indices[i];
+            const Vector3 &c = ctx.centroids[obj_idx];
+            for (int a = 0; a < 3; a++) {
+                if (scale[a] == 0.0) continue;
+                SAHBin &bin = bs.bins[a][bin_index(axis_value(c, a), lo[a], scale[a])];
+                bin.count++;
+                bin.box.expand(ctx.bounds[obj_idx]);
+            }
+        }
+    };
 
-    // 分割对象
-    int mid = start;
-    for (int i = start; i < end; i++) {
-        int obj_idx = prim_indices[i];
-        const auto& obj = scene.objects[obj_idx];
+    BinSet bins;
+    if (parallel) {
+        // 各分块独立分箱，再按固定顺序合并（min/max 与计数的合并与顺序无关）
+        std::vector<BinSet> chunk_bins(PARALLEL_CHUNKS);
+#pragma omp taskloop grainsize(1) shared(chunk_bins, bin_range)
+        for (int c = 0; c < PARALLEL_CHUNKS; c++) {
+            int s = start + (int)((long long)prim_count * c / PARALLEL_CHUNKS);
+            int e = start + (int)((long long)prim_count * (c + 1) / PARALLEL_CHUNKS);
+            bin_range(chunk_bins[c], s, e);
+        }
+        for (int c = 0; c < PARALLEL_CHUNKS; c++) bins.merge(chunk_bins[c]);
+    } else {
+        bin_range(bins, start, end);
+    }
 
-        // 使用对象AABB的中心进行分割
-        Vector3 obj_bmin, obj_bmax;
-        obj->bounds(obj_bmin, obj_bmax);
-        Vector3 center = (obj_bmin + obj_bmax) * 0.5;
+    // 扫描桶边界，寻找 SAH 代价最小的分割
+    double node_area = std::max(box.surface_area(), 1e-12);
+    double best_cost = std::numeric_limits<double>::infinity();
+    int best_axis = -1, best_split = -1;
+    for (int a = 0; a < 3; a++) {
+        if (scale[a] == 0.0) continue;
 
-        double center_component;
-        if (axis == 0) center_component = center.x;
-        else if (axis == 1) center_component = center.y;
-        else center_component = center.z;
+        double right_area[SAH_BINS];
+        int right_count[SAH_BINS];
+        AABB acc;
+        int cnt = 0;
+        for (int b = SAH_BINS - 1; b > 0; b--) {
+            acc.expand(bins.bins[a][b].box);
+            cnt += bins.bins[a][b].count;
+            right_area[b] = cnt ? acc.surface_area() : 0.0;
+            right_count[b] = cnt;
+        }
 
-        if (center_component < split_pos) {
-            std::swap(prim_indices[i], prim_indices[mid]);
-            mid++;
+        acc = AABB();
+        cnt = 0;
+        for (int b = 0; b < SAH_BINS - 1; b++) {
+            acc.expand(bins.bins[a][b].box);
+            cnt += bins.bins[a][b].count;
+            if (cnt == 0 || right_count[b + 1] == 0) continue;
+            double cost = TRAVERSAL_COST + INTERSECT_COST *
+                (acc.surface_area() * cnt + right_area[b + 1] * right_count[b + 1]) / node_area;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = a;
+                best_split = b;
+            }
         }
     }
 
-    // 如果分割失败，创建叶子节点
-    if (mid == start || mid == end) {
-        // 尝试不同的分割策略
-        mid = start + (end - start) / 2;
+    // 不分割更便宜时创建叶子节点
+    double leaf_cost = INTERSECT_COST * prim_count;
+    if (best_axis >= 0 && leaf_cost <= best_cost && prim_count <= MAX_LEAF_PRIMS) {
+        node.first_prim = start;
+        node.prim_count = prim_count;
+        return;
+    }
+
+    int mid;
+    if (best_axis < 0) {
+        // 质心全部重合，无法按空间分割：按索引对半分
+        if (prim_count <= MAX_LEAF_PRIMS) {
+            node.first_prim = start;
+            node.prim_count = prim_count;
+            return;
+        }
+        mid = start + prim_count / 2;
+    } else {
+        auto goes_left = [&](int obj_idx) {
+            double c = axis_value(ctx.centroids[obj_idx], best_axis);
+            return bin_index(c, lo[best_axis], scale[best_axis]) <= best_split;
+        };
 
-        // 如果还是失败，创建叶子节点
-        if (mid == start || mid == end) {
-            nodes[node_idx].first_prim = start;
-            nodes[node_idx].prim_count = prim_count;
-            return node_idx;
+        if (parallel) {
+            // 稳定的并行划分：分块计数 -> 前缀和 -> 分散写入临时缓冲
+            std::vector<int> left_count(PARALLEL_CHUNKS), left_off(PARALLEL_CHUNKS), right_off(PARALLEL_CHUNKS);
+#pragma omp taskloop grainsize(1) shared(left_count, goes_left)
+            for (int c = 0; c < PARALLEL_CHUNKS; c++) {
+                int s = start + (int)((long long)prim_count * c / PARALLEL_CHUNKS);
+                int e = start + (int)((long long)prim_count * (c + 1) / PARALLEL_CHUNKS);
+                int k = 0;
+                for (int i = s; i < e; i++) k += goes_left(prim_indices[i]);
+                left_count[c] = k;
+            }
+            int total_left = 0;
+            for (int c = 0; c < PARALLEL_CHUNKS; c++) {
+                left_off[c] = start + total_left;
+                total_left += left_count[c];
+            }
+            int r = start + total_left;
+            for (int c = 0; c < PARALLEL_CHUNKS; c++) {
+                int s = start + (int)((long long)prim_count * c / PARALLEL_CHUNKS);
+                int e = start + (int)((long long)prim_count * (c + 1) / PARALLEL_CHUNKS);
+                right_off[c] = r;
+                r += (e - s) - left_count[c];
+            }
+#pragma omp taskloop grainsize(1) shared(ctx, left_off, right_off, goes_left)
+            for (int c = 0; c < PARALLEL_CHUNKS; c++) {
+                int s = start + (int)((long long)prim_count * c / PARALLEL_CHUNKS);
+                int e = start + (int)((long long)prim_count * (c + 1) / PARALLEL_CHUNKS);
+                int l_out = left_off[c], r_out = right_off[c];
+                for (int i = s; i < e; i++) {
+                    int obj_idx = prim_indices[i];
+                    if (goes_left(obj_idx)) ctx.scratch[l_out++] = obj_idx;
+                    else ctx.scratch[r_out++] = obj_idx;
+                }
+            }
+            std::copy(ctx.scratch.begin() + start, ctx.scratch.begin() + end, prim_indices.begin() + start);
+            mid = start + total_left;
+        } else {
+            mid = (int)(std::partition(prim_indices.begin() + start, prim_indices.begin() + end, goes_left)
+                        - prim_indices.begin());
         }
     }
 
-    // 递归构建子节点
-    nodes[node_idx].left = build_recursive(scene, start, mid, depth + 1);
-    nodes[node_idx].right = build_recursive(scene, mid, end, depth + 1);
+    int left_idx = node_idx + 1;
+    int right_idx = node_idx + 2 * (mid - start);
+    node.left = left_idx;
+    node.right = right_idx;
 
-    return node_idx;
+    // 递归构建子节点：大子树作为任务并行
+    if (prim_count >= TASK_THRESHOLD) {
+#pragma omp task default(shared) firstprivate(left_idx, start, mid, depth)
+        build_recursive(ctx, left_idx, start, mid, depth + 1);
+        build_recursive(ctx, right_idx, mid, end, depth + 1);
+#pragma omp taskwait
+    } else {
+        build_recursive(ctx, left_idx, start, mid, depth + 1);
+        build_recursive(ctx, right_idx, mid, end, depth + 1);
+    }
+}
+
+// ---------------- LBVH（Karras 2012） ----------------
+namespace {
+// 把 10 位整数的每一位之间插入两个 0
+inline uint32_t expand_bits(uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// 30 位 Morton 码，p 为 [0,1]^3 内的归一化坐标
+inline uint32_t morton3d(double x, double y, double z) {
+    auto q = [](double v) { return (uint32_t)std::clamp(v * 1024.0, 0.0, 1023.0); };
+    return (expand_bits(q(x)) << 2) | (expand_bits(q(y)) << 1) | expand_bits(q(z));
+}
+
+// 并行 LSD 基数排序（每趟 8 位）。稳定排序，结果与分块方式无关
+void radix_sort_pairs(std::vector<uint32_t> &keys, std::vector<int> &vals) {
+    const int n = (int)keys.size();
+    std::vector<uint32_t> keys_tmp(n);
+    std::vector<int> vals_tmp(n);
+    const int chunks = std::max(1, std::min(omp_get_max_threads() * 4, n / 4096));
+
+    std::vector<std::array<int, 256>> hist(chunks);
+    for (int shift = 0; shift < 32; shift += 8) {
+#pragma omp parallel for schedule(static)
+        for (int c = 0; c < chunks; c++) {
+            hist[c].fill(0);
+            int s = (int)((long long)n * c / chunks), e = (int)((long long)n * (c + 1) / chunks);
+            for (int i = s; i < e; i++) hist[c][(keys[i] >> shift) & 0xFF]++;
+        }
+
+        // 按 (桶, 分块) 顺序求前缀和，保证稳定
+        int offset = 0;
+        for (int d = 0; d < 256; d++) {
+            for (int c = 0; c < chunks; c++) {
+                int cnt = hist[c][d];
+                hist[c][d] = offset;
+                offset += cnt;
+            }
+        }
+
+#pragma omp parallel for schedule(static)
+        for (int c = 0; c < chunks; c++) {
+            int s = (int)((long long)n * c / chunks), e = (int)((long long)n * (c + 1) / chunks);
+            for (int i = s; i < e; i++) {
+                int dst = hist[c][(keys[i] >> shift) & 0xFF]++;
+                keys_tmp[dst] = keys[i];
+                vals_tmp[dst] = vals[i];
+            }
+        }
+        keys.swap(keys_tmp);
+        vals.swap(vals_tmp);
+    }
 }
+} // namespace
+
+void BVH::build_lbvh(const std::vector<AABB> &prim_bounds) {
+    const int n = (int)prim_bounds.size();
 
-bool BVH::intersect(const Ray &ray, Hit &hit, const Scene &scene) const {
-    if (nodes.empty()) return false;
+    // 质心包围盒
+    AABB cbox;
+    for (const auto &b : prim_bounds) cbox.expand_point(b.center());
+    Vector3 ext = cbox.bmax - cbox.bmin;
+    Vector3 inv(ext.x > 1e-12 ? 1.0 / ext.x : 0.0,
+                ext.y > 1e-12 ? 1.0 / ext.y : 0.0,
+                ext.z > 1e-12 ? 1.0 / ext.z : 0.0);
+
+    // 1. 计算每个图元质心的 Morton 码
+    std::vector<uint32_t> codes(n);
+    prim_indices.resize(n);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+        Vector3 c = (prim_bounds[i].center() - cbox.bmin) * inv;
+        codes[i] = morton3d(c.x, c.y, c.z);
+        prim_indices[i] = i;
+    }
 
-    // 保存原始t值用于恢复
-    double original_t = hit.t;
-    bool found = intersect_recursive(ray, hit, scene, 0);
+    // 2. 并行基数排序
+    radix_sort_pairs(codes, prim_indices);
 
-    // 如果没有找到交点，恢复原始t值
-    if (!found) {
-        hit.t = original_t;
+    // 3. 并行生成层次结构：内部节点 0..n-2，叶子 j 存放在 n-1+j
+    nodes.assign(2 * n - 1, BVHNode());
+    for (int j = 0; j < n; j++) {
+        nodes[n - 1 + j].first_prim = j;
+        nodes[n - 1 + j].prim_count = 1;
     }
 
-    return found;
+    // 相邻键的公共前缀长度；Morton 码相同时用索引区分
+    auto delta = [&](int i, int j) -> int {
+        if (j < 0 || j >= n) return -1;
+        uint32_t a = codes[i], b = codes[j];
+        if (a == b) return 32 + std::countl_zero((uint32_t)(i ^ j));
+        return std::countl_zero(a ^ b);
+    };
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n - 1; i++) {
+        // 确定覆盖区间的方向
+        int d = (delta(i, i + 1) - delta(i, i - 1)) >= 0 ? 1 : -1;
+        int delta_min = delta(i, i - d);
+
+        // 区间另一端的上界，再二分求精确位置
+        int lmax = 2;
+        while (delta(i, i + lmax * d) > delta_min) lmax *= 2;
+        int l = 0;
+        for (int t = lmax / 2; t >= 1; t /= 2) {
+            if (delta(i, i + (l + t) * d) > delta_min) l += t;
+        }
+        int j = i + l * d;
+
+        // 二分查找分割位置
+        int delta_node = delta(i, j);
+        int split = 0;
+        int t = l;
+        do {
+            t = (t + 1) / 2;
+            if (delta(i, i + (split + t) * d) > delta_node) split += t;
+        } while (t > 1);
+        int gamma = i + split * d + std::min(d, 0);
+
+        nodes[i].left  = (std::min(i, j) == gamma)     ? n - 1 + gamma     : gamma;
+        nodes[i].right = (std::max(i, j) == gamma + 1) ? n - 1 + gamma + 1 : gamma + 1;
+    }
+
+    // 4. 转为深度优先顺序并自底向上计算包围盒
+    reorder_depth_first();
+    refit_bounds(prim_bounds);
+
+    // 5. 叶子合并：Morton 顺序下每个子树覆盖连续的图元区间，SAH 更优时把小子树压成一个叶子
+    std::vector<int> first(nodes.size()), count(nodes.size());
+    std::vector<double> cost(nodes.size());
+    double root_area = std::max(nodes[0].box.surface_area(), 1e-12);
+    bool collapsed = false;
+    for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+        BVHNode &node = nodes[i];
+        double area = node.box.surface_area() / root_area;
+        if (node.is_leaf()) {
+            first[i] = node.first_prim;
+            count[i] = node.prim_count;
+            cost[i] = area * INTERSECT_COST * node.prim_count;
+            continue;
+        }
+        first[i] = first[node.left];
+        count[i] = count[node.left] + count[node.right];
+        cost[i] = area * TRAVERSAL_COST + cost[node.left] + cost[node.right];
+        double leaf_cost = area * INTERSECT_COST * count[i];
+        if (count[i] <= MAX_LEAF_PRIMS && leaf_cost <= cost[i]) {
+            node.first_prim = first[i];
+            node.prim_count = count[i];
+            cost[i] = leaf_cost;
+            collapsed = true;
+        }
+    }
+    if (collapsed) {
+        for (auto &node : nodes) {
+            if (node.is_leaf()) node.left = node.right = -1;
+        }
+        reorder_depth_first();
+    }
+}
+
+// ---------------- SBVH（Stich, Friedrich, Dietrich 2009） ----------------
+namespace {
+// 最优对象分割的两个子节点重叠面积超过根节点表面积的该比例时才尝试空间分割
+constexpr double SBVH_ALPHA = 1e-5;
+// 空间分割复制引用后，引用总数不超过图元数的该倍数
+constexpr double SBVH_MAX_REFS = 2.0;
+
+// 空间分割的桶：裁剪到桶内的引用包围盒，以及在此进入 / 离开的引用数
+struct SpatialBin {
+    AABB box;
+    int enter = 0;
+    int exit = 0;
+};
+
+// 把图元引用裁剪到 box（已是引用包围盒的子集）内；clip 为空时直接取 box
+bool clip_reference(const BVH::ClipFn &clip, int prim, const AABB &box, AABB &out) {
+    if (!box.valid()) return false;
+    if (!clip) {
+        out = box;
+        return true;
+    }
+    AABB part;
+    if (!clip(prim, box, part)) return false;
+    out = AABB::intersection(part, box);
+    return out.valid();
+}
+} // namespace
+
+struct BVH::Reference {
+    AABB box; // 图元被裁剪后的包围盒
+    int prim;
+};
+
+struct BVH::SpatialContext {
+    const ClipFn &clip;
+    double root_area;
+    size_t max_refs;
+    size_t ref_count;
+};
+
+void BVH::build_sbvh(const std::vector<AABB> &prim_bounds, const ClipFn &clip) {
+    const int n = (int)prim_bounds.size();
+    std::vector<Reference> refs(n);
+    AABB root;
+    for (int i = 0; i < n; i++) {
+        refs[i] = {prim_bounds[i], i};
+        root.expand(prim_bounds[i]);
+    }
+
+    // 串行构建：父节点先入 nodes，随后是左子树、右子树，直接得到深度优先顺序
+    SpatialContext ctx{clip, std::max(root.surface_area(), 1e-12), (size_t)(n * SBVH_MAX_REFS), (size_t)n};
+    nodes.reserve(2 * n);
+    prim_indices.reserve(n);
+    build_sbvh_recursive(ctx, refs, 0);
 }
 
-bool BVH::intersect_recursive(const Ray &ray, Hit &hit, const Scene &scene, int node_idx) const {
-    const BVHNode& node = nodes[node_idx];
+int BVH::build_sbvh_recursive(SpatialContext &ctx, std::vector<Reference> &refs, int depth) {
+    const int node_idx = (int)nodes.size();
+    nodes.emplace_back();
+    const int count = (int)refs.size();
+
+    AABB box, cbox;
+    for (const auto &r : refs) {
+        box.expand(r.box);
+        cbox.expand_point(r.box.center());
+    }
+    nodes[node_idx].box = box;
+
+    auto make_leaf = [&]() {
+        nodes[node_idx].first_prim = (int)prim_indices.size();
+        nodes[node_idx].prim_count = count;
+        for (const auto &r : refs) prim_indices.push_back(r.prim);
+        return node_idx;
+    };
+    if (count <= 2 || depth >= MAX_BUILD_DEPTH) return make_leaf();
+
+    const double node_area = std::max(box.surface_area(), 1e-12);
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // 1. 对象分割：与 build_recursive 相同的质心分箱 SAH，同时记录两侧包围盒以计算重叠
+    double obj_cost = inf;
+    int obj_axis = -1, obj_split = -1;
+    AABB obj_left, obj_right;
+    double clo[3], cscale[3];
+    for (int a = 0; a < 3; a++) {
+        double e = axis_value(cbox.bmax, a) - axis_value(cbox.bmin, a);
+        clo[a] = axis_value(cbox.bmin, a);
+        cscale[a] = e > 1e-12 ? SAH_BINS / e : 0.0;
+        if (cscale[a] == 0.0) continue;
+
+        SAHBin bins[SAH_BINS];
+        for (const auto &r : refs) {
+            SAHBin &bin = bins[bin_index(axis_value(r.box.center(), a), clo[a], cscale[a])];
+            bin.count++;
+            bin.box.expand(r.box);
+        }
+
+        AABB right_box[SAH_BINS];
+        int right_count[SAH_BINS];
+        AABB acc;
+        int cnt = 0;
+        for (int b = SAH_BINS - 1; b > 0; b--) {
+            acc.expand(bins[b].box);
+            cnt += bins[b].count;
+            right_box[b] = acc;
+            right_count[b] = cnt;
+        }
+        acc = AABB();
+        cnt = 0;
+        for (int b = 0; b < SAH_BINS - 1; b++) {
+            acc.expand(bins[b].box);
+            cnt += bins[b].count;
+            if (cnt == 0 || right_count[b + 1] == 0) continue;
+            double cost = TRAVERSAL_COST + INTERSECT_COST *
+                (acc.surface_area() * cnt + right_box[b + 1].surface_area() * right_count[b + 1]) / node_area;
+            if (cost < obj_cost) {
+                obj_cost = cost;
+                obj_axis = a;
+                obj_split = b;
+                obj_left = acc;
+                obj_right = right_box[b + 1];
+            }
+        }
+    }
+
+    // 2. 空间分割：对象分割的子节点明显重叠（或质心重合无法对象分割）时，
+    //    在节点包围盒上等距分桶，跨越多个桶的引用按桶裁剪
+    double sp_cost = inf;
+    int sp_axis = -1;
+    double sp_pos = 0.0;
+    bool try_spatial = ctx.ref_count < ctx.max_refs;
+    if (try_spatial && obj_axis >= 0) {
+        AABB overlap = AABB::intersection(obj_left, obj_right);
+        try_spatial = overlap.valid() && overlap.surface_area() > SBVH_ALPHA * ctx.root_area;
+    }
+    if (try_spatial) {
+        for (int a = 0; a < 3; a++) {
+            const double lo = axis_value(box.bmin, a);
+            const double ext = axis_value(box.bmax, a) - lo;
+            if (ext <= 1e-12) continue;
+            const double width = ext / SAH_BINS, scale = SAH_BINS / ext;
 
-    // 检查与AABB的相交
-    double t_min = 0.001;  // 避免自相交
-    double t_max = hit.t;  // 使用当前最近交点的t值进行优化
-    if (!node.box.intersect(ray, t_min, t_max)) {
-        return false;
+            SpatialBin bins[SAH_BINS];
+            for (const auto &r : refs) {
+                int b0 = bin_index(axis_value(r.box.bmin, a), lo, scale);
+                int b1 = bin_index(axis_value(r.box.bmax, a), lo, scale);
+                bins[b0].enter++;
+                bins[b1].exit++;
+                if (b0 == b1) {
+                    bins[b0].box.expand(r.box);
+                    continue;
+                }
+                for (int b = b0; b <= b1; b++) {
+                    AABB slab = r.box;
+                    if (b > b0) set_axis(slab.bmin, a, lo + b * width);
+                    if (b < b1) set_axis(slab.bmax, a, lo + (b + 1) * width);
+                    AABB part;
+                    if (clip_reference(ctx.clip, r.prim, slab, part)) bins[b].box.expand(part);
+                }
+            }
+
+            double right_area[SAH_BINS];
+            int right_count[SAH_BINS];
+            AABB acc;
+            int cnt = 0;
+            for (int b = SAH_BINS - 1; b > 0; b--) {
+                acc.expand(bins[b].box);
+                cnt += bins[b].exit;
+                right_area[b] = cnt ? acc.surface_area() : 0.0;
+                right_count[b] = cnt;
+            }
+            acc = AABB();
+            cnt = 0;
+            for (int b = 0; b < SAH_BINS - 1; b++) {
+                acc.expand(bins[b].box);
+                cnt += bins[b].enter;
+                if (cnt == 0 || right_count[b + 1] == 0) continue;
+                double cost = TRAVERSAL_COST + INTERSECT_COST *
+                    (acc.surface_area() * cnt + right_area[b + 1] * right_count[b + 1]) / node_area;
+                if (cost < sp_cost) {
+                    sp_cost = cost;
+                    sp_axis = a;
+                    sp_pos = lo + (b + 1) * width;
+                }
+            }
+        }
     }
 
-    bool found_hit = false;
+    // 不分割更便宜时创建叶子节点
+    const double best_cost = std::min(obj_cost, sp_cost);
+    const double leaf_cost = INTERSECT_COST * count;
+    if (count <= MAX_LEAF_PRIMS && (best_cost == inf || leaf_cost <= best_cost)) return make_leaf();
 
-    // 如果是叶子节点，检查所有对象
-    if (node.is_leaf()) {
-        for (int i = 0; i < node.prim_count; i++) {
-            int obj_idx = prim_indices[node.first_prim + i];
-            if (scene.objects[obj_idx]->intersect(ray, hit)) {
-                found_hit = true;
+    std::vector<Reference> left, right;
+    if (sp_cost < obj_cost) {
+        for (const auto &r : refs) {
+            if (axis_value(r.box.bmax, sp_axis) <= sp_pos) {
+                left.push_back(r);
+            } else if (axis_value(r.box.bmin, sp_axis) >= sp_pos) {
+                right.push_back(r);
+            } else {
+                // 跨越分割面的引用裁剪到两侧；两侧都裁空只可能是数值误差，按包围盒保留
+                AABB lbox = r.box, rbox = r.box, lpart, rpart;
+                set_axis(lbox.bmax, sp_axis, sp_pos);
+                set_axis(rbox.bmin, sp_axis, sp_pos);
+                bool hl = clip_reference(ctx.clip, r.prim, lbox, lpart);
+                bool hr = clip_reference(ctx.clip, r.prim, rbox, rpart);
+                if (!hl && !hr) {
+                    hl = hr = true;
+                    lpart = lbox;
+                    rpart = rbox;
+                }
+                if (hl) left.push_back({lpart, r.prim});
+                if (hr) right.push_back({rpart, r.prim});
+                if (hl && hr) ctx.ref_count++;
             }
         }
-        return found_hit;
+    } else if (obj_axis >= 0) {
+        for (const auto &r : refs) {
+            bool goes_left = bin_index(axis_value(r.box.center(), obj_axis), clo[obj_axis], cscale[obj_axis]) <= obj_split;
+            (goes_left ? left : right).push_back(r);
+        }
+    }
+
+    if (left.empty() || right.empty()) {
+        // 无法按空间分割：按引用顺序对半分
+        if (count <= MAX_LEAF_PRIMS) return make_leaf();
+        left.assign(refs.begin(), refs.begin() + count / 2);
+        right.assign(refs.begin() + count / 2, refs.end());
+    }
+    std::vector<Reference>().swap(refs); // 子树构建期间不再需要父节点的引用
+
+    int left_idx = build_sbvh_recursive(ctx, left, depth + 1);
+    int right_idx = build_sbvh_recursive(ctx, right, depth + 1);
+    nodes[node_idx].left = left_idx;
+    nodes[node_idx].right = right_idx;
+    return node_idx;
+}
+
+double BVH::sah_cost() const {
+    // 无界列表中的图元每条光线都要测试
+    double cost = INTERSECT_COST * unbounded.size();
+    if (nodes.empty()) return cost;
+    double root_area = std::max(nodes[0].box.surface_area(), 1e-12);
+    for (const auto &n : nodes) {
+        double a = n.box.surface_area() / root_area;
+        cost += n.is_leaf() ? a * n.prim_count * INTERSECT_COST : a * TRAVERSAL_COST;
     }
+    return cost;
+}
 
-    // 内部节点，递归检查子节点
-    bool hit_left = intersect_recursive(ray, hit, scene, node.left);
-    bool hit_right = intersect_recursive(ray, hit, scene, node.right);
+size_t BVH::memory_bytes() const {
+    return nodes.capacity() * sizeof(BVHNode) + prim_indices.capacity() * sizeof(int) +
+           motion_boxes.capacity() * sizeof(AABB) + unbounded.capacity() * sizeof(int) +
+           leaf_obbs.capacity() * sizeof(OBB) + float_nodes.capacity() * sizeof(BVHNodef);
+}
+
+bool BVH::intersect(const Ray &ray, Hit &hit, const Scene &scene, TraversalStats *stats) const {
+    return traverse(ray, hit, [&](int obj_idx) {
+        return scene.objects[obj_idx]->intersect_at_time(ray, hit);
+    }, stats);
+}
 
-    return hit_left || hit_right;
+bool BVH::intersect(const Rayf &ray, Hitf &hit, const Scene &scene, TraversalStats *stats) const {
+    return traverse(ray, hit, [&](int obj_idx) {
+        return scene.objects[obj_idx]->intersect_at_time(ray, hit);
+    }, stats);
 }
@@ -5,21 +5,55 @@
 #ifndef GRAPHIC_BVH_H
 #define GRAPHIC_BVH_H
 #pragma once
-#include "Scene.h"
+#include "Shape.h"
+#include "RenderStats.h"
 #include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
 
-struct AABB {
-    Vector3 bmin, bmax;
-    AABB();
-    void expand(const AABB &o);
-    void expand_point(const Vector3 &p);
-    bool intersect(const Ray &ray, double tmin, double tmax) const;
+struct Scene;
+
+// 轴对齐包围盒，按标量类型模板化（方法在 BVH.cpp 中对 double / float 显式实例化）
+template <typename T>
+struct AABBT {
+    Vec3<T> bmin, bmax;
+    AABBT();
+    void expand(const AABBT &o);
+    void expand_point(const Vec3<T> &p);
+    bool intersect(const RayT<T> &ray, T tmin, T tmax) const;
+    // 同时返回光线进入包围盒的距离（用于由近到远遍历）
+    bool intersect(const RayT<T> &ray, T tmin, T tmax, T &t_enter) const;
     // 计算AABB的表面积（用于SAH）
-    double surface_area() const;
+    T surface_area() const;
     // 计算AABB的中心点
-    Vector3 center() const;
+    Vec3<T> center() const;
+    // 线性插值：s=0 为 a，s=1 为 b
+    static AABBT lerp(const AABBT &a, const AABBT &b, double s);
+    // 两个包围盒的交集（不相交时 valid() 为 false）
+    static AABBT intersection(const AABBT &a, const AABBT &b);
+    bool valid() const { return bmin.x <= bmax.x && bmin.y <= bmax.y && bmin.z <= bmax.z; }
+};
+
+using AABB = AABBT<double>;
+using AABBf = AABBT<float>;
+
+// 有向包围盒，预先存为 世界 -> 单位盒 [-1,1]^3 的变换：p_unit = to_unit * (p - center)，
+// 求交只需两次矩阵乘法加单位盒 slab 测试
+struct OBB {
+    Matrix3 to_unit;
+    Vector3 center;
+    bool active = false; // false 表示图元没有更紧的有向包围盒，不做剔除
+
+    static OBB from(const Vector3 &center, const Matrix3 &rot, const Vector3 &half);
+    // 光线在 [tmin, tmax] 内是否与盒子相交
+    bool intersect(const Ray &ray, double tmin, double tmax) const;
 };
 
+// 把凸多边形（三角形、Plane 四边形）裁剪到 box 内，返回裁剪后多边形的包围盒；完全在外时返回 false
+bool clip_polygon_bounds(const Vector3 *verts, int count, const AABB &box, AABB &out);
+
 struct BVHNode {
     AABB box;
     int left=-1, right=-1; // 子节点索引
@@ -29,16 +63,229 @@ struct BVHNode {
     bool is_leaf() const { return prim_count > 0; }
 };
 
+// 单精度紧凑节点（32 字节，一条缓存行两个；BVHNode 为 64 字节）：包围盒向外取整保证保守，
+// 左子节点紧跟父节点（深度优先），只存右子节点或叶子区间
+struct BVHNodef {
+    AABBf box;
+    int offset = -1; // 内部节点：右子节点；叶子：first_prim
+    int count = 0;   // 叶子的图元数，0 表示内部节点
+
+    bool is_leaf() const { return count > 0; }
+};
+
+// BVH 构建算法
+enum class BVHBuilder : uint32_t {
+    SAH  = 0, // 自顶向下分箱 SAH：构建较慢，树质量高
+    LBVH = 1, // Morton 码线性 BVH：构建极快，适合每帧重建
+    SBVH = 2, // 带空间分割的 SAH（Stich 2009）：大图元的引用被裁剪到两侧子节点，节点重叠少，构建最慢
+};
+
+// 遍历统计，用于比较树质量
+struct TraversalStats {
+    long long nodes = 0;       // 访问的节点数
+    long long prims = 0;       // 图元求交次数
+    long long prim_hits = 0;   // 其中找到更近交点的次数（其余为包围盒误报）
+    long long obb_rejects = 0; // 被叶子中的有向包围盒提前剔除、没有求交的图元数
+};
+
+// 节点按深度优先顺序存放：nodes[0] 为根，子节点索引总是大于父节点索引
 struct BVH {
     std::vector<BVHNode> nodes;
     std::vector<int> prim_indices; // 对象索引
 
-    void build(const Scene &scene);
-    bool intersect(const Ray &ray, Hit &hit, const Scene &scene) const;
+    // 运动 BVH：场景中有带速度的物体且相机快门时间 > 0 时，nodes[i].box 为快门开启时刻的包围盒，
+    // motion_boxes[i] 为快门关闭（shutter_time）时刻的包围盒，遍历时按光线时间插值；静止场景为空
+    std::vector<AABB> motion_boxes;
+    double shutter_time = 0.0;
+
+    // 无界列表：包围盒表面积超过全部图元包围盒 unbounded_fraction 倍的图元（地板、墙面等大 Plane）
+    // 不进入树，每条光线在遍历前先逐个测试。unbounded_fraction 为 0 时关闭（构建前设置）
+    std::vector<int> unbounded;
+    double unbounded_fraction = 0.0;
+
+    // 叶子中的有向包围盒：与 prim_indices 一一对应（无则为空）。旋转的 Cube 等图元的轴对齐包围盒
+    // 远大于图元本身，求交前先做有向包围盒测试，不必访问图元对象。use_obbs 为 false 时不生成
+    std::vector<OBB> leaf_obbs;
+    bool use_obbs = true;
+
+    // 单精度路径的紧凑节点：与 nodes 一一对应（运动 BVH 取开启 / 关闭时刻的并集），use_float_nodes 为 false 时为空
+    std::vector<BVHNodef> float_nodes;
+    bool use_float_nodes = false;
+
+    // SBVH 空间分割时裁剪图元引用：输出图元 prim 在 box 内部分的包围盒，与 box 不相交时返回 false
+    using ClipFn = std::function<bool(int prim, const AABB &box, AABB &out)>;
+
+    void build(const Scene &scene, BVHBuilder builder = BVHBuilder::SAH);
+    // 由图元包围盒构建（OpenMP 并行；结果与线程数无关）。
+    // SBVH 的 prim_indices 中同一图元可能出现多次；clip 为空时按包围盒求交裁剪
+    void build(const std::vector<AABB> &prim_bounds, BVHBuilder builder = BVHBuilder::SAH,
+               const ClipFn &clip = nullptr);
+    bool intersect(const Ray &ray, Hit &hit, const Scene &scene, TraversalStats *stats = nullptr) const;
+    // 单精度求交：有 float_nodes 时节点和图元都在 float 中测试，否则节点按双精度测试
+    bool intersect(const Rayf &ray, Hitf &hit, const Scene &scene, TraversalStats *stats = nullptr) const;
+
+    // 通用遍历：先测试无界列表，再对光线经过的叶子中的每个图元调用 hit_prim(prim_index)，
+    // hit_prim 命中时须缩短 hit.t 并返回 true；场景级和网格内的 BVH 共用此遍历。stats 非空时累计访问计数
+    template <typename T, typename PrimFn>
+    bool traverse(const RayT<T> &ray, HitT<T> &hit, PrimFn &&hit_prim, TraversalStats *stats = nullptr) const;
+
+    // 保持拓扑不变，按对象当前几何自底向上重算包围盒（动画帧之间使用）
+    void refit(const Scene &scene);
+
+    // 增量更新（热重载）：只有 changed 中的对象几何改变时，只重算这些对象所在叶子到根路径上的包围盒；
+    // 路径上某个节点的表面积增长超过 LOCAL_REBUILD_GROWTH 倍时，在其中最高的节点的子树上局部重建 SAH
+    // （子树的图元区间不变，其余节点只调整编号）。返回局部重建的图元数，0 表示只做了 refit；
+    // 无法就地更新（SBVH 的重复引用、无界列表中的对象、根节点需要重建）时返回 -1，由调用者完整重建
+    int update_objects(const Scene &scene, const std::vector<int> &changed);
+
+    // 按对象当前几何重新生成 leaf_obbs（build / refit / 加载缓存时自动调用）
+    void update_leaf_obbs(const Scene &scene);
+    // 由 nodes（及 motion_boxes）重新生成 float_nodes（调用时机同上）
+    void update_float_nodes();
+
+    // 把运动 BVH 退化为扫掠包围盒（每个节点取开启/关闭时刻的并集），仅用于对比
+    void sweep_motion_bounds();
+
+    // 节点、索引、运动包围盒、无界列表、有向包围盒和紧凑节点占用的字节数
+    size_t memory_bytes() const;
+
+    // 树质量：SAH 代价（相对根节点表面积归一化）
+    double sah_cost() const;
+
+    // 全部对象在 time 时刻的包围盒（并行计算）
+    static std::vector<AABB> object_bounds(const Scene &scene, double time = 0.0);
+    // 需要运动 BVH 时返回快门时间，否则返回 0
+    static double motion_shutter(const Scene &scene);
+
+    // SAH 代价模型参数
+    static constexpr double TRAVERSAL_COST = 0.125;
+    static constexpr double INTERSECT_COST = 1.0;
+    // 有向包围盒表面积小于轴对齐包围盒的该比例时才在叶子中保存
+    static constexpr double OBB_AREA_RATIO = 0.9;
+    // update_objects 中节点表面积增长超过该倍数时局部重建其子树
+    static constexpr double LOCAL_REBUILD_GROWTH = 1.5;
 
 private:
-    int build_recursive(const Scene &scene, int start, int end, int depth = 0);
-    bool intersect_recursive(const Ray &ray, Hit &hit, const Scene &scene, int node_idx) const;
+    struct BuildContext;
+    struct SpatialContext;
+    struct Reference;
+    void build_tree(const std::vector<AABB> &prim_bounds, BVHBuilder builder, const ClipFn &clip);
+    void build_sah(const std::vector<AABB> &prim_bounds);
+    void build_recursive(BuildContext &ctx, int node_idx, int start, int end, int depth);
+    void build_sbvh(const std::vector<AABB> &prim_bounds, const ClipFn &clip);
+    int build_sbvh_recursive(SpatialContext &ctx, std::vector<Reference> &refs, int depth);
+    void build_lbvh(const std::vector<AABB> &prim_bounds);
+    // 把任意编号的树重排为深度优先顺序（根为 0，左子树紧跟父节点）
+    void reorder_depth_first();
+    // 自底向上重新计算全部节点包围盒（依赖深度优先顺序：子节点编号大于父节点）
+    void refit_bounds(const std::vector<AABB> &prim_bounds);
+    // 按快门开启 / 关闭时刻的图元包围盒分别 refit，填充 nodes[i].box 和 motion_boxes
+    void refit_motion(const std::vector<AABB> &open_bounds, const std::vector<AABB> &close_bounds);
+    // 在以 root（深度 root_depth）为根的子树上按 SAH 重建，新节点替换原子树的节点区间；返回图元数。
+    // 图元区间不连续、或新子树会使整棵树深度超过构建上限（遍历栈按该深度设定）时返回 -1，由调用方完整重建
+    int rebuild_subtree(const Scene &scene, int root, int root_depth);
 };
 
-#endif //GRAPHIC_BVH_H
\ No newline at end of file
+template <typename T, typename PrimFn>
+bool BVH::traverse(const RayT<T> &ray, HitT<T> &hit, PrimFn &&hit_prim, TraversalStats *stats) const {
+    bool found = false;
+    for (int idx : unbounded) {
+        bool h = hit_prim(idx);
+        found |= h;
+        if (stats) {
+            stats->prims++;
+            stats->prim_hits += h;
+        }
+    }
+    if (nodes.empty()) return found;
+
+    // 单精度光线且有紧凑节点时只访问 float_nodes；否则按双精度节点测试
+    const bool compact = std::is_same_v<T, float> && !float_nodes.empty();
+    const Ray ray_d(ray);
+    // 次级光线起点已偏移到表面之外，包围盒测试从 0 开始
+    const double s = motion_boxes.empty() ? 0.0 : std::clamp(ray.time / shutter_time, 0.0, 1.0);
+
+    // 节点包围盒求交；运动 BVH 按光线时间插值。hit.t 为当前最近交点，更远的节点直接跳过
+    auto enter = [&](int idx, T &t_enter) -> bool {
+        RT_STAT(aabb_tests);
+        if constexpr (std::is_same_v<T, float>) {
+            if (compact) return float_nodes[idx].box.intersect(ray, 0.0f, hit.t, t_enter);
+        }
+        double te;
+        bool h = motion_boxes.empty()
+                     ? nodes[idx].box.intersect(ray_d, 0.0, static_cast<double>(hit.t), te)
+                     : AABB::lerp(nodes[idx].box, motion_boxes[idx], s).intersect(ray_d, 0.0, static_cast<double>(hit.t), te);
+        t_enter = static_cast<T>(te);
+        return h;
+    };
+
+    // 显式栈代替递归，栈中保存节点及其进入距离；构建深度有上限，128 足够
+    struct Entry { int node; T t; };
+    Entry stack[128];
+    int sp = 0;
+    T t_root;
+    if (!enter(0, t_root)) return found;
+    stack[sp++] = {0, t_root};
+
+    while (sp > 0) {
+        Entry e = stack[--sp];
+        // 入栈后找到了更近的交点
+        if (e.t >= hit.t) continue;
+        if (stats) stats->nodes++;
+        RT_STAT(nodes);
+
+        int first, count, left, right;
+        if (compact) {
+            const BVHNodef &node = float_nodes[e.node];
+            first = node.offset;
+            count = node.count;
+            left = e.node + 1;
+            right = node.offset;
+        } else {
+            const BVHNode &node = nodes[e.node];
+            first = node.first_prim;
+            count = node.prim_count;
+            left = node.left;
+            right = node.right;
+        }
+
+        if (count > 0) {
+            for (int i = 0; i < count; i++) {
+                const int slot = first + i;
+                if (!leaf_obbs.empty() && leaf_obbs[slot].active &&
+                    !leaf_obbs[slot].intersect(ray_d, 0.0, static_cast<double>(hit.t))) {
+                    if (stats) stats->obb_rejects++;
+                    continue;
+                }
+                bool h = hit_prim(prim_indices[slot]);
+                found |= h;
+                if (stats) {
+                    stats->prims++;
+                    stats->prim_hits += h;
+                }
+            }
+            continue;
+        }
+
+        // 由近到远：较近的子节点后入栈、先访问
+        T tl, tr;
+        bool hl = enter(left, tl);
+        bool hr = enter(right, tr);
+        if (hl && hr) {
+            if (tl <= tr) {
+                stack[sp++] = {right, tr};
+                stack[sp++] = {left, tl};
+            } else {
+                stack[sp++] = {left, tl};
+                stack[sp++] = {right, tr};
+            }
+        } else if (hl) {
+            stack[sp++] = {left, tl};
+        } else if (hr) {
+            stack[sp++] = {right, tr};
+        }
+    }
+    return found;
+}
+
+#endif //GRAPHIC_BVH_H
@@ -0,0 +1,429 @@
+//
+// Created by 31934 on 2025/12/10.
+//
+#include "BVHReport.h"
+#include "BVH.h"
+#include "Instance.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <omp.h>
+
+static bool same_tree(const BVH &a, const BVH &b) {
+    if (a.nodes.size() != b.nodes.size() || a.prim_indices != b.prim_indices) return false;
+    for (size_t i = 0; i < a.nodes.size(); i++) {
+        const BVHNode &x = a.nodes[i], &y = b.nodes[i];
+        if (x.left != y.left || x.right != y.right || x.first_prim != y.first_prim || x.prim_count != y.prim_count)
+            return false;
+        if (x.box.bmin.x != y.box.bmin.x || x.box.bmin.y != y.box.bmin.y || x.box.bmin.z != y.box.bmin.z ||
+            x.box.bmax.x != y.box.bmax.x || x.box.bmax.y != y.box.bmax.y || x.box.bmax.z != y.box.bmax.z)
+            return false;
+    }
+    return true;
+}
+
+// 固定光线集：相机主光线（最多 256x256 网格，相干）+ 同样数量的场景内随机光线（非相干）
+static void make_ray_sets(const Scene &scene, const BVH &bvh,
+                          std::vector<Ray> &primary, std::vector<Ray> &incoherent) {
+    primary.clear();
+    incoherent.clear();
+    if (bvh.nodes.empty()) return;
+
+    if (scene.camera) {
+        Camera cam = *scene.camera;
+        cam.compute_basis();
+        int nx = std::min(cam.res_x, 256), ny = std::min(cam.res_y, 256);
+        for (int y = 0; y < ny; y++) {
+            for (int x = 0; x < nx; x++) {
+                primary.push_back(cam.pixel_to_ray((x + 0.5) * cam.res_x / nx, (y + 0.5) * cam.res_y / ny));
+            }
+        }
+    }
+
+    const AABB &root = bvh.nodes[0].box;
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    size_t count = primary.empty() ? 65536 : primary.size();
+    for (size_t i = 0; i < count; i++) {
+        Vector3 o(root.bmin.x + u(rng) * (root.bmax.x - root.bmin.x),
+                  root.bmin.y + u(rng) * (root.bmax.y - root.bmin.y),
+                  root.bmin.z + u(rng) * (root.bmax.z - root.bmin.z));
+        double z = 2.0 * u(rng) - 1.0, phi = 2.0 * M_PI * u(rng), r = std::sqrt(1.0 - z * z);
+        incoherent.emplace_back(o, Vector3(r * std::cos(phi), r * std::sin(phi), z));
+    }
+}
+
+// 并行追踪光线集，返回毫秒（hit_count 非空时输出命中数）
+static double trace_ms(const BVH &bvh, const Scene &scene, const std::vector<Ray> &rays,
+                       long long *hit_count = nullptr) {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    long long hits = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:hits)
+    for (int i = 0; i < (int)rays.size(); i++) {
+        Hit h;
+        if (bvh.intersect(rays[i], h, scene)) hits++;
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    if (hit_count) *hit_count = hits;
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+static void report_builders(const Scene &scene) {
+    struct Entry { const char *name; BVHBuilder builder; };
+    const Entry builders[] = {{"sah", BVHBuilder::SAH}, {"lbvh", BVHBuilder::LBVH}, {"sbvh", BVHBuilder::SBVH}};
+
+    BVH ref;
+    ref.build(scene);
+    std::vector<Ray> primary, incoherent;
+    make_ray_sets(scene, ref, primary, incoherent);
+    size_t ray_count = primary.size() + incoherent.size();
+
+    std::cout << "\n=== BVH Builder Trade-off (" << omp_get_max_threads() << " threads, "
+              << primary.size() << " primary + " << incoherent.size() << " random rays) ===" << std::endl;
+    std::cout << std::left << std::setw(8) << "builder" << std::setw(12) << "build_ms"
+              << std::setw(10) << "nodes" << std::setw(11) << "sah_cost"
+              << std::setw(13) << "primary_ms" << std::setw(12) << "random_ms"
+              << std::setw(10) << "Mrays/s" << "build+trace_ms" << std::endl;
+
+    for (const auto &e : builders) {
+        BVH bvh;
+        double build = 1e30;
+        for (int rep = 0; rep < 3; rep++) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            bvh.build(scene, e.builder);
+            auto t1 = std::chrono::high_resolution_clock::now();
+            build = std::min(build, std::chrono::duration<double, std::milli>(t1 - t0).count());
+        }
+        double prim_ms = trace_ms(bvh, scene, primary);
+        double rand_ms = trace_ms(bvh, scene, incoherent);
+        double total = prim_ms + rand_ms;
+
+        std::cout << std::left << std::setw(8) << e.name
+                  << std::setw(12) << std::fixed << std::setprecision(3) << build
+                  << std::setw(10) << bvh.nodes.size()
+                  << std::setw(11) << std::setprecision(4) << bvh.sah_cost()
+                  << std::setw(13) << std::setprecision(3) << prim_ms
+                  << std::setw(12) << rand_ms
+                  << std::setw(10) << std::setprecision(2) << (total > 0 ? ray_count / total / 1000.0 : 0.0)
+                  << std::setprecision(3) << build + total << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+// 运动模糊：按光线时间插值的运动 BVH 与扫掠包围盒 BVH（同一拓扑）对比
+static void report_motion_bounds(const Scene &scene) {
+    BVH motion;
+    motion.build(scene);
+    if (motion.motion_boxes.empty()) {
+        std::cout << "\n=== Motion BVH ===\nNo moving objects (object 'velocity' with camera shutter_speed > 0); skipped."
+                  << std::endl;
+        return;
+    }
+    BVH swept = motion;
+    swept.sweep_motion_bounds();
+
+    std::vector<Ray> primary, incoherent;
+    make_ray_sets(scene, swept, primary, incoherent);
+    std::vector<Ray> rays = primary;
+    rays.insert(rays.end(), incoherent.begin(), incoherent.end());
+    std::mt19937 rng(54321);
+    std::uniform_real_distribution<> shutter(0.0, motion.shutter_time);
+    for (auto &r : rays) r.time = shutter(rng);
+
+    size_t moving = 0;
+    for (const auto &obj : scene.objects) moving += obj->is_moving() ? 1 : 0;
+    std::cout << "\n=== Motion BVH (" << moving << "/" << scene.objects.size() << " moving objects, shutter "
+              << motion.shutter_time << " s, " << rays.size() << " rays at random times) ===" << std::endl;
+    std::cout << std::left << std::setw(16) << "bounds" << std::setw(12) << "trace_ms"
+              << std::setw(10) << "Mrays/s" << std::setw(11) << "sah_cost" << "hits" << std::endl;
+
+    struct Entry { const char *name; const BVH *bvh; };
+    const Entry entries[] = {{"interpolated", &motion}, {"swept", &swept}};
+    for (const auto &e : entries) {
+        double ms = 1e30;
+        long long hits = 0;
+        for (int rep = 0; rep < 3; rep++) ms = std::min(ms, trace_ms(*e.bvh, scene, rays, &hits));
+        std::cout << std::left << std::setw(16) << e.name
+                  << std::setw(12) << std::fixed << std::setprecision(3) << ms
+                  << std::setw(10) << std::setprecision(2) << (ms > 0 ? rays.size() / ms / 1000.0 : 0.0)
+                  << std::setw(11) << std::setprecision(4) << e.bvh->sah_cost()
+                  << hits << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+// 空间分割与无界列表：对象分割 SAH、SBVH 以及二者加无界列表，比较每条光线访问的节点数和求交的图元数
+static void report_spatial_splits(const Scene &scene) {
+    struct Entry { const char *name; BVHBuilder builder; double unbounded_fraction; };
+    const Entry entries[] = {{"sah", BVHBuilder::SAH, 0.0}, {"sbvh", BVHBuilder::SBVH, 0.0},
+                             {"sah+unbounded", BVHBuilder::SAH, 0.1}, {"sbvh+unbounded", BVHBuilder::SBVH, 0.1}};
+
+    BVH ref;
+    ref.build(scene);
+    std::vector<Ray> rays, incoherent;
+    make_ray_sets(scene, ref, rays, incoherent);
+    rays.insert(rays.end(), incoherent.begin(), incoherent.end());
+    if (rays.empty()) return;
+
+    std::cout << "\n=== Spatial Splits / Unbounded List (" << rays.size() << " rays, unbounded = bounds area > 0.1 of scene) ==="
+              << std::endl;
+    std::cout << std::left << std::setw(16) << "bvh" << std::setw(12) << "build_ms" << std::setw(9) << "nodes"
+              << std::setw(9) << "refs" << std::setw(11) << "unbounded" << std::setw(12) << "nodes/ray"
+              << std::setw(12) << "prims/ray" << std::setw(10) << "Mrays/s" << "hits" << std::endl;
+
+    for (const auto &e : entries) {
+        BVH bvh;
+        bvh.unbounded_fraction = e.unbounded_fraction;
+        auto t0 = std::chrono::high_resolution_clock::now();
+        bvh.build(scene, e.builder);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        double build_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        // 访问计数单独统计一遍，计时不受计数影响
+        long long nodes = 0, prims = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:nodes, prims)
+        for (int i = 0; i < (int)rays.size(); i++) {
+            TraversalStats st;
+            Hit h;
+            bvh.intersect(rays[i], h, scene, &st);
+            nodes += st.nodes;
+            prims += st.prims;
+        }
+        double ms = 1e30;
+        long long hits = 0;
+        for (int rep = 0; rep < 3; rep++) ms = std::min(ms, trace_ms(bvh, scene, rays, &hits));
+
+        std::cout << std::left << std::setw(16) << e.name
+                  << std::setw(12) << std::fixed << std::setprecision(3) << build_ms
+                  << std::setw(9) << bvh.nodes.size()
+                  << std::setw(9) << bvh.prim_indices.size()
+                  << std::setw(11) << bvh.unbounded.size()
+                  << std::setw(12) << std::setprecision(2) << (double)nodes / rays.size()
+                  << std::setw(12) << (double)prims / rays.size()
+                  << std::setw(10) << (ms > 0 ? rays.size() / ms / 1000.0 : 0.0)
+                  << hits << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+// 叶子有向包围盒：关闭 / 开启时每条光线的图元求交次数与误报率（求交后没有找到更近交点的比例）
+static void report_obb_culling(const Scene &scene) {
+    BVH bvh;
+    bvh.build(scene);
+    if (bvh.leaf_obbs.empty()) {
+        std::cout << "\n=== Leaf OBB Culling: skipped (no primitive has an oriented box tighter than its AABB) ==="
+                  << std::endl;
+        return;
+    }
+    long long oriented = 0;
+    for (const auto &o : bvh.leaf_obbs) oriented += o.active;
+
+    std::vector<Ray> rays, incoherent;
+    make_ray_sets(scene, bvh, rays, incoherent);
+    rays.insert(rays.end(), incoherent.begin(), incoherent.end());
+    if (rays.empty()) return;
+
+    std::cout << "\n=== Leaf OBB Culling (" << rays.size() << " rays, " << oriented << "/" << bvh.leaf_obbs.size()
+              << " leaf refs oriented) ===" << std::endl;
+    std::cout << std::left << std::setw(8) << "obb" << std::setw(12) << "tests/ray" << std::setw(14) << "false_pos_%"
+              << std::setw(13) << "rejects/ray" << std::setw(10) << "Mrays/s" << "hits" << std::endl;
+
+    std::vector<OBB> obbs = bvh.leaf_obbs;
+    for (bool on : {false, true}) {
+        bvh.leaf_obbs = on ? obbs : std::vector<OBB>();
+
+        long long prims = 0, prim_hits = 0, rejects = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:prims, prim_hits, rejects)
+        for (int i = 0; i < (int)rays.size(); i++) {
+            TraversalStats st;
+            Hit h;
+            bvh.intersect(rays[i], h, scene, &st);
+            prims += st.prims;
+            prim_hits += st.prim_hits;
+            rejects += st.obb_rejects;
+        }
+        double ms = 1e30;
+        long long hits = 0;
+        for (int rep = 0; rep < 3; rep++) ms = std::min(ms, trace_ms(bvh, scene, rays, &hits));
+
+        std::cout << std::left << std::setw(8) << (on ? "on" : "off")
+                  << std::setw(12) << std::fixed << std::setprecision(2) << (double)prims / rays.size()
+                  << std::setw(14) << (prims > 0 ? 100.0 * (prims - prim_hits) / prims : 0.0)
+                  << std::setw(13) << (double)rejects / rays.size()
+                  << std::setw(10) << (ms > 0 ? rays.size() / ms / 1000.0 : 0.0)
+                  << hits << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+// 经纬度细分的单位球网格（nu * nv * 2 个三角形）
+static std::shared_ptr<TriangleMesh> make_sphere_mesh(int nu, int nv) {
+    auto mesh = std::make_shared<TriangleMesh>();
+    for (int j = 0; j <= nv; j++) {
+        double theta = M_PI * j / nv;
+        for (int i = 0; i < nu; i++) {
+            double phi = 2.0 * M_PI * i / nu;
+            Vector3 p(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta));
+            mesh->positions.push_back(p);
+            mesh->normals.push_back(p);
+        }
+    }
+    for (int j = 0; j < nv; j++) {
+        for (int i = 0; i < nu; i++) {
+            int a = j * nu + i, b = j * nu + (i + 1) % nu, c = (j + 1) * nu + i, d = (j + 1) * nu + (i + 1) % nu;
+            mesh->triangles.push_back({a, c, d});
+            mesh->triangles.push_back({a, d, b});
+        }
+    }
+    mesh->build_bvh();
+    return mesh;
+}
+
+void report_instancing(int instance_count) {
+    instance_count = std::max(instance_count, 1);
+
+    // 原型：两个不同细分的球网格 + 一个解析立方体
+    std::vector<std::shared_ptr<TriangleMesh>> meshes{make_sphere_mesh(128, 64), make_sphere_mesh(32, 16)};
+    InstanceGroup group;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        auto m = std::make_shared<Mesh>(meshes[i]);
+        m->name = "mesh" + std::to_string(i);
+        group.prototypes.push_back(m);
+        group.prototype_names.push_back(m->name);
+    }
+    auto cube = std::make_shared<Cube>(Vector3(0, 0, 0), 1.5);
+    cube->name = "cube";
+    group.prototypes.push_back(cube);
+    group.prototype_names.push_back(cube->name);
+
+    // 8 种材质覆盖
+    for (int i = 0; i < 8; i++) {
+        InstanceLook look;
+        look.color = Vector3(0.2 + 0.1 * i, 0.9 - 0.1 * i, 0.5);
+        look.material.reflectivity = 0.05 * i;
+        group.looks.push_back(look);
+    }
+
+    // 实例均匀散布在立方体区域内（平均间距约 4 个单位）
+    double extent = 2.0 * std::cbrt((double)instance_count) * 2.0;
+    std::mt19937 rng(2024);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    group.instances.resize(instance_count);
+    size_t mesh_instances = 0;
+    std::vector<size_t> per_proto(group.prototypes.size(), 0);
+    for (auto &inst : group.instances) {
+        inst.prototype = std::min((int)(u(rng) * group.prototypes.size()), (int)group.prototypes.size() - 1);
+        inst.look = (u(rng) < 0.5) ? -1 : std::min((int)(u(rng) * group.looks.size()), (int)group.looks.size() - 1);
+        inst.translation = Vector3((u(rng) - 0.5) * extent, (u(rng) - 0.5) * extent, (u(rng) - 0.5) * extent);
+        inst.rot = InstanceGroup::rotation_from_degrees(u(rng) * 360.0, u(rng) * 360.0, u(rng) * 360.0);
+        inst.scale = 0.5 + u(rng);
+        per_proto[inst.prototype]++;
+        if (inst.prototype < (int)meshes.size()) mesh_instances++;
+    }
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    group.build();
+    auto t1 = std::chrono::high_resolution_clock::now();
+    double build_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+    // 内存：唯一几何只存一份；展开后每个实例都要复制几何并重建 BVH
+    size_t unique_bytes = 0;
+    size_t flattened_bytes = 0;
+    size_t total_tris = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        unique_bytes += meshes[i]->memory_bytes();
+        flattened_bytes += per_proto[i] * meshes[i]->memory_bytes();
+        total_tris += per_proto[i] * meshes[i]->triangle_count();
+    }
+    flattened_bytes += per_proto[meshes.size()] * sizeof(Cube);
+    size_t instance_bytes = group.instance_bytes();
+
+    // 从区域外侧看向中心的相机光线 + 区域内的随机光线
+    Camera cam(Vector3(0, -extent, extent * 0.3), Vector3(0, 1, -0.3), 0.035, 0.036, 0.024, 256, 256);
+    std::vector<Ray> rays;
+    for (int y = 0; y < cam.res_y; y++) {
+        for (int x = 0; x < cam.res_x; x++) rays.push_back(cam.pixel_to_ray(x + 0.5, y + 0.5));
+    }
+    size_t primary = rays.size();
+    for (size_t i = 0; i < primary; i++) {
+        Vector3 o((u(rng) - 0.5) * extent, (u(rng) - 0.5) * extent, (u(rng) - 0.5) * extent);
+        double z = 2.0 * u(rng) - 1.0, phi = 2.0 * M_PI * u(rng), r = std::sqrt(1.0 - z * z);
+        rays.emplace_back(o, Vector3(r * std::cos(phi), r * std::sin(phi), z));
+    }
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+    long long hits = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(+:hits)
+    for (int i = 0; i < (int)rays.size(); i++) {
+        Hit h;
+        if (group.intersect(rays[i], h)) hits++;
+    }
+    auto t3 = std::chrono::high_resolution_clock::now();
+    double trace_ms = std::chrono::duration<double, std::milli>(t3 - t2).count();
+
+    auto mib = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+    std::cout << "\n=== Instancing Demo (" << instance_count << " instances, " << group.prototypes.size()
+              << " prototypes, " << group.looks.size() << " material overrides) ===" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Unique geometry:        " << mib(unique_bytes) << " MiB" << std::endl;
+    std::cout << "Instances + top BVH:    " << mib(instance_bytes) << " MiB ("
+              << (double)instance_bytes / instance_count << " bytes/instance)" << std::endl;
+    std::cout << "Total (instanced):      " << mib(unique_bytes + instance_bytes) << " MiB" << std::endl;
+    std::cout << "Flattened equivalent:   " << mib(flattened_bytes) << " MiB (" << mesh_instances
+              << " mesh copies, " << total_tris << " triangles; estimated, not allocated)" << std::endl;
+    std::cout << "Top-level BVH build:    " << std::setprecision(3) << build_ms << " ms ("
+              << group.bvh.nodes.size() << " nodes)" << std::endl;
+    std::cout << "Trace:                  " << trace_ms << " ms for " << rays.size() << " rays ("
+              << std::setprecision(2) << (trace_ms > 0 ? rays.size() / trace_ms / 1000.0 : 0.0) << " Mrays/s, "
+              << hits << " hits, " << omp_get_max_threads() << " threads)" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+void report_bvh_build(const Scene &scene) {
+    const int max_threads = omp_get_max_threads();
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    std::cout << "\n=== BVH Build Report (" << scene.objects.size() << " objects) ===" << std::endl;
+    std::cout << std::left << std::setw(10) << "threads" << std::setw(14) << "build_ms"
+              << std::setw(10) << "speedup" << std::setw(10) << "nodes"
+              << std::setw(12) << "sah_cost" << "identical" << std::endl;
+
+    BVH reference;
+    double base_ms = 0.0;
+    for (int t : thread_counts) {
+        omp_set_num_threads(t);
+
+        // 取 3 次中最快的一次
+        BVH bvh;
+        double best_ms = 1e30;
+        for (int rep = 0; rep < 3; rep++) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            bvh.build(scene);
+            auto t1 = std::chrono::high_resolution_clock::now();
+            best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(t1 - t0).count());
+        }
+
+        if (reference.nodes.empty()) {
+            reference = bvh;
+            base_ms = best_ms;
+        }
+
+        std::cout << std::left << std::setw(10) << t
+                  << std::setw(14) << std::fixed << std::setprecision(3) << best_ms
+                  << std::setw(10) << std::setprecision(2) << base_ms / best_ms
+                  << std::setw(10) << bvh.nodes.size()
+                  << std::setw(12) << std::setprecision(4) << bvh.sah_cost()
+                  << (same_tree(reference, bvh) ? "yes" : "NO") << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    omp_set_num_threads(max_threads);
+
+    report_builders(scene);
+    report_spatial_splits(scene);
+    report_obb_culling(scene);
+    report_motion_bounds(scene);
+}
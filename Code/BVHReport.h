@@ -0,0 +1,20 @@
+//
+// Created by 31934 on 2025/12/10.
+//
+
+#ifndef GRAPHIC_CW_BVHREPORT_H
+#define GRAPHIC_CW_BVHREPORT_H
+#pragma once
+#include "Scene.h"
+
+// 在 1..全部线程下构建 BVH，报告构建时间和 SAH 代价，并检查结果是否与单线程构建一致；
+// 随后比较各构建算法（SAH / LBVH / SBVH）的构建时间与固定光线集上的追踪时间，
+// 空间分割和无界列表对每条光线访问节点数的影响，以及叶子有向包围盒对图元求交误报率的影响；
+// 场景含运动物体时，再比较运动 BVH（按光线时间插值）与扫掠包围盒的追踪速度
+void report_bvh_build(const Scene &scene);
+
+// 合成 instance_count 个实例（共享少量原型）的场景，报告内存占用（唯一几何 vs. 展开后的等价几何）、
+// 顶层 BVH 构建时间和追踪速度
+void report_instancing(int instance_count);
+
+#endif //GRAPHIC_CW_BVHREPORT_H
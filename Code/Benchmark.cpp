@@ -0,0 +1,417 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+// 微基准：图元求交内核（Sphere / Cube / Plane / AABB）、BVH 构建和 BVH 遍历。
+// 合成场景与光线集都由固定种子生成，同一参数下每次运行、每个版本测试的输入完全相同；
+// 每项测量重复 --repeat 次取最短时间（单线程，BVH 构建除外），--json 输出结果供跨版本比较回归
+#include "Scene.h"
+#include "BVH.h"
+#include "Sphere.h"
+#include "Cube.h"
+#include "Plane.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+namespace {
+
+struct Options {
+    std::vector<int> sizes = {1000, 10000, 100000}; // 合成场景的图元数
+    int rays = 65536;                               // 每个光线集的光线数
+    int repeat = 5;
+    unsigned seed = 12345;
+    std::string json_path;
+    std::string label; // 写入 JSON，标记版本（如 git 提交号）
+};
+
+// 一项测量结果：ns/ray 与 rays/s 按最短一次计时；nodes / prims 为每条光线的节点访问和图元求交次数
+struct Result {
+    std::string name;
+    int scene_size = 0; // 0 表示与场景无关的内核测试
+    long long rays = 0;
+    double seconds = 0.0;
+    double nodes_per_ray = 0.0;
+    double prims_per_ray = 0.0;
+    double hit_rate = 0.0;
+    double build_ms = 0.0; // 仅 BVH 构建
+    size_t node_count = 0;
+
+    double ns_per_ray() const { return rays > 0 ? seconds * 1e9 / rays : 0.0; }
+    double rays_per_sec() const { return seconds > 0.0 ? rays / seconds : 0.0; }
+};
+
+// 重复 repeat 次取最短时间（秒）
+template <typename Fn>
+double best_seconds(int repeat, Fn &&fn) {
+    double best = 1e300;
+    for (int r = 0; r < repeat; r++) {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        fn();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+Vector3 random_direction(std::mt19937 &rng) {
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    double z = 2.0 * u(rng) - 1.0, phi = 2.0 * M_PI * u(rng), r = std::sqrt(1.0 - z * z);
+    return {r * std::cos(phi), r * std::sin(phi), z};
+}
+
+// 合成场景：size 个图元（约 60% 球、30% 旋转长方体、10% 小四边形）均匀散布在边长随 size 立方根增长的立方体内，
+// 图元的平均间距保持不变；相机位于立方体外，看向中心
+Scene make_scene(int size, unsigned seed) {
+    Scene scene;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    const double extent = 2.0 * std::cbrt((double)size);
+    auto random_point = [&] { return Vector3(u(rng), u(rng), u(rng)) * extent; };
+
+    for (int i = 0; i < size; i++) {
+        double kind = u(rng);
+        if (kind < 0.6) {
+            scene.objects.push_back(std::make_shared<Sphere>(random_point(), 0.2 + 0.4 * u(rng)));
+        } else if (kind < 0.9) {
+            auto cube = std::make_shared<Cube>(random_point(), Vector3(0.3 + 0.6 * u(rng), 0.3 + 0.6 * u(rng), 0.3 + 0.6 * u(rng)));
+            cube->set_rotation(360.0 * u(rng), 360.0 * u(rng), 360.0 * u(rng));
+            scene.objects.push_back(cube);
+        } else {
+            auto plane = std::make_shared<Plane>();
+            Vector3 c = random_point(), a = random_direction(rng);
+            Vector3 b = a.cross(random_direction(rng)).normalized();
+            a = b.cross(random_direction(rng)).normalized();
+            double s = 0.3 + 0.5 * u(rng);
+            plane->corners = {c - a * s - b * s, c + a * s - b * s, c + a * s + b * s, c - a * s + b * s};
+            plane->store_rest_pose();
+            scene.objects.push_back(plane);
+        }
+    }
+
+    Vector3 center(extent * 0.5, extent * 0.5, extent * 0.5);
+    Vector3 eye = center + Vector3(-1.2, -1.5, 0.6) * extent;
+    scene.camera = std::make_shared<Camera>(eye, (center - eye).normalized(), 0.035, 0.036, 0.024, 256, 256);
+    scene.lights.emplace_back(center + Vector3(0.2, -0.3, 1.5) * extent, 1.0, 0.0);
+    return scene;
+}
+
+// 三个光线集：相干主光线（相机像素网格）、非相干随机光线（包围盒内随机起点和方向）、
+// 阴影光线（主光线交点指向光源，只需判断 (0, 到光源距离) 内有无遮挡）
+struct RaySets {
+    std::vector<Ray> primary, incoherent, shadow;
+    std::vector<double> shadow_tmax;
+};
+
+RaySets make_rays(const Scene &scene, const BVH &bvh, int count, unsigned seed) {
+    RaySets sets;
+    Camera cam = *scene.camera;
+    const int side = std::max(1, (int)std::ceil(std::sqrt((double)count)));
+    cam.res_x = cam.res_y = side;
+    cam.compute_basis();
+    for (int i = 0; i < count; i++)
+        sets.primary.push_back(cam.pixel_to_ray(i % side + 0.5, i / side + 0.5));
+
+    const AABB &root = bvh.nodes[0].box;
+    std::mt19937 rng(seed + 1);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    for (int i = 0; i < count; i++) {
+        Vector3 o(root.bmin.x + u(rng) * (root.bmax.x - root.bmin.x),
+                  root.bmin.y + u(rng) * (root.bmax.y - root.bmin.y),
+                  root.bmin.z + u(rng) * (root.bmax.z - root.bmin.z));
+        sets.incoherent.emplace_back(o, random_direction(rng));
+    }
+
+    const Vector3 light = scene.lights[0].pos;
+    for (const Ray &ray : sets.primary) {
+        Hit hit;
+        if (!bvh.intersect(ray, hit, scene)) continue;
+        Vector3 to_light = light - hit.pos;
+        double dist = to_light.length();
+        Ray shadow = spawn_ray(hit.pos, hit.normal, to_light * (1.0 / dist), 0.0);
+        sets.shadow.push_back(shadow);
+        sets.shadow_tmax.push_back((light - shadow.origin).length());
+    }
+    return sets;
+}
+
+// BVH 遍历：先单独一遍统计访问次数，再计时（计时时不传 stats，避免计数本身的开销）
+Result bench_traversal(const std::string &name, const Scene &scene, const BVH &bvh, const std::vector<Ray> &rays,
+                       const std::vector<double> *tmax, int repeat) {
+    Result r;
+    r.name = name;
+    r.scene_size = (int)scene.objects.size();
+    r.rays = (long long)rays.size();
+    if (rays.empty()) return r;
+
+    auto trace = [&](size_t i, TraversalStats *stats) {
+        Hit hit;
+        if (tmax) hit.t = (*tmax)[i];
+        return bvh.intersect(rays[i], hit, scene, stats);
+    };
+    TraversalStats stats;
+    long long hits = 0;
+    for (size_t i = 0; i < rays.size(); i++) hits += trace(i, &stats);
+    r.nodes_per_ray = (double)stats.nodes / rays.size();
+    r.prims_per_ray = (double)stats.prims / rays.size();
+    r.hit_rate = (double)hits / rays.size();
+
+    volatile long long sink = 0;
+    r.seconds = best_seconds(repeat, [&] {
+        long long h = 0;
+        for (size_t i = 0; i < rays.size(); i++) h += trace(i, nullptr);
+        sink = sink + h;
+    });
+    return r;
+}
+
+// 单个图元的求交内核：count 条光线，每条从半径 4 的球面上的随机点射向一个随机图元中心附近（大部分命中），
+// 图元按光线轮换，经虚函数调用（与渲染时相同）
+Result bench_primitive(const std::string &name, const std::vector<std::shared_ptr<Shape>> &prims, int count,
+                       unsigned seed, int repeat) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (int i = 0; i < count; i++) {
+        Vector3 bmin, bmax;
+        prims[i % prims.size()]->bounds(bmin, bmax);
+        Vector3 c = (bmin + bmax) * 0.5;
+        Vector3 target = c + random_direction(rng) * (0.6 * u(rng));
+        Vector3 origin = c + random_direction(rng) * 4.0;
+        rays.emplace_back(origin, (target - origin).normalized());
+    }
+
+    Result r;
+    r.name = name;
+    r.rays = count;
+    r.prims_per_ray = 1.0;
+    long long hits = 0;
+    for (int i = 0; i < count; i++) {
+        Hit hit;
+        hits += prims[i % prims.size()]->intersect(rays[i], hit);
+    }
+    r.hit_rate = (double)hits / count;
+
+    volatile long long sink = 0;
+    r.seconds = best_seconds(repeat, [&] {
+        long long h = 0;
+        for (int i = 0; i < count; i++) {
+            Hit hit;
+            h += prims[i % prims.size()]->intersect(rays[i], hit);
+        }
+        sink = sink + h;
+    });
+    return r;
+}
+
+// 轴对齐包围盒 slab 测试：与图元内核相同的光线生成方式，盒子边长 0.5 ~ 1.5
+Result bench_aabb(int count, unsigned seed, int repeat) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    const int box_count = 1024;
+    std::vector<AABB> boxes(box_count);
+    for (auto &box : boxes) {
+        Vector3 c(u(rng) * 10.0, u(rng) * 10.0, u(rng) * 10.0);
+        Vector3 h(0.25 + 0.5 * u(rng), 0.25 + 0.5 * u(rng), 0.25 + 0.5 * u(rng));
+        box.expand_point(c - h);
+        box.expand_point(c + h);
+    }
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (int i = 0; i < count; i++) {
+        Vector3 c = boxes[i % box_count].center();
+        Vector3 target = c + random_direction(rng) * (0.8 * u(rng));
+        Vector3 origin = c + random_direction(rng) * 4.0;
+        rays.emplace_back(origin, (target - origin).normalized());
+    }
+
+    Result r;
+    r.name = "aabb.intersect";
+    r.rays = count;
+    r.nodes_per_ray = 1.0;
+    long long hits = 0;
+    for (int i = 0; i < count; i++) hits += boxes[i % box_count].intersect(rays[i], 0.0, 1e30);
+    r.hit_rate = (double)hits / count;
+
+    volatile long long sink = 0;
+    r.seconds = best_seconds(repeat, [&] {
+        long long h = 0;
+        for (int i = 0; i < count; i++) h += boxes[i % box_count].intersect(rays[i], 0.0, 1e30);
+        sink = sink + h;
+    });
+    return r;
+}
+
+std::vector<Result> run(const Options &opt) {
+    std::vector<Result> results;
+
+    // 1. 图元与包围盒内核（与场景大小无关）
+    {
+        std::mt19937 rng(opt.seed);
+        std::uniform_real_distribution<> u(0.0, 1.0);
+        std::vector<std::shared_ptr<Shape>> spheres, cubes, planes;
+        for (int i = 0; i < 1024; i++) {
+            Vector3 c(u(rng) * 10.0, u(rng) * 10.0, u(rng) * 10.0);
+            spheres.push_back(std::make_shared<Sphere>(c, 0.5));
+            auto cube = std::make_shared<Cube>(c, 1.0);
+            cube->set_rotation(360.0 * u(rng), 360.0 * u(rng), 360.0 * u(rng));
+            cubes.push_back(cube);
+            auto plane = std::make_shared<Plane>();
+            plane->corners = {c + Vector3(-0.5, -0.5, 0), c + Vector3(0.5, -0.5, 0),
+                              c + Vector3(0.5, 0.5, 0), c + Vector3(-0.5, 0.5, 0)};
+            plane->store_rest_pose();
+            planes.push_back(plane);
+        }
+        results.push_back(bench_primitive("sphere.intersect", spheres, opt.rays, opt.seed, opt.repeat));
+        results.push_back(bench_primitive("cube.intersect", cubes, opt.rays, opt.seed, opt.repeat));
+        results.push_back(bench_primitive("plane.intersect", planes, opt.rays, opt.seed, opt.repeat));
+        results.push_back(bench_aabb(opt.rays, opt.seed, opt.repeat));
+    }
+
+    // 2. 每个场景大小：各构建算法的构建时间，SAH 树上三个光线集的遍历
+    for (int size : opt.sizes) {
+        Scene scene = make_scene(size, opt.seed);
+        struct Builder { const char *name; BVHBuilder builder; };
+        const Builder builders[] = {{"sah", BVHBuilder::SAH}, {"lbvh", BVHBuilder::LBVH}, {"sbvh", BVHBuilder::SBVH}};
+        for (const auto &b : builders) {
+            BVH bvh;
+            Result r;
+            r.name = std::string("bvh.build.") + b.name;
+            r.scene_size = size;
+            r.seconds = best_seconds(std::min(opt.repeat, 3), [&] { bvh = BVH(); bvh.build(scene, b.builder); });
+            r.build_ms = r.seconds * 1e3;
+            r.node_count = bvh.nodes.size();
+            results.push_back(r);
+        }
+
+        BVH bvh;
+        bvh.build(scene, BVHBuilder::SAH);
+        RaySets sets = make_rays(scene, bvh, opt.rays, opt.seed);
+        results.push_back(bench_traversal("bvh.intersect.primary", scene, bvh, sets.primary, nullptr, opt.repeat));
+        results.push_back(bench_traversal("bvh.intersect.incoherent", scene, bvh, sets.incoherent, nullptr, opt.repeat));
+        results.push_back(bench_traversal("bvh.intersect.shadow", scene, bvh, sets.shadow, &sets.shadow_tmax, opt.repeat));
+        std::cout << "[Benchmark] scene size " << size << " done" << std::endl;
+    }
+    return results;
+}
+
+void print_table(const std::vector<Result> &results) {
+    std::cout << "\n" << std::left << std::setw(28) << "benchmark" << std::setw(9) << "size" << std::setw(11) << "rays"
+              << std::setw(11) << "ns/ray" << std::setw(11) << "Mrays/s" << std::setw(11) << "nodes/ray"
+              << std::setw(11) << "prims/ray" << std::setw(8) << "hit%" << "build_ms" << std::endl;
+    std::cout << std::fixed;
+    for (const auto &r : results) {
+        std::cout << std::left << std::setw(28) << r.name << std::setw(9) << r.scene_size;
+        if (r.rays > 0) {
+            std::cout << std::setw(11) << r.rays << std::setprecision(1) << std::setw(11) << r.ns_per_ray()
+                      << std::setprecision(2) << std::setw(11) << r.rays_per_sec() * 1e-6
+                      << std::setw(11) << r.nodes_per_ray << std::setw(11) << r.prims_per_ray
+                      << std::setprecision(1) << std::setw(8) << r.hit_rate * 100.0 << "-";
+        } else {
+            std::cout << std::setw(11) << "-" << std::setw(11) << "-" << std::setw(11) << "-"
+                      << std::setw(11) << "-" << std::setw(11) << "-" << std::setw(8) << "-"
+                      << std::setprecision(2) << r.build_ms << " (" << r.node_count << " nodes)";
+        }
+        std::cout << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+std::string json_escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+bool write_json(const std::string &path, const Options &opt, const std::vector<Result> &results) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: Cannot open " << path << " for writing." << std::endl;
+        return false;
+    }
+    out << std::setprecision(10);
+    out << "{\n  \"label\": \"" << json_escape(opt.label) << "\",\n"
+        << "  \"config\": {\"rays\": " << opt.rays << ", \"repeat\": " << opt.repeat << ", \"seed\": " << opt.seed
+        << ", \"threads\": " << omp_get_max_threads() << "},\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"scene_size\": " << r.scene_size;
+        if (r.rays > 0) {
+            out << ", \"rays\": " << r.rays << ", \"ns_per_ray\": " << r.ns_per_ray()
+                << ", \"rays_per_sec\": " << r.rays_per_sec() << ", \"nodes_per_ray\": " << r.nodes_per_ray
+                << ", \"prims_per_ray\": " << r.prims_per_ray << ", \"hit_rate\": " << r.hit_rate;
+        } else {
+            out << ", \"build_ms\": " << r.build_ms << ", \"nodes\": " << r.node_count;
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+std::vector<int> parse_sizes(const std::string &list) {
+    std::vector<int> sizes;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int n = std::stoi(item);
+        if (n <= 0) throw std::runtime_error("scene size must be positive: " + item);
+        sizes.push_back(n);
+    }
+    return sizes;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    try {
+        Options opt;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--sizes" && i + 1 < argc) opt.sizes = parse_sizes(argv[++i]);
+            else if (arg == "--rays" && i + 1 < argc) opt.rays = std::max(1, std::stoi(argv[++i]));
+            else if (arg == "--repeat" && i + 1 < argc) opt.repeat = std::max(1, std::stoi(argv[++i]));
+            else if (arg == "--seed" && i + 1 < argc) opt.seed = (unsigned)std::stoul(argv[++i]);
+            else if (arg == "--json" && i + 1 < argc) opt.json_path = argv[++i];
+            else if (arg == "--label" && i + 1 < argc) opt.label = argv[++i];
+            else if (arg == "--help" || arg == "-h") {
+                std::cout << "Usage: " << argv[0] << " [options]\n"
+                          << "Options:\n"
+                          << "  --sizes N,N,...  Synthetic scene sizes in primitives (default: 1000,10000,100000)\n"
+                          << "  --rays N         Rays per ray set and per kernel (default: 65536)\n"
+                          << "  --repeat N       Timed repetitions, the fastest is reported (default: 5)\n"
+                          << "  --seed S         Seed for scenes and ray sets (default: 12345)\n"
+                          << "  --json FILE      Also write the results as JSON\n"
+                          << "  --label TEXT     Version label stored in the JSON output (e.g. a commit id)\n"
+                          << "  --help           Show this help message\n";
+                return 0;
+            } else {
+                std::cerr << "Unknown argument: " << arg << std::endl;
+                std::cerr << "Use --help for usage information" << std::endl;
+                return 1;
+            }
+        }
+
+        std::vector<Result> results = run(opt);
+        print_table(results);
+        if (!opt.json_path.empty()) {
+            if (!write_json(opt.json_path, opt, results)) return 1;
+            std::cout << "JSON written: " << opt.json_path << std::endl;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -1,94 +1,95 @@
 #include "Cube.h"
+#include "RenderStats.h"
 #include <algorithm>
 #include <limits>
 #include <cmath>
 
-bool Cube::intersect(const Ray &ray, Hit &hit) const {
-
-    Vector3 O = ray.origin;
-    Vector3 D = ray.dir;   // 不归一化
-
-    // 三条世界坐标轴方向（已旋转）
-    Vector3 axisX = rot.mul(Vector3(1,0,0));
-    Vector3 axisY = rot.mul(Vector3(0,1,0));
-    Vector3 axisZ = rot.mul(Vector3(0,0,1));
-
-    // 半尺寸（使用你的 size）
-    Vector3 half = size * 0.5;
-
-    double tMin = -1e18, tMax = 1e18;
-    Vector3 bestNormal;
-
-    auto checkAxis = [&](const Vector3& axis, double h, const Vector3& norm) {
-        double e = axis.dot(center - O);
-        double f = axis.dot(D);
-
-        if (std::abs(f) < 1e-6) {
+// 单 / 双精度共用的求交实现
+template <typename T>
+static bool intersect_cube(const Cube &cube, const RayT<T> &ray, HitT<T> &hit) {
+    RT_STAT_PRIM(PrimKind::CUBE);
+    // 在单位盒 [-1,1]^3 中做 slab 测试：to_unit 预先合并了旋转和尺寸，
+    // 方向不归一化，参数 t 与世界坐标系相同
+    const Mat3<T> to_unit(cube.to_unit);
+    const Vec3<T> center(cube.center);
+    Vec3<T> lo = to_unit.mul(ray.origin - center);
+    Vec3<T> ld = to_unit.mul(ray.dir);
+    const T o[3] = {lo.x, lo.y, lo.z};
+    const T d[3] = {ld.x, ld.y, ld.z};
+    const T half[3] = {T(cube.size.x * 0.5), T(cube.size.y * 0.5), T(cube.size.z * 0.5)};
+
+    T tMin = T(-1e18), tMax = T(1e18);
+    // 进入面 / 离开面的轴及其在局部坐标系中的外法线方向
+    int entry_axis = 0, exit_axis = 0;
+    T entry_sign = -1, exit_sign = 1;
+
+    for (int a = 0; a < 3; a++) {
+        if (std::abs(d[a] * half[a]) < T(1e-6)) {
             // 光线与该方向的面平行
-            if (std::abs(e) > h) return false;
-            return true;
+            if (std::abs(o[a]) > 1) return false;
+            continue;
         }
 
-        double t1 = (e - h) / f;
-        double t2 = (e + h) / f;
-        Vector3 n1 = -norm;
-        Vector3 n2 =  norm;
-
-        if (t1 > t2) { std::swap(t1, t2); std::swap(n1, n2); }
+        T inv = 1 / d[a];
+        T t1 = (-1 - o[a]) * inv;
+        T t2 = (1 - o[a]) * inv;
+        T sign = -1;
+        if (t1 > t2) { std::swap(t1, t2); sign = 1; }
 
         if (t1 > tMin) {
             tMin = t1;
-            bestNormal = n1;
+            entry_axis = a;
+            entry_sign = sign;
+        }
+        if (t2 < tMax) {
+            tMax = t2;
+            exit_axis = a;
+            exit_sign = -sign;
         }
-        if (t2 < tMax) tMax = t2;
 
         if (tMin > tMax) return false;
-        if (tMax < 1e-6) return false;
-
-        return true;
-    };
+        if (tMax <= 0) return false;
+    }
 
-    if (!checkAxis(axisX, half.x, axisX.normalized())) return false;
-    if (!checkAxis(axisY, half.y, axisY.normalized())) return false;
-    if (!checkAxis(axisZ, half.z, axisZ.normalized())) return false;
+    // 次级光线起点已偏移到表面之外，不再需要 t 的下限；起点在盒内时取离开面
+    const bool inside = tMin <= 0;
+    const T tHit = inside ? tMax : tMin;
+    if (tHit >= hit.t) return false;
+    const int axis_idx = inside ? exit_axis : entry_axis;
+    const T face_sign = inside ? exit_sign : entry_sign;
 
-    double tHit = (tMin > 1e-6) ? tMin : tMax;
-    if (tHit < 1e-6 || tHit >= hit.t) return false;
+    // 法线：交点所在面的局部轴（rot 的第 axis_idx 列）
+    Vec3<T> axis(T(cube.rot.m[0][axis_idx]), T(cube.rot.m[1][axis_idx]), T(cube.rot.m[2][axis_idx]));
 
-    Vector3 P = O + D * tHit;
+    // 单位盒坐标，交点所在面的分量精确取 ±1，再变换回世界坐标：交点严格落在面上，
+    // 误差只来自变换本身，偏移次级光线起点时才有可靠的界
+    Vec3<T> local = lo + ld * tHit;
+    if (axis_idx == 0) local.x = face_sign;
+    else if (axis_idx == 1) local.y = face_sign;
+    else local.z = face_sign;
 
     hit.hit = true;
     hit.t = tHit;
-    hit.pos = P;
-    hit.normal = bestNormal.normalized();
-    hit.color = color;
-    hit.material = material;
-    hit.texture = texture_image;
-
-    // ----------- 计算 UV（只用 local 坐标）-----------
-    Vector3 local = rot_inv.mul(P - center);
-    local.x /= half.x;
-    local.y /= half.y;
-    local.z /= half.z;
-
-    double ax = std::abs(hit.normal.dot(axisX));
-    double ay = std::abs(hit.normal.dot(axisY));
-    double az = std::abs(hit.normal.dot(axisZ));
-
-    double u, v;
-
-    if (ax > ay && ax > az) {
+    hit.pos = center + Mat3<T>(cube.rot).mul(local * Vec3<T>(half[0], half[1], half[2]));
+    hit.normal = axis * face_sign;
+    hit.color = cube.color;
+    hit.material = cube.material;
+    hit.texture = cube.texture_image;
+
+    // ----------- 计算 UV（单位盒坐标）-----------
+    T u, v;
+    if (axis_idx == 0) {
         // ±X 面
-        u = 0.5 + 0.5 * local.z;
-        v = 0.5 + 0.5 * local.y;
-    } else if (ay > ax && ay > az) {
+        u = T(0.5) + T(0.5) * local.z;
+        v = T(0.5) + T(0.5) * local.y;
+    } else if (axis_idx == 1) {
         // ±Y 面
-        u = 0.5 + 0.5 * local.x;
-        v = 0.5 + 0.5 * local.z;
+        u = T(0.5) + T(0.5) * local.x;
+        v = T(0.5) + T(0.5) * local.z;
     } else {
         // ±Z 面
-        u = 0.5 + 0.5 * local.x;
-        v = 0.5 + 0.5 * local.y;
+        u = T(0.5) + T(0.5) * local.x;
+        v = T(0.5) + T(0.5) * local.y;
     }
 
     hit.u = u;
@@ -97,6 +98,14 @@ bool Cube::intersect(const Ray &ray, Hit &hit) const {
     return true;
 }
 
+bool Cube::intersect(const Ray &ray, Hit &hit) const {
+    return intersect_cube(*this, ray, hit);
+}
+
+bool Cube::intersect(const Rayf &ray, Hitf &hit) const {
+    return intersect_cube(*this, ray, hit);
+}
+
 void Cube::bounds(Vector3 &bmin, Vector3 &bmax) const {
     Vector3 half = size * 0.5;
 
@@ -122,11 +131,19 @@ void Cube::bounds(Vector3 &bmin, Vector3 &bmax) const {
     }
 }
 
+void Cube::set_pose(const Vector3 &translation, const Vector3 &rotation_deg) {
+    center = rest_center + translation;
+    rot = Matrix3::from_euler(rotation_deg.x * M_PI / 180.0,
+                              rotation_deg.y * M_PI / 180.0,
+                              rotation_deg.z * M_PI / 180.0).mul(rest_rot);
+    update_transform();
+}
+
 void Cube::set_rotation(double rx_deg, double ry_deg, double rz_deg) {
     double rx = rx_deg * M_PI / 180.0;
     double ry = ry_deg * M_PI / 180.0;
     double rz = rz_deg * M_PI / 180.0;
 
     rot = Matrix3::from_euler(rx, ry, rz);
-    rot_inv = rot.transpose();
+    update_transform();
 }
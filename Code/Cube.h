@@ -15,40 +15,70 @@ public:
     Vector3 size;      // 长方体的尺寸 (width, height, depth)
     Matrix3 rot;       // world rotation (object->world)
     Matrix3 rot_inv;   // transpose
+    Matrix3 to_unit;   // world -> 单位盒 [-1,1]^3：diag(2/size) * rot_inv，由 update_transform() 维护
+    // 动画的静止姿态
+    Vector3 rest_center;
+    Matrix3 rest_rot;
 
     Cube() : size(1.0, 1.0, 1.0) {
         rot = Matrix3();
-        rot_inv = rot.transpose();
+        update_transform();
     }
 
     // 构造函数：指定尺寸
     Cube(const Vector3& center_, const Vector3& size_)
         : center(center_), size(size_) {
         rot = Matrix3();
-        rot_inv = rot.transpose();
+        update_transform();
     }
 
     // 构造函数：指定尺寸（标量，创建立方体）
     Cube(const Vector3& center_, double uniform_size)
         : center(center_), size(uniform_size, uniform_size, uniform_size) {
         rot = Matrix3();
-        rot_inv = rot.transpose();
+        update_transform();
     }
 
     virtual bool intersect(const Ray &r, Hit &h) const override;
+    virtual bool intersect(const Rayf &r, Hitf &h) const override;
     virtual void bounds(Vector3 &bmin, Vector3 &bmax) const override;
+    virtual bool oriented_bounds(Vector3 &center_, Matrix3 &rot_, Vector3 &half_) const override {
+        center_ = center;
+        rot_ = rot;
+        half_ = half_size();
+        return true;
+    }
 
     // 设置旋转（Euler angles，单位：度）
     void set_rotation(double rx_deg, double ry_deg, double rz_deg);
 
+    // rot 或 size 改变后重新计算 rot_inv 和 to_unit
+    void update_transform() {
+        rot_inv = rot.transpose();
+        to_unit = rot_inv;
+        const double inv[3] = {2.0 / size.x, 2.0 / size.y, 2.0 / size.z};
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++) to_unit.m[i][j] *= inv[i];
+    }
+
+    virtual size_t memory_bytes() const override { return sizeof(Cube) + heap_bytes(); }
+    virtual void store_rest_pose() override {
+        rest_center = center;
+        rest_rot = rot;
+    }
+    // 关键帧旋转叠加在静止旋转之上
+    virtual void set_pose(const Vector3 &translation, const Vector3 &rotation_deg) override;
+
     // 设置统一尺寸（创建立方体）
     void set_uniform_scale(double scale) {
         size = Vector3(scale, scale, scale);
+        update_transform();
     }
 
     // 设置长方体尺寸
     void set_size(double width, double height, double depth) {
         size = Vector3(width, height, depth);
+        update_transform();
     }
 
     // 获取半尺寸（用于相交检测） —— 仍然返回真实半尺寸
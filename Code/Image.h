@@ -22,6 +22,7 @@ public:
     void write_ppm(const std::string &filename) const;
     void set_pixel(int x, int y, const Vector3 &color);
     Vector3 get_pixel(int x, int y) const;
+    size_t memory_bytes() const { return pixels.capacity() * sizeof(Color); }
     // 纹理处理
     bool load_ppm(const std::string &filename);      // 读取 P3 ASCII PPM
     Vector3 sample_uv(double u, double v) const;     // 以 u,v (0..1) 取得颜色（最近邻）
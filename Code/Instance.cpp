@@ -0,0 +1,85 @@
+//
+// Created by 31934 on 2025/12/13.
+//
+#include "Instance.h"
+#include <cmath>
+
+int InstanceGroup::find_prototype(const std::string &proto_name) const {
+    for (size_t i = 0; i < prototype_names.size(); i++) {
+        if (prototype_names[i] == proto_name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void InstanceGroup::build(BVHBuilder builder) {
+    // 原型的局部包围盒只算一次
+    std::vector<AABB> proto_bounds(prototypes.size());
+    for (size_t i = 0; i < prototypes.size(); i++) prototypes[i]->bounds(proto_bounds[i].bmin, proto_bounds[i].bmax);
+
+    std::vector<AABB> inst_bounds(instances.size());
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < (int)instances.size(); i++) {
+        const Instance &inst = instances[i];
+        const AABB &local = proto_bounds[inst.prototype];
+        for (int k = 0; k < 8; k++) {
+            Vector3 corner((k & 1) ? local.bmax.x : local.bmin.x,
+                           (k & 2) ? local.bmax.y : local.bmin.y,
+                           (k & 4) ? local.bmax.z : local.bmin.z);
+            inst_bounds[i].expand_point(inst.translation + inst.rot.mul(corner * inst.scale));
+        }
+    }
+    bvh.build(inst_bounds, builder);
+}
+
+bool InstanceGroup::intersect(const Ray &r, Hit &h) const {
+    bool found = bvh.traverse(r, h, [&](int idx) {
+        const Instance &inst = instances[idx];
+
+        // 变换到原型的局部坐标系；方向不归一化，参数 t 在两个坐标系中相同
+        Matrix3 rot_inv = inst.rot.transpose();
+        double inv_scale = 1.0 / inst.scale;
+        Ray local(rot_inv.mul(r.origin - inst.translation) * inv_scale, rot_inv.mul(r.dir) * inv_scale, r.time);
+
+        Hit local_hit;
+        local_hit.t = h.t;
+        if (!prototypes[inst.prototype]->intersect(local, local_hit)) return false;
+
+        h = local_hit;
+        h.pos = r.origin + r.dir * local_hit.t;
+        h.normal = inst.rot.mul(local_hit.normal).normalized();
+        if (inst.look >= 0) {
+            const InstanceLook &look = looks[inst.look];
+            h.color = look.color;
+            h.material = look.material;
+            h.texture = look.texture_image;
+        }
+        return true;
+    });
+    if (found) h.time = r.time;
+    return found;
+}
+
+void InstanceGroup::bounds(Vector3 &bmin, Vector3 &bmax) const {
+    AABB box = bvh.nodes.empty() ? AABB() : bvh.nodes[0].box;
+    bmin = box.bmin;
+    bmax = box.bmax;
+}
+
+size_t InstanceGroup::instance_bytes() const {
+    size_t bytes = instances.capacity() * sizeof(Instance);
+    bytes += bvh.nodes.capacity() * sizeof(BVHNode) + bvh.prim_indices.capacity() * sizeof(int);
+    bytes += looks.capacity() * sizeof(InstanceLook);
+    return bytes;
+}
+
+size_t InstanceGroup::memory_bytes() const {
+    size_t bytes = sizeof(InstanceGroup) + heap_bytes() + instance_bytes();
+    bytes += prototypes.capacity() * sizeof(std::shared_ptr<Shape>);
+    for (const auto &proto : prototypes) bytes += proto->memory_bytes();
+    for (const auto &proto_name : prototype_names) bytes += sizeof(std::string) + proto_name.capacity();
+    return bytes;
+}
+
+Matrix3 InstanceGroup::rotation_from_degrees(double rx_deg, double ry_deg, double rz_deg) {
+    return Matrix3::from_euler(rx_deg * M_PI / 180.0, ry_deg * M_PI / 180.0, rz_deg * M_PI / 180.0);
+}
@@ -0,0 +1,64 @@
+//
+// Created by 31934 on 2025/12/13.
+//
+
+#ifndef GRAPHIC_CW_INSTANCE_H
+#define GRAPHIC_CW_INSTANCE_H
+#pragma once
+#include "Shape.h"
+#include "Matrix3.h"
+#include "BVH.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 实例的材质覆盖：替换原型的颜色、材质和纹理
+struct InstanceLook {
+    Vector3 color = {0.8, 0.8, 0.8};
+    Material material;
+    std::string texture_file;
+    std::shared_ptr<Image> texture_image;
+};
+
+// 单个实例：原型索引 + 物体到世界的变换（均匀缩放、旋转、平移）+ 可选材质覆盖
+// 不保存名字和材质副本，内存与实例数量成正比的部分只有这一条记录
+struct Instance {
+    Matrix3 rot;            // object->world
+    Vector3 translation;
+    double scale = 1.0;
+    int32_t prototype = 0;  // InstanceGroup::prototypes 的下标
+    int32_t look = -1;      // InstanceGroup::looks 的下标，-1 表示沿用原型的材质
+};
+
+// 实例集合：在场景 BVH 中作为一个图元。
+// 内部的顶层 BVH 建在实例的世界包围盒上；命中实例时把光线变换到原型的局部坐标系，
+// 再由原型自己的结构（例如 TriangleMesh 的底层 BVH）求交，几何只保存一份
+class InstanceGroup : public Shape {
+public:
+    std::vector<std::shared_ptr<Shape>> prototypes;
+    std::vector<std::string> prototype_names;
+    std::vector<InstanceLook> looks;
+    std::vector<Instance> instances;
+    BVH bvh; // 顶层 BVH（实例包围盒）
+
+    // 原型名字 -> 下标，未找到返回 -1
+    int find_prototype(const std::string &proto_name) const;
+
+    // 由原型包围盒和实例变换构建顶层 BVH（实例或原型改变后调用）
+    void build(BVHBuilder builder = BVHBuilder::SAH);
+
+    using Shape::intersect; // 单精度求交沿用默认的双精度转换
+    virtual bool intersect(const Ray &r, Hit &h) const override;
+    virtual void bounds(Vector3 &bmin, Vector3 &bmax) const override;
+
+    // 实例记录、顶层 BVH 和材质覆盖占用的字节数（不含原型几何）
+    size_t instance_bytes() const;
+    // 实例记录、顶层 BVH 和原型对象（原型的网格几何仍属于共享的 TriangleMesh）
+    virtual size_t memory_bytes() const override;
+
+    // 由欧拉角（度）生成实例旋转
+    static Matrix3 rotation_from_degrees(double rx_deg, double ry_deg, double rz_deg);
+};
+
+#endif //GRAPHIC_CW_INSTANCE_H
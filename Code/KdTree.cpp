@@ -0,0 +1,269 @@
+//
+// Created by 31934 on 2025/12/14.
+//
+#include "KdTree.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+inline double axis_value(const Vector3 &v, int axis) {
+    if (axis == 0) return v.x;
+    if (axis == 1) return v.y;
+    return v.z;
+}
+
+inline void set_axis(Vector3 &v, int axis, double value) {
+    if (axis == 0) v.x = value;
+    else if (axis == 1) v.y = value;
+    else v.z = value;
+}
+
+// 扫描事件：同一位置上按 结束 < 平面 < 开始 排序
+enum EventType { EVENT_END = 0, EVENT_PLANAR = 1, EVENT_START = 2 };
+struct Event {
+    double pos;
+    int type;
+    bool operator<(const Event &o) const { return pos < o.pos || (pos == o.pos && type < o.type); }
+};
+
+// 光线与包围盒的进入 / 离开距离
+bool ray_box(const AABB &box, const Ray &ray, double tmin, double tmax, double &t0, double &t1) {
+    const double o[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    const double d[3] = {ray.dir.x, ray.dir.y, ray.dir.z};
+    const double lo[3] = {box.bmin.x, box.bmin.y, box.bmin.z};
+    const double hi[3] = {box.bmax.x, box.bmax.y, box.bmax.z};
+    for (int a = 0; a < 3; a++) {
+        if (d[a] == 0.0) {
+            if (o[a] < lo[a] || o[a] > hi[a]) return false;
+            continue;
+        }
+        double inv = 1.0 / d[a];
+        double n = (lo[a] - o[a]) * inv, f = (hi[a] - o[a]) * inv;
+        if (inv < 0.0) std::swap(n, f);
+        tmin = std::max(tmin, n);
+        tmax = std::min(tmax, f);
+        if (tmax < tmin) return false;
+    }
+    t0 = tmin;
+    t1 = tmax;
+    return true;
+}
+} // namespace
+
+struct KdTree::Reference {
+    AABB box; // 对象裁剪到当前节点后的包围盒
+    int prim;
+};
+
+struct KdTree::BuildContext {
+    const Scene &scene;
+    double shutter;
+    int max_depth;
+
+    // 把对象引用裁剪到子节点空间内；运动物体按扫掠包围盒处理
+    bool clip(const Reference &r, const AABB &child, AABB &out) const {
+        AABB b = AABB::intersection(r.box, child);
+        if (!b.valid()) return false;
+        const Shape &obj = *scene.objects[r.prim];
+        if (shutter > 0.0 && obj.is_moving()) {
+            out = b;
+            return true;
+        }
+        AABB part;
+        if (!obj.clip_bounds(b.bmin, b.bmax, part.bmin, part.bmax)) return false;
+        out = AABB::intersection(part, b);
+        return out.valid();
+    }
+};
+
+void KdTree::build(const Scene &scene) {
+    box = AABB();
+    nodes.clear();
+    prim_indices.clear();
+
+    std::vector<AABB> bounds = static_object_bounds(scene);
+    if (bounds.empty()) return;
+
+    std::vector<Reference> refs(bounds.size());
+    for (int i = 0; i < (int)bounds.size(); i++) {
+        refs[i] = {bounds[i], i};
+        box.expand(bounds[i]);
+    }
+
+    // 深度上限：8 + 1.3 log2(N)（Havran 的经验值）
+    int max_depth = std::min(60, (int)(8 + 1.3 * std::log2((double)bounds.size())));
+    BuildContext ctx{scene, BVH::motion_shutter(scene), max_depth};
+    build_recursive(ctx, refs, box, 0);
+}
+
+void KdTree::build_recursive(BuildContext &ctx, std::vector<Reference> &refs, const AABB &node_box, int depth) {
+    const int node_idx = (int)nodes.size();
+    nodes.emplace_back();
+    const int count = (int)refs.size();
+
+    auto make_leaf = [&]() {
+        nodes[node_idx].first_prim = (int)prim_indices.size();
+        nodes[node_idx].prim_count = count;
+        for (const auto &r : refs) prim_indices.push_back(r.prim);
+    };
+    if (count <= 1 || depth >= ctx.max_depth) {
+        make_leaf();
+        return;
+    }
+
+    // 沿三个轴扫描对象边界事件，求 SAH 代价最小的分割面；平面对象（厚度为 0）分别试放两侧
+    const double area = std::max(node_box.surface_area(), 1e-12);
+    double best_cost = INTERSECT_COST * count;
+    int best_axis = -1;
+    double best_pos = 0.0;
+    bool best_planar_left = true;
+    std::vector<Event> events;
+    for (int a = 0; a < 3; a++) {
+        const double lo = axis_value(node_box.bmin, a), hi = axis_value(node_box.bmax, a);
+        if (hi - lo <= 1e-12) continue;
+
+        events.clear();
+        for (const auto &r : refs) {
+            double rmin = std::clamp(axis_value(r.box.bmin, a), lo, hi);
+            double rmax = std::clamp(axis_value(r.box.bmax, a), lo, hi);
+            if (rmin == rmax) {
+                events.push_back({rmin, EVENT_PLANAR});
+            } else {
+                events.push_back({rmin, EVENT_START});
+                events.push_back({rmax, EVENT_END});
+            }
+        }
+        std::sort(events.begin(), events.end());
+
+        int n_left = 0, n_right = count;
+        for (size_t i = 0; i < events.size();) {
+            const double pos = events[i].pos;
+            int n_end = 0, n_planar = 0, n_start = 0;
+            for (; i < events.size() && events[i].pos == pos && events[i].type == EVENT_END; i++) n_end++;
+            for (; i < events.size() && events[i].pos == pos && events[i].type == EVENT_PLANAR; i++) n_planar++;
+            for (; i < events.size() && events[i].pos == pos && events[i].type == EVENT_START; i++) n_start++;
+
+            n_right -= n_planar + n_end;
+            if (pos > lo && pos < hi) {
+                AABB lbox = node_box, rbox = node_box;
+                set_axis(lbox.bmax, a, pos);
+                set_axis(rbox.bmin, a, pos);
+                const double pl = lbox.surface_area() / area, pr = rbox.surface_area() / area;
+                auto sah = [&](int nl, int nr) {
+                    double cost = TRAVERSAL_COST + INTERSECT_COST * (pl * nl + pr * nr);
+                    return (nl == 0 || nr == 0) ? cost * (1.0 - EMPTY_BONUS) : cost;
+                };
+                double cost_l = sah(n_left + n_planar, n_right);
+                double cost_r = sah(n_left, n_right + n_planar);
+                double cost = std::min(cost_l, cost_r);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = a;
+                    best_pos = pos;
+                    best_planar_left = cost_l <= cost_r;
+                }
+            }
+            n_left += n_start + n_planar;
+        }
+    }
+    if (best_axis < 0) {
+        make_leaf();
+        return;
+    }
+
+    // 划分：跨越分割面的对象裁剪到两侧，只进入实际重叠的子节点
+    AABB left_box = node_box, right_box = node_box;
+    set_axis(left_box.bmax, best_axis, best_pos);
+    set_axis(right_box.bmin, best_axis, best_pos);
+    std::vector<Reference> left, right;
+    for (const auto &r : refs) {
+        double rmin = axis_value(r.box.bmin, best_axis), rmax = axis_value(r.box.bmax, best_axis);
+        if (rmin == best_pos && rmax == best_pos) {
+            (best_planar_left ? left : right).push_back(r);
+        } else if (rmax <= best_pos) {
+            left.push_back(r);
+        } else if (rmin >= best_pos) {
+            right.push_back(r);
+        } else {
+            AABB lpart, rpart;
+            bool hl = ctx.clip(r, left_box, lpart);
+            bool hr = ctx.clip(r, right_box, rpart);
+            if (!hl && !hr) {
+                // 两侧都裁空只可能是数值误差，按包围盒保留
+                hl = hr = true;
+                lpart = AABB::intersection(r.box, left_box);
+                rpart = AABB::intersection(r.box, right_box);
+            }
+            if (hl) left.push_back({lpart, r.prim});
+            if (hr) right.push_back({rpart, r.prim});
+        }
+    }
+    std::vector<Reference>().swap(refs);
+
+    nodes[node_idx].axis = best_axis;
+    nodes[node_idx].split = best_pos;
+    build_recursive(ctx, left, left_box, depth + 1);
+    nodes[node_idx].right = (int)nodes.size();
+    build_recursive(ctx, right, right_box, depth + 1);
+}
+
+bool KdTree::intersect(const Ray &ray, Hit &hit, const Scene &scene) const {
+    if (nodes.empty()) return false;
+
+    const double t_min = 0.0; // 次级光线起点已偏移到表面之外（见 spawn_ray），与 BVH 相同从 0 开始
+    double t0, t1;
+    if (!ray_box(box, ray, t_min, hit.t, t0, t1)) return false;
+
+    const double o[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    const double d[3] = {ray.dir.x, ray.dir.y, ray.dir.z};
+
+    // 栈中保存远侧子节点及其光线区间；深度有上限，128 足够
+    struct Entry { int node; double t0, t1; };
+    Entry stack[128];
+    int sp = 0;
+    int node = 0;
+    bool found = false;
+
+    while (true) {
+        // 下降到叶子：光线区间跨越分割面时先访问近侧，远侧入栈
+        while (!nodes[node].is_leaf()) {
+            const KdNode &n = nodes[node];
+            const int a = n.axis;
+            int near_child = node + 1, far_child = n.right;
+            bool below = o[a] < n.split || (o[a] == n.split && d[a] <= 0.0);
+            if (!below) std::swap(near_child, far_child);
+            if (d[a] == 0.0) {
+                node = near_child;
+                continue;
+            }
+            double t_split = (n.split - o[a]) / d[a];
+            if (t_split > t1 || t_split <= 0.0) {
+                node = near_child;
+            } else if (t_split < t0) {
+                node = far_child;
+            } else {
+                stack[sp++] = {far_child, t_split, t1};
+                node = near_child;
+                t1 = t_split;
+            }
+        }
+
+        const KdNode &leaf = nodes[node];
+        for (int i = 0; i < leaf.prim_count; i++) {
+            if (scene.objects[prim_indices[leaf.first_prim + i]]->intersect_at_time(ray, hit)) found = true;
+        }
+
+        // 交点在当前叶子的区间内即为最近交点；之后的叶子都更远
+        if (hit.t <= t1 || sp == 0) return found;
+        Entry e = stack[--sp];
+        if (e.t0 >= hit.t) return found;
+        node = e.node;
+        t0 = e.t0;
+        t1 = e.t1;
+    }
+}
+
+size_t KdTree::memory_bytes() const {
+    return nodes.capacity() * sizeof(KdNode) + prim_indices.capacity() * sizeof(int);
+}
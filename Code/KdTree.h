@@ -0,0 +1,45 @@
+//
+// Created by 31934 on 2025/12/14.
+//
+
+#ifndef GRAPHIC_CW_KDTREE_H
+#define GRAPHIC_CW_KDTREE_H
+#pragma once
+#include "Accelerator.h"
+#include <vector>
+
+struct KdNode {
+    double split = 0.0;
+    int axis = -1;       // -1 表示叶子
+    int right = -1;      // 左子节点紧跟父节点（深度优先），这里只存右子节点
+    int first_prim = 0;  // 叶子：prim_indices 中的区间
+    int prim_count = 0;
+
+    bool is_leaf() const { return axis < 0; }
+};
+
+// SAH kd 树：在对象包围盒的边界上扫描候选分割面（Wald & Havran 2006 的 O(N log^2 N) 版本）。
+// 跨越分割面的对象进入两侧；Plane 等平面对象通过 Shape::clip_bounds 裁剪到子空间，只进入真正重叠的一侧。
+// 空间不重叠，遍历按光线顺序访问叶子，找到落在当前叶子区间内的交点即可停止
+class KdTree : public Accelerator {
+public:
+    static constexpr double TRAVERSAL_COST = 1.0;
+    static constexpr double INTERSECT_COST = 1.5;
+    static constexpr double EMPTY_BONUS = 0.2; // 一侧为空时的代价折扣（鼓励切掉空白区域）
+
+    AABB box;
+    std::vector<KdNode> nodes;
+    std::vector<int> prim_indices;
+
+    AcceleratorType type() const override { return AcceleratorType::KDTREE; }
+    void build(const Scene &scene) override;
+    bool intersect(const Ray &ray, Hit &hit, const Scene &scene) const override;
+    size_t memory_bytes() const override;
+
+private:
+    struct Reference;
+    struct BuildContext;
+    void build_recursive(BuildContext &ctx, std::vector<Reference> &refs, const AABB &node_box, int depth);
+};
+
+#endif //GRAPHIC_CW_KDTREE_H
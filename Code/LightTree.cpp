@@ -0,0 +1,196 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+#include "LightTree.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+// 超过此深度后改为按中位数分割：强度悬殊、沿一条轴排列的光源会使 SAOH 分割退化成链，
+// 限制深度后树高不超过 MAX_SAOH_DEPTH + log2(N)，intersect_disks 的固定栈不会溢出
+constexpr int MAX_SAOH_DEPTH = 32;
+constexpr int TRAVERSAL_STACK = 64;
+
+inline double axis_value(const Vector3 &v, int axis) {
+    if (axis == 0) return v.x;
+    if (axis == 1) return v.y;
+    return v.z;
+}
+
+AABB light_box(const PointLight &light) {
+    const double e = light.extent();
+    AABB box;
+    box.expand_point(light.pos - Vector3(e, e, e));
+    box.expand_point(light.pos + Vector3(e, e, e));
+    return box;
+}
+} // namespace
+
+void LightTree::build(const std::vector<PointLight> &lights) {
+    nodes.clear();
+    parents.clear();
+    leaf_of.assign(lights.size(), -1);
+    if (lights.empty()) return;
+    nodes.reserve(2 * lights.size() - 1);
+    std::vector<int> order(lights.size());
+    std::iota(order.begin(), order.end(), 0);
+    build_recursive(lights, order, 0, (int)order.size(), 0);
+
+    parents.assign(nodes.size(), -1);
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        if (nodes[i].is_leaf()) {
+            leaf_of[nodes[i].light] = i;
+        } else {
+            parents[i + 1] = i;
+            parents[nodes[i].right] = i;
+        }
+    }
+}
+
+int LightTree::build_recursive(const std::vector<PointLight> &lights, std::vector<int> &order, int begin, int end,
+                               int depth) {
+    const int node_idx = (int)nodes.size();
+    nodes.emplace_back();
+    AABB box, centroids;
+    double power = 0.0;
+    for (int i = begin; i < end; i++) {
+        const PointLight &l = lights[order[i]];
+        box.expand(light_box(l));
+        centroids.expand_point(l.pos);
+        power += l.intensity;
+    }
+    nodes[node_idx].box = box;
+    nodes[node_idx].power = power;
+    if (end - begin == 1) {
+        nodes[node_idx].light = order[begin];
+        return node_idx;
+    }
+
+    // 沿质心跨度最大的轴排序，扫描所有分割位置，取 强度 x 表面积 之和最小的一个（Kulla 的 SAOH 去掉方向项）
+    Vector3 ext = centroids.bmax - centroids.bmin;
+    int axis = ext.x > ext.y ? (ext.x > ext.z ? 0 : 2) : (ext.y > ext.z ? 1 : 2);
+    std::sort(order.begin() + begin, order.begin() + end, [&](int a, int b) {
+        return axis_value(lights[a].pos, axis) < axis_value(lights[b].pos, axis);
+    });
+
+    // 深度超过 MAX_SAOH_DEPTH 时取中位数
+    const int n = end - begin;
+    int split = begin + n / 2;
+    if (depth < MAX_SAOH_DEPTH) {
+        std::vector<double> right_cost(n, 0.0);
+        AABB acc;
+        double acc_power = 0.0;
+        for (int i = n - 1; i > 0; i--) {
+            acc.expand(light_box(lights[order[begin + i]]));
+            acc_power += lights[order[begin + i]].intensity;
+            right_cost[i] = acc_power * acc.surface_area();
+        }
+        double best = 1e300;
+        acc = AABB();
+        acc_power = 0.0;
+        for (int i = 0; i < n - 1; i++) {
+            acc.expand(light_box(lights[order[begin + i]]));
+            acc_power += lights[order[begin + i]].intensity;
+            double cost = acc_power * acc.surface_area() + right_cost[i + 1];
+            if (cost < best) {
+                best = cost;
+                split = begin + i + 1;
+            }
+        }
+    }
+
+    build_recursive(lights, order, begin, split, depth + 1);
+    int right = build_recursive(lights, order, split, end, depth + 1);
+    nodes[node_idx].right = right;
+    return node_idx;
+}
+
+double LightTree::importance(const LightTreeNode &node, const Vector3 &p, const Vector3 &n) {
+    if (node.power <= 0.0) return 0.0;
+    const AABB &b = node.box;
+
+    // 着色点到包围盒的最近距离：衰减的上界
+    Vector3 nearest(std::clamp(p.x, b.bmin.x, b.bmax.x), std::clamp(p.y, b.bmin.y, b.bmax.y),
+                    std::clamp(p.z, b.bmin.z, b.bmax.z));
+    double attenuation = light_attenuation((nearest - p).length());
+
+    // 包围球对着色点张成的圆锥：cos(max(0, θ - θ_box)) 是包围盒内任意方向与法线夹角余弦的上界
+    Vector3 d = b.center() - p;
+    double dist = d.length();
+    double radius = 0.5 * (b.bmax - b.bmin).length();
+    double cos_bound = 1.0;
+    if (dist > radius) {
+        double cos_theta = std::clamp(n.dot(d) / dist, -1.0, 1.0);
+        double sin_box = radius / dist, cos_box = std::sqrt(1.0 - sin_box * sin_box);
+        if (cos_theta < cos_box) {
+            double sin_theta = std::sqrt(1.0 - cos_theta * cos_theta);
+            cos_bound = cos_theta * cos_box + sin_theta * sin_box;
+        }
+    }
+    return node.power * attenuation * std::max(cos_bound, MIN_COS);
+}
+
+int LightTree::sample(const Vector3 &p, const Vector3 &n, double u, double &pdf) const {
+    pdf = 0.0;
+    if (nodes.empty()) return -1;
+    double prob = 1.0;
+    int node = 0;
+    while (!nodes[node].is_leaf()) {
+        const int left = node + 1, right = nodes[node].right;
+        double il = importance(nodes[left], p, n), ir = importance(nodes[right], p, n);
+        if (il + ir <= 0.0) return -1; // 整棵子树强度为 0，没有贡献
+        double pl = il / (il + ir);
+        // 复用同一个随机数：选中一侧后把 u 重新缩放到 [0,1)
+        if (u < pl) {
+            u = std::min(u / pl, 1.0 - 1e-12);
+            prob *= pl;
+            node = left;
+        } else {
+            u = std::min((u - pl) / (1.0 - pl), 1.0 - 1e-12);
+            prob *= 1.0 - pl;
+            node = right;
+        }
+    }
+    pdf = prob;
+    return nodes[node].light;
+}
+
+double LightTree::pdf(const Vector3 &p, const Vector3 &n, int light) const {
+    if (light < 0 || light >= (int)leaf_of.size()) return 0.0;
+    // 从叶子向上累乘每一层选中该侧的概率（与 sample 的选择规则相同）
+    double prob = 1.0;
+    for (int node = leaf_of[light]; parents[node] >= 0; node = parents[node]) {
+        const int parent = parents[node], left = parent + 1, right = nodes[parent].right;
+        double il = importance(nodes[left], p, n), ir = importance(nodes[right], p, n);
+        if (il + ir <= 0.0) return 0.0;
+        prob *= (node == left ? il : ir) / (il + ir);
+    }
+    return prob;
+}
+
+int LightTree::intersect_disks(const Ray &ray, double t_max, const std::vector<PointLight> &lights,
+                               DiskHit *hits, int max_hits) const {
+    if (nodes.empty() || std::abs(ray.dir.z) < 1e-12) return 0;
+    int count = 0;
+    int stack[TRAVERSAL_STACK];
+    int sp = 0;
+    stack[sp++] = 0;
+    while (sp > 0 && count < max_hits) {
+        const LightTreeNode &node = nodes[stack[--sp]];
+        if (!node.box.intersect(ray, 0.0, t_max)) continue;
+        if (!node.is_leaf()) {
+            stack[sp++] = node.right;
+            stack[sp++] = (int)(&node - nodes.data()) + 1;
+            continue;
+        }
+        const PointLight &l = lights[node.light];
+        if (l.radius <= 0.0) continue;
+        double t = (l.pos.z - ray.origin.z) / ray.dir.z;
+        if (t <= 0.0 || t >= t_max) continue;
+        Vector3 q = ray.origin + ray.dir * t - l.pos;
+        if (q.x * q.x + q.y * q.y <= l.radius * l.radius) hits[count++] = {node.light, t};
+    }
+    return count;
+}
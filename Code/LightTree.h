@@ -0,0 +1,61 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_LIGHTTREE_H
+#define GRAPHIC_CW_LIGHTTREE_H
+#pragma once
+#include "BVH.h"
+#include <vector>
+
+struct PointLight;
+
+// 光源树节点：包围盒覆盖子树内所有光源的采样范围（含面光源半径和点光源抖动）
+struct LightTreeNode {
+    AABB box;
+    double power = 0.0; // 子树光源强度之和
+    int right = -1;     // 内部节点：右子节点（左子节点紧跟父节点，深度优先）
+    int light = -1;     // 叶子：光源下标
+
+    bool is_leaf() const { return light >= 0; }
+};
+
+// 光源 BVH（Conty Estevez & Kulla 2018, "Importance Sampling of Many Lights with Adaptive Tree Splitting"）：
+// 每个光源样本从根向下走，在每个内部节点按两个子节点对着色点的重要性随机选一侧，
+// 选中光源的概率为沿途选择概率之积，贡献除以该概率。重要性只需处处为正即可保持无偏，
+// 每个样本的开销为 O(log N)，与光源数基本无关
+class LightTree {
+public:
+    // 光源完全位于着色点切平面下方时漫反射为 0，但 Blinn-Phong 高光仍可能非零：重要性保留此下限，不取 0
+    static constexpr double MIN_COS = 0.05;
+
+    std::vector<LightTreeNode> nodes;
+    std::vector<int> parents;  // 每个节点的父节点（根为 -1）
+    std::vector<int> leaf_of;  // 每个光源所在的叶子
+
+    void build(const std::vector<PointLight> &lights);
+    bool empty() const { return nodes.empty(); }
+
+    // 在着色点 p（法线 n）处按重要性选择一个光源：返回光源下标，pdf 为其被选中的概率；没有光源时返回 -1
+    int sample(const Vector3 &p, const Vector3 &n, double u, double &pdf) const;
+
+    // sample 在着色点 p（法线 n）处选中光源 light 的概率
+    double pdf(const Vector3 &p, const Vector3 &n, int light) const;
+
+    // 光线与面光源圆盘（半径 > 0，假设在 XY 平面）在 (0, t_max) 内的所有交点，最多 max_hits 个，返回个数
+    struct DiskHit { int light; double t; };
+    int intersect_disks(const Ray &ray, double t_max, const std::vector<PointLight> &lights,
+                        DiskHit *hits, int max_hits) const;
+
+    // 节点对着色点的重要性：强度 x 最近距离处的衰减 x 法线与包围盒方向夹角余弦的上界
+    static double importance(const LightTreeNode &node, const Vector3 &p, const Vector3 &n);
+
+    size_t memory_bytes() const {
+        return nodes.capacity() * sizeof(LightTreeNode) + (parents.capacity() + leaf_of.capacity()) * sizeof(int);
+    }
+
+private:
+    int build_recursive(const std::vector<PointLight> &lights, std::vector<int> &order, int begin, int end, int depth);
+};
+
+#endif //GRAPHIC_CW_LIGHTTREE_H
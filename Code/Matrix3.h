@@ -8,27 +8,40 @@
 #include "Vector3.h"
 #include <cmath>
 
-struct Matrix3 {
-    double m[3][3];
-    Matrix3(){ for(int i=0;i<3;i++) for(int j=0;j<3;j++) m[i][j]= (i==j?1.0:0.0); }
-    Vector3 mul(const Vector3 &v) const {
+// 3x3 矩阵（行主序），与 Vec3 一样按标量类型模板化
+template <typename T>
+struct Mat3 {
+    T m[3][3];
+    Mat3(){ for(int i=0;i<3;i++) for(int j=0;j<3;j++) m[i][j]= (i==j?1:0); }
+    // 不同精度之间显式转换
+    template <typename U>
+    explicit Mat3(const Mat3<U> &b) { for(int i=0;i<3;i++) for(int j=0;j<3;j++) m[i][j]=static_cast<T>(b.m[i][j]); }
+    Vec3<T> mul(const Vec3<T> &v) const {
         return {
             m[0][0]*v.x + m[0][1]*v.y + m[0][2]*v.z,
             m[1][0]*v.x + m[1][1]*v.y + m[1][2]*v.z,
             m[2][0]*v.x + m[2][1]*v.y + m[2][2]*v.z
         };
     }
-    Matrix3 transpose() const {
-        Matrix3 r;
+    Mat3 mul(const Mat3 &b) const {
+        Mat3 r;
+        for(int i=0;i<3;i++) for(int j=0;j<3;j++){
+            r.m[i][j]=0;
+            for(int k=0;k<3;k++) r.m[i][j]+= m[i][k]*b.m[k][j];
+        }
+        return r;
+    }
+    Mat3 transpose() const {
+        Mat3 r;
         for(int i=0;i<3;i++) for(int j=0;j<3;j++) r.m[i][j]=m[j][i];
         return r;
     }
-    static Matrix3 from_euler(double rx, double ry, double rz) {
-        double cx = cos(rx), sx = sin(rx);
-        double cy = cos(ry), sy = sin(ry);
-        double cz = cos(rz), sz = sin(rz);
+    static Mat3 from_euler(T rx, T ry, T rz) {
+        T cx = std::cos(rx), sx = std::sin(rx);
+        T cy = std::cos(ry), sy = std::sin(ry);
+        T cz = std::cos(rz), sz = std::sin(rz);
         // R = Rz * Ry * Rx
-        Matrix3 Rx, Ry, Rz;
+        Mat3 Rx, Ry, Rz;
         Rx.m[0][0]=1; Rx.m[0][1]=0;  Rx.m[0][2]=0;
         Rx.m[1][0]=0; Rx.m[1][1]=cx; Rx.m[1][2]=-sx;
         Rx.m[2][0]=0; Rx.m[2][1]=sx; Rx.m[2][2]=cx;
@@ -38,13 +51,13 @@ struct Matrix3 {
         Rz.m[0][0]=cz; Rz.m[0][1]=-sz; Rz.m[0][2]=0;
         Rz.m[1][0]=sz; Rz.m[1][1]=cz;  Rz.m[1][2]=0;
         Rz.m[2][0]=0;  Rz.m[2][1]=0;   Rz.m[2][2]=1;
-        Matrix3 tmp;
+        Mat3 tmp;
         // tmp = Rz * Ry
         for(int i=0;i<3;i++) for(int j=0;j<3;j++){
             tmp.m[i][j]=0;
             for(int k=0;k<3;k++) tmp.m[i][j]+= Rz.m[i][k]*Ry.m[k][j];
         }
-        Matrix3 R;
+        Mat3 R;
         // R = tmp * Rx
         for(int i=0;i<3;i++) for(int j=0;j<3;j++){
             R.m[i][j]=0;
@@ -54,4 +67,7 @@ struct Matrix3 {
     }
 };
 
+using Matrix3 = Mat3<double>;
+using Matrix3f = Mat3<float>;
+
 #endif //GRAPHIC_MATRIX3_H
\ No newline at end of file
@@ -0,0 +1,98 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+#include "MemoryStats.h"
+#include "Scene.h"
+#include "Image.h"
+#include "Mesh.h"
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+
+namespace {
+constexpr int TAG_COUNT = (int)MemTag::COUNT;
+std::atomic<long long> g_current[TAG_COUNT];
+std::atomic<long long> g_peak[TAG_COUNT];
+std::atomic<long long> g_total{0}, g_total_peak{0};
+
+void raise_peak(std::atomic<long long> &peak, long long value) {
+    long long old = peak.load(std::memory_order_relaxed);
+    while (value > old && !peak.compare_exchange_weak(old, value, std::memory_order_relaxed)) {}
+}
+
+double mib(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+} // namespace
+
+const char *mem_tag_name(MemTag tag) {
+    static const char *names[TAG_COUNT] = {"scene_objects", "lights", "textures", "meshes", "bvh",
+                                           "accelerator", "light_tree", "framebuffer", "render_buffers",
+                                           "scene_cache"};
+    return names[(int)tag];
+}
+
+void mem_add(MemTag tag, long long delta) {
+    const int i = (int)tag;
+    raise_peak(g_peak[i], g_current[i].fetch_add(delta, std::memory_order_relaxed) + delta);
+    raise_peak(g_total_peak, g_total.fetch_add(delta, std::memory_order_relaxed) + delta);
+}
+
+void mem_set(MemTag tag, size_t bytes) {
+    mem_add(tag, (long long)bytes - g_current[(int)tag].load(std::memory_order_relaxed));
+}
+
+size_t mem_current(MemTag tag) { return (size_t)g_current[(int)tag].load(); }
+size_t mem_peak(MemTag tag) { return (size_t)g_peak[(int)tag].load(); }
+size_t mem_total_current() { return (size_t)g_total.load(); }
+size_t mem_total_peak() { return (size_t)g_total_peak.load(); }
+
+void mem_account_scene(const Scene &scene) {
+    size_t objects = scene.objects.capacity() * sizeof(std::shared_ptr<Shape>);
+    for (const auto &obj : scene.objects) objects += obj->memory_bytes();
+    mem_set(MemTag::SCENE_OBJECTS, objects);
+
+    mem_set(MemTag::LIGHTS, scene.lights.capacity() * sizeof(PointLight));
+
+    size_t textures = 0;
+    for (const auto &tex : scene.textures) textures += sizeof(Image) + tex->memory_bytes();
+    mem_set(MemTag::TEXTURES, textures);
+
+    size_t meshes = 0;
+    for (const auto &mesh : scene.meshes) meshes += sizeof(TriangleMesh) + mesh->memory_bytes();
+    mem_set(MemTag::MESHES, meshes);
+}
+
+void print_memory_report(std::ostream &os, size_t process_peak) {
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << "\n=== Memory (tracked by subsystem) ===\n";
+    os << std::left << std::setw(18) << "subsystem" << std::right << std::setw(14) << "current_MiB" << std::setw(12)
+       << "peak_MiB" << "\n";
+    os << std::fixed << std::setprecision(3);
+    for (int i = 0; i < TAG_COUNT; i++) {
+        MemTag tag = (MemTag)i;
+        os << std::left << std::setw(18) << mem_tag_name(tag) << std::right << std::setw(14) << mib(mem_current(tag))
+           << std::setw(12) << mib(mem_peak(tag)) << "\n";
+    }
+    os << std::left << std::setw(18) << "total" << std::right << std::setw(14) << mib(mem_total_current())
+       << std::setw(12) << mib(mem_total_peak()) << "\n";
+    if (process_peak > 0)
+        os << "Process peak RSS: " << mib(process_peak) << " MiB (untracked: code, stacks, allocator overhead, "
+           << "temporaries)\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+bool write_memory_json(const std::string &path, size_t process_peak) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "{\n  \"subsystems\": {\n";
+    for (int i = 0; i < TAG_COUNT; i++) {
+        MemTag tag = (MemTag)i;
+        out << "    \"" << mem_tag_name(tag) << "\": {\"current_bytes\": " << mem_current(tag)
+            << ", \"peak_bytes\": " << mem_peak(tag) << "}" << (i + 1 < TAG_COUNT ? "," : "") << "\n";
+    }
+    out << "  },\n  \"total\": {\"current_bytes\": " << mem_total_current() << ", \"peak_bytes\": " << mem_total_peak()
+        << "},\n  \"process_peak_rss_bytes\": " << process_peak << "\n}\n";
+    return (bool)out;
+}
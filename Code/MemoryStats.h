@@ -0,0 +1,62 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_MEMORYSTATS_H
+#define GRAPHIC_CW_MEMORYSTATS_H
+#pragma once
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+struct Scene;
+
+// 按子系统的内存记账：显式计数（各结构的 memory_bytes()，与加速结构报告一致），不替换分配器。
+// 长期存在的数据（场景、BVH、纹理、帧缓冲）在构建后用 mem_set 登记，渲染中的临时缓冲用 MemScope 登记；
+// 每个子系统和总量都记录当前值与峰值，渲染结束后输出表格或 JSON（--memory-report），用于估算一台机器能并行几个渲染
+enum class MemTag {
+    SCENE_OBJECTS,  // Shape 对象（含名字、关键帧、实例记录）
+    LIGHTS,
+    TEXTURES,       // 纹理像素
+    MESHES,         // 三角网格顶点、索引及其底层 BVH
+    BVH,            // 场景 BVH 节点和索引
+    ACCELERATOR,    // BVH 以外的加速结构（网格、kd 树）
+    LIGHT_TREE,
+    FRAMEBUFFER,    // 输出图像
+    RENDER_BUFFERS, // 渲染中的临时缓冲（ReSTIR 的 G-buffer / 蓄水池等）
+    SCENE_CACHE,    // 加载时映射的二进制场景缓存
+    COUNT
+};
+
+const char *mem_tag_name(MemTag tag);
+
+// 设置子系统当前占用（替换之前的值）
+void mem_set(MemTag tag, size_t bytes);
+// 增减子系统当前占用（线程安全）
+void mem_add(MemTag tag, long long delta);
+size_t mem_current(MemTag tag);
+size_t mem_peak(MemTag tag);
+size_t mem_total_current();
+size_t mem_total_peak();
+
+// 登记场景对象、光源、纹理和网格
+void mem_account_scene(const Scene &scene);
+
+// 作用域内的临时分配
+class MemScope {
+public:
+    MemScope(MemTag tag, size_t bytes) : tag_(tag), bytes_(bytes) { mem_add(tag_, (long long)bytes_); }
+    ~MemScope() { mem_add(tag_, -(long long)bytes_); }
+    MemScope(const MemScope &) = delete;
+    MemScope &operator=(const MemScope &) = delete;
+
+private:
+    MemTag tag_;
+    size_t bytes_;
+};
+
+// process_peak：进程峰值常驻内存（操作系统统计，0 表示未知），用于对照未记账的部分
+void print_memory_report(std::ostream &os, size_t process_peak);
+bool write_memory_json(const std::string &path, size_t process_peak);
+
+#endif //GRAPHIC_CW_MEMORYSTATS_H
@@ -0,0 +1,192 @@
+//
+// Created by 31934 on 2025/12/12.
+//
+#include "Mesh.h"
+#include "RenderStats.h"
+#include <cmath>
+#include <numeric>
+
+namespace {
+inline double comp(const Vector3 &v, int k) {
+    return k == 0 ? v.x : (k == 1 ? v.y : v.z);
+}
+
+// 水密光线/三角形求交（Woop, Benthin, Wald 2013）的逐光线预计算：
+// 选取光线方向绝对值最大的分量为 z 轴，剪切变换后光线沿 +z，三角形投影到 xy 平面做 2D 边函数测试。
+// 相邻三角形共享的边在两侧得到完全相同的边函数值，不会出现漏光的缝隙
+struct WatertightRay {
+    int kx, ky, kz;
+    double sx, sy, sz;
+
+    explicit WatertightRay(const Vector3 &d) {
+        double ax = std::abs(d.x), ay = std::abs(d.y), az = std::abs(d.z);
+        kz = (ax > ay) ? (ax > az ? 0 : 2) : (ay > az ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        // 保持三角形的环绕方向
+        if (comp(d, kz) < 0.0) std::swap(kx, ky);
+        sz = 1.0 / comp(d, kz);
+        sx = comp(d, kx) * sz;
+        sy = comp(d, ky) * sz;
+    }
+};
+} // namespace
+
+// ====================== TriangleMesh ======================
+void TriangleMesh::build_bvh(BVHBuilder builder) {
+    std::vector<AABB> tri_bounds(triangles.size());
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < (int)triangles.size(); i++) {
+        for (int k = 0; k < 3; k++) tri_bounds[i].expand_point(positions[triangles[i][k]]);
+    }
+    BVH::ClipFn clip;
+    if (builder == BVHBuilder::SBVH) {
+        clip = [this](int tri, const AABB &box, AABB &out) {
+            const Vector3 verts[3] = {positions[triangles[tri][0]], positions[triangles[tri][1]], positions[triangles[tri][2]]};
+            return clip_polygon_bounds(verts, 3, box, out);
+        };
+    }
+    bvh.build(tri_bounds, builder, clip);
+
+    // 三角形按叶子顺序重排，遍历时顺序访问内存（SBVH 被空间分割的三角形在多个叶子中各存一份）
+    std::vector<std::array<int, 3>> ordered(bvh.prim_indices.size());
+    for (size_t i = 0; i < ordered.size(); i++) ordered[i] = triangles[bvh.prim_indices[i]];
+    triangles.swap(ordered);
+    std::iota(bvh.prim_indices.begin(), bvh.prim_indices.end(), 0);
+}
+
+AABB TriangleMesh::local_bounds() const {
+    return bvh.nodes.empty() ? AABB() : bvh.nodes[0].box;
+}
+
+size_t TriangleMesh::memory_bytes() const {
+    return positions.capacity() * sizeof(Vector3) + normals.capacity() * sizeof(Vector3) +
+           texcoords.capacity() * sizeof(std::array<double, 2>) + triangles.capacity() * sizeof(std::array<int, 3>) +
+           bvh.nodes.capacity() * sizeof(BVHNode) + bvh.prim_indices.capacity() * sizeof(int);
+}
+
+bool TriangleMesh::intersect(const Ray &ray, Hit &hit) const {
+    const WatertightRay wr(ray.dir);
+    int best = -1;
+    double bu = 0.0, bv = 0.0, bw = 0.0; // 最近交点的重心坐标（对应顶点 0/1/2）
+
+    bvh.traverse(ray, hit, [&](int tri) {
+        RT_STAT_PRIM(PrimKind::TRIANGLE);
+        const auto &idx = triangles[tri];
+        const Vector3 A = positions[idx[0]] - ray.origin;
+        const Vector3 B = positions[idx[1]] - ray.origin;
+        const Vector3 C = positions[idx[2]] - ray.origin;
+
+        // 剪切并投影到 xy 平面
+        const double Az = comp(A, wr.kz), Bz = comp(B, wr.kz), Cz = comp(C, wr.kz);
+        const double Ax = comp(A, wr.kx) - wr.sx * Az, Ay = comp(A, wr.ky) - wr.sy * Az;
+        const double Bx = comp(B, wr.kx) - wr.sx * Bz, By = comp(B, wr.ky) - wr.sy * Bz;
+        const double Cx = comp(C, wr.kx) - wr.sx * Cz, Cy = comp(C, wr.ky) - wr.sy * Cz;
+
+        // 缩放后的重心坐标（边函数）
+        const double U = Cx * By - Cy * Bx;
+        const double V = Ax * Cy - Ay * Cx;
+        const double W = Bx * Ay - By * Ax;
+        if ((U < 0.0 || V < 0.0 || W < 0.0) && (U > 0.0 || V > 0.0 || W > 0.0)) return false;
+
+        const double det = U + V + W;
+        if (det == 0.0) return false;
+
+        const double t = (U * Az + V * Bz + W * Cz) * wr.sz / det;
+        if (t <= 0.0 || t >= hit.t) return false;
+
+        hit.t = t;
+        best = tri;
+        bu = U / det;
+        bv = V / det;
+        bw = W / det;
+        return true;
+    });
+    if (best < 0) return false;
+
+    // 只为最近的交点计算表面属性
+    const auto &idx = triangles[best];
+    const Vector3 &p0 = positions[idx[0]], &p1 = positions[idx[1]], &p2 = positions[idx[2]];
+    Vector3 geo_normal = (p1 - p0).cross(p2 - p0).normalized();
+    if (geo_normal.dot(ray.dir) > 0.0) geo_normal = -geo_normal; // 与 Plane 一致：法线朝向光线来向
+
+    Vector3 normal = geo_normal;
+    if (!normals.empty()) {
+        normal = (normals[idx[0]] * bu + normals[idx[1]] * bv + normals[idx[2]] * bw).normalized();
+        if (normal.dot(geo_normal) < 0.0) normal = -normal;
+    }
+
+    hit.hit = true;
+    hit.pos = ray.origin + ray.dir * hit.t;
+    hit.normal = normal;
+    if (!texcoords.empty()) {
+        const auto &t0 = texcoords[idx[0]], &t1 = texcoords[idx[1]], &t2 = texcoords[idx[2]];
+        hit.u = t0[0] * bu + t1[0] * bv + t2[0] * bw;
+        hit.v = t0[1] * bu + t1[1] * bv + t2[1] * bw;
+    } else {
+        hit.u = bv;
+        hit.v = bw;
+    }
+    return true;
+}
+
+// ====================== Mesh ======================
+bool Mesh::intersect(const Ray &r, Hit &h) const {
+    if (!mesh) return false;
+
+    // 变换到网格局部坐标系；方向不归一化，参数 t 在两个坐标系中相同
+    double inv_scale = 1.0 / scale;
+    Ray local(rot_inv.mul(r.origin - translation) * inv_scale, rot_inv.mul(r.dir) * inv_scale, r.time);
+
+    Hit local_hit;
+    local_hit.t = h.t;
+    if (!mesh->intersect(local, local_hit)) return false;
+
+    h.hit = true;
+    h.t = local_hit.t;
+    h.pos = r.origin + r.dir * local_hit.t;
+    h.normal = rot.mul(local_hit.normal).normalized();
+    h.color = this->color;
+    h.material = this->material;
+    h.u = local_hit.u;
+    h.v = local_hit.v;
+    h.texture = this->texture_image; // 可能为空
+    return true;
+}
+
+void Mesh::bounds(Vector3 &bmin, Vector3 &bmax) const {
+    AABB box;
+    if (mesh) {
+        AABB local = mesh->local_bounds();
+        for (int i = 0; i < 8; i++) {
+            Vector3 corner((i & 1) ? local.bmax.x : local.bmin.x,
+                           (i & 2) ? local.bmax.y : local.bmin.y,
+                           (i & 4) ? local.bmax.z : local.bmin.z);
+            box.expand_point(translation + rot.mul(corner * scale));
+        }
+    }
+    bmin = box.bmin;
+    bmax = box.bmax;
+}
+
+bool Mesh::oriented_bounds(Vector3 &center, Matrix3 &rot_, Vector3 &half) const {
+    if (!mesh) return false;
+    AABB local = mesh->local_bounds();
+    center = translation + rot.mul(local.center() * scale);
+    rot_ = rot;
+    half = (local.bmax - local.bmin) * (0.5 * scale);
+    return true;
+}
+
+void Mesh::set_rotation(double rx_deg, double ry_deg, double rz_deg) {
+    rot = Matrix3::from_euler(rx_deg * M_PI / 180.0, ry_deg * M_PI / 180.0, rz_deg * M_PI / 180.0);
+    rot_inv = rot.transpose();
+}
+
+void Mesh::set_pose(const Vector3 &translation_, const Vector3 &rotation_deg) {
+    translation = rest_translation + translation_;
+    rot = Matrix3::from_euler(rotation_deg.x * M_PI / 180.0,
+                              rotation_deg.y * M_PI / 180.0,
+                              rotation_deg.z * M_PI / 180.0).mul(rest_rot);
+    rot_inv = rot.transpose();
+}
@@ -0,0 +1,75 @@
+//
+// Created by 31934 on 2025/12/12.
+//
+
+#ifndef GRAPHIC_CW_MESH_H
+#define GRAPHIC_CW_MESH_H
+#pragma once
+#include "Shape.h"
+#include "Matrix3.h"
+#include "BVH.h"
+#include <array>
+#include <vector>
+#include <memory>
+
+// 索引三角网格（局部坐标系）及其底层 BVH
+// 底层 BVH 建好后三角形按叶子顺序重排，bvh.prim_indices 为恒等映射，叶子内的三角形在内存中连续
+struct TriangleMesh {
+    std::vector<Vector3> positions;
+    std::vector<Vector3> normals;                  // 每顶点法线，可为空（使用几何法线）
+    std::vector<std::array<double, 2>> texcoords;  // 每顶点纹理坐标，可为空（使用重心坐标）
+    std::vector<std::array<int, 3>> triangles;     // 顶点索引
+    BVH bvh;
+
+    size_t triangle_count() const { return triangles.size(); }
+
+    // 构建底层 BVH 并按叶子顺序重排三角形
+    void build_bvh(BVHBuilder builder = BVHBuilder::SAH);
+
+    // 局部坐标系下求交，填充 t / pos / normal / u / v（hit.t 为当前最近距离）
+    bool intersect(const Ray &ray, Hit &hit) const;
+
+    // 局部坐标系下的包围盒（BVH 根节点）
+    AABB local_bounds() const;
+
+    // 顶点、索引和底层 BVH 占用的字节数
+    size_t memory_bytes() const;
+};
+
+// 网格物体：共享的三角网格 + 物体到世界的变换（均匀缩放、旋转、平移）
+// 求交时把光线变换到网格局部坐标系，底层 BVH 不随物体移动而重建
+class Mesh : public Shape {
+public:
+    std::shared_ptr<const TriangleMesh> mesh;
+    Vector3 translation;
+    Matrix3 rot;       // object->world
+    Matrix3 rot_inv;   // transpose
+    double scale = 1.0;
+    // 动画的静止姿态
+    Vector3 rest_translation;
+    Matrix3 rest_rot;
+
+    Mesh() {}
+    explicit Mesh(std::shared_ptr<const TriangleMesh> m) : mesh(std::move(m)) {}
+
+    using Shape::intersect; // 单精度求交沿用默认的双精度转换
+    virtual bool intersect(const Ray &r, Hit &h) const override;
+    virtual void bounds(Vector3 &bmin, Vector3 &bmax) const override;
+    // 局部包围盒经物体变换后的有向包围盒
+    virtual bool oriented_bounds(Vector3 &center, Matrix3 &rot_, Vector3 &half) const override;
+
+    // 三角形数据属于共享的 TriangleMesh，不计入
+    virtual size_t memory_bytes() const override { return sizeof(Mesh) + heap_bytes(); }
+
+    // 设置旋转（Euler angles，单位：度）
+    void set_rotation(double rx_deg, double ry_deg, double rz_deg);
+
+    virtual void store_rest_pose() override {
+        rest_translation = translation;
+        rest_rot = rot;
+    }
+    // 关键帧旋转叠加在静止旋转之上（绕物体原点）
+    virtual void set_pose(const Vector3 &translation_, const Vector3 &rotation_deg) override;
+};
+
+#endif //GRAPHIC_CW_MESH_H
@@ -0,0 +1,393 @@
+//
+// Created by 31934 on 2025/12/12.
+//
+#include "MeshLoader.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+std::string read_file(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open mesh file: " + path);
+    std::string data;
+    in.seekg(0, std::ios::end);
+    data.resize(static_cast<size_t>(in.tellg()));
+    in.seekg(0, std::ios::beg);
+    in.read(data.data(), data.size());
+    return data;
+}
+
+// 网格必须非空且索引合法
+void validate(const TriangleMesh &mesh, const std::string &path) {
+    if (mesh.triangles.empty()) throw std::runtime_error("Mesh has no triangles: " + path);
+    const int n = static_cast<int>(mesh.positions.size());
+    for (const auto &tri : mesh.triangles) {
+        for (int v : tri) {
+            if (v < 0 || v >= n) throw std::runtime_error("Mesh index out of range: " + path);
+        }
+    }
+    if (!mesh.normals.empty() && mesh.normals.size() != mesh.positions.size())
+        throw std::runtime_error("Mesh normal count mismatch: " + path);
+    if (!mesh.texcoords.empty() && mesh.texcoords.size() != mesh.positions.size())
+        throw std::runtime_error("Mesh texcoord count mismatch: " + path);
+}
+
+// ---------------- OBJ ----------------
+// 面的一个角：位置 / 纹理坐标 / 法线索引（0 起，缺省为 -1）
+struct ObjCorner {
+    int v, vt, vn;
+    bool operator==(const ObjCorner &o) const { return v == o.v && vt == o.vt && vn == o.vn; }
+};
+
+struct ObjCornerHash {
+    size_t operator()(const ObjCorner &c) const {
+        uint64_t h = static_cast<uint32_t>(c.v);
+        h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(c.vt);
+        h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(c.vn);
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+inline const char *skip_spaces(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+// OBJ 索引从 1 开始，负数表示相对当前末尾
+inline int resolve_index(long idx, size_t count) {
+    if (idx > 0) return static_cast<int>(idx - 1);
+    if (idx < 0) return static_cast<int>(static_cast<long>(count) + idx);
+    return -1;
+}
+
+} // namespace
+
+void load_obj(const std::string &path, TriangleMesh &mesh) {
+    const std::string data = read_file(path);
+    const char *p = data.data();
+    const char *end = p + data.size();
+
+    std::vector<Vector3> positions, normals;
+    std::vector<std::array<double, 2>> texcoords;
+    std::vector<ObjCorner> corners;      // 所有面的角
+    std::vector<uint32_t> face_starts;   // 每个面在 corners 中的起点
+    bool has_attributes = false;
+
+    while (p < end) {
+        const char *line_end = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!line_end) line_end = end;
+        p = skip_spaces(p, line_end);
+
+        if (p + 1 < line_end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            char *q;
+            double x = std::strtod(p + 2, &q);
+            double y = std::strtod(q, &q);
+            double z = std::strtod(q, &q);
+            positions.emplace_back(x, y, z);
+        } else if (p + 2 < line_end && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+            char *q;
+            double u = std::strtod(p + 3, &q);
+            double v = std::strtod(q, &q);
+            texcoords.push_back({u, v});
+        } else if (p + 2 < line_end && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+            char *q;
+            double x = std::strtod(p + 3, &q);
+            double y = std::strtod(q, &q);
+            double z = std::strtod(q, &q);
+            normals.emplace_back(x, y, z);
+        } else if (p + 1 < line_end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            face_starts.push_back(static_cast<uint32_t>(corners.size()));
+            const char *s = p + 2;
+            while (true) {
+                s = skip_spaces(s, line_end);
+                if (s >= line_end || !(std::isdigit(static_cast<unsigned char>(*s)) || *s == '-')) break;
+                char *q;
+                ObjCorner c{resolve_index(std::strtol(s, &q, 10), positions.size()), -1, -1};
+                if (*q == '/') {
+                    q++;
+                    if (*q != '/') c.vt = resolve_index(std::strtol(q, &q, 10), texcoords.size());
+                    if (*q == '/') {
+                        q++;
+                        c.vn = resolve_index(std::strtol(q, &q, 10), normals.size());
+                    }
+                }
+                if (c.vt >= 0 || c.vn >= 0) has_attributes = true;
+                corners.push_back(c);
+                s = q;
+            }
+        }
+        p = line_end + 1;
+    }
+    face_starts.push_back(static_cast<uint32_t>(corners.size()));
+
+    mesh = TriangleMesh();
+    const bool use_vt = has_attributes && !texcoords.empty();
+    const bool use_vn = has_attributes && !normals.empty();
+
+    // 没有 vt / vn 时直接使用位置索引；否则按 (v, vt, vn) 组合去重生成顶点
+    std::unordered_map<ObjCorner, int, ObjCornerHash> remap;
+    auto vertex_of = [&](const ObjCorner &c) -> int {
+        if (!has_attributes) return c.v;
+        ObjCorner key{c.v, use_vt ? c.vt : -1, use_vn ? c.vn : -1};
+        auto it = remap.find(key);
+        if (it != remap.end()) return it->second;
+        int idx = static_cast<int>(mesh.positions.size());
+        if (c.v < 0 || c.v >= (int)positions.size()) throw std::runtime_error("OBJ vertex index out of range: " + path);
+        mesh.positions.push_back(positions[c.v]);
+        if (use_vt) mesh.texcoords.push_back(key.vt >= 0 && key.vt < (int)texcoords.size() ? texcoords[key.vt]
+                                                                                               : std::array<double, 2>{0.0, 0.0});
+        if (use_vn) mesh.normals.push_back(key.vn >= 0 && key.vn < (int)normals.size() ? normals[key.vn] : Vector3(0, 0, 0));
+        remap.emplace(key, idx);
+        return idx;
+    };
+    if (!has_attributes) mesh.positions = std::move(positions);
+
+    for (size_t f = 0; f + 1 < face_starts.size(); f++) {
+        uint32_t first = face_starts[f], last = face_starts[f + 1];
+        if (last - first < 3) continue;
+        int v0 = vertex_of(corners[first]);
+        int prev = vertex_of(corners[first + 1]);
+        for (uint32_t k = first + 2; k < last; k++) {
+            int cur = vertex_of(corners[k]);
+            mesh.triangles.push_back({v0, prev, cur});
+            prev = cur;
+        }
+    }
+
+    // 缺失法线的角会得到零向量，此时整体退回几何法线
+    if (std::any_of(mesh.normals.begin(), mesh.normals.end(),
+                    [](const Vector3 &n) { return n.x == 0.0 && n.y == 0.0 && n.z == 0.0; })) {
+        mesh.normals.clear();
+    }
+    validate(mesh, path);
+}
+
+// ---------------- PLY ----------------
+namespace {
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+PlyType parse_ply_type(const std::string &s) {
+    if (s == "char" || s == "int8") return PlyType::Int8;
+    if (s == "uchar" || s == "uint8") return PlyType::UInt8;
+    if (s == "short" || s == "int16") return PlyType::Int16;
+    if (s == "ushort" || s == "uint16") return PlyType::UInt16;
+    if (s == "int" || s == "int32") return PlyType::Int32;
+    if (s == "uint" || s == "uint32") return PlyType::UInt32;
+    if (s == "float" || s == "float32") return PlyType::Float32;
+    if (s == "double" || s == "float64") return PlyType::Float64;
+    throw std::runtime_error("Unknown PLY property type: " + s);
+}
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Float32;
+    bool is_list = false;
+    PlyType count_type = PlyType::UInt8;
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> props;
+};
+
+enum class PlyFormat { Ascii, BinaryLittle, BinaryBig };
+
+// 按格式逐个读取标量（统一转换为 double）
+class PlyReader {
+public:
+    PlyReader(const char *p, const char *end, PlyFormat fmt) : p_(p), end_(end), fmt_(fmt) {}
+
+    double read(PlyType t) {
+        if (fmt_ == PlyFormat::Ascii) {
+            while (p_ < end_ && std::isspace(static_cast<unsigned char>(*p_))) p_++;
+            if (p_ >= end_) throw std::runtime_error("PLY data truncated");
+            char *q;
+            double v = std::strtod(p_, &q);
+            if (q == p_) throw std::runtime_error("Bad PLY ascii value");
+            p_ = q;
+            return v;
+        }
+        switch (t) {
+            case PlyType::Int8:    return binary<int8_t>();
+            case PlyType::UInt8:   return binary<uint8_t>();
+            case PlyType::Int16:   return binary<int16_t>();
+            case PlyType::UInt16:  return binary<uint16_t>();
+            case PlyType::Int32:   return binary<int32_t>();
+            case PlyType::UInt32:  return binary<uint32_t>();
+            case PlyType::Float32: return binary<float>();
+            case PlyType::Float64: return binary<double>();
+        }
+        return 0.0;
+    }
+
+private:
+    template <typename T>
+    double binary() {
+        if (static_cast<size_t>(end_ - p_) < sizeof(T)) throw std::runtime_error("PLY data truncated");
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, p_, sizeof(T));
+        p_ += sizeof(T);
+        const bool file_little = (fmt_ == PlyFormat::BinaryLittle);
+        if (file_little != (std::endian::native == std::endian::little)) std::reverse(bytes, bytes + sizeof(T));
+        T v;
+        std::memcpy(&v, bytes, sizeof(T));
+        return static_cast<double>(v);
+    }
+
+    const char *p_;
+    const char *end_;
+    PlyFormat fmt_;
+};
+
+} // namespace
+
+void load_ply(const std::string &path, TriangleMesh &mesh) {
+    const std::string data = read_file(path);
+
+    // 文件头
+    size_t header_end = data.find("end_header");
+    if (data.compare(0, 3, "ply") != 0 || header_end == std::string::npos)
+        throw std::runtime_error("Not a PLY file: " + path);
+    size_t body = data.find('\n', header_end);
+    if (body == std::string::npos) throw std::runtime_error("PLY header truncated: " + path);
+    body++;
+
+    PlyFormat fmt = PlyFormat::Ascii;
+    std::vector<PlyElement> elements;
+    std::istringstream header(data.substr(0, header_end));
+    std::string line;
+    while (std::getline(header, line)) {
+        std::istringstream l(line);
+        std::string key;
+        l >> key;
+        if (key == "format") {
+            std::string f;
+            l >> f;
+            if (f == "ascii") fmt = PlyFormat::Ascii;
+            else if (f == "binary_little_endian") fmt = PlyFormat::BinaryLittle;
+            else if (f == "binary_big_endian") fmt = PlyFormat::BinaryBig;
+            else throw std::runtime_error("Unknown PLY format: " + f);
+        } else if (key == "element") {
+            PlyElement e;
+            l >> e.name >> e.count;
+            elements.push_back(e);
+        } else if (key == "property") {
+            if (elements.empty()) throw std::runtime_error("PLY property before element: " + path);
+            PlyProperty prop;
+            std::string type;
+            l >> type;
+            if (type == "list") {
+                std::string count_type, item_type;
+                l >> count_type >> item_type;
+                prop.is_list = true;
+                prop.count_type = parse_ply_type(count_type);
+                prop.type = parse_ply_type(item_type);
+            } else {
+                prop.type = parse_ply_type(type);
+            }
+            l >> prop.name;
+            elements.back().props.push_back(prop);
+        }
+    }
+
+    mesh = TriangleMesh();
+    PlyReader r(data.data() + body, data.data() + data.size(), fmt);
+    std::vector<double> values;
+    std::vector<int> poly;
+
+    for (const auto &e : elements) {
+        if (e.name == "vertex") {
+            // 属性名 -> 位置
+            auto find = [&](std::initializer_list<const char *> names) -> int {
+                for (const char *n : names) {
+                    for (size_t i = 0; i < e.props.size(); i++) {
+                        if (!e.props[i].is_list && e.props[i].name == n) return static_cast<int>(i);
+                    }
+                }
+                return -1;
+            };
+            int ix = find({"x"}), iy = find({"y"}), iz = find({"z"});
+            int inx = find({"nx"}), iny = find({"ny"}), inz = find({"nz"});
+            int iu = find({"u", "s", "texture_u"}), iv = find({"v", "t", "texture_v"});
+            if (ix < 0 || iy < 0 || iz < 0) throw std::runtime_error("PLY vertex has no x/y/z: " + path);
+            bool has_n = inx >= 0 && iny >= 0 && inz >= 0;
+            bool has_uv = iu >= 0 && iv >= 0;
+
+            mesh.positions.reserve(e.count);
+            if (has_n) mesh.normals.reserve(e.count);
+            if (has_uv) mesh.texcoords.reserve(e.count);
+            values.resize(e.props.size());
+            for (size_t k = 0; k < e.count; k++) {
+                for (size_t i = 0; i < e.props.size(); i++) {
+                    const PlyProperty &prop = e.props[i];
+                    if (prop.is_list) {
+                        size_t n = static_cast<size_t>(r.read(prop.count_type));
+                        for (size_t j = 0; j < n; j++) r.read(prop.type);
+                        values[i] = 0.0;
+                    } else {
+                        values[i] = r.read(prop.type);
+                    }
+                }
+                mesh.positions.emplace_back(values[ix], values[iy], values[iz]);
+                if (has_n) mesh.normals.emplace_back(values[inx], values[iny], values[inz]);
+                if (has_uv) mesh.texcoords.push_back({values[iu], values[iv]});
+            }
+        } else if (e.name == "face") {
+            mesh.triangles.reserve(e.count);
+            for (size_t k = 0; k < e.count; k++) {
+                for (const auto &prop : e.props) {
+                    if (!prop.is_list) {
+                        r.read(prop.type);
+                        continue;
+                    }
+                    size_t n = static_cast<size_t>(r.read(prop.count_type));
+                    poly.resize(n);
+                    for (size_t j = 0; j < n; j++) poly[j] = static_cast<int>(r.read(prop.type));
+                    if (prop.name != "vertex_indices" && prop.name != "vertex_index") continue;
+                    for (size_t j = 2; j < n; j++) mesh.triangles.push_back({poly[0], poly[j - 1], poly[j]});
+                }
+            }
+        } else {
+            // 其他元素（edge、material 等）跳过
+            for (size_t k = 0; k < e.count; k++) {
+                for (const auto &prop : e.props) {
+                    if (prop.is_list) {
+                        size_t n = static_cast<size_t>(r.read(prop.count_type));
+                        for (size_t j = 0; j < n; j++) r.read(prop.type);
+                    } else {
+                        r.read(prop.type);
+                    }
+                }
+            }
+        }
+    }
+    validate(mesh, path);
+}
+
+std::shared_ptr<TriangleMesh> load_mesh(const std::string &path, BVHBuilder builder) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    auto mesh = std::make_shared<TriangleMesh>();
+    if (ext == ".obj") load_obj(path, *mesh);
+    else if (ext == ".ply") load_ply(path, *mesh);
+    else throw std::runtime_error("Unsupported mesh format: " + path);
+
+    mesh->build_bvh(builder);
+    std::cout << "Mesh loaded: " << path << " (" << mesh->positions.size() << " vertices, "
+              << mesh->triangle_count() << " triangles, " << mesh->bvh.nodes.size() << " BVH nodes)" << std::endl;
+    return mesh;
+}
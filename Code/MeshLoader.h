@@ -0,0 +1,21 @@
+//
+// Created by 31934 on 2025/12/12.
+//
+
+#ifndef GRAPHIC_CW_MESHLOADER_H
+#define GRAPHIC_CW_MESHLOADER_H
+#pragma once
+#include "Mesh.h"
+#include <string>
+
+// 按扩展名加载三角网格（.obj / .ply）并构建底层 BVH；失败时抛出 std::runtime_error
+std::shared_ptr<TriangleMesh> load_mesh(const std::string &path, BVHBuilder builder = BVHBuilder::SAH);
+
+// Wavefront OBJ：v / vt / vn / f（支持 v、v/vt、v//vn、v/vt/vn 和负索引，多边形按扇形三角化）
+void load_obj(const std::string &path, TriangleMesh &mesh);
+
+// PLY：binary_little_endian / binary_big_endian / ascii；
+// 读取 vertex 的 x y z [nx ny nz] [u v | s t | texture_u texture_v] 和 face 的顶点索引列表
+void load_ply(const std::string &path, TriangleMesh &mesh);
+
+#endif //GRAPHIC_CW_MESHLOADER_H
@@ -1,60 +1,91 @@
 #include "Plane.h"
+#include "Matrix3.h"
+#include "BVH.h"
+#include "RenderStats.h"
 #include <cmath>
+#include <limits>
 
 // Helper: point-in-triangle using barycentric (works in 3D on same plane)
-static bool point_in_triangle(const Vector3 &p, const Vector3 &a, const Vector3 &b, const Vector3 &c) {
-    Vector3 v0 = c - a;
-    Vector3 v1 = b - a;
-    Vector3 v2 = p - a;
-    double dot00 = v0.dot(v0);
-    double dot01 = v0.dot(v1);
-    double dot02 = v0.dot(v2);
-    double dot11 = v1.dot(v1);
-    double dot12 = v1.dot(v2);
-    double denom = dot00 * dot11 - dot01 * dot01;
-    if (std::abs(denom) < 1e-12) return false;
-    double u = (dot11 * dot02 - dot01 * dot12) / denom;
-    double v = (dot00 * dot12 - dot01 * dot02) / denom;
-    return (u >= -1e-8) && (v >= -1e-8) && (u + v <= 1.0 + 1e-8);
+template <typename T>
+static bool point_in_triangle(const Vec3<T> &p, const Vec3<T> &a, const Vec3<T> &b, const Vec3<T> &c) {
+    // 边界容差：双精度保持 1e-8，单精度放宽到几个 ulp，避免两个三角形的公共对角线上出现缝隙
+    const T tol = std::max(T(1e-8), 8 * std::numeric_limits<T>::epsilon());
+    Vec3<T> v0 = c - a;
+    Vec3<T> v1 = b - a;
+    Vec3<T> v2 = p - a;
+    T dot00 = v0.dot(v0);
+    T dot01 = v0.dot(v1);
+    T dot02 = v0.dot(v2);
+    T dot11 = v1.dot(v1);
+    T dot12 = v1.dot(v2);
+    T denom = dot00 * dot11 - dot01 * dot01;
+    if (std::abs(denom) < T(1e-12)) return false;
+    T u = (dot11 * dot02 - dot01 * dot12) / denom;
+    T v = (dot00 * dot12 - dot01 * dot02) / denom;
+    return (u >= -tol) && (v >= -tol) && (u + v <= 1 + tol);
 }
 
-bool Plane::intersect(const Ray &ray, Hit &hit) const {
+// 单 / 双精度共用的求交实现
+template <typename T>
+static bool intersect_plane(const Plane &plane, const RayT<T> &ray, HitT<T> &hit) {
+    RT_STAT_PRIM(PrimKind::PLANE);
     // plane from corners[0..3], treat as convex quad split into two triangles (0,1,2) and (0,2,3)
-    Vector3 a = corners[0], b = corners[1], c = corners[2], d = corners[3];
+    const Vec3<T> a(plane.corners[0]), b(plane.corners[1]), c(plane.corners[2]), d(plane.corners[3]);
 
-    Vector3 uvec = b - a;
-    Vector3 vvec = d - a;
-    double ulen2 = uvec.dot(uvec);
-    double vlen2 = vvec.dot(vvec);
+    Vec3<T> uvec = b - a;
+    Vec3<T> vvec = d - a;
+    T ulen2 = uvec.dot(uvec);
+    T vlen2 = vvec.dot(vvec);
 
-    Vector3 normal = (b - a).cross(c - a).normalized();
-    double denom = normal.dot(ray.dir);
-    if (std::abs(denom) < 1e-12) return false; // parallel
-    double t = normal.dot(a - ray.origin) / denom;
-    if (t < 1e-6 || t >= hit.t) return false;
-    Vector3 p = ray.origin + ray.dir * t;
+    Vec3<T> normal = (b - a).cross(c - a).normalized();
+    T denom = normal.dot(ray.dir);
+    if (std::abs(denom) < T(1e-12)) return false; // parallel
+    T t = normal.dot(a - ray.origin) / denom;
+    // 次级光线起点已偏移到表面之外，不再需要 t 的下限
+    if (t <= 0 || t >= hit.t) return false;
+    Vec3<T> p = ray.origin + ray.dir * t;
+    // 投影回平面：消除 o + t d 中与起点量级成正比的误差
+    p = p - normal * normal.dot(p - a);
     // check inside quad by triangles
-    if (point_in_triangle(p, corners[0], corners[1], corners[2]) ||
-        point_in_triangle(p, corners[0], corners[2], corners[3])) {
+    if (point_in_triangle(p, a, b, c) ||
+        point_in_triangle(p, a, c, d)) {
         hit.hit = true;
         hit.t = t;
         hit.pos = p;
-        hit.normal = (denom < 0) ? normal : normal * -1.0; // adjust normal to face opposite ray if needed
-        hit.color = this->color;
-        hit.material = this->material;
+        hit.normal = (denom < 0) ? normal : normal * T(-1); // adjust normal to face opposite ray if needed
+        hit.color = plane.color;
+        hit.material = plane.material;
 
         // 纹理
-        Vector3 local = p - a;
-        double u = local.dot(uvec) / ulen2; // 0..1 over edge
-        double v = local.dot(vvec) / vlen2;
+        Vec3<T> local = p - a;
+        T u = local.dot(uvec) / ulen2; // 0..1 over edge
+        T v = local.dot(vvec) / vlen2;
         hit.u = u;
         hit.v = v;
-        hit.texture = this->texture_image;
+        hit.texture = plane.texture_image;
         return true;
     }
     return false;
 }
 
+bool Plane::intersect(const Ray &ray, Hit &hit) const {
+    return intersect_plane(*this, ray, hit);
+}
+
+bool Plane::intersect(const Rayf &ray, Hitf &hit) const {
+    return intersect_plane(*this, ray, hit);
+}
+
+void Plane::set_pose(const Vector3 &translation, const Vector3 &rotation_deg) {
+    Vector3 c = (rest_corners[0] + rest_corners[1] + rest_corners[2] + rest_corners[3]) * 0.25;
+    Matrix3 R = Matrix3::from_euler(rotation_deg.x * M_PI / 180.0,
+                                    rotation_deg.y * M_PI / 180.0,
+                                    rotation_deg.z * M_PI / 180.0);
+    for (int i = 0; i < 4; i++) {
+        corners[i] = c + R.mul(rest_corners[i] - c) + translation;
+    }
+}
+
 void Plane::bounds(Vector3 &bmin, Vector3 &bmax) const {
     bmin = { 1e30, 1e30, 1e30 }; bmax = { -1e30, -1e30, -1e30 };
     for (int i=0;i<4;i++){
@@ -66,3 +97,13 @@ void Plane::bounds(Vector3 &bmin, Vector3 &bmax) const {
         if (corners[i].z > bmax.z) bmax.z = corners[i].z;
     }
 }
+
+bool Plane::clip_bounds(const Vector3 &box_min, const Vector3 &box_max, Vector3 &bmin, Vector3 &bmax) const {
+    AABB box, out;
+    box.bmin = box_min;
+    box.bmax = box_max;
+    if (!clip_polygon_bounds(corners.data(), 4, box, out)) return false;
+    bmin = out.bmin;
+    bmax = out.bmax;
+    return true;
+}
@@ -11,9 +11,17 @@
 class Plane : public Shape {
 public:
     std::array<Vector3,4> corners;
+    std::array<Vector3,4> rest_corners; // 动画的静止角点
     Plane() {}
     virtual bool intersect(const Ray &r, Hit &h) const override;
+    virtual bool intersect(const Rayf &r, Hitf &h) const override;
     virtual void bounds(Vector3 &bmin, Vector3 &bmax) const override;
+    // 把四边形裁剪到 box 内：地板、墙面被空间分割后只保留落在子节点内的部分
+    virtual bool clip_bounds(const Vector3 &box_min, const Vector3 &box_max, Vector3 &bmin, Vector3 &bmax) const override;
+    virtual size_t memory_bytes() const override { return sizeof(Plane) + heap_bytes(); }
+    virtual void store_rest_pose() override { rest_corners = corners; }
+    // 绕静止角点的中心旋转后平移
+    virtual void set_pose(const Vector3 &translation, const Vector3 &rotation_deg) override;
 };
 
 #endif //GRAPHIC_PLANE_H
\ No newline at end of file
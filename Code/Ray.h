@@ -7,12 +7,65 @@
 
 #pragma once
 #include "Vector3.h"
-struct Ray
+#include <bit>
+#include <cstdint>
+
+template <typename T>
+struct RayT
 {
-    Vector3 origin;
-    Vector3 dir;
-    Ray(){}
-    Ray(const Vector3 &o,const Vector3 &d):origin(o),dir(d){}
+    Vec3<T> origin;
+    Vec3<T> dir;
+    double time = 0.0; // 快门开启后的时间（秒），用于物体运动模糊
+    RayT(){}
+    RayT(const Vec3<T> &o,const Vec3<T> &d):origin(o),dir(d){}
+    RayT(const Vec3<T> &o,const Vec3<T> &d,double t):origin(o),dir(d),time(t){}
+    // 不同精度之间显式转换
+    template <typename U>
+    explicit RayT(const RayT<U> &r):origin(r.origin),dir(r.dir),time(r.time){}
+};
+
+using Ray = RayT<double>;
+using Rayf = RayT<float>;
+
+// ====================== 次级光线起点偏移 ======================
+// Wächter & Binder, "A Fast and Robust Method for Avoiding Self-Intersection"（Ray Tracing Gems 第 6 章）：
+// 交点坐标的误差与其量级成正比，因此沿法线把每个分量移动固定数目的 ulp（在整数表示上加减）；
+// 接近原点时 ulp 过小，改用固定的小偏移。偏移量随坐标量级和标量精度缩放，代替固定的 1e-4
+template <typename T> struct OffsetParams;
+template <> struct OffsetParams<float> {
+    using Int = int32_t;
+    static constexpr float origin = 1.0f / 32.0f;
+    static constexpr float float_scale = 1.0f / 65536.0f;
+    static constexpr float int_scale = 256.0f;
 };
+// double 的交点误差远小于 float，按比例取更小的偏移（2^20 ulp，|p| = 1 时约 2e-10）
+template <> struct OffsetParams<double> {
+    using Int = int64_t;
+    static constexpr double origin = 1.0 / 32.0;
+    static constexpr double float_scale = 1.0 / 268435456.0; // 2^-28
+    static constexpr double int_scale = 1048576.0;            // 2^20
+};
+
+// 把交点 p 沿法线 n 一侧偏移到表面之外（n 须指向光线离开的一侧）
+template <typename T>
+Vec3<T> offset_ray_origin(const Vec3<T> &p, const Vec3<T> &n) {
+    using P = OffsetParams<T>;
+    using Int = typename P::Int;
+    const T pc[3] = {p.x, p.y, p.z};
+    const T nc[3] = {n.x, n.y, n.z};
+    T out[3];
+    for (int a = 0; a < 3; a++) {
+        Int of = static_cast<Int>(P::int_scale * nc[a]);
+        T pi = std::bit_cast<T>(std::bit_cast<Int>(pc[a]) + (pc[a] < 0 ? -of : of));
+        out[a] = std::abs(pc[a]) < P::origin ? pc[a] + P::float_scale * nc[a] : pi;
+    }
+    return {out[0], out[1], out[2]};
+}
+
+// 从交点 p（法线 n，任意朝向）沿 dir 发出的次级光线：起点偏移到 dir 所在的一侧
+template <typename T>
+RayT<T> spawn_ray(const Vec3<T> &p, const Vec3<T> &n, const Vec3<T> &dir, double time = 0.0) {
+    return RayT<T>(offset_ray_origin(p, dir.dot(n) < 0 ? -n : n), dir, time);
+}
 
-#endif //CWPROJECT_RAY_H
\ No newline at end of file
+#endif //CWPROJECT_RAY_H
@@ -0,0 +1,118 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+#include "RenderRegion.h"
+#include "Timeline.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+RenderRegion g_region;
+
+PixelRange pixel_range(const Camera &cam, const RenderRegion &region) {
+    PixelRange r{0, 0, cam.res_x, cam.res_y, &region};
+    if (!region.cropped) return r;
+    r.x0 = std::clamp(region.x0, 0, cam.res_x);
+    r.y0 = std::clamp(region.y0, 0, cam.res_y);
+    r.x1 = std::clamp(region.x1, r.x0, cam.res_x);
+    r.y1 = std::clamp(region.y1, r.y0, cam.res_y);
+    return r;
+}
+
+RenderRegion dilate_region(const RenderRegion &region, int radius, int width, int height) {
+    if (!region.cropped) return region;
+    RenderRegion out;
+    out.cropped = true;
+    out.x0 = std::max(region.x0 - radius, 0);
+    out.y0 = std::max(region.y0 - radius, 0);
+    out.x1 = std::min(region.x1 + radius, width);
+    out.y1 = std::min(region.y1 + radius, height);
+    if (region.mask.empty()) return out;
+
+    // 可分离的方形膨胀：先按行、再按列，用前缀和判断窗口 [i - radius, i + radius] 内是否有种子像素。
+    // 种子只取矩形内的掩码像素（与各渲染循环的遍历范围一致）
+    std::vector<unsigned char> rows((size_t)width * height, 0);
+    std::vector<int> prefix(std::max(width, height) + 1);
+    for (int y = region.y0; y < region.y1; y++) {
+        prefix[0] = 0;
+        for (int x = 0; x < width; x++)
+            prefix[x + 1] = prefix[x] + (x >= region.x0 && x < region.x1 && region.mask[(size_t)y * region.mask_width + x]);
+        for (int x = out.x0; x < out.x1; x++)
+            rows[(size_t)y * width + x] = prefix[std::min(x + radius + 1, width)] > prefix[std::max(x - radius, 0)];
+    }
+    out.mask.assign((size_t)width * height, 0);
+    out.mask_width = width;
+    for (int x = out.x0; x < out.x1; x++) {
+        prefix[0] = 0;
+        for (int y = 0; y < height; y++) prefix[y + 1] = prefix[y] + rows[(size_t)y * width + x];
+        for (int y = out.y0; y < out.y1; y++)
+            out.mask[(size_t)y * width + x] = prefix[std::min(y + radius + 1, height)] > prefix[std::max(y - radius, 0)];
+    }
+    return out;
+}
+
+void setup_render_region(const Camera &cam, const std::string &crop_arg, const std::string &mask_path) {
+    RenderRegion region;
+    region.cropped = true;
+    region.x1 = cam.res_x;
+    region.y1 = cam.res_y;
+    if (!crop_arg.empty() &&
+        std::sscanf(crop_arg.c_str(), "%d,%d,%d,%d", &region.x0, &region.y0, &region.x1, &region.y1) != 4)
+        throw std::runtime_error("--crop expects X0,Y0,X1,Y1, got " + crop_arg);
+    if (!mask_path.empty()) {
+        Image mask;
+        if (!mask.load_ppm(mask_path)) throw std::runtime_error("Cannot read mask " + mask_path);
+        if (mask.width != cam.res_x || mask.height != cam.res_y)
+            throw std::runtime_error("Mask " + mask_path + " must be " + std::to_string(cam.res_x) + "x" +
+                                     std::to_string(cam.res_y));
+        region.mask.resize(mask.pixels.size());
+        region.mask_width = mask.width;
+        int bx0 = cam.res_x, by0 = cam.res_y, bx1 = 0, by1 = 0;
+        for (int y = 0; y < mask.height; y++) {
+            for (int x = 0; x < mask.width; x++) {
+                bool on = luminance(mask.get_pixel(x, y)) > 0.5;
+                region.mask[(size_t)y * mask.width + x] = on;
+                if (on) {
+                    bx0 = std::min(bx0, x); by0 = std::min(by0, y);
+                    bx1 = std::max(bx1, x + 1); by1 = std::max(by1, y + 1);
+                }
+            }
+        }
+        region.x0 = std::max(region.x0, bx0); region.y0 = std::max(region.y0, by0);
+        region.x1 = std::min(region.x1, bx1); region.y1 = std::min(region.y1, by1);
+    }
+    region.x0 = std::clamp(region.x0, 0, cam.res_x); region.x1 = std::clamp(region.x1, region.x0, cam.res_x);
+    region.y0 = std::clamp(region.y0, 0, cam.res_y); region.y1 = std::clamp(region.y1, region.y0, cam.res_y);
+    if (region.x0 == region.x1 || region.y0 == region.y1) throw std::runtime_error("Render region is empty");
+    g_region = std::move(region);
+}
+
+std::string write_region_output(const Image &img, const std::string &output_filename, const std::string &composite_path) {
+    TIMELINE_SCOPE("image.write");
+    const PixelRange range{g_region.x0, g_region.y0, g_region.x1, g_region.y1, &g_region};
+    if (!composite_path.empty()) {
+        Image frame;
+        if (!frame.load_ppm(composite_path)) throw std::runtime_error("Cannot read " + composite_path);
+        if (frame.width != img.width || frame.height != img.height)
+            throw std::runtime_error(composite_path + " does not match the camera resolution");
+        for (int y = range.y0; y < range.y1; y++)
+            for (int x = range.x0; x < range.x1; x++)
+                if (range.contains(x, y)) frame.pixels[(size_t)y * img.width + x] = img.pixels[(size_t)y * img.width + x];
+        frame.write_ppm(output_filename);
+        return output_filename;
+    }
+    const std::string name = region_output_name(output_filename, composite_path);
+    Image crop(range.x1 - range.x0, range.y1 - range.y0);
+    for (int y = range.y0; y < range.y1; y++)
+        for (int x = range.x0; x < range.x1; x++)
+            crop.pixels[(size_t)(y - range.y0) * crop.width + (x - range.x0)] = img.pixels[(size_t)y * img.width + x];
+    crop.write_ppm(name);
+    return name;
+}
+
+std::string region_output_name(const std::string &output_filename, const std::string &composite_path) {
+    if (!composite_path.empty()) return output_filename;
+    std::string name = output_filename;
+    if (name.size() > 4 && name.substr(name.size() - 4) == ".ppm") name.resize(name.size() - 4);
+    return name + "_crop.ppm";
+}
@@ -0,0 +1,46 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_RENDERREGION_H
+#define GRAPHIC_CW_RENDERREGION_H
+#pragma once
+#include "camera.h"
+#include "Image.h"
+#include <string>
+#include <vector>
+
+// 渲染区域（--crop / --mask）：各渲染循环只追踪区域内的像素，区域外的像素保持为 0。
+// 相机投影仍按整幅画面计算，区域内的像素与整幅渲染中相同位置的像素一致
+struct RenderRegion {
+    bool cropped = false;
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;   // [x0, x1) x [y0, y1)，cropped 为 false 时为整幅画面
+    std::vector<unsigned char> mask;       // 整幅画面大小的逐像素掩码，为空表示矩形内全部追踪
+    int mask_width = 0;
+};
+extern RenderRegion g_region;
+
+// 一次渲染实际遍历的像素矩形（区域与画面求交）
+struct PixelRange {
+    int x0, y0, x1, y1;
+    const RenderRegion *region;
+    bool contains(int x, int y) const {
+        return region->mask.empty() || region->mask[(size_t)y * region->mask_width + x] != 0;
+    }
+};
+
+PixelRange pixel_range(const Camera &cam, const RenderRegion &region = g_region);
+
+// 把区域（矩形与掩码）向外膨胀 radius 个像素（ReSTIR 的空间复用需要区域外的邻居）
+RenderRegion dilate_region(const RenderRegion &region, int radius, int width, int height);
+
+// --crop / --mask：设置 g_region。掩码须与画面同尺寸；只给掩码时矩形取掩码的包围盒
+void setup_render_region(const Camera &cam, const std::string &crop_arg, const std::string &mask_path);
+
+// 写出区域渲染结果，返回实际写入的文件名。composite_path 非空时读入该整幅图像，只替换区域（掩码）内的像素后
+// 写到 output_filename；否则把区域矩形裁剪为单独的图像（output_crop.ppm，掩码外为黑色）
+std::string write_region_output(const Image &img, const std::string &output_filename, const std::string &composite_path);
+// write_region_output 将写入的文件名（可在写出前用于日志）
+std::string region_output_name(const std::string &output_filename, const std::string &composite_path);
+
+#endif //GRAPHIC_CW_RENDERREGION_H
@@ -0,0 +1,332 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+#include "RenderServer.h"
+#include "Renderer.h"
+#include "RenderRegion.h"
+#include "SceneCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#endif
+
+#ifndef _WIN32
+bool RenderServer::send_all(int fd, const void *data, size_t size) {
+    const char *p = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n <= 0) return false;
+        p += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+std::shared_ptr<const SceneSnapshot> RenderServer::acquire_scene(const std::string &path, bool &loaded, double &ms) {
+    loaded = false;
+    ms = 0.0;
+    if (!std::filesystem::exists(path)) throw std::runtime_error("scene not found: " + path);
+    const uint64_t hash = hash_file(path);
+    auto it = scenes_.find(path);
+    if (it != scenes_.end() && it->second->hash == hash) return it->second;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    auto snap = std::make_shared<SceneSnapshot>();
+    snap->path = path;
+    snap->hash = hash;
+    snap->bvh.unbounded_fraction = opt_.bvh_unbounded;
+    snap->bvh.use_float_nodes = g_float_path;
+    load_scene_and_bvh(path, snap->scene, snap->bvh, opt_.builder, opt_.use_scene_cache);
+    if (!snap->scene.camera) throw std::runtime_error("no camera in " + path);
+    snap->accel = make_accelerator(opt_.accel, snap->scene, snap->bvh, opt_.builder);
+    snap->light_tree.build(snap->scene.lights);
+    ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+    loaded = true;
+    scenes_[path] = snap;
+    return snap;
+}
+
+void RenderServer::render_job(const std::map<std::string, std::string> &args, int fd) {
+    auto arg = [&](const char *key, const std::string &def) {
+        auto it = args.find(key);
+        return it == args.end() ? def : it->second;
+    };
+    auto vec3 = [](const std::string &s) {
+        Vector3 v;
+        if (std::sscanf(s.c_str(), "%lf,%lf,%lf", &v.x, &v.y, &v.z) != 3) throw std::runtime_error("bad vector " + s);
+        return v;
+    };
+
+    bool loaded;
+    double load_ms;
+    std::shared_ptr<const SceneSnapshot> snap = acquire_scene(arg("scene", "../ASCII/scene.txt"), loaded, load_ms);
+
+    Camera cam = *snap->scene.camera;
+    if (args.count("pos")) cam.position = vec3(args.at("pos"));
+    if (args.count("gaze")) cam.gaze = vec3(args.at("gaze"));
+    if (args.count("focal")) cam.focal_length_m = std::stod(args.at("focal"));
+    if (args.count("res") && std::sscanf(args.at("res").c_str(), "%dx%d", &cam.res_x, &cam.res_y) != 2)
+        throw std::runtime_error("bad res " + args.at("res"));
+    if (cam.res_x <= 0 || cam.res_y <= 0) throw std::runtime_error("bad resolution");
+    cam.compute_basis();
+    cam.compute_lens_radius();
+
+    int x0 = 0, y0 = 0, x1 = cam.res_x, y1 = cam.res_y;
+    if (args.count("region") && std::sscanf(args.at("region").c_str(), "%d,%d,%d,%d", &x0, &y0, &x1, &y1) != 4)
+        throw std::runtime_error("bad region " + args.at("region"));
+    x0 = std::clamp(x0, 0, cam.res_x); x1 = std::clamp(x1, x0, cam.res_x);
+    y0 = std::clamp(y0, 0, cam.res_y); y1 = std::clamp(y1, y0, cam.res_y);
+    const int tile = std::max(8, std::stoi(arg("tile", "64")));
+    const int spp = std::max(1, std::stoi(arg("spp", "16")));
+    const int shadow = std::max(1, std::stoi(arg("shadow", "4")));
+    const std::string mode = arg("mode", "distributed");
+    const Accelerator *accel = opt_.accel == AcceleratorType::BRUTE ? nullptr : snap->accel.get();
+
+    std::function<void(Image &)> render = make_mode_render(mode, cam, snap->scene, accel, spp, shadow);
+
+    const int id = next_job_++;
+    send_line(fd, "job " + std::to_string(id) + " " + std::to_string(x1 - x0) + " " + std::to_string(y1 - y0));
+
+    // 全局渲染设置按任务切换（只有渲染线程会修改）
+    g_shadow_accel = accel;
+    g_light_tree = arg("lighttree", "0") == "1" ? &snap->light_tree : nullptr;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    Image img(cam.res_x, cam.res_y);
+    // 逐块渲染（g_region 设为当前块），每块完成后立即发送；ReSTIR 每次调用都要分配整幅缓冲并追踪复用边距，
+    // 整个区域只渲染一次再分块发送
+    const bool per_tile = mode != "restir";
+    g_region = RenderRegion();
+    g_region.cropped = true;
+    if (!per_tile) {
+        g_region.x0 = x0; g_region.y0 = y0; g_region.x1 = x1; g_region.y1 = y1;
+        render(img);
+    }
+
+    std::vector<unsigned char> bytes;
+    bool connected = true;
+    for (int ty = y0; ty < y1 && connected; ty += tile) {
+        for (int tx = x0; tx < x1; tx += tile) {
+            const int tw = std::min(tile, x1 - tx), th = std::min(tile, y1 - ty);
+            if (per_tile) {
+                g_region.x0 = tx; g_region.y0 = ty; g_region.x1 = tx + tw; g_region.y1 = ty + th;
+                render(img);
+            }
+            bytes.clear();
+            for (int y = ty; y < ty + th; y++) {
+                for (int x = tx; x < tx + tw; x++) {
+                    const Color &c = img.pixels[(size_t)y * img.width + x];
+                    bytes.push_back((unsigned char)std::clamp(int(c.r * 255.0), 0, 255));
+                    bytes.push_back((unsigned char)std::clamp(int(c.g * 255.0), 0, 255));
+                    bytes.push_back((unsigned char)std::clamp(int(c.b * 255.0), 0, 255));
+                }
+            }
+            if (!send_line(fd, "tile " + std::to_string(tx - x0) + " " + std::to_string(ty - y0) + " " +
+                                   std::to_string(tw) + " " + std::to_string(th)) ||
+                !send_all(fd, bytes.data(), bytes.size())) {
+                connected = false; // 客户端已断开
+                break;
+            }
+        }
+    }
+    g_region = RenderRegion();
+    g_light_tree = nullptr;
+    if (!connected) return;
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+    send_line(fd, "done " + std::to_string(id) + " " + std::to_string(seconds));
+    std::cout << "[Server] job " << id << ": " << mode << " " << (x1 - x0) << "x" << (y1 - y0) << " spp=" << spp
+         << (loaded ? " (scene loaded " + std::to_string((int)load_ms) + " ms)" : "") << " " << seconds << " s" << std::endl;
+}
+
+void RenderServer::execute(const std::string &line, int fd) {
+    std::istringstream in(line);
+    std::string cmd;
+    in >> cmd;
+    try {
+        if (cmd == "load") {
+            std::string path;
+            in >> path;
+            bool loaded;
+            double ms;
+            auto snap = acquire_scene(path, loaded, ms);
+            send_line(fd, "ok " + path + " objects=" + std::to_string(snap->scene.objects.size()) + " ms=" +
+                              std::to_string((int)ms) + (loaded ? "" : " resident"));
+        } else if (cmd == "render") {
+            std::map<std::string, std::string> args;
+            std::string token;
+            while (in >> token) {
+                size_t eq = token.find('=');
+                if (eq == std::string::npos) throw std::runtime_error("expected key=value: " + token);
+                args[token.substr(0, eq)] = token.substr(eq + 1);
+            }
+            render_job(args, fd);
+        } else if (cmd == "scenes") {
+            for (const auto &[path, snap] : scenes_)
+                send_line(fd, path + " objects=" + std::to_string(snap->scene.objects.size()) + " lights=" +
+                                  std::to_string(snap->scene.lights.size()) + " bvh_nodes=" +
+                                  std::to_string(snap->bvh.nodes.size()));
+            send_line(fd, "ok");
+        } else {
+            send_line(fd, "error unknown command " + cmd);
+        }
+    } catch (const std::exception &e) {
+        send_line(fd, std::string("error ") + e.what());
+    }
+}
+
+void RenderServer::render_loop() {
+    while (true) {
+        Job *job;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            job = queue_.front();
+            queue_.pop_front();
+        }
+        execute(job->line, job->fd);
+        job->done.set_value();
+    }
+}
+
+// 一个连接内的请求按顺序执行：提交后等待完成再读下一行
+// 关闭和停止时的 shutdown 都在 clients_mutex_ 内进行，fd 编号被重用前不会被误关
+void RenderServer::close_client(int fd) {
+    std::lock_guard<std::mutex> lock(clients_mutex_);
+    client_fds_.erase(std::remove(client_fds_.begin(), client_fds_.end(), fd), client_fds_.end());
+    ::close(fd);
+}
+
+void RenderServer::serve_client(int fd) {
+    std::string buffer;
+    char chunk[4096];
+    while (!stopping_) {
+        size_t nl;
+        while ((nl = buffer.find('\n')) == std::string::npos) {
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n <= 0) {
+                close_client(fd);
+                return;
+            }
+            buffer.append(chunk, (size_t)n);
+        }
+        std::string line = buffer.substr(0, nl);
+        buffer.erase(0, nl + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+
+        if (line == "shutdown") {
+            send_line(fd, "ok");
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                stopping_ = true;
+            }
+            queue_cv_.notify_all();
+            ::shutdown(listen_fd_, SHUT_RDWR);
+            break;
+        }
+        Job job{line, fd, {}};
+        auto done = job.done.get_future();
+        bool rejected;
+        {
+            // stopping_ 在队列锁内检查：渲染线程退出前已入队的任务都会执行，之后的任务被拒绝
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            rejected = stopping_;
+            if (!rejected) queue_.push_back(&job);
+        }
+        if (rejected) {
+            send_line(fd, "error server stopping");
+            break;
+        }
+        queue_cv_.notify_one();
+        done.wait();
+    }
+    close_client(fd);
+}
+
+int RenderServer::run() {
+    std::signal(SIGPIPE, SIG_IGN); // 客户端中途断开时 write 返回错误而不是终止进程
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (listen_fd_ < 0 || socket_path_.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: cannot create socket " << socket_path_ << std::endl;
+        return 1;
+    }
+    std::strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+    ::unlink(socket_path_.c_str());
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd_, 16) != 0) {
+        std::cerr << "Error: cannot listen on " << socket_path_ << ": " << std::strerror(errno) << std::endl;
+        ::close(listen_fd_);
+        return 1;
+    }
+    std::cout << "Render server listening on " << socket_path_ << std::endl;
+
+    std::thread worker([this] { render_loop(); });
+    // 连接线程结束时置位自己的标记，每次 accept 前回收已结束的线程，长时间运行时不会无限积累
+    struct Client {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::vector<Client> clients;
+    while (!stopping_) {
+        int fd = ::accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (auto &c : clients)
+            if (*c.done) c.thread.join();
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                     [](const Client &c) { return !c.thread.joinable(); }),
+                      clients.end());
+        {
+            std::lock_guard<std::mutex> lock(clients_mutex_);
+            client_fds_.push_back(fd);
+        }
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        clients.push_back({std::thread([this, fd, done] {
+                               serve_client(fd);
+                               *done = true;
+                           }),
+                           done});
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_cv_.notify_all();
+    worker.join();
+    // 唤醒仍在等待输入的连接，等全部连接线程结束后才返回（它们引用 this）
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex_);
+        for (int fd : client_fds_) ::shutdown(fd, SHUT_RDWR);
+    }
+    for (auto &c : clients) c.thread.join();
+    ::close(listen_fd_);
+    ::unlink(socket_path_.c_str());
+    std::cout << "Render server stopped" << std::endl;
+    return 0;
+}
+#endif
+
+int run_render_server(const std::string &socket_path, const ServerOptions &opt) {
+#ifdef _WIN32
+    std::cerr << "Error: --server needs Unix domain sockets and is not available in the Windows build" << std::endl;
+    return 1;
+#else
+    RenderServer server(socket_path, opt);
+    return server.run();
+#endif
+}
@@ -0,0 +1,93 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_RENDERSERVER_H
+#define GRAPHIC_CW_RENDERSERVER_H
+#pragma once
+#include "Scene.h"
+#include "BVH.h"
+#include "Accelerator.h"
+#include "LightTree.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// --server SOCKET：常驻进程，在本地 Unix socket 上接受渲染任务。场景按路径加载一次，场景、BVH、加速结构和光源树
+// 作为不可变快照（shared_ptr<const>）常驻；任务开始时场景文件内容哈希改变则重新加载，旧快照在仍被使用时保持有效。
+// 每个连接一个线程解析请求，全部任务进入同一个队列，由唯一的渲染线程依次执行，渲染本身使用共享的 OpenMP 线程池。
+//
+// 协议：每个请求一行文本，参数为 key=value：
+//   load <scene>                                        预加载 -> "ok <scene> objects=N ms=T"
+//   render scene=<path> [mode=whitted|distributed|restir|path] [spp=N] [shadow=N] [lighttree=0|1]
+//          [pos=x,y,z] [gaze=x,y,z] [focal=F] [res=WxH] [region=x0,y0,x1,y1] [tile=N]
+//       -> "job <id> <w> <h>"，每个完成的分块 "tile <x> <y> <w> <h>" 加 w*h*3 字节 RGB8（与 write_ppm 相同的量化），
+//          最后 "done <id> <seconds>"
+//   scenes                                              常驻场景列表，以 "ok" 结束
+//   shutdown                                            停止服务器
+// 出错时返回 "error <原因>"，连接保持可用
+struct ServerOptions {
+    BVHBuilder builder = BVHBuilder::SAH;
+    AcceleratorType accel = AcceleratorType::BVH;
+    double bvh_unbounded = 0.0;
+    bool use_scene_cache = true;
+};
+
+#ifndef _WIN32
+struct SceneSnapshot {
+    std::string path;
+    uint64_t hash = 0;
+    Scene scene;
+    BVH bvh;
+    std::unique_ptr<Accelerator> accel; // BVH 类型引用 bvh：快照创建后不再移动
+    LightTree light_tree;
+};
+
+class RenderServer {
+public:
+    RenderServer(const std::string &socket_path, const ServerOptions &opt) : socket_path_(socket_path), opt_(opt) {}
+    int run();
+
+private:
+    struct Job {
+        std::string line;
+        int fd;
+        std::promise<void> done;
+    };
+
+    std::string socket_path_;
+    ServerOptions opt_;
+    int listen_fd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Job *> queue_;
+    // 打开的连接：停止时逐个 shutdown，使阻塞在 read 上的连接线程返回
+    std::mutex clients_mutex_;
+    std::vector<int> client_fds_;
+    // 只由渲染线程访问
+    std::map<std::string, std::shared_ptr<const SceneSnapshot>> scenes_;
+    int next_job_ = 1;
+
+    void serve_client(int fd);
+    void close_client(int fd);
+    void render_loop();
+    void execute(const std::string &line, int fd);
+    std::shared_ptr<const SceneSnapshot> acquire_scene(const std::string &path, bool &loaded, double &ms);
+    void render_job(const std::map<std::string, std::string> &args, int fd);
+
+    static bool send_all(int fd, const void *data, size_t size);
+    static bool send_line(int fd, const std::string &line) { return send_all(fd, (line + "\n").data(), line.size() + 1); }
+};
+#endif
+
+// 运行服务器直到收到 shutdown；返回进程退出码（Windows 构建不支持，返回 1）
+int run_render_server(const std::string &socket_path, const ServerOptions &opt);
+
+#endif //GRAPHIC_CW_RENDERSERVER_H
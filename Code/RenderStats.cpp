@@ -0,0 +1,109 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+#include "RenderStats.h"
+
+#ifdef RT_STATS
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+
+namespace {
+// 各线程的计数器：deque 中元素地址不变，线程退出后仍可合并
+std::deque<RenderCounters> g_thread_counters;
+std::mutex g_counters_mutex;
+
+std::vector<double> g_pixel_costs;
+int g_cost_width = 0;
+
+RenderCounters *register_thread() {
+    std::lock_guard<std::mutex> lock(g_counters_mutex);
+    return &g_thread_counters.emplace_back();
+}
+} // namespace
+
+long long RenderCounters::traversal_cost() const {
+    long long cost = nodes + aabb_tests;
+    for (long long p : prim_tests) cost += p;
+    return cost;
+}
+
+RenderCounters &RenderCounters::operator+=(const RenderCounters &o) {
+    primary_rays += o.primary_rays;
+    shadow_rays += o.shadow_rays;
+    reflection_rays += o.reflection_rays;
+    refraction_rays += o.refraction_rays;
+    nodes += o.nodes;
+    aabb_tests += o.aabb_tests;
+    for (int i = 0; i < (int)PrimKind::COUNT; i++) prim_tests[i] += o.prim_tests[i];
+    shadow_early_outs += o.shadow_early_outs;
+    shadow_occluded += o.shadow_occluded;
+    return *this;
+}
+
+RenderCounters &render_counters() {
+    thread_local RenderCounters *counters = register_thread();
+    return *counters;
+}
+
+RenderCounters merge_render_counters() {
+    std::lock_guard<std::mutex> lock(g_counters_mutex);
+    RenderCounters total;
+    for (const auto &c : g_thread_counters) total += c;
+    return total;
+}
+
+void reset_render_counters() {
+    std::lock_guard<std::mutex> lock(g_counters_mutex);
+    for (auto &c : g_thread_counters) c = RenderCounters();
+    std::fill(g_pixel_costs.begin(), g_pixel_costs.end(), 0.0);
+}
+
+void print_render_counters(std::ostream &os, const RenderCounters &c, long long pixels, double seconds) {
+    const std::ios_base::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    const long long rays = c.primary_rays + c.shadow_rays + c.reflection_rays + c.refraction_rays;
+    const double per_ray = rays > 0 ? 1.0 / rays : 0.0;
+    const double per_pixel = pixels > 0 ? 1.0 / pixels : 0.0;
+    auto row = [&](const char *name, long long v, double per) {
+        os << std::left << std::setw(22) << name << std::right << std::setw(16) << v << std::setw(14)
+           << std::fixed << std::setprecision(2) << v * per_pixel << std::setw(12) << v * per << "\n";
+        os.unsetf(std::ios::floatfield);
+    };
+    const char *prim_names[] = {"prim tests: sphere", "prim tests: cube", "prim tests: plane", "prim tests: triangle"};
+
+    os << "\n=== Render Statistics (" << pixels << " pixels, " << seconds << " s) ===\n";
+    os << std::left << std::setw(22) << "counter" << std::right << std::setw(16) << "total" << std::setw(14)
+       << "per_pixel" << std::setw(12) << "per_ray" << "\n";
+    row("primary rays", c.primary_rays, per_ray);
+    row("shadow rays", c.shadow_rays, per_ray);
+    row("reflection rays", c.reflection_rays, per_ray);
+    row("refraction rays", c.refraction_rays, per_ray);
+    row("BVH nodes visited", c.nodes, per_ray);
+    row("AABB tests", c.aabb_tests, per_ray);
+    for (int i = 0; i < (int)PrimKind::COUNT; i++) row(prim_names[i], c.prim_tests[i], per_ray);
+    row("shadow early-outs", c.shadow_early_outs, per_ray);
+    row("shadow occluded", c.shadow_occluded, per_ray);
+    os << "Mrays/s: " << (seconds > 0.0 ? rays / seconds * 1e-6 : 0.0) << "\n";
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void begin_pixel_costs(int width, int height) {
+    g_cost_width = width;
+    g_pixel_costs.assign((size_t)width * height, 0.0);
+}
+
+const std::vector<double> &pixel_costs() { return g_pixel_costs; }
+
+// 同一次循环中每个像素只由一个线程处理，直接累加不需要同步
+PixelCostScope::PixelCostScope(int x, int y)
+    : index(g_pixel_costs.empty() ? -1 : y * g_cost_width + x), start(render_counters().traversal_cost()) {}
+
+PixelCostScope::~PixelCostScope() {
+    if (index >= 0 && index < (int)g_pixel_costs.size())
+        g_pixel_costs[index] += (double)(render_counters().traversal_cost() - start);
+}
+#endif
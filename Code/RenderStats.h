@@ -0,0 +1,63 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_RENDERSTATS_H
+#define GRAPHIC_CW_RENDERSTATS_H
+#pragma once
+
+// 渲染统计（编译选项 RT_STATS，CMake 中 -DRT_STATS=ON，默认关闭）：
+// 每个线程独立计数光线、BVH 节点访问、包围盒测试和按类型的图元求交，渲染结束后合并；
+// 同时按像素累计遍历代价（节点访问 + 包围盒测试 + 图元求交），用于输出代价热力图。
+// 未开启时 RT_STAT / RT_STAT_PIXEL 展开为空语句，热路径上没有任何开销
+#ifdef RT_STATS
+#include <iosfwd>
+#include <vector>
+
+enum class PrimKind { SPHERE, CUBE, PLANE, TRIANGLE, COUNT };
+
+struct RenderCounters {
+    long long primary_rays = 0;
+    long long shadow_rays = 0;
+    long long reflection_rays = 0;       // 反射 / 光泽 / 漫反射反弹
+    long long refraction_rays = 0;
+    long long nodes = 0;                 // BVH 节点访问（含网格内部的 BVH）
+    long long aabb_tests = 0;            // 节点包围盒求交（含未命中）
+    long long prim_tests[(int)PrimKind::COUNT] = {};
+    long long shadow_early_outs = 0;     // 未照亮（光源在背面等）而不必发射的阴影光线
+    long long shadow_occluded = 0;       // 被遮挡的阴影光线
+
+    // 遍历代价：节点访问 + 包围盒测试 + 图元求交
+    long long traversal_cost() const;
+    RenderCounters &operator+=(const RenderCounters &o);
+};
+
+// 当前线程的计数器（第一次调用时注册，合并时可见）
+RenderCounters &render_counters();
+// 全部线程计数器之和
+RenderCounters merge_render_counters();
+// 清零全部线程计数器和像素代价
+void reset_render_counters();
+void print_render_counters(std::ostream &os, const RenderCounters &c, long long pixels, double seconds);
+
+// 像素代价：begin_pixel_costs 之后，RT_STAT_PIXEL 作用域内当前线程的遍历代价计入该像素
+void begin_pixel_costs(int width, int height);
+const std::vector<double> &pixel_costs();
+
+struct PixelCostScope {
+    int index;
+    long long start;
+    PixelCostScope(int x, int y);
+    ~PixelCostScope();
+};
+
+#define RT_STAT(field) (++render_counters().field)
+#define RT_STAT_PRIM(kind) (++render_counters().prim_tests[(int)(kind)])
+#define RT_STAT_PIXEL(x, y) PixelCostScope rt_stat_pixel_scope_((x), (y))
+#else
+#define RT_STAT(field) ((void)0)
+#define RT_STAT_PRIM(kind) ((void)0)
+#define RT_STAT_PIXEL(x, y) ((void)0)
+#endif
+
+#endif //GRAPHIC_CW_RENDERSTATS_H
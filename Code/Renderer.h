@@ -0,0 +1,37 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_RENDERER_H
+#define GRAPHIC_CW_RENDERER_H
+#pragma once
+#include "Scene.h"
+#include "BVH.h"
+#include "Accelerator.h"
+#include "LightTree.h"
+#include "camera.h"
+#include "Image.h"
+#include <atomic>
+#include <functional>
+#include <string>
+
+// 渲染设置与入口（定义在 main.cpp），供渲染服务器、场景热重载等模块使用
+
+// 求交精度：为 true 时场景求交走单精度路径
+extern bool g_float_path;
+// 光源树：非空时 shade 按重要性为每个阴影样本选择一个光源
+extern const LightTree *g_light_tree;
+// 阴影光线使用的加速结构：为空时逐对象遍历
+extern const Accelerator *g_shadow_accel;
+// 置位后各渲染循环跳过剩余的行，渲染函数尽快返回
+extern std::atomic<bool> g_render_cancel;
+
+// 按模式名（whitted / distributed / restir / path）构造渲染函数；cam 按引用捕获
+std::function<void(Image &)> make_mode_render(const std::string &mode, const Camera &cam, const Scene &scene,
+                                              const Accelerator *accel, int spp, int shadow);
+
+// 场景 + BVH：优先从二进制缓存加载，未命中时解析文本、构建 BVH 并写回缓存；返回是否命中缓存。
+// bvh 的 unbounded_fraction / use_float_nodes 须在调用前设置
+bool load_scene_and_bvh(const std::string &path, Scene &scene, BVH &bvh, BVHBuilder builder, bool use_cache);
+
+#endif //GRAPHIC_CW_RENDERER_H
@@ -74,9 +74,10 @@ inline Vector3 ggxSampleHemisphere(const Vector3& normal, const Vector3& viewDir
     double a = roughness * roughness;
     double a2 = a * a;
 
-    // 采样GGX分布
+    // 采样GGX分布（反演 CDF 的两处必须是同一个随机数）
     double phi = 2.0 * M_PI * dis(g_rng);
-    double cosTheta = sqrt((1.0 - dis(g_rng)) / (dis(g_rng) * (a2 - 1.0) + 1.0));
+    double u = dis(g_rng);
+    double cosTheta = sqrt((1.0 - u) / (u * (a2 - 1.0) + 1.0));
     double sinTheta = sqrt(fmax(0.0, 1.0 - cosTheta * cosTheta));
 
     // 微表面法线（切线空间）
@@ -98,6 +99,37 @@ inline Vector3 ggxSampleHemisphere(const Vector3& normal, const Vector3& viewDir
     return reflectDir.normalized();
 }
 
+// 余弦加权半球采样（cosineSampleHemisphere）生成方向 dir 的 pdf（立体角测度）
+inline double cosineHemispherePdf(const Vector3& normal, const Vector3& dir) {
+    return fmax(0.0, normal.dot(dir)) / M_PI;
+}
+
+// GGX 法线分布 D(h)，alpha = roughness^2（与 ggxSampleHemisphere 一致）
+inline double ggxD(const Vector3& normal, const Vector3& h, double roughness) {
+    double a = roughness * roughness;
+    double a2 = a * a;
+    double cosTheta = normal.dot(h);
+    if (cosTheta <= 0.0) return 0.0;
+    double d = cosTheta * cosTheta * (a2 - 1.0) + 1.0;
+    return a2 / (M_PI * d * d);
+}
+
+// Smith 遮蔽函数 G1（GGX）
+inline double ggxSmithG1(const Vector3& normal, const Vector3& v, double roughness) {
+    double a = roughness * roughness;
+    double a2 = a * a;
+    double cosTheta = fabs(normal.dot(v));
+    return 2.0 * cosTheta / (cosTheta + sqrt(a2 + (1.0 - a2) * cosTheta * cosTheta));
+}
+
+// ggxSampleHemisphere 生成反射方向 dir 的 pdf（立体角测度）：D(h) (n·h) / (4 |v·h|)，viewDir 为入射方向
+inline double ggxPdf(const Vector3& normal, const Vector3& viewDir, const Vector3& dir, double roughness) {
+    Vector3 h = (dir - viewDir).normalized();
+    double vh = fabs(viewDir.dot(h));
+    if (vh <= 0.0) return 0.0;
+    return ggxD(normal, h, roughness) * normal.dot(h) / (4.0 * vh);
+}
+
 // 计算光源采样位置（根据光源半径）
 inline Vector3 sampleLightPosition(const PointLight& light) {
     if (light.radius <= 0.0) {
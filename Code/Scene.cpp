@@ -1,5 +1,8 @@
 #include "Scene.h"
 #include "Image.h"
+#include "MeshLoader.h"
+#include "Instance.h"
+#include "Timeline.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -15,7 +18,27 @@ static std::string trim(const std::string &s) {
     return (start == std::string::npos) ? "" : s.substr(start, end - start + 1);
 }
 
-Scene load_scene_txt(const std::string &filename) {
+// 网格文件路径：绝对路径直接使用，否则先相对场景文件目录，再相对其上级目录（与 Textures 同级）
+static std::string resolve_mesh_path(const std::string &scene_file, const std::string &file) {
+    std::filesystem::path p(file);
+    if (p.is_absolute()) return p.string();
+    std::filesystem::path scene_dir = std::filesystem::path(scene_file).parent_path();
+    std::filesystem::path candidate = scene_dir / p;
+    if (!std::filesystem::exists(candidate) && std::filesystem::exists(scene_dir.parent_path() / p))
+        candidate = scene_dir.parent_path() / p;
+    if (!std::filesystem::exists(candidate)) throw std::runtime_error("Mesh file not found: " + file);
+    return std::filesystem::canonical(candidate).string();
+}
+
+// keyframe <frame> <tx> <ty> <tz> [<rx> <ry> <rz>]，相对静止姿态
+static void parse_keyframe(std::istringstream &l, std::vector<Keyframe> &keys) {
+    Keyframe k;
+    l >> k.frame >> k.translation.x >> k.translation.y >> k.translation.z;
+    if (!(l >> k.rotation.x >> k.rotation.y >> k.rotation.z)) k.rotation = Vector3(0, 0, 0);
+    keys.push_back(k);
+}
+
+Scene load_scene_txt(const std::string &filename, const Scene *reuse) {
     Scene scene;
     scene.ambient_light = {0.2, 0.2, 0.2};
     scene.background_color = {0.8, 0.9, 1.0};
@@ -44,6 +67,23 @@ Scene load_scene_txt(const std::string &filename) {
         textures_dir = scene_dir;
     }
 
+    // 同一网格文件只加载一次
+    std::unordered_map<std::string, std::shared_ptr<TriangleMesh>> mesh_cache;
+
+    // 带 prototype 标记的物体只作为实例原型；所有 Instance 收集到一个 InstanceGroup 中
+    std::shared_ptr<InstanceGroup> instances;
+    std::unordered_map<std::string, int> look_index; // 去重相同的材质覆盖
+    auto add_shape = [&](const std::shared_ptr<Shape> &obj, bool is_prototype) {
+        if (!is_prototype) {
+            scene.objects.push_back(obj);
+            return;
+        }
+        if (!instances) instances = std::make_shared<InstanceGroup>();
+        if (instances->find_prototype(obj->name) >= 0) throw std::runtime_error("Duplicate prototype " + obj->name);
+        instances->prototypes.push_back(obj);
+        instances->prototype_names.push_back(obj->name);
+    };
+
     std::string line;
     while (std::getline(in, line)) {
         line = trim(line);
@@ -130,6 +170,7 @@ Scene load_scene_txt(const std::string &filename) {
             cam->compute_lens_radius(); // 计算透镜半径
 
             scene.camera = cam;
+            scene.cameras.push_back(cam);
         }
         else if (token == "PointLight") {
             Vector3 loc{0,0,0};
@@ -152,6 +193,9 @@ Scene load_scene_txt(const std::string &filename) {
             double radius = 1.0;
             std::string color_filename;
             Material material; // 添加材质属性
+            std::vector<Keyframe> keys;
+            Vector3 velocity{0,0,0}; // 运动模糊速度（米/秒）
+            bool is_prototype = false; // 仅作为实例原型，不直接出现在场景中
 
             while (std::getline(in, line)) {
                 line = trim(line);
@@ -167,19 +211,27 @@ Scene load_scene_txt(const std::string &filename) {
                 else if (key == "ior") l >> material.ior;
                 else if (key == "shininess") l >> material.shininess;
                 else if (key == "roughness") l >> material.roughness;
+                else if (key == "keyframe") parse_keyframe(l, keys);
+                else if (key == "velocity") l >> velocity.x >> velocity.y >> velocity.z;
+                else if (key == "prototype") is_prototype = true;
             }
             auto s = std::make_shared<Sphere>(loc, radius);
             s->name = name;
+            s->keyframes = keys;
+            s->velocity = velocity;
             s->color = color;
             s->texture_file = color_filename;
             s->material = material; // 设置材质
-            scene.objects.push_back(s);
+            add_shape(s, is_prototype);
         }
         else if (token == "Plane") {
             auto p = std::make_shared<Plane>();
             Vector3 color{0.8,0.8,0.8};
             std::string color_filename;
             Material material; // 添加材质属性
+            std::vector<Keyframe> keys;
+            Vector3 velocity{0,0,0}; // 运动模糊速度（米/秒）
+            bool is_prototype = false; // 仅作为实例原型，不直接出现在场景中
 
             while (std::getline(in, line)) {
                 line = trim(line);
@@ -197,18 +249,26 @@ Scene load_scene_txt(const std::string &filename) {
                 else if (key == "ior") l >> material.ior;
                 else if (key == "shininess") l >> material.shininess;
                 else if (key == "roughness") l >> material.roughness;
+                else if (key == "keyframe") parse_keyframe(l, keys);
+                else if (key == "velocity") l >> velocity.x >> velocity.y >> velocity.z;
+                else if (key == "prototype") is_prototype = true;
             }
             p->name = name;
+            p->keyframes = keys;
+            p->velocity = velocity;
             p->color = color;
             p->texture_file = color_filename;
             p->material = material; // 设置材质
-            scene.objects.push_back(p);
+            add_shape(p, is_prototype);
         }
         else if (token == "Cube") {
             Vector3 trans{0,0,0}, color{0.7,0.7,0.9}, size{1.0,1.0,1.0};
             double rx=0, ry=0, rz=0, scale=1.0;
             std::string color_filename;
             Material material; // 添加材质属性
+            std::vector<Keyframe> keys;
+            Vector3 velocity{0,0,0}; // 运动模糊速度（米/秒）
+            bool is_prototype = false; // 仅作为实例原型，不直接出现在场景中
 
             while (std::getline(in, line)) {
                 line = trim(line);
@@ -235,16 +295,137 @@ Scene load_scene_txt(const std::string &filename) {
                 else if (key == "ior") l >> material.ior;
                 else if (key == "shininess") l >> material.shininess;
                 else if (key == "roughness") l >> material.roughness;
+                else if (key == "keyframe") parse_keyframe(l, keys);
+                else if (key == "velocity") l >> velocity.x >> velocity.y >> velocity.z;
+                else if (key == "prototype") is_prototype = true;
             }
             auto c = std::make_shared<Cube>();
             c->name = name;
+            c->keyframes = keys;
+            c->velocity = velocity;
             c->center = trans;
             c->set_size(size.x, size.y, size.z);
             c->set_rotation(rx, ry, rz);
             c->color = color;
             c->texture_file = color_filename;
             c->material = material; // 设置材质
-            scene.objects.push_back(c);
+            add_shape(c, is_prototype);
+        }
+        else if (token == "Mesh") {
+            Vector3 trans{0,0,0}, color{0.8,0.8,0.8};
+            double rx=0, ry=0, rz=0, scale=1.0;
+            std::string file, color_filename;
+            Material material;
+            std::vector<Keyframe> keys;
+            Vector3 velocity{0,0,0};
+            bool is_prototype = false;
+
+            while (std::getline(in, line)) {
+                line = trim(line);
+                if (line == "end") break;
+                std::istringstream l(line);
+                std::string key; l >> key;
+                if (key == "file") l >> file;
+                else if (key == "translation") l >> trans.x >> trans.y >> trans.z;
+                else if (key == "rotation") l >> rx >> ry >> rz;
+                else if (key == "scale") l >> scale;
+                else if (key == "color") l >> color.x >> color.y >> color.z;
+                else if (key == "texture") l >> color_filename;
+                else if (key == "reflectivity") l >> material.reflectivity;
+                else if (key == "refractivity") l >> material.refractivity;
+                else if (key == "ior") l >> material.ior;
+                else if (key == "shininess") l >> material.shininess;
+                else if (key == "roughness") l >> material.roughness;
+                else if (key == "keyframe") parse_keyframe(l, keys);
+                else if (key == "velocity") l >> velocity.x >> velocity.y >> velocity.z;
+                else if (key == "prototype") is_prototype = true;
+            }
+            if (file.empty()) throw std::runtime_error("Mesh " + name + " has no file");
+
+            std::string mesh_path = resolve_mesh_path(filename, file);
+            auto it = mesh_cache.find(mesh_path);
+            if (it == mesh_cache.end()) {
+                std::shared_ptr<TriangleMesh> mesh;
+                if (reuse) {
+                    auto r = std::find(reuse->mesh_paths.begin(), reuse->mesh_paths.end(), mesh_path);
+                    if (r != reuse->mesh_paths.end()) mesh = reuse->meshes[r - reuse->mesh_paths.begin()];
+                }
+                if (!mesh) {
+                    TIMELINE_SCOPE("mesh.load");
+                    mesh = load_mesh(mesh_path);
+                }
+                it = mesh_cache.emplace(mesh_path, mesh).first;
+                scene.meshes.push_back(it->second);
+                scene.mesh_paths.push_back(mesh_path);
+            }
+
+            auto m = std::make_shared<Mesh>(it->second);
+            m->name = name;
+            m->keyframes = keys;
+            m->velocity = velocity;
+            m->translation = trans;
+            m->scale = scale;
+            m->set_rotation(rx, ry, rz);
+            m->color = color;
+            m->texture_file = color_filename;
+            m->material = material;
+            add_shape(m, is_prototype);
+        }
+        else if (token == "Instance") {
+            Instance inst;
+            std::string proto_name;
+            double rx=0, ry=0, rz=0;
+
+            // 材质相关的行先保存，原型确定后再套用
+            std::vector<std::string> material_lines;
+            while (std::getline(in, line)) {
+                line = trim(line);
+                if (line == "end") break;
+                std::istringstream l(line);
+                std::string key; l >> key;
+                if (key == "prototype") l >> proto_name;
+                else if (key == "translation") l >> inst.translation.x >> inst.translation.y >> inst.translation.z;
+                else if (key == "rotation") l >> rx >> ry >> rz;
+                else if (key == "scale") l >> inst.scale;
+                else if (key == "color" || key == "texture" || key == "reflectivity" || key == "refractivity" ||
+                         key == "ior" || key == "shininess" || key == "roughness") material_lines.push_back(line);
+            }
+
+            int proto = instances ? instances->find_prototype(proto_name) : -1;
+            if (proto < 0) throw std::runtime_error("Instance " + name + " references unknown prototype " + proto_name);
+            inst.prototype = proto;
+            inst.rot = InstanceGroup::rotation_from_degrees(rx, ry, rz);
+
+            // 材质覆盖以原型的材质为基础，只替换出现的字段
+            if (!material_lines.empty()) {
+                InstanceLook look;
+                const Shape &p = *instances->prototypes[proto];
+                look.color = p.color;
+                look.material = p.material;
+                look.texture_file = p.texture_file;
+                for (const auto &ml : material_lines) {
+                    std::istringstream l(ml);
+                    std::string key; l >> key;
+                    if (key == "color") l >> look.color.x >> look.color.y >> look.color.z;
+                    else if (key == "texture") l >> look.texture_file;
+                    else if (key == "reflectivity") l >> look.material.reflectivity;
+                    else if (key == "refractivity") l >> look.material.refractivity;
+                    else if (key == "ior") l >> look.material.ior;
+                    else if (key == "shininess") l >> look.material.shininess;
+                    else if (key == "roughness") l >> look.material.roughness;
+                }
+
+                std::string key(reinterpret_cast<const char *>(&look.color), sizeof(look.color));
+                key.append(reinterpret_cast<const char *>(&look.material), sizeof(look.material));
+                key += look.texture_file;
+                auto it = look_index.find(key);
+                if (it == look_index.end()) {
+                    it = look_index.emplace(key, (int)instances->looks.size()).first;
+                    instances->looks.push_back(look);
+                }
+                inst.look = it->second;
+            }
+            instances->instances.push_back(inst);
         }
         else if (token == "Scene") {
             while (std::getline(in, line) && line != "end") {
@@ -261,25 +442,37 @@ Scene load_scene_txt(const std::string &filename) {
         }
     }
 
+    // 关键帧按帧号排序，并记录加载时的几何为静止姿态
+    std::vector<std::shared_ptr<Shape>> all_shapes = scene.objects;
+    if (instances) all_shapes.insert(all_shapes.end(), instances->prototypes.begin(), instances->prototypes.end());
+    for (auto &obj : all_shapes) {
+        std::stable_sort(obj->keyframes.begin(), obj->keyframes.end(),
+                         [](const Keyframe &a, const Keyframe &b) { return a.frame < b.frame; });
+        obj->store_rest_pose();
+    }
+
     std::cout << "Scene loaded: " << scene.objects.size() << " objects, "
               << scene.lights.size() << " lights.\n";
+    if (instances) {
+        std::cout << "Instances: " << instances->instances.size() << " of "
+                  << instances->prototypes.size() << " prototypes ("
+                  << instances->looks.size() << " material overrides)\n";
+    }
     if (!scene.camera) std::cerr << "Warning: No camera found in scene file!\n";
 
     // 加载纹理文件
     std::unordered_map<std::string, std::shared_ptr<Image>> tex_cache;
     int loaded_textures = 0;
 
-    for (auto &obj : scene.objects) {
-        if (obj->texture_file.empty()) continue;
-
+    auto load_texture = [&](const std::string &texture_file) -> std::shared_ptr<Image> {
         // 构建纹理文件的完整路径
-        std::string texture_path = textures_dir + "\\" + obj->texture_file + ".ppm";
+        std::string texture_path = (std::filesystem::path(textures_dir) / (texture_file + ".ppm")).string();
 
-        //std::cout << "Searching for texture: " << obj->texture_file << " -> " << texture_path << std::endl;
+        //std::cout << "Searching for texture: " << texture_file << " -> " << texture_path << std::endl;
 
         if (!std::filesystem::exists(texture_path)) {
             std::cerr << "Warning: Texture file not found: " << texture_path << std::endl;
-            continue;
+            return nullptr;
         }
 
         texture_path = std::filesystem::canonical(texture_path).string();
@@ -287,36 +480,63 @@ Scene load_scene_txt(const std::string &filename) {
 
         // 加载纹理
         auto it = tex_cache.find(texture_path);
-        if (it == tex_cache.end()) {
-            auto img = std::make_shared<Image>();
-            std::cout << "Loading texture: " << texture_path << std::endl;
-
-            // 检查文件内容
-            std::ifstream test_file(texture_path);
-            if (test_file) {
-                std::string first_line;
-                std::getline(test_file, first_line);
-                std::cout << "First line: " << first_line << std::endl;
-
-                std::string second_line;
-                std::getline(test_file, second_line);
-                std::cout << "Second line: " << second_line << std::endl;
-
-                test_file.close();
-            }
-
-            if (img->load_ppm(texture_path)) {
+        if (it != tex_cache.end()) {
+            //std::cout << "Texture reused from cache: " << texture_path << std::endl;
+            return it->second;
+        }
+        if (reuse) {
+            auto r = std::find(reuse->texture_paths.begin(), reuse->texture_paths.end(), texture_path);
+            if (r != reuse->texture_paths.end()) {
+                auto img = reuse->textures[r - reuse->texture_paths.begin()];
                 tex_cache[texture_path] = img;
-                obj->texture_image = img;
-                loaded_textures++;
-                std::cout << "Texture loaded successfully!" << std::endl;
-            } else {
-                std::cerr << "Warning: Failed to load texture " << texture_path << "\n";
+                scene.textures.push_back(img);
+                scene.texture_paths.push_back(texture_path);
+                return img;
             }
         }
-        else {
-            obj->texture_image = it->second;
-            //std::cout << "Texture reused from cache: " << texture_path << std::endl;
+
+        auto img = std::make_shared<Image>();
+        std::cout << "Loading texture: " << texture_path << std::endl;
+
+        // 检查文件内容
+        std::ifstream test_file(texture_path);
+        if (test_file) {
+            std::string first_line;
+            std::getline(test_file, first_line);
+            std::cout << "First line: " << first_line << std::endl;
+
+            std::string second_line;
+            std::getline(test_file, second_line);
+            std::cout << "Second line: " << second_line << std::endl;
+
+            test_file.close();
+        }
+
+        TIMELINE_SCOPE("texture.decode");
+        if (!img->load_ppm(texture_path)) {
+            std::cerr << "Warning: Failed to load texture " << texture_path << "\n";
+            return nullptr;
+        }
+        tex_cache[texture_path] = img;
+        scene.textures.push_back(img);
+        scene.texture_paths.push_back(texture_path);
+        loaded_textures++;
+        std::cout << "Texture loaded successfully!" << std::endl;
+        return img;
+    };
+
+    for (auto &obj : all_shapes) {
+        if (!obj->texture_file.empty()) obj->texture_image = load_texture(obj->texture_file);
+    }
+    if (instances) {
+        for (auto &look : instances->looks) {
+            if (!look.texture_file.empty()) look.texture_image = load_texture(look.texture_file);
+        }
+        // 顶层 BVH 建在实例包围盒上，整个集合在场景 BVH 中作为一个图元
+        if (!instances->instances.empty()) {
+            instances->name = "instances";
+            instances->build();
+            scene.objects.push_back(instances);
         }
     }
 
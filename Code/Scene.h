@@ -9,11 +9,14 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <random>
+#include <cmath>
 #include "Shape.h"
 #include "camera.h"
 #include "Sphere.h"
 #include "Plane.h"
 #include "Cube.h"
+#include "Mesh.h"
 #include "Vector3.h"
 
 // 点光源结构
@@ -24,22 +27,57 @@ struct PointLight {
     double radius = 0.0;  // 光源半径，0表示点光源
     // Vector3 normal;       // 面光源的法线方向
 
+    // 点光源每次采样在 ±JITTER 的立方体内随机抖动，模拟柔光阴影
+    static constexpr double JITTER = 0.025;
+
     PointLight() : pos(0,0,0), intensity(1.0) {}
     PointLight(const Vector3 &p, double i,double r) : pos(p), intensity(i),radius(r) {}
+
+    // 在光源上随机取一个采样位置：面光源在圆盘上均匀采样（简化：假设光源在XY平面），点光源加小范围抖动
+    Vector3 sample_position(std::mt19937 &rng) const {
+        std::uniform_real_distribution<> dis(0.0, 1.0);
+        if (radius > 0.0) {
+            double r = std::sqrt(dis(rng)) * radius;
+            double theta = 2.0 * M_PI * dis(rng);
+            return pos + Vector3(r * std::cos(theta), r * std::sin(theta), 0);
+        }
+        double dx = (dis(rng) - 0.5) * 2.0 * JITTER;
+        double dy = (dis(rng) - 0.5) * 2.0 * JITTER;
+        double dz = (dis(rng) - 0.5) * 2.0 * JITTER;
+        return pos + Vector3(dx, dy, dz);
+    }
+
+    // 采样位置到 pos 的最大偏移（各轴）
+    double extent() const { return radius > 0.0 ? radius : JITTER; }
 };
 
+// 光照距离衰减（shade 与光源树的重要性估计共用）
+inline double light_attenuation(double distance) {
+    return 1.0 / (1.0 + 0.1 * distance);
+}
+
 // 场景结构
 struct Scene {
-    std::shared_ptr<Camera> camera;
+    std::shared_ptr<Camera> camera;               // 默认渲染的相机（文件中最后一个）
+    std::vector<std::shared_ptr<Camera>> cameras; // 文件中的全部相机，按出现顺序（--batch 使用）
     std::vector<std::shared_ptr<Shape>> objects;
     std::vector<PointLight> lights;
 
     Vector3 background_color = {0.8, 0.9, 1.0};  // 默认天空色
     Vector3 ambient_light   = {0.1, 0.1, 0.1};  // 默认环境光
+
+    // 已加载的纹理（去重后），与 texture_paths 一一对应，供场景缓存使用
+    std::vector<std::shared_ptr<Image>> textures;
+    std::vector<std::string> texture_paths;
+
+    // 已加载的三角网格（按文件去重，多个 Mesh 物体可共享），与 mesh_paths 一一对应
+    std::vector<std::shared_ptr<TriangleMesh>> meshes;
+    std::vector<std::string> mesh_paths;
 };
 
 
-// 从 ASCII 文本文件加载场景
-Scene load_scene_txt(const std::string &filename);
+// 从 ASCII 文本文件加载场景。
+// reuse 非空时（热重载），其中已加载的纹理和网格按路径直接共享，不重新解码
+Scene load_scene_txt(const std::string &filename, const Scene *reuse = nullptr);
 
 #endif //GRAPHIC_SCENE_H
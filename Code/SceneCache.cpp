@@ -0,0 +1,580 @@
+//
+// Created by 31934 on 2025/12/9.
+//
+#include "SceneCache.h"
+#include "Image.h"
+#include "Instance.h"
+#include "MemoryStats.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+#include <filesystem>
+#include <type_traits>
+#include <unordered_map>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'R', 'T', 'S', 'C', 'A', 'C', 'H', 'E'};
+
+enum ShapeType : uint32_t {
+    SHAPE_SPHERE = 0,
+    SHAPE_PLANE  = 1,
+    SHAPE_CUBE   = 2,
+    SHAPE_MESH   = 3,
+    SHAPE_INSTANCES = 4,
+};
+
+// ---------------- 只读内存映射 ----------------
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file_, &sz) || sz.QuadPart == 0) return;
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_) return;
+        data_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        if (data_) size_ = static_cast<size_t>(sz.QuadPart);
+#else
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) return;
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || st.st_size == 0) return;
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (p == MAP_FAILED) return;
+        data_ = static_cast<const char *>(p);
+        size_ = static_cast<size_t>(st.st_size);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+        if (data_) munmap(const_cast<char *>(data_), size_);
+        if (fd_ >= 0) close(fd_);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool valid() const { return data_ != nullptr; }
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+// ---------------- 顺序读写辅助 ----------------
+class CacheWriter {
+public:
+    explicit CacheWriter(std::ofstream &out) : out_(out) {}
+
+    template<typename T>
+    void pod(const T &v) {
+        static_assert(std::is_trivially_copyable_v<T>, "cache records must be trivially copyable");
+        out_.write(reinterpret_cast<const char *>(&v), sizeof(T));
+    }
+
+    template<typename T>
+    void array(const std::vector<T> &v) {
+        static_assert(std::is_trivially_copyable_v<T>, "cache records must be trivially copyable");
+        pod<uint64_t>(v.size());
+        if (!v.empty()) out_.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+    }
+
+    void string(const std::string &s) {
+        pod<uint32_t>(static_cast<uint32_t>(s.size()));
+        out_.write(s.data(), s.size());
+    }
+
+private:
+    std::ofstream &out_;
+};
+
+class CacheReader {
+public:
+    CacheReader(const char *data, size_t size) : p_(data), end_(data + size) {}
+
+    template<typename T>
+    T pod() {
+        static_assert(std::is_trivially_copyable_v<T>, "cache records must be trivially copyable");
+        T v;
+        std::memcpy(&v, take(sizeof(T)), sizeof(T));
+        return v;
+    }
+
+    template<typename T>
+    void array(std::vector<T> &v) {
+        uint64_t n = pod<uint64_t>();
+        if (n > static_cast<uint64_t>(end_ - p_) / sizeof(T)) throw std::runtime_error("corrupt array length");
+        v.resize(n);
+        if (n) std::memcpy(v.data(), take(n * sizeof(T)), n * sizeof(T));
+    }
+
+    std::string string() {
+        uint32_t n = pod<uint32_t>();
+        const char *s = take(n);
+        return std::string(s, n);
+    }
+
+    const char *take(size_t n) {
+        if (static_cast<size_t>(end_ - p_) < n) throw std::runtime_error("truncated scene cache");
+        const char *r = p_;
+        p_ += n;
+        return r;
+    }
+
+private:
+    const char *p_;
+    const char *end_;
+};
+
+// 相机的持久化字段（基向量和透镜半径在加载后重新计算）
+struct CameraRecord {
+    Vector3 position, gaze, velocity;
+    double focal_length_m, sensor_w_m, sensor_h_m;
+    double shutter_speed, aperture_fstop, focus_distance_m;
+    int32_t res_x, res_y;
+};
+
+struct LightRecord {
+    Vector3 pos;
+    double intensity, radius;
+};
+
+uint64_t fnv1a(const void *data, size_t n, uint64_t h = 1469598103934665603ull) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// 依赖文件列表的组合键（包含格式版本和 BVH 构建算法）
+uint64_t combine_key(const std::vector<uint64_t> &hashes, BVHBuilder builder) {
+    uint64_t h = fnv1a(&SCENE_CACHE_VERSION, sizeof(SCENE_CACHE_VERSION));
+    h = fnv1a(&builder, sizeof(builder), h);
+    for (uint64_t v : hashes) h = fnv1a(&v, sizeof(v), h);
+    return h;
+}
+
+
+// 纹理 / 网格指针到缓存内下标的映射
+struct ShapeTables {
+    std::unordered_map<const Image *, int32_t> textures;
+    std::unordered_map<const TriangleMesh *, int32_t> meshes;
+
+    int32_t texture(const std::shared_ptr<Image> &img) const {
+        auto it = textures.find(img.get());
+        return it == textures.end() ? -1 : it->second;
+    }
+};
+
+std::shared_ptr<Image> texture_at(const Scene &s, int32_t tex) {
+    if (tex < 0) return nullptr;
+    if (tex >= static_cast<int32_t>(s.textures.size())) throw std::runtime_error("bad texture index");
+    return s.textures[tex];
+}
+
+void write_shape(CacheWriter &w, const Shape &obj, const ShapeTables &tables) {
+    uint32_t type;
+    if (dynamic_cast<const Sphere *>(&obj)) type = SHAPE_SPHERE;
+    else if (dynamic_cast<const Plane *>(&obj)) type = SHAPE_PLANE;
+    else if (dynamic_cast<const Cube *>(&obj)) type = SHAPE_CUBE;
+    else if (dynamic_cast<const Mesh *>(&obj)) type = SHAPE_MESH;
+    else if (dynamic_cast<const InstanceGroup *>(&obj)) type = SHAPE_INSTANCES;
+    else throw std::runtime_error("unsupported shape type for cache: " + obj.name);
+
+    w.pod(type);
+    w.string(obj.name);
+    w.pod(obj.color);
+    w.pod(obj.material);
+    w.string(obj.texture_file);
+    w.pod<int32_t>(tables.texture(obj.texture_image));
+    w.array(obj.keyframes);
+    w.pod(obj.velocity);
+
+    if (type == SHAPE_SPHERE) {
+        const auto &s = static_cast<const Sphere &>(obj);
+        w.pod(s.center);
+        w.pod(s.radius);
+    } else if (type == SHAPE_PLANE) {
+        const auto &p = static_cast<const Plane &>(obj);
+        w.pod(p.corners);
+    } else if (type == SHAPE_CUBE) {
+        const auto &c = static_cast<const Cube &>(obj);
+        w.pod(c.center);
+        w.pod(c.size);
+        w.pod(c.rot);
+    } else if (type == SHAPE_MESH) {
+        const auto &m = static_cast<const Mesh &>(obj);
+        auto mit = tables.meshes.find(m.mesh.get());
+        if (mit == tables.meshes.end()) throw std::runtime_error("mesh not registered in scene: " + obj.name);
+        w.pod<int32_t>(mit->second);
+        w.pod(m.translation);
+        w.pod(m.rot);
+        w.pod(m.scale);
+    } else {
+        // 原型递归写入；实例记录和顶层 BVH 直接按数组写入
+        const auto &g = static_cast<const InstanceGroup &>(obj);
+        w.pod<uint32_t>(static_cast<uint32_t>(g.prototypes.size()));
+        for (const auto &proto : g.prototypes) write_shape(w, *proto, tables);
+        w.pod<uint32_t>(static_cast<uint32_t>(g.looks.size()));
+        for (const auto &look : g.looks) {
+            w.pod(look.color);
+            w.pod(look.material);
+            w.string(look.texture_file);
+            w.pod<int32_t>(tables.texture(look.texture_image));
+        }
+        w.array(g.instances);
+        w.array(g.bvh.nodes);
+        w.array(g.bvh.prim_indices);
+    }
+}
+
+std::shared_ptr<Shape> read_shape(CacheReader &r, const Scene &s) {
+    uint32_t type = r.pod<uint32_t>();
+    std::string name = r.string();
+    Vector3 color = r.pod<Vector3>();
+    Material material = r.pod<Material>();
+    std::string texture_file = r.string();
+    int32_t tex = r.pod<int32_t>();
+    std::vector<Keyframe> keyframes;
+    r.array(keyframes);
+    Vector3 velocity = r.pod<Vector3>();
+
+    std::shared_ptr<Shape> obj;
+    if (type == SHAPE_SPHERE) {
+        Vector3 center = r.pod<Vector3>();
+        double radius = r.pod<double>();
+        obj = std::make_shared<Sphere>(center, radius);
+    } else if (type == SHAPE_PLANE) {
+        auto p = std::make_shared<Plane>();
+        p->corners = r.pod<std::array<Vector3, 4>>();
+        obj = p;
+    } else if (type == SHAPE_CUBE) {
+        auto c = std::make_shared<Cube>();
+        c->center = r.pod<Vector3>();
+        c->size = r.pod<Vector3>();
+        c->rot = r.pod<Matrix3>();
+        c->update_transform();
+        obj = c;
+    } else if (type == SHAPE_MESH) {
+        int32_t mesh = r.pod<int32_t>();
+        if (mesh < 0 || mesh >= static_cast<int32_t>(s.meshes.size())) throw std::runtime_error("bad mesh index");
+        auto m = std::make_shared<Mesh>(s.meshes[mesh]);
+        m->translation = r.pod<Vector3>();
+        m->rot = r.pod<Matrix3>();
+        m->rot_inv = m->rot.transpose();
+        m->scale = r.pod<double>();
+        obj = m;
+    } else if (type == SHAPE_INSTANCES) {
+        auto g = std::make_shared<InstanceGroup>();
+        uint32_t proto_count = r.pod<uint32_t>();
+        for (uint32_t i = 0; i < proto_count; i++) {
+            g->prototypes.push_back(read_shape(r, s));
+            g->prototype_names.push_back(g->prototypes.back()->name);
+        }
+        uint32_t look_count = r.pod<uint32_t>();
+        for (uint32_t i = 0; i < look_count; i++) {
+            InstanceLook look;
+            look.color = r.pod<Vector3>();
+            look.material = r.pod<Material>();
+            look.texture_file = r.string();
+            look.texture_image = texture_at(s, r.pod<int32_t>());
+            g->looks.push_back(look);
+        }
+        r.array(g->instances);
+        r.array(g->bvh.nodes);
+        r.array(g->bvh.prim_indices);
+        for (const auto &inst : g->instances) {
+            if (inst.prototype < 0 || inst.prototype >= static_cast<int32_t>(proto_count) ||
+                inst.look >= static_cast<int32_t>(look_count))
+                throw std::runtime_error("bad instance record");
+        }
+        for (int idx : g->bvh.prim_indices) {
+            if (idx < 0 || idx >= static_cast<int>(g->instances.size())) throw std::runtime_error("bad instance BVH index");
+        }
+        obj = g;
+    } else {
+        throw std::runtime_error("unknown shape type");
+    }
+
+    obj->name = name;
+    obj->color = color;
+    obj->material = material;
+    obj->texture_file = texture_file;
+    obj->keyframes = std::move(keyframes);
+    obj->velocity = velocity;
+    obj->store_rest_pose();
+    obj->texture_image = texture_at(s, tex);
+    return obj;
+}
+
+} // namespace
+
+std::string scene_cache_path(const std::string &scene_path) {
+    std::filesystem::path p(scene_path);
+    p.replace_extension(".rtc");
+    return p.string();
+}
+
+uint64_t hash_file(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open " + path);
+    uint64_t h = 1469598103934665603ull;
+    std::vector<char> buf(1 << 16);
+    while (in) {
+        in.read(buf.data(), buf.size());
+        h = fnv1a(buf.data(), static_cast<size_t>(in.gcount()), h);
+    }
+    return h;
+}
+
+bool write_scene_cache(const std::string &cache_path, const std::string &scene_path,
+                       const Scene &scene, const BVH &bvh, BVHBuilder builder) {
+    try {
+        // 依赖文件：场景文件本身 + 全部纹理 + 全部网格文件
+        std::vector<std::string> deps{std::filesystem::absolute(scene_path).string()};
+        deps.insert(deps.end(), scene.texture_paths.begin(), scene.texture_paths.end());
+        deps.insert(deps.end(), scene.mesh_paths.begin(), scene.mesh_paths.end());
+        std::vector<uint64_t> hashes;
+        for (const auto &d : deps) hashes.push_back(hash_file(d));
+
+        ShapeTables tables;
+        for (size_t i = 0; i < scene.textures.size(); i++) tables.textures[scene.textures[i].get()] = static_cast<int32_t>(i);
+        for (size_t i = 0; i < scene.meshes.size(); i++) tables.meshes[scene.meshes[i].get()] = static_cast<int32_t>(i);
+
+        std::string tmp_path = cache_path + ".tmp";
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        CacheWriter w(out);
+
+        // 头部
+        out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        w.pod<uint32_t>(SCENE_CACHE_VERSION);
+        w.pod(builder);
+        w.pod<uint64_t>(combine_key(hashes, builder));
+        w.pod<uint32_t>(static_cast<uint32_t>(deps.size()));
+        for (size_t i = 0; i < deps.size(); i++) {
+            w.string(deps[i]);
+            w.pod<uint64_t>(hashes[i]);
+        }
+
+        // 全局参数
+        w.pod(scene.background_color);
+        w.pod(scene.ambient_light);
+
+        // 相机（全部，按文件顺序；默认相机是最后一个）
+        w.pod<uint32_t>(static_cast<uint32_t>(scene.cameras.size()));
+        for (const auto &cam : scene.cameras) {
+            const Camera &c = *cam;
+            CameraRecord r{c.position, c.gaze, c.velocity,
+                           c.focal_length_m, c.sensor_w_m, c.sensor_h_m,
+                           c.shutter_speed, c.aperture_fstop, c.focus_distance_m,
+                           c.res_x, c.res_y};
+            w.string(c.name);
+            w.pod(r);
+        }
+
+        // 光源
+        std::vector<LightRecord> lights;
+        for (const auto &l : scene.lights) lights.push_back({l.pos, l.intensity, l.radius});
+        w.array(lights);
+
+        // 纹理像素
+        w.pod<uint32_t>(static_cast<uint32_t>(scene.textures.size()));
+        for (const auto &tex : scene.textures) {
+            w.pod<int32_t>(tex->width);
+            w.pod<int32_t>(tex->height);
+            w.array(tex->pixels);
+        }
+
+        // 三角网格及其底层 BVH
+        w.pod<uint32_t>(static_cast<uint32_t>(scene.meshes.size()));
+        for (const auto &mesh : scene.meshes) {
+            w.array(mesh->positions);
+            w.array(mesh->normals);
+            w.array(mesh->texcoords);
+            w.array(mesh->triangles);
+            w.array(mesh->bvh.nodes);
+            w.array(mesh->bvh.prim_indices);
+        }
+
+        // 几何与材质
+        w.pod<uint64_t>(scene.objects.size());
+        for (const auto &obj : scene.objects) write_shape(w, *obj, tables);
+
+        // 展平的 BVH
+        w.array(bvh.nodes);
+        w.array(bvh.prim_indices);
+        w.array(bvh.motion_boxes);
+        w.pod(bvh.shutter_time);
+        w.pod(bvh.unbounded_fraction);
+        w.array(bvh.unbounded);
+
+        out.close();
+        if (!out) return false;
+        std::filesystem::rename(tmp_path, cache_path);
+        return true;
+    } catch (const std::exception &e) {
+        std::cerr << "Warning: Failed to write scene cache " << cache_path << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool load_scene_cache(const std::string &cache_path, Scene &scene, BVH &bvh, BVHBuilder builder) {
+    if (!std::filesystem::exists(cache_path)) return false;
+
+    MappedFile file(cache_path);
+    if (!file.valid()) return false;
+    MemScope mapped(MemTag::SCENE_CACHE, file.size());
+
+    try {
+        CacheReader r(file.data(), file.size());
+
+        if (std::memcmp(r.take(sizeof(CACHE_MAGIC)), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) return false;
+        if (r.pod<uint32_t>() != SCENE_CACHE_VERSION) return false;
+        if (r.pod<BVHBuilder>() != builder) return false;
+        uint64_t key = r.pod<uint64_t>();
+
+        // 校验全部依赖文件的内容哈希
+        uint32_t dep_count = r.pod<uint32_t>();
+        std::vector<std::string> deps;
+        std::vector<uint64_t> hashes;
+        for (uint32_t i = 0; i < dep_count; i++) {
+            std::string path = r.string();
+            uint64_t stored = r.pod<uint64_t>();
+            if (!std::filesystem::exists(path) || hash_file(path) != stored) return false;
+            deps.push_back(path);
+            hashes.push_back(stored);
+        }
+        if (combine_key(hashes, builder) != key) return false;
+
+        Scene s;
+        s.background_color = r.pod<Vector3>();
+        s.ambient_light = r.pod<Vector3>();
+
+        uint32_t cam_count = r.pod<uint32_t>();
+        for (uint32_t i = 0; i < cam_count; i++) {
+            auto cam = std::make_shared<Camera>();
+            cam->name = r.string();
+            CameraRecord c = r.pod<CameraRecord>();
+            cam->position = c.position;
+            cam->gaze = c.gaze;
+            cam->velocity = c.velocity;
+            cam->focal_length_m = c.focal_length_m;
+            cam->sensor_w_m = c.sensor_w_m;
+            cam->sensor_h_m = c.sensor_h_m;
+            cam->shutter_speed = c.shutter_speed;
+            cam->aperture_fstop = c.aperture_fstop;
+            cam->focus_distance_m = c.focus_distance_m;
+            cam->res_x = c.res_x;
+            cam->res_y = c.res_y;
+            cam->compute_basis();
+            cam->compute_lens_radius();
+            s.camera = cam;
+            s.cameras.push_back(cam);
+        }
+
+        std::vector<LightRecord> lights;
+        r.array(lights);
+        for (const auto &l : lights) s.lights.push_back({l.pos, l.intensity, l.radius});
+
+        uint32_t tex_count = r.pod<uint32_t>();
+        for (uint32_t i = 0; i < tex_count; i++) {
+            auto img = std::make_shared<Image>();
+            img->width = r.pod<int32_t>();
+            img->height = r.pod<int32_t>();
+            r.array(img->pixels);
+            if (img->pixels.size() != static_cast<size_t>(img->width) * img->height)
+                throw std::runtime_error("texture size mismatch");
+            s.textures.push_back(img);
+        }
+        uint32_t mesh_count = r.pod<uint32_t>();
+        for (uint32_t i = 0; i < mesh_count; i++) {
+            auto mesh = std::make_shared<TriangleMesh>();
+            r.array(mesh->positions);
+            r.array(mesh->normals);
+            r.array(mesh->texcoords);
+            r.array(mesh->triangles);
+            r.array(mesh->bvh.nodes);
+            r.array(mesh->bvh.prim_indices);
+            for (const auto &tri : mesh->triangles) {
+                for (int v : tri) {
+                    if (v < 0 || v >= static_cast<int>(mesh->positions.size())) throw std::runtime_error("bad mesh index");
+                }
+            }
+            if (mesh->bvh.prim_indices.size() != mesh->triangles.size()) throw std::runtime_error("mesh BVH mismatch");
+            s.meshes.push_back(mesh);
+        }
+
+        // 依赖表的第 0 项是场景文件，随后依次是纹理和网格文件
+        if (deps.size() != 1 + tex_count + mesh_count) throw std::runtime_error("dependency table mismatch");
+        s.texture_paths.assign(deps.begin() + 1, deps.begin() + 1 + tex_count);
+        s.mesh_paths.assign(deps.begin() + 1 + tex_count, deps.end());
+
+        uint64_t obj_count = r.pod<uint64_t>();
+        s.objects.reserve(obj_count);
+        for (uint64_t i = 0; i < obj_count; i++) s.objects.push_back(read_shape(r, s));
+
+        BVH b;
+        r.array(b.nodes);
+        r.array(b.prim_indices);
+        r.array(b.motion_boxes);
+        b.shutter_time = r.pod<double>();
+        b.unbounded_fraction = r.pod<double>();
+        if (b.unbounded_fraction != bvh.unbounded_fraction) return false;
+        r.array(b.unbounded);
+        if (!b.motion_boxes.empty() && b.motion_boxes.size() != b.nodes.size())
+            throw std::runtime_error("motion bounds mismatch");
+        for (int idx : b.prim_indices) {
+            if (idx < 0 || idx >= static_cast<int>(s.objects.size())) throw std::runtime_error("bad BVH index");
+        }
+        for (int idx : b.unbounded) {
+            if (idx < 0 || idx >= static_cast<int>(s.objects.size())) throw std::runtime_error("bad BVH index");
+        }
+
+        // 有向包围盒和单精度节点由对象几何 / 双精度节点直接算出，不写入缓存
+        b.use_obbs = bvh.use_obbs;
+        b.update_leaf_obbs(s);
+        b.use_float_nodes = bvh.use_float_nodes;
+        b.update_float_nodes();
+
+        scene = std::move(s);
+        bvh = std::move(b);
+        return true;
+    } catch (const std::exception &e) {
+        std::cerr << "Warning: Ignoring scene cache " << cache_path << ": " << e.what() << std::endl;
+        return false;
+    }
+}
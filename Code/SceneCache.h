@@ -0,0 +1,36 @@
+//
+// Created by 31934 on 2025/12/9.
+//
+
+#ifndef GRAPHIC_CW_SCENECACHE_H
+#define GRAPHIC_CW_SCENECACHE_H
+#pragma once
+#include "Scene.h"
+#include "BVH.h"
+#include <cstdint>
+#include <string>
+
+// 二进制场景缓存（.rtc）
+// 第一次从 ASCII 场景加载后写入：几何记录、材质、展平的 BVH、纹理像素以及三角网格和各自的底层 BVH。
+// 之后的运行直接内存映射该文件，跳过文本解析、PPM 解码和 BVH 构建。
+// 缓存以场景文件、全部纹理和网格文件内容的哈希为键，任何一个文件改变都会使缓存失效。
+
+// 缓存格式版本，格式改变时必须递增
+constexpr uint32_t SCENE_CACHE_VERSION = 9;
+
+// 场景文件对应的缓存路径：scene.txt -> scene.rtc
+std::string scene_cache_path(const std::string &scene_path);
+
+// 文件内容的 64 位 FNV-1a 哈希
+uint64_t hash_file(const std::string &path);
+
+// 读取缓存；缓存不存在、版本不符、哈希不匹配、BVH 构建算法或 bvh.unbounded_fraction 不同时
+// 返回 false（scene / bvh 不被修改）
+bool load_scene_cache(const std::string &cache_path, Scene &scene, BVH &bvh,
+                      BVHBuilder builder = BVHBuilder::SAH);
+
+// 写入缓存；scene_path 为原始 ASCII 场景文件，builder 为 bvh 使用的构建算法
+bool write_scene_cache(const std::string &cache_path, const std::string &scene_path,
+                       const Scene &scene, const BVH &bvh, BVHBuilder builder = BVHBuilder::SAH);
+
+#endif //GRAPHIC_CW_SCENECACHE_H
@@ -0,0 +1,95 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+#include "SceneGenerator.h"
+#include "Vector3.h"
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+namespace {
+// Textures 目录中的自带纹理（不含扩展名）
+const char *const TEXTURES[] = {"brick_wall", "checkerboard", "gradient_sky", "noise_texture",
+                                "rainbow_stripes", "wood_texture"};
+
+void write_material(std::ostream &out, std::mt19937 &rng, const SceneGenOptions &opt) {
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    out << "color " << 0.2 + 0.8 * u(rng) << " " << 0.2 + 0.8 * u(rng) << " " << 0.2 + 0.8 * u(rng) << "\n";
+    if (u(rng) < opt.textured_fraction)
+        out << "texture " << TEXTURES[std::uniform_int_distribution<>(0, 5)(rng)] << "\n";
+    double kind = u(rng);
+    if (kind < opt.refractive_fraction) {
+        out << "refractivity " << 0.5 + 0.4 * u(rng) << "\nior " << 1.3 + 0.4 * u(rng) << "\n";
+    } else if (kind < opt.refractive_fraction + opt.reflective_fraction) {
+        out << "reflectivity " << 0.2 + 0.6 * u(rng) << "\nroughness " << u(rng) << "\n";
+    }
+    out << "shininess " << 10.0 + 90.0 * u(rng) << "\n";
+}
+} // namespace
+
+bool write_generated_scene(const std::string &path, const SceneGenOptions &opt) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cerr << "Error: Cannot open " << path << " for writing." << std::endl;
+        return false;
+    }
+    std::mt19937 rng(opt.seed);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    out << std::fixed;
+
+    // 物体分布在 [-E, E]^2 x [0, E] 内，每个物体平均占约 8 立方米
+    const double extent = std::cbrt(4.0 * std::max(opt.objects, 1));
+    const Vector3 center(0.0, 0.0, extent * 0.4);
+    const Vector3 eye(extent * 1.9, -extent * 1.9, extent * 1.6);
+    const Vector3 gaze = (center - eye).normalized();
+
+    out << "Background 0.05 0.05 0.05\nAmbientLight 0.1 0.1 0.1\n\n";
+    out << "Camera MainCamera\nlocation " << eye.x << " " << eye.y << " " << eye.z << "\n"
+        << "gaze " << gaze.x << " " << gaze.y << " " << gaze.z << "\n"
+        << "focal_length 35\nsensor_width 36\nsensor_height 24\n"
+        << "resolution " << opt.res_x << " " << opt.res_y << "\nend\n\n";
+
+    const int lights = std::max(opt.lights, 1);
+    for (int i = 0; i < lights; i++) {
+        out << "PointLight Light_" << i << "\nlocation " << (2.0 * u(rng) - 1.0) * extent << " "
+            << (2.0 * u(rng) - 1.0) * extent << " " << extent * (1.2 + 0.3 * u(rng)) << "\n"
+            << "intensity " << 5000.0 / lights << "\nradius 0.5\nend\n\n";
+    }
+
+    const double floor = extent * 1.5;
+    out << "Plane Floor\ncorner1 " << -floor << " " << -floor << " 0\ncorner2 " << floor << " " << -floor
+        << " 0\ncorner3 " << floor << " " << floor << " 0\ncorner4 " << -floor << " " << floor << " 0\n"
+        << "texture checkerboard\nend\n\n";
+
+    const double total = opt.sphere_weight + opt.cube_weight + opt.plane_weight;
+    for (int i = 0; i < opt.objects; i++) {
+        Vector3 p((2.0 * u(rng) - 1.0) * extent, (2.0 * u(rng) - 1.0) * extent, 0.3 + u(rng) * extent);
+        double kind = u(rng) * total;
+        if (kind < opt.sphere_weight) {
+            out << "Sphere Sphere_" << i << "\nlocation " << p.x << " " << p.y << " " << p.z
+                << "\nradius " << 0.3 + 0.5 * u(rng) << "\n";
+        } else if (kind < opt.sphere_weight + opt.cube_weight) {
+            out << "Cube Cube_" << i << "\ntranslation " << p.x << " " << p.y << " " << p.z
+                << "\nrotation " << 360.0 * u(rng) << " " << 360.0 * u(rng) << " " << 360.0 * u(rng)
+                << "\nsize " << 0.4 + 0.8 * u(rng) << " " << 0.4 + 0.8 * u(rng) << " " << 0.4 + 0.8 * u(rng) << "\n";
+        } else {
+            // 随机朝向的正方形：两条正交边 a、b
+            auto dir = [&] {
+                double z = 2.0 * u(rng) - 1.0, phi = 2.0 * M_PI * u(rng), r = std::sqrt(1.0 - z * z);
+                return Vector3(r * std::cos(phi), r * std::sin(phi), z);
+            };
+            Vector3 a = dir();
+            Vector3 b = a.cross(dir()).normalized();
+            a = b.cross(a).normalized();
+            double s = 0.4 + 0.6 * u(rng);
+            const Vector3 c[4] = {p - a * s - b * s, p + a * s - b * s, p + a * s + b * s, p - a * s + b * s};
+            out << "Plane Quad_" << i << "\n";
+            for (int k = 0; k < 4; k++)
+                out << "corner" << k + 1 << " " << c[k].x << " " << c[k].y << " " << c[k].z << "\n";
+        }
+        write_material(out, rng, opt);
+        out << "end\n\n";
+    }
+    return out.good();
+}
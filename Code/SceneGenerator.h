@@ -0,0 +1,28 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_SCENEGENERATOR_H
+#define GRAPHIC_CW_SCENEGENERATOR_H
+#pragma once
+#include <string>
+
+// 程序化场景参数：objects 个物体按形状权重随机取球 / 长方体 / 四边形，散布在边长随物体数立方根增长的区域内，
+// 物体的平均间距不随数量变化；另加一块地板。纹理取自 Textures 目录中的自带纹理
+struct SceneGenOptions {
+    int objects = 1000;
+    double sphere_weight = 0.5;
+    double cube_weight = 0.35;
+    double plane_weight = 0.15;
+    double textured_fraction = 0.3;   // 使用纹理的物体比例
+    double reflective_fraction = 0.3; // 反射材质比例（其余为漫反射）
+    double refractive_fraction = 0.1; // 折射材质比例
+    int lights = 1;                   // 面光源数，强度之和固定
+    int res_x = 320, res_y = 180;
+    unsigned seed = 1;
+};
+
+// 按 load_scene_txt 的文本格式写出场景；无法写入时输出错误并返回 false
+bool write_generated_scene(const std::string &path, const SceneGenOptions &opt);
+
+#endif //GRAPHIC_CW_SCENEGENERATOR_H
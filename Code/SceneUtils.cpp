@@ -4,12 +4,13 @@
 #include "SceneUtils.h"
 #include "BVH.h"
 
-// 普通遍历版本
-bool intersect_scene(const Ray &ray, const Scene &scene, Hit &hit) {
+// 普通遍历版本（单 / 双精度共用）
+template <typename T>
+static bool intersect_all(const RayT<T> &ray, const Scene &scene, HitT<T> &hit) {
     bool any_hit = false;
     for (const auto &obj : scene.objects) {
-        Hit temp_hit;
-        if (obj->intersect(ray, temp_hit)) {
+        HitT<T> temp_hit;
+        if (obj->intersect_at_time(ray, temp_hit)) {
             if (temp_hit.t < hit.t) {
                 hit = temp_hit;
                 any_hit = true;
@@ -19,6 +20,14 @@ bool intersect_scene(const Ray &ray, const Scene &scene, Hit &hit) {
     return any_hit;
 }
 
+bool intersect_scene(const Ray &ray, const Scene &scene, Hit &hit) {
+    return intersect_all(ray, scene, hit);
+}
+
+bool intersect_scene(const Rayf &ray, const Scene &scene, Hitf &hit) {
+    return intersect_all(ray, scene, hit);
+}
+
 // BVH 加速版本
 bool intersect_scene(const Ray &ray, const BVH &bvh, const Scene &scene, Hit &hit) {
     return bvh.intersect(ray, hit, scene);
@@ -10,5 +10,7 @@
 #include "Shape.h"
 
 bool intersect_scene(const Ray &ray, const Scene &scene, Hit &hit);
+// 单精度版本：图元在 float 中求交
+bool intersect_scene(const Rayf &ray, const Scene &scene, Hitf &hit);
 
 #endif //GRAPHIC_CW_SCENEUTILS_H
\ No newline at end of file
@@ -0,0 +1,324 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+#include "SceneWatch.h"
+#include "Renderer.h"
+#include "MemoryStats.h"
+#include "Timeline.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+// 场景文件按块切分：键为块的首行（"Sphere Ball1"），值为整块文本；Background / AmbientLight 为单行块
+static std::map<std::string, std::string> scene_blocks(const std::string &path) {
+    auto strip = [](const std::string &s) {
+        size_t b = s.find_first_not_of(" \t\r\n"), e = s.find_last_not_of(" \t\r\n");
+        return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+    };
+    std::ifstream in(path);
+    std::map<std::string, std::string> blocks;
+    std::string line;
+    while (std::getline(in, line)) {
+        const std::string head = strip(line);
+        if (head.empty()) continue;
+        std::string body = head + "\n";
+        if (head.rfind("Background", 0) != 0 && head.rfind("AmbientLight", 0) != 0) {
+            while (std::getline(in, line) && (line = strip(line)) != "end") body += line + "\n";
+        }
+        std::string key = head;
+        for (int n = 2; blocks.count(key); n++) key = head + " #" + std::to_string(n);
+        blocks[key] = body;
+    }
+    return blocks;
+}
+
+// 新旧场景按对象名字比较的结果
+struct SceneDiff {
+    std::vector<std::string> changed; // 参数、材质或纹理改变的对象
+    std::vector<int> moved;           // 包围盒改变的对象（新场景下标），只有它们需要更新 BVH
+    int added = 0, removed = 0;
+    bool same_objects = true;         // 对象名字和顺序不变，BVH 拓扑可以保留
+    bool camera = false, lights = false, globals = false;
+};
+
+// reused：从旧场景直接共享的纹理，其余纹理是新加载的（新引用或文件已改变）
+static SceneDiff diff_scenes(const Scene &old_scene, const Scene &new_scene,
+                             const std::map<std::string, std::string> &old_blocks,
+                             const std::map<std::string, std::string> &new_blocks,
+                             const std::set<const Image *> &reused, double shutter) {
+    SceneDiff diff;
+    std::map<std::string, int> old_index;
+    for (int i = 0; i < (int)old_scene.objects.size(); i++) old_index[old_scene.objects[i]->name] = i;
+    std::set<std::string> new_names;
+    for (const auto &obj : new_scene.objects) new_names.insert(obj->name);
+
+    // 改变的块按类型归类；名字不是对象的块（Instance、原型）影响没有独立块的对象（实例集合）
+    std::set<std::string> changed_blocks;
+    bool other_changed = false;
+    auto classify = [&](const std::string &key) {
+        std::istringstream iss(key);
+        std::string token, name;
+        iss >> token >> name;
+        if (token == "Camera") diff.camera = true;
+        else if (token == "PointLight") diff.lights = true;
+        else if (token == "Background" || token == "AmbientLight" || token == "Scene") diff.globals = true;
+        else if (new_names.count(name) || old_index.count(name)) changed_blocks.insert(name);
+        else other_changed = true;
+    };
+    for (const auto &[key, body] : new_blocks) {
+        auto it = old_blocks.find(key);
+        if (it == old_blocks.end() || it->second != body) classify(key);
+    }
+    for (const auto &[key, body] : old_blocks)
+        if (!new_blocks.count(key)) classify(key);
+
+    std::set<std::string> block_names;
+    for (const auto &[key, body] : new_blocks) {
+        std::istringstream iss(key);
+        std::string token, name;
+        iss >> token >> name;
+        block_names.insert(name);
+    }
+    bool new_textures = false;
+    for (const auto &tex : new_scene.textures) new_textures |= !reused.count(tex.get());
+
+    diff.same_objects = old_scene.objects.size() == new_scene.objects.size();
+    for (int i = 0; i < (int)new_scene.objects.size(); i++) {
+        const Shape &obj = *new_scene.objects[i];
+        auto it = old_index.find(obj.name);
+        if (it == old_index.end()) {
+            diff.added++;
+            diff.same_objects = false;
+            continue;
+        }
+        if (it->second != i) diff.same_objects = false;
+        const Shape &old_obj = *old_scene.objects[it->second];
+        bool changed = changed_blocks.count(obj.name) > 0 ||
+                       (obj.texture_image && !reused.count(obj.texture_image.get())) ||
+                       (!block_names.count(obj.name) && (other_changed || new_textures));
+        // 几何比较包围盒（快门开启和关闭时刻），网格文件改变等不经过块文本的修改也能发现
+        for (double time : {0.0, shutter}) {
+            AABB a, b;
+            old_obj.bounds_at_time(time, a.bmin, a.bmax);
+            obj.bounds_at_time(time, b.bmin, b.bmax);
+            if (a.bmin.x != b.bmin.x || a.bmin.y != b.bmin.y || a.bmin.z != b.bmin.z || a.bmax.x != b.bmax.x ||
+                a.bmax.y != b.bmax.y || a.bmax.z != b.bmax.z) {
+                diff.moved.push_back(i);
+                changed = true;
+                break;
+            }
+        }
+        if (changed) diff.changed.push_back(obj.name);
+    }
+    for (const auto &obj : old_scene.objects) diff.removed += !new_names.count(obj->name);
+    if (diff.removed > 0) diff.same_objects = false;
+    return diff;
+}
+
+static std::map<std::string, std::filesystem::file_time_type> file_times(const std::vector<std::string> &paths) {
+    std::map<std::string, std::filesystem::file_time_type> times;
+    for (const auto &p : paths) {
+        std::error_code ec;
+        auto t = std::filesystem::last_write_time(p, ec);
+        if (!ec) times[p] = t;
+    }
+    return times;
+}
+
+static std::vector<std::string> scene_dependencies(const std::string &scene_path, const Scene &scene) {
+    std::vector<std::string> deps{scene_path};
+    deps.insert(deps.end(), scene.texture_paths.begin(), scene.texture_paths.end());
+    deps.insert(deps.end(), scene.mesh_paths.begin(), scene.mesh_paths.end());
+    return deps;
+}
+
+// Ctrl-C：置位后监视线程和渲染循环退出，run_watch 正常返回（时间线和内存报告照常写出）
+static std::atomic<bool> g_watch_stop{false};
+
+static void watch_sigint(int) {
+    g_watch_stop = true;
+    g_render_cancel = true;
+}
+
+void run_watch(const std::string &scene_path, Scene &scene, BVH &bvh, Accelerator &accel, LightTree &light_tree,
+               Camera &cam, int &pixel_samples, bool sampled, const std::function<void(Image &)> &render_frame,
+               const std::string &output_filename) {
+    const int target = sampled ? std::max(1, pixel_samples) : 1;
+    if (sampled) pixel_samples = 1;
+
+    std::mutex deps_mutex;
+    std::vector<std::string> deps = scene_dependencies(scene_path, scene);
+    std::map<std::string, std::filesystem::file_time_type> dep_times = file_times(deps);
+    std::map<std::string, std::string> blocks = scene_blocks(scene_path);
+    std::atomic<bool> dirty{false};
+    std::atomic<int64_t> changed_at{0};
+    auto now_ns = []() {
+        return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    g_watch_stop = false;
+    std::signal(SIGINT, watch_sigint);
+    std::thread watcher([&]() {
+        std::map<std::string, std::filesystem::file_time_type> seen;
+        while (!g_watch_stop) {
+            std::vector<std::string> paths;
+            {
+                std::lock_guard<std::mutex> lock(deps_mutex);
+                paths = deps;
+            }
+            bool changed = false;
+            for (const auto &[path, time] : file_times(paths)) {
+                auto it = seen.find(path);
+                if (it == seen.end()) seen[path] = time;
+                else if (it->second != time) {
+                    it->second = time;
+                    changed = true;
+                }
+            }
+            if (changed) {
+                // 先中止渲染再标记：主循环清除 dirty 后才清除 g_render_cancel
+                changed_at = now_ns();
+                g_render_cancel = true;
+                dirty = true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    });
+
+    std::cout << "\n=== Watching " << scene_path << " (" << deps.size() - 1 << " textures / meshes); progressive "
+         << target << (sampled ? " spp" : " pass") << ", Ctrl-C to stop ===" << std::endl;
+    // 累加缓冲随分辨率变化，按差值登记到 RENDER_BUFFERS
+    std::vector<Vector3> accum;
+    long long accum_bytes = 0;
+    auto mem_set_accum = [&](size_t bytes) {
+        mem_add(MemTag::RENDER_BUFFERS, (long long)bytes - accum_bytes);
+        accum_bytes = (long long)bytes;
+    };
+    int passes = 0;
+    int64_t restart_from = 0; // 最近一次修改的时间，第一遍开始时打印重启延迟
+    std::future<void> pending_write;
+    while (!g_watch_stop) {
+        if (dirty.exchange(false)) {
+            g_render_cancel = false;
+            TIMELINE_SCOPE("watch.reload");
+            auto t0 = std::chrono::high_resolution_clock::now();
+            // 文件未改变的纹理和网格直接共享
+            std::map<std::string, std::filesystem::file_time_type> times = file_times(scene_dependencies(scene_path, scene));
+            Scene reuse;
+            std::set<const Image *> reused;
+            for (size_t i = 0; i < scene.textures.size(); i++) {
+                if (times[scene.texture_paths[i]] != dep_times[scene.texture_paths[i]]) continue;
+                reuse.textures.push_back(scene.textures[i]);
+                reuse.texture_paths.push_back(scene.texture_paths[i]);
+                reused.insert(scene.textures[i].get());
+            }
+            for (size_t i = 0; i < scene.meshes.size(); i++) {
+                if (times[scene.mesh_paths[i]] != dep_times[scene.mesh_paths[i]]) continue;
+                reuse.meshes.push_back(scene.meshes[i]);
+                reuse.mesh_paths.push_back(scene.mesh_paths[i]);
+            }
+            Scene next;
+            std::map<std::string, std::string> next_blocks;
+            try {
+                next = load_scene_txt(scene_path, &reuse);
+                next_blocks = scene_blocks(scene_path);
+                if (!next.camera) throw std::runtime_error("no camera");
+            } catch (const std::exception &e) {
+                // 编辑器可能正在写文件；保留当前场景，等下一次修改
+                std::cerr << "[Watch] reload failed (" << e.what() << "), keeping the previous scene" << std::endl;
+                continue;
+            }
+            auto t1 = std::chrono::high_resolution_clock::now();
+
+            SceneDiff diff = diff_scenes(scene, next, blocks, next_blocks, reused, bvh.shutter_time);
+            const bool shutter_changed = BVH::motion_shutter(next) != bvh.shutter_time;
+            scene = std::move(next);
+            blocks = std::move(next_blocks);
+            const char *accel_action = "none";
+            if (!diff.same_objects || shutter_changed) {
+                accel.build(scene);
+                accel_action = "rebuild";
+            } else if (!diff.moved.empty()) {
+                accel_action = accel.update_objects(scene, diff.moved);
+            }
+            if (g_light_tree && diff.lights) light_tree.build(scene.lights);
+            cam = *scene.camera;
+            cam.compute_basis();
+            cam.compute_lens_radius();
+            mem_account_scene(scene);
+            mem_set(MemTag::BVH, bvh.memory_bytes());
+            {
+                std::lock_guard<std::mutex> lock(deps_mutex);
+                deps = scene_dependencies(scene_path, scene);
+            }
+            dep_times = file_times(scene_dependencies(scene_path, scene));
+            auto t2 = std::chrono::high_resolution_clock::now();
+
+            std::cout << "[Watch] reload: " << diff.changed.size() << " changed";
+            for (size_t i = 0; i < diff.changed.size() && i < 5; i++) std::cout << (i ? ", " : " (") << diff.changed[i];
+            std::cout << (diff.changed.size() > 5 ? ", ..." : "") << (diff.changed.empty() ? "" : ")") << ", " << diff.added
+                 << " added, " << diff.removed << " removed" << (diff.camera ? ", camera" : "")
+                 << (diff.lights ? ", lights" : "") << (diff.globals ? ", globals" : "") << "; parse "
+                 << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, accel " << accel_action << " ("
+                 << diff.moved.size() << " moved) " << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms"
+                 << std::endl;
+            passes = 0;
+            restart_from = changed_at;
+        }
+        if (passes >= target) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        if (restart_from != 0) {
+            std::cout << "[Watch] re-render started " << (now_ns() - restart_from) * 1e-6 << " ms after the change" << std::endl;
+            restart_from = 0;
+        }
+
+        Image pass(cam.res_x, cam.res_y);
+        MemScope pass_mem(MemTag::RENDER_BUFFERS, pass.memory_bytes());
+        auto t0 = std::chrono::high_resolution_clock::now();
+        render_frame(pass);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        if (g_render_cancel) continue; // 场景已改变，丢弃这一遍
+
+        if (passes == 0) {
+            accum.assign(pass.pixels.size(), Vector3(0, 0, 0));
+            mem_set_accum(accum.capacity() * sizeof(Vector3));
+        }
+        auto img = std::make_shared<Image>(cam.res_x, cam.res_y);
+        const long long frame_bytes = (long long)img->memory_bytes();
+        mem_add(MemTag::FRAMEBUFFER, frame_bytes);
+        passes++;
+        for (size_t i = 0; i < accum.size(); i++) {
+            accum[i] += Vector3(pass.pixels[i].r, pass.pixels[i].g, pass.pixels[i].b);
+            const Vector3 c = accum[i] * (1.0 / passes);
+            img->pixels[i] = Color(c.x, c.y, c.z);
+        }
+        if (pending_write.valid()) pending_write.get();
+        pending_write = std::async(std::launch::async, [img, output_filename, frame_bytes]() {
+            TIMELINE_SCOPE("image.write");
+            img->write_ppm(output_filename);
+            mem_add(MemTag::FRAMEBUFFER, -frame_bytes);
+        });
+        std::cout << "[Watch] pass " << passes << "/" << target << " " << std::chrono::duration<double, std::milli>(t1 - t0).count()
+             << " ms -> " << output_filename << std::endl;
+    }
+
+    watcher.join();
+    if (pending_write.valid()) pending_write.get();
+    mem_set_accum(0);
+    std::signal(SIGINT, SIG_DFL);
+    g_render_cancel = false;
+    std::cout << "[Watch] stopped" << std::endl;
+}
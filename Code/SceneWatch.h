@@ -0,0 +1,26 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_SCENEWATCH_H
+#define GRAPHIC_CW_SCENEWATCH_H
+#pragma once
+#include "Scene.h"
+#include "BVH.h"
+#include "Accelerator.h"
+#include "LightTree.h"
+#include "camera.h"
+#include "Image.h"
+#include <functional>
+#include <string>
+
+// --watch：渐进渲染（每遍 1 个采样累加，达到 pixel_samples 后停止，非采样模式一遍即完成），每遍结束写出当前结果。
+// 后台线程每 10 ms 检查场景文件及其纹理、网格文件的修改时间，改变时中止正在进行的一遍（各渲染循环逐行检查
+// g_render_cancel），重新解析场景（未改变的纹理和网格直接共享），按对象名字与当前场景比较：只有包围盒改变的
+// 对象更新 BVH（refit 路径 / 局部重建），对象增删时完整重建；随后从第一遍重新开始累加。
+// render_frame 按引用捕获 scene / cam / pixel_samples，在此处原地替换。Ctrl-C 中止当前一遍，等待最后一次写出后返回
+void run_watch(const std::string &scene_path, Scene &scene, BVH &bvh, Accelerator &accel, LightTree &light_tree,
+               Camera &cam, int &pixel_samples, bool sampled, const std::function<void(Image &)> &render_frame,
+               const std::string &output_filename);
+
+#endif //GRAPHIC_CW_SCENEWATCH_H
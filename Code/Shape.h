@@ -7,8 +7,12 @@
 #pragma once
 #include "Ray.h"
 #include "Vector3.h"
+#include "Matrix3.h"
 #include <limits>
 #include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
 
 struct Material {
     double reflectivity = 0.0;
@@ -18,20 +22,41 @@ struct Material {
     double roughness = 0.0; // 新增：0为镜面，1 为粗糙
 };
 
-struct Hit {
+// 交点记录：几何量（t / pos / normal / uv）按求交精度模板化，着色属性保持不变
+template <typename T>
+struct HitT {
     bool hit = false;
-    double t = std::numeric_limits<double>::infinity();
-    Vector3 pos;
-    Vector3 normal;
+    T t = std::numeric_limits<T>::infinity();
+    Vec3<T> pos;
+    Vec3<T> normal;
     Vector3 color; // simple diffuse albedo
     Material material;
     //Vector2 uv;
     // 纹理坐标（0..1）
-    double u = 0.0;
-    double v = 0.0;
+    T u = 0.0;
+    T v = 0.0;
+    // 光线时间（阴影、反射等次级光线沿用）
+    double time = 0.0;
 
     // 指向纹理图像（可为空）
     std::shared_ptr<class Image> texture;
+
+    HitT() = default;
+    // 不同精度之间显式转换
+    template <typename U>
+    explicit HitT(const HitT<U> &h)
+        : hit(h.hit), t(static_cast<T>(h.t)), pos(h.pos), normal(h.normal), color(h.color), material(h.material),
+          u(static_cast<T>(h.u)), v(static_cast<T>(h.v)), time(h.time), texture(h.texture) {}
+};
+
+using Hit = HitT<double>;
+using Hitf = HitT<float>;
+
+// 关键帧：相对静止姿态的平移和绕物体中心的旋转（欧拉角，度）
+struct Keyframe {
+    double frame = 0.0;
+    Vector3 translation;
+    Vector3 rotation;
 };
 
 class Shape {
@@ -44,12 +69,84 @@ public:
     std::string texture_file;
     // 纹理图像
     std::shared_ptr<Image> texture_image; // in Shape
+    // 关键帧（按 frame 升序），为空表示静止
+    std::vector<Keyframe> keyframes;
+    // 快门期间的线性速度（米/秒），用于物体运动模糊；物体在 time 时刻位于当前几何 + velocity * time
+    Vector3 velocity = {0, 0, 0};
 
     virtual ~Shape() {}
     // returns true if hit and fills hit data (with distance measured along ray)
     virtual bool intersect(const Ray &r, Hit &h) const = 0;
+    // 单精度求交；默认转换为双精度求交，常用图元（Sphere / Cube / Plane）直接在 float 中计算
+    virtual bool intersect(const Rayf &r, Hitf &h) const {
+        Hit hd;
+        hd.t = h.t;
+        if (!intersect(Ray(r), hd)) return false;
+        h = Hitf(hd);
+        return true;
+    }
     // bounding box for BVH:
     virtual void bounds(Vector3 &bmin, Vector3 &bmax) const = 0;
+    // 几何在 [box_min, box_max] 内部分的包围盒（SBVH 空间分割时裁剪引用），与 box 不相交时返回 false。
+    // 默认取包围盒与 box 的交集；平面图形可以裁剪得更紧
+    virtual bool clip_bounds(const Vector3 &box_min, const Vector3 &box_max, Vector3 &bmin, Vector3 &bmax) const {
+        bounds(bmin, bmax);
+        bmin = Vector3(std::max(bmin.x, box_min.x), std::max(bmin.y, box_min.y), std::max(bmin.z, box_min.z));
+        bmax = Vector3(std::min(bmax.x, box_max.x), std::min(bmax.y, box_max.y), std::min(bmax.z, box_max.z));
+        return bmin.x <= bmax.x && bmin.y <= bmax.y && bmin.z <= bmax.z;
+    }
+    // 有向包围盒（中心、object->world 旋转、半尺寸），用于 BVH 叶子中的提前剔除；没有时返回 false
+    virtual bool oriented_bounds(Vector3 & /*center*/, Matrix3 & /*rot*/, Vector3 & /*half*/) const { return false; }
+
+    // 对象本身及其名字、关键帧占用的字节数（纹理和网格几何是共享的，另行统计）；子类按自身大小覆盖
+    virtual size_t memory_bytes() const { return sizeof(Shape) + heap_bytes(); }
+    size_t heap_bytes() const {
+        return name.capacity() + texture_file.capacity() + keyframes.capacity() * sizeof(Keyframe);
+    }
+
+    bool is_moving() const { return velocity.x != 0.0 || velocity.y != 0.0 || velocity.z != 0.0; }
+
+    // 按光线时间求交：把光线反向平移到快门开启时刻的物体空间，再把交点移回
+    template <typename T>
+    bool intersect_at_time(const RayT<T> &r, HitT<T> &h) const {
+        if (r.time == 0.0 || !is_moving()) {
+            if (!intersect(r, h)) return false;
+            h.time = r.time;
+            return true;
+        }
+        Vec3<T> offset(velocity * r.time);
+        if (!intersect(RayT<T>(r.origin - offset, r.dir, r.time), h)) return false;
+        h.pos = h.pos + offset;
+        h.time = r.time;
+        return true;
+    }
+
+    // time 时刻的包围盒（纯平移，包围盒随之平移）
+    void bounds_at_time(double time, Vector3 &bmin, Vector3 &bmax) const {
+        bounds(bmin, bmax);
+        if (time == 0.0 || !is_moving()) return;
+        bmin = bmin + velocity * time;
+        bmax = bmax + velocity * time;
+    }
+
+    // 记录当前几何为静止姿态（场景加载完成后调用）
+    virtual void store_rest_pose() {}
+    // 以静止姿态为基准应用平移和旋转（度）
+    virtual void set_pose(const Vector3 & /*translation*/, const Vector3 & /*rotation_deg*/) {}
+
+    // 在关键帧之间线性插值并移动到第 frame 帧，帧号超出范围时保持首/尾关键帧
+    void animate(double frame) {
+        if (keyframes.empty()) return;
+        const Keyframe *a = &keyframes.front(), *b = a;
+        for (size_t i = 0; i < keyframes.size(); i++) {
+            b = &keyframes[i];
+            if (b->frame >= frame) break;
+            a = b;
+        }
+        double t = (b->frame > a->frame) ? std::clamp((frame - a->frame) / (b->frame - a->frame), 0.0, 1.0) : 0.0;
+        set_pose(a->translation * (1 - t) + b->translation * t,
+                 a->rotation * (1 - t) + b->rotation * t);
+    }
 };
 
 #endif //GRAPHIC_SHAPE_H
\ No newline at end of file
@@ -1,39 +1,59 @@
 #include "Sphere.h"
+#include "RenderStats.h"
 #include <cmath>
 
-bool Sphere::intersect(const Ray &ray, Hit &hit) const {
-    // ray: o + t d
-    Vector3 L = ray.origin - center;
-    double a = ray.dir.dot(ray.dir);
-    double b = 2.0 * ray.dir.dot(L);
-    double c = L.dot(L) - radius*radius;
-    double disc = b*b - 4*a*c;
+// 单 / 双精度共用的求交实现
+template <typename T>
+static bool intersect_sphere(const Sphere &sphere, const RayT<T> &ray, HitT<T> &hit) {
+    RT_STAT_PRIM(PrimKind::SPHERE);
+    // ray: o + t d。a t^2 + 2 b t + c = 0，判别式按 r^2 - |f - (f·d / d·d) d|^2 计算
+    // （Ray Tracing Gems 第 7 章），避免 b^2 - ac 在远处小球上的相消误差；单精度下尤其重要
+    const Vec3<T> center(sphere.center);
+    const T radius = static_cast<T>(sphere.radius);
+    const Vec3<T> f = ray.origin - center;
+    const T a = ray.dir.dot(ray.dir);
+    const T b = f.dot(ray.dir);
+    const Vec3<T> l = f - ray.dir * (b / a);
+    const T disc = radius * radius - l.dot(l);
     if (disc < 0) return false;
-    double sq = std::sqrt(disc);
-    double t0 = (-b - sq) / (2*a);
-    double t1 = (-b + sq) / (2*a);
-    double t = t0;
-    if (t < 1e-6) t = t1;
-    if (t < 1e-6) return false;
+    const T c = f.dot(f) - radius * radius;
+    const T q = -(b + std::copysign(std::sqrt(a * disc), b));
+    T t0 = (q != 0) ? c / q : -b / a;
+    T t1 = q / a;
+    if (t0 > t1) std::swap(t0, t1);
+    // 次级光线起点已偏移到表面之外，不再需要 t 的下限
+    T t = t0;
+    if (t <= 0) t = t1;
+    if (t <= 0) return false;
     if (t >= hit.t) return false;
     hit.hit = true;
     hit.t = t;
-    hit.pos = ray.origin + ray.dir * t;
-    hit.normal = (hit.pos - center).normalized();
-    hit.color = this->color;
-    hit.material = this->material;
+    // 交点投影回球面：误差只与坐标量级有关，偏移次级光线起点时才有可靠的界
+    const Vec3<T> d = ray.origin + ray.dir * t - center;
+    hit.normal = d.normalized();
+    hit.pos = center + hit.normal * radius;
+    hit.color = sphere.color;
+    hit.material = sphere.material;
 
     // 计算球面 UV（基于归一化法线 n）
-    Vector3 n = hit.normal; // 已归一化
-    double u = 0.5 + std::atan2(n.z, n.x) / (2.0 * M_PI);
-    double v = 0.5 - std::asin(n.y) / M_PI;
+    Vec3<T> n = hit.normal; // 已归一化
+    T u = T(0.5) + std::atan2(n.z, n.x) / T(2.0 * M_PI);
+    T v = T(0.5) - std::asin(std::clamp(n.y, T(-1), T(1))) / T(M_PI);
     hit.u = u;
     hit.v = v;
-    hit.texture = this->texture_image; // 可能为空
+    hit.texture = sphere.texture_image; // 可能为空
 
     return true;
 }
 
+bool Sphere::intersect(const Ray &ray, Hit &hit) const {
+    return intersect_sphere(*this, ray, hit);
+}
+
+bool Sphere::intersect(const Rayf &ray, Hitf &hit) const {
+    return intersect_sphere(*this, ray, hit);
+}
+
 void Sphere::bounds(Vector3 &bmin, Vector3 &bmax) const {
     bmin = { center.x - radius, center.y - radius, center.z - radius };
     bmax = { center.x + radius, center.y + radius, center.z + radius };
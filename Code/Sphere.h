@@ -11,9 +11,16 @@ class Sphere : public Shape {
 public:
     Vector3 center;
     double radius;
-    Sphere(const Vector3 &c={0,0,0}, double r=1.0):center(c),radius(r){}
+    Vector3 rest_center; // 动画的静止位置
+    Sphere(const Vector3 &c={0,0,0}, double r=1.0):center(c),radius(r),rest_center(c){}
     virtual bool intersect(const Ray &r, Hit &h) const override;
+    virtual bool intersect(const Rayf &r, Hitf &h) const override;
     virtual void bounds(Vector3 &bmin, Vector3 &bmax) const override;
+    virtual size_t memory_bytes() const override { return sizeof(Sphere) + heap_bytes(); }
+    virtual void store_rest_pose() override { rest_center = center; }
+    virtual void set_pose(const Vector3 &translation, const Vector3 & /*rotation_deg*/) override {
+        center = rest_center + translation; // 球体旋转不改变几何
+    }
 };
 
 #endif //GRAPHIC_SPHERE_H
\ No newline at end of file
@@ -0,0 +1,80 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+#include "Timeline.h"
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> g_timeline_enabled{false};
+
+namespace {
+// 每线程 32768 个事件（1 MiB），逐行渲染 1080p 的数十帧仍不会覆盖
+constexpr size_t RING_CAPACITY = 1 << 15;
+
+struct ThreadRing {
+    int tid = 0;
+    std::unique_ptr<TimelineEvent[]> events{new TimelineEvent[RING_CAPACITY]};
+    std::atomic<uint64_t> count{0}; // 累计写入数；只有所属线程写，导出时以 acquire 读取
+};
+
+std::deque<ThreadRing> g_rings;
+std::mutex g_rings_mutex;
+std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+ThreadRing *register_thread() {
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    ThreadRing &ring = g_rings.emplace_back();
+    ring.tid = (int)g_rings.size() - 1;
+    return &ring;
+}
+} // namespace
+
+void timeline_enable() {
+    g_epoch = std::chrono::steady_clock::now();
+    g_timeline_enabled.store(true, std::memory_order_relaxed);
+}
+
+int64_t timeline_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+void timeline_record(const char *name, int64_t start_ns, int64_t dur_ns, int arg) {
+    thread_local ThreadRing *ring = register_thread();
+    const uint64_t n = ring->count.load(std::memory_order_relaxed);
+    ring->events[n % RING_CAPACITY] = {name, start_ns, dur_ns, arg};
+    ring->count.store(n + 1, std::memory_order_release);
+}
+
+// 完成事件（ph = "X"）以微秒为单位；第一个注册的线程（执行 main 的线程）命名为 main
+bool timeline_write_chrome(const std::string &path) {
+    FILE *f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    uint64_t dropped = 0;
+    for (const ThreadRing &ring : g_rings) {
+        std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                     first ? "" : ",\n", ring.tid, ring.tid == 0 ? "main" : "worker", ring.tid);
+        first = false;
+        const uint64_t count = ring.count.load(std::memory_order_acquire);
+        const uint64_t begin = count > RING_CAPACITY ? count - RING_CAPACITY : 0;
+        dropped += begin;
+        for (uint64_t i = begin; i < count; i++) {
+            const TimelineEvent &e = ring.events[i % RING_CAPACITY];
+            std::fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"render\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                         e.name, ring.tid, e.start_ns * 1e-3, e.dur_ns * 1e-3);
+            if (e.arg >= 0) std::fprintf(f, ",\"args\":{\"item\":%d}", e.arg);
+            std::fprintf(f, "}");
+        }
+    }
+    std::fprintf(f, "\n]}\n");
+    std::fclose(f);
+    if (dropped > 0) std::fprintf(stderr, "Warning: timeline ring buffers overflowed, %llu oldest events dropped\n",
+                                  (unsigned long long)dropped);
+    return true;
+}
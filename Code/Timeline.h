@@ -0,0 +1,52 @@
+//
+// Created by 31934 on 2025/12/15.
+//
+
+#ifndef GRAPHIC_CW_TIMELINE_H
+#define GRAPHIC_CW_TIMELINE_H
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// 时间线记录（--trace FILE）：渲染各阶段（加载、纹理解码、BVH 构建、逐行渲染、写图像）的起止时间，
+// 导出为 Chrome trace-event JSON（chrome://tracing 或 ui.perfetto.dev 打开），用于查看负载不均、空闲线程和串行阶段。
+// 每个线程写自己的环形缓冲区（单写者，无锁；只有线程第一次记录时注册加锁），缓冲区满后覆盖最旧的事件。
+// 未开启时每个作用域只有一次原子读
+struct TimelineEvent {
+    const char *name;  // 必须是字符串字面量（只保存指针）
+    int64_t start_ns;  // 相对 timeline_enable 的时间
+    int64_t dur_ns;
+    int arg;           // 工作项编号（行号、帧号等），-1 表示无
+};
+
+extern std::atomic<bool> g_timeline_enabled;
+
+void timeline_enable();
+int64_t timeline_now_ns();
+void timeline_record(const char *name, int64_t start_ns, int64_t dur_ns, int arg);
+// 写出全部线程已记录的事件；返回 false 表示文件无法写入
+bool timeline_write_chrome(const std::string &path);
+
+class TimelineScope {
+public:
+    explicit TimelineScope(const char *name, int arg = -1)
+        : name_(g_timeline_enabled.load(std::memory_order_relaxed) ? name : nullptr), arg_(arg),
+          start_(name_ ? timeline_now_ns() : 0) {}
+    ~TimelineScope() {
+        if (name_) timeline_record(name_, start_, timeline_now_ns() - start_, arg_);
+    }
+    TimelineScope(const TimelineScope &) = delete;
+    TimelineScope &operator=(const TimelineScope &) = delete;
+
+private:
+    const char *name_;
+    int arg_;
+    int64_t start_;
+};
+
+#define TIMELINE_CONCAT_(a, b) a##b
+#define TIMELINE_CONCAT(a, b) TIMELINE_CONCAT_(a, b)
+#define TIMELINE_SCOPE(...) TimelineScope TIMELINE_CONCAT(timeline_scope_, __LINE__)(__VA_ARGS__)
+
+#endif //GRAPHIC_CW_TIMELINE_H
@@ -0,0 +1,131 @@
+//
+// Created by 31934 on 2025/12/14.
+//
+#include "UniformGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void UniformGrid::build(const Scene &scene) {
+    box = AABB();
+    res = {0, 0, 0};
+    cell_start.clear();
+    cell_prims.clear();
+
+    std::vector<AABB> bounds = static_object_bounds(scene);
+    if (bounds.empty()) return;
+    for (const auto &b : bounds) box.expand(b);
+
+    // 稍微扩大包围盒：地板等平面物体会让某一维厚度为 0
+    Vector3 ext = box.bmax - box.bmin;
+    double max_ext = std::max({ext.x, ext.y, ext.z});
+    Vector3 pad(max_ext * 1e-6 + 1e-9, max_ext * 1e-6 + 1e-9, max_ext * 1e-6 + 1e-9);
+    box.bmin = box.bmin - pad;
+    box.bmax = box.bmax + pad;
+    ext = box.bmax - box.bmin;
+
+    // 每轴格子数与边长成正比，总格子数约为 对象数 / DENSITY；很薄的维度只分一格
+    const double e[3] = {ext.x, ext.y, ext.z};
+    double volume = 1.0;
+    int dims = 0;
+    for (int a = 0; a < 3; a++) {
+        if (e[a] > max_ext * 1e-3) {
+            volume *= e[a];
+            dims++;
+        }
+    }
+    double k = std::pow(bounds.size() / DENSITY / volume, 1.0 / dims);
+    for (int a = 0; a < 3; a++) {
+        res[a] = e[a] > max_ext * 1e-3 ? std::clamp((int)std::ceil(e[a] * k), 1, MAX_RES) : 1;
+    }
+    cell_size = Vector3(ext.x / res[0], ext.y / res[1], ext.z / res[2]);
+
+    // 每个对象覆盖的格子范围
+    const double lo[3] = {box.bmin.x, box.bmin.y, box.bmin.z};
+    const double cs[3] = {cell_size.x, cell_size.y, cell_size.z};
+    std::vector<std::array<int, 6>> ranges(bounds.size());
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < (int)bounds.size(); i++) {
+        const double bmin[3] = {bounds[i].bmin.x, bounds[i].bmin.y, bounds[i].bmin.z};
+        const double bmax[3] = {bounds[i].bmax.x, bounds[i].bmax.y, bounds[i].bmax.z};
+        for (int a = 0; a < 3; a++) {
+            ranges[i][a] = std::clamp((int)((bmin[a] - lo[a]) / cs[a]), 0, res[a] - 1);
+            ranges[i][a + 3] = std::clamp((int)((bmax[a] - lo[a]) / cs[a]), 0, res[a] - 1);
+        }
+    }
+
+    // 计数 -> 前缀和 -> 填充（CSR）
+    const int cells = res[0] * res[1] * res[2];
+    cell_start.assign(cells + 1, 0);
+    for (const auto &r : ranges) {
+        for (int z = r[2]; z <= r[5]; z++)
+            for (int y = r[1]; y <= r[4]; y++)
+                for (int x = r[0]; x <= r[3]; x++) cell_start[cell_index(x, y, z) + 1]++;
+    }
+    for (int c = 0; c < cells; c++) cell_start[c + 1] += cell_start[c];
+    cell_prims.resize(cell_start[cells]);
+    std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+    for (int i = 0; i < (int)ranges.size(); i++) {
+        const auto &r = ranges[i];
+        for (int z = r[2]; z <= r[5]; z++)
+            for (int y = r[1]; y <= r[4]; y++)
+                for (int x = r[0]; x <= r[3]; x++) cell_prims[fill[cell_index(x, y, z)]++] = i;
+    }
+}
+
+bool UniformGrid::intersect(const Ray &ray, Hit &hit, const Scene &scene) const {
+    if (cell_start.empty()) return false;
+
+    const double t_min = 0.0; // 次级光线起点已偏移到表面之外（见 spawn_ray），与 BVH 相同从 0 开始
+    double t_enter;
+    if (!box.intersect(ray, t_min, hit.t, t_enter)) return false;
+
+    const double o[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+    const double d[3] = {ray.dir.x, ray.dir.y, ray.dir.z};
+    const double lo[3] = {box.bmin.x, box.bmin.y, box.bmin.z};
+    const double cs[3] = {cell_size.x, cell_size.y, cell_size.z};
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // 3D-DDA 初始化：进入点所在格子、各轴到下一个格子边界的距离和每跨一格的距离
+    int cell[3], step[3], stop[3];
+    double t_next[3], t_delta[3];
+    for (int a = 0; a < 3; a++) {
+        double p = o[a] + d[a] * t_enter;
+        cell[a] = std::clamp((int)((p - lo[a]) / cs[a]), 0, res[a] - 1);
+        if (d[a] > 0.0) {
+            step[a] = 1;
+            stop[a] = res[a];
+            t_next[a] = (lo[a] + (cell[a] + 1) * cs[a] - o[a]) / d[a];
+            t_delta[a] = cs[a] / d[a];
+        } else if (d[a] < 0.0) {
+            step[a] = -1;
+            stop[a] = -1;
+            t_next[a] = (lo[a] + cell[a] * cs[a] - o[a]) / d[a];
+            t_delta[a] = -cs[a] / d[a];
+        } else {
+            step[a] = 0;
+            stop[a] = -1;
+            t_next[a] = inf;
+            t_delta[a] = inf;
+        }
+    }
+
+    bool found = false;
+    while (true) {
+        const int c = cell_index(cell[0], cell[1], cell[2]);
+        for (int i = cell_start[c]; i < cell_start[c + 1]; i++) {
+            if (scene.objects[cell_prims[i]]->intersect_at_time(ray, hit)) found = true;
+        }
+
+        // 交点在当前格子之内即为最近交点；否则继续走向下一格
+        int a = (t_next[0] < t_next[1]) ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+        if (hit.t <= t_next[a]) return found;
+        cell[a] += step[a];
+        if (cell[a] == stop[a]) return found;
+        t_next[a] += t_delta[a];
+    }
+}
+
+size_t UniformGrid::memory_bytes() const {
+    return cell_start.capacity() * sizeof(int) + cell_prims.capacity() * sizeof(int);
+}
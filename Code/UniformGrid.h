@@ -0,0 +1,37 @@
+//
+// Created by 31934 on 2025/12/14.
+//
+
+#ifndef GRAPHIC_CW_UNIFORMGRID_H
+#define GRAPHIC_CW_UNIFORMGRID_H
+#pragma once
+#include "Accelerator.h"
+#include <array>
+#include <vector>
+
+// 均匀网格：场景包围盒等分为 res[0] x res[1] x res[2] 个格子，每个格子记录与之重叠的对象。
+// 遍历用 3D-DDA（Amanatides & Woo 1987）按光线经过的顺序逐格访问，格内找到的交点落在当前格子内即可停止。
+// 对象密度均匀的场景（例如密集的小球阵列）上格子几乎不空也不拥挤，遍历开销接近常数
+class UniformGrid : public Accelerator {
+public:
+    // 平均每个格子的对象数（决定分辨率）
+    static constexpr double DENSITY = 2.0;
+    static constexpr int MAX_RES = 256;
+
+    AABB box;
+    std::array<int, 3> res = {0, 0, 0};
+    Vector3 cell_size;
+    // CSR 布局：格子 c 的对象为 cell_prims[cell_start[c] .. cell_start[c+1])
+    std::vector<int> cell_start;
+    std::vector<int> cell_prims;
+
+    AcceleratorType type() const override { return AcceleratorType::GRID; }
+    void build(const Scene &scene) override;
+    bool intersect(const Ray &ray, Hit &hit, const Scene &scene) const override;
+    size_t memory_bytes() const override;
+
+private:
+    int cell_index(int x, int y, int z) const { return (z * res[1] + y) * res[0] + x; }
+};
+
+#endif //GRAPHIC_CW_UNIFORMGRID_H
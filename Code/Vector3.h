@@ -5,92 +5,106 @@
 #ifndef CWPROJECT_VEC3_H
 #define CWPROJECT_VEC3_H
 #pragma once
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
-struct Vector3 {
-    double x, y, z;
+// 三维向量，按标量类型模板化：Vector3（double）用于场景描述和着色，Vector3f（float）用于单精度求交路径
+template <typename T>
+struct Vec3 {
+    T x, y, z;
 
-    Vector3(double x_=0, double y_=0, double z_=0)
+    Vec3(T x_=0, T y_=0, T z_=0)
         : x(x_), y(y_), z(z_) {}
+    // 不同精度之间显式转换
+    template <typename U>
+    explicit Vec3(const Vec3<U> &v) : x(static_cast<T>(v.x)), y(static_cast<T>(v.y)), z(static_cast<T>(v.z)) {}
 
-    Vector3 operator+(const Vector3& b) const
+    Vec3 operator+(const Vec3& b) const
     {
         return {x + b.x, y + b.y, z + b.z};
     }
-    Vector3 operator-(const Vector3& b) const
+    Vec3 operator-(const Vec3& b) const
     {
         return {x - b.x, y - b.y, z - b.z};
     }
-    Vector3 operator*(double s) const
+    Vec3 operator*(T s) const
     {
         return {x * s, y * s, z * s};
     }
-    Vector3 operator/(double s) const
+    Vec3 operator/(T s) const
     {
         return {x / s, y / s, z / s};
     }
     // 标量与向量除法（友元函数）
-    friend Vector3 operator/(double s, const Vector3& v)
+    friend Vec3 operator/(T s, const Vec3& v)
     {
         return {s / v.x, s / v.y, s / v.z};
     }
-    Vector3& operator+=(const Vector3& b)
+    Vec3& operator+=(const Vec3& b)
     {
         x += b.x;
         y += b.y;
         z += b.z;
         return *this;
     }
-    Vector3 operator*(const Vector3 &b) const
+    Vec3 operator*(const Vec3 &b) const
     {
         return {x * b.x, y * b.y, z * b.z};
     }
     // 标量与向量乘法（友元函数）
-    friend Vector3 operator*(double s, const Vector3& v) {
+    friend Vec3 operator*(T s, const Vec3& v) {
         return {s * v.x, s * v.y, s * v.z};
     }
 
     // ✅ 一元负号运算符（允许 -light_dir）
-    Vector3 operator-() const
+    Vec3 operator-() const
     {
         return {-x, -y, -z};
     }
 
     // 向量与向量逐元素除法
-    Vector3 operator/(const Vector3& b) const {
+    Vec3 operator/(const Vec3& b) const {
         return {x / b.x, y / b.y, z / b.z};
     }
 
-    double dot(const Vector3& b) const
+    T dot(const Vec3& b) const
     {
         return x * b.x + y * b.y + z * b.z;
     }
-    Vector3 cross(const Vector3& b) const
+    Vec3 cross(const Vec3& b) const
     {
         return {y * b.z - z * b.y, z * b.x - x * b.z, x * b.y - y * b.x};
     }
 
-    double length() const
+    T length() const
     {
         return std::sqrt(x * x + y * y + z * z);
     }
 
-    Vector3 normalized() const {
-        double l = length();
-        if (l < 1e-12) return {0, 0, 0};
+    Vec3 normalized() const {
+        T l = length();
+        if (l < T(1e-12)) return {0, 0, 0};
         return {x / l, y / l, z / l};
     }
 };
 
-inline std::ostream& operator<<(std::ostream &os, const Vector3 &v) {
+using Vector3 = Vec3<double>;
+using Vector3f = Vec3<float>;
+
+template <typename T>
+inline std::ostream& operator<<(std::ostream &os, const Vec3<T> &v) {
     os << "(" << v.x << ", " << v.y << ", " << v.z << ")";
     return os;
 }
 
+// 颜色的亮度（Rec. 709 系数）
+inline double luminance(const Vector3 &c) { return 0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z; }
+
 // 向量逐元素最小值
-inline Vector3 min(const Vector3& a, const Vector3& b) {
-    return Vector3(
+template <typename T>
+inline Vec3<T> min(const Vec3<T>& a, const Vec3<T>& b) {
+    return Vec3<T>(
         std::min(a.x, b.x),
         std::min(a.y, b.y),
         std::min(a.z, b.z)
@@ -98,8 +112,9 @@ inline Vector3 min(const Vector3& a, const Vector3& b) {
 }
 
 // 向量逐元素最大值
-inline Vector3 max(const Vector3& a, const Vector3& b) {
-    return Vector3(
+template <typename T>
+inline Vec3<T> max(const Vec3<T>& a, const Vec3<T>& b) {
+    return Vec3<T>(
         std::max(a.x, b.x),
         std::max(a.y, b.y),
         std::max(a.z, b.z)
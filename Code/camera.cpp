@@ -126,7 +126,8 @@ Ray Camera::pixel_to_ray_with_effects(double px, double py, double time_offset,
         ray_origin = cam_pos;  // 使用运动模糊后的位置
     }
 
-    return Ray(ray_origin, ray_direction);
+    // 光线时间同时驱动物体运动模糊
+    return Ray(ray_origin, ray_direction, time_offset);
 }
 
 void Camera::compute_lens_radius() {
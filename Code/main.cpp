@@ -3,6 +3,7 @@
 #include "BVH.h"
 #include "Image.h"
 #include <iostream>
+#include <iomanip>
 #include <chrono>
 #include <filesystem>
 #include <cstdlib>
@@ -10,8 +11,33 @@
 #include <algorithm>
 #include <functional>
 #include <random>
+#include <future>
+#include <sstream>
+#include <atomic>
+#include <cstdio>
+#include <cctype>
+#include <fstream>
+#include <map>
 #include <omp.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 #include "SceneUtils.h"
+#include "SceneCache.h"
+#include "BVHReport.h"
+#include "Accelerator.h"
+#include "LightTree.h"
+#include "SceneGenerator.h"
+#include "RenderStats.h"
+#include "Timeline.h"
+#include "MemoryStats.h"
+#include "RenderRegion.h"
+#include "Renderer.h"
+#include "RenderServer.h"
+#include "SceneWatch.h"
 // 在 #include 部分添加
 #include <bemapiset.h>
 
@@ -25,6 +51,32 @@ namespace fs = std::filesystem;
 
 const int MAX_DEPTH = 5;
 
+// 求交精度：为 true 时场景求交走单精度路径（加速结构节点和常用图元在 float 中计算，着色仍用 double），
+// 次级光线起点也按 float 交点的误差偏移
+bool g_float_path = false;
+
+// 光源树：非空时 shade 按重要性为每个阴影样本选择一个光源（--light-tree），否则逐光源采样
+const LightTree *g_light_tree = nullptr;
+
+// 阴影光线使用的加速结构：为空时逐对象遍历（--no-bvh / --accel brute）
+const Accelerator *g_shadow_accel = nullptr;
+
+// 置位后各渲染循环跳过剩余的行，渲染函数尽快返回（--watch 在场景文件改变时中止当前的渐进遍）
+std::atomic<bool> g_render_cancel{false};
+
+// 光线计数（只在报告中开启）：相机 / 反射 / 折射光线与阴影光线
+static bool g_count_rays = false;
+static std::atomic<long long> g_trace_rays{0}, g_shadow_rays{0};
+
+// 次级光线：起点按求交精度偏移到 dir 所在一侧（见 Ray.h 的 spawn_ray），代替固定的 1e-4
+Ray spawn_secondary(const Hit &hit, const Vector3 &dir) {
+    if (g_float_path) {
+        Rayf r = spawn_ray(Vector3f(hit.pos), Vector3f(hit.normal), Vector3f(dir), hit.time);
+        return Ray(Vector3(r.origin), dir, hit.time);
+    }
+    return spawn_ray(hit.pos, hit.normal, dir, hit.time);
+}
+
 // ====================== 光照函数 ======================
 // 与你原来相同：shade 仅依赖 Hit 与 scene（不负责反射/折射）
 // Vector3 shade(const Hit &hit, const Scene &scene) {
@@ -72,113 +124,126 @@ const int MAX_DEPTH = 5;
 // }
 
 // 辅助函数：检测阴影
+// 求交前把 hit.t 设为 maxDistance，加速结构遍历时直接剔除光源之后的节点
 bool is_in_shadow(const Ray& ray, const Scene& scene, double maxDistance) {
+    if (g_float_path) {
+        if (g_count_rays) g_shadow_rays.fetch_add(1, std::memory_order_relaxed);
+        RT_STAT(shadow_rays);
+        Hitf hit;
+        hit.t = static_cast<float>(maxDistance);
+        Rayf rayf(ray);
+        bool occluded = (g_shadow_accel ? g_shadow_accel->intersect(rayf, hit, scene) : intersect_scene(rayf, scene, hit)) &&
+                        hit.t < maxDistance;
+        if (occluded) RT_STAT(shadow_occluded);
+        return occluded;
+    }
+    if (g_count_rays) g_shadow_rays.fetch_add(1, std::memory_order_relaxed);
+    RT_STAT(shadow_rays);
     Hit hit;
-    // 这里使用你已有的相交函数
-    return intersect_scene(ray, scene, hit) && hit.t < maxDistance;
+    hit.t = maxDistance;
+    bool occluded = (g_shadow_accel ? g_shadow_accel->intersect(ray, hit, scene) : intersect_scene(ray, scene, hit)) &&
+                    hit.t < maxDistance;
+    if (occluded) RT_STAT(shadow_occluded);
+    return occluded;
+}
+
+// 交点的漫反射颜色（有纹理时按 uv 采样）
+Vector3 surface_color(const Hit &hit) {
+    return hit.texture ? hit.texture->sample_uv(hit.u, hit.v) : hit.color;
+}
+
+// 光源上一点 lightSamplePos 对交点的直接光照（Blinn-Phong + 距离衰减，不含阴影）
+Vector3 direct_light(const Hit &hit, const Scene &scene, const Vector3 &base_color,
+                     const PointLight &light, const Vector3 &lightSamplePos) {
+    // 计算从交点指向光源的向量
+    Vector3 L = (lightSamplePos - hit.pos).normalized();
+    double distanceToLight = (lightSamplePos - hit.pos).length();
+
+    // 视角方向
+    Vector3 V = (scene.camera->position - hit.pos).normalized();
+
+    // 半角向量（用于Blinn-Phong高光）
+    Vector3 H = (L + V).normalized();
+
+    // 漫反射系数
+    double diff = std::max(0.0, hit.normal.dot(L));
+
+    // 高光系数
+    double spec = pow(
+        std::max(0.0, hit.normal.dot(H)),
+        hit.material.shininess
+    );
+    if (diff <= 0.0 && spec <= 0.0) return {0, 0, 0};
+
+    // 简单光照衰减
+    double attenuation = light_attenuation(distanceToLight);
+
+    // 漫反射贡献
+    Vector3 sampleColor = base_color * diff * light.intensity * attenuation;
+
+    // 高光贡献
+    if (spec > 0.0) {
+        sampleColor += Vector3(1, 1, 1) * spec * light.intensity * attenuation;
+    }
+    return sampleColor;
+}
+
+// 交点与光源采样点之间是否无遮挡
+bool light_visible(const Hit &hit, const Scene &scene, const Vector3 &lightSamplePos) {
+    Ray shadow_ray = spawn_secondary(hit, (lightSamplePos - hit.pos).normalized());
+    return !is_in_shadow(shadow_ray, scene, (lightSamplePos - shadow_ray.origin).length());
+}
+
+// 在光源上随机取一个采样位置，返回其直接光照（含阴影检测）；被遮挡时返回 0
+Vector3 light_sample_contribution(const Hit &hit, const Scene &scene, const Vector3 &base_color,
+                                  const PointLight &light, std::mt19937 &rng) {
+    Vector3 lightSamplePos = light.sample_position(rng);
+    Vector3 c = direct_light(hit, scene, base_color, light, lightSamplePos);
+    if (c.x <= 0.0 && c.y <= 0.0 && c.z <= 0.0) {
+        RT_STAT(shadow_early_outs);
+        return c;
+    }
+    return light_visible(hit, scene, lightSamplePos) ? c : Vector3(0, 0, 0);
 }
 
 // 分布式
+// 直接光照对 shadowSamples 个样本取平均（被遮挡的样本计为 0，半影区域随被遮挡比例变暗）。
+// 启用光源树时每个样本按重要性只选一个光源，贡献除以选择概率：期望与逐光源求和相同，
+// 但每个着色点的阴影光线数固定为 shadowSamples，不随光源数增长
 Vector3 shade(const Hit &hit, const Scene &scene, std::mt19937& rng, int shadowSamples = 4) {
     if (!hit.hit) return {0, 0, 0};
 
     // 创建局部随机数分布（使用传入的rng）
     std::uniform_real_distribution<> dis(0.0, 1.0);
 
-    Vector3 base_color = hit.texture ?
-        hit.texture->sample_uv(hit.u, hit.v) :
-        hit.color;
+    Vector3 base_color = surface_color(hit);
 
     // 环境光部分保持不变
     Vector3 color = scene.ambient_light * base_color;
+    if (shadowSamples <= 0) return color;
+
+    if (g_light_tree) {
+        Vector3 directIllumination = {0, 0, 0};
+        for (int i = 0; i < shadowSamples; i++) {
+            double pdf;
+            int li = g_light_tree->sample(hit.pos, hit.normal, dis(rng), pdf);
+            if (li < 0) break;
+            directIllumination += light_sample_contribution(hit, scene, base_color, scene.lights[li], rng) * (1.0 / pdf);
+        }
+        return color + directIllumination * (1.0 / shadowSamples);
+    }
 
     // 对每个光源进行采样
     for (const auto &light : scene.lights) {
         Vector3 directIllumination = {0, 0, 0};
-        int validSamples = 0;  // 统计有效光照样本
 
         // 柔光阴影：对光源进行多次采样
         for (int i = 0; i < shadowSamples; i++) {
-            // 采样光源位置
-            Vector3 lightSamplePos;
-
-            if (light.radius > 0.0) {
-                // 面光源：在圆盘上采样
-                double r = sqrt(dis(rng)) * light.radius;
-                double theta = 2.0 * M_PI * dis(rng);
-
-                // 简化：假设光源在XY平面
-                Vector3 offset(r * cos(theta), r * sin(theta), 0);
-                lightSamplePos = light.pos + offset;
-            } else {
-                // 点光源：为了模拟柔光阴影，添加一点随机偏移
-                Vector3 offset(
-                    (dis(rng) - 0.5) * 0.05,  // 小范围抖动
-                    (dis(rng) - 0.5) * 0.05,
-                    (dis(rng) - 0.5) * 0.05
-                );
-                lightSamplePos = light.pos + offset;
-            }
-
-            // 计算从交点指向光源的向量
-            Vector3 L = (lightSamplePos - hit.pos).normalized();
-            double distanceToLight = (lightSamplePos - hit.pos).length();
-
-            // 视角方向
-            Vector3 V = (scene.camera->position - hit.pos).normalized();
-
-            // 半角向量（用于Blinn-Phong高光）
-            Vector3 H = (L + V).normalized();
-
-            // 漫反射系数
-            double diff = std::max(0.0, hit.normal.dot(L));
-
-            // 高光系数
-            double spec = pow(
-                std::max(0.0, hit.normal.dot(H)),
-                hit.material.shininess
-            );
-
-            // 阴影检测
-            // bool inShadow = false;
-            Ray shadow_ray(hit.pos + hit.normal * 1e-4, L);
-            // Hit shadow_hit;
-            //
-            // // 检查是否有物体遮挡光源
-            // if (intersect_scene(shadow_ray, scene, shadow_hit)) {
-            //     // 如果相交点比光源近，说明被遮挡
-            //     if (shadow_hit.t < distanceToLight - 1e-4) {
-            //         inShadow = true;
-            //     }
-            // }
-            // 阴影检测
-            bool inShadow = is_in_shadow(shadow_ray, scene, distanceToLight - 1e-4);
-
-            // 如果不在阴影中，计算光照贡献
-            if (!inShadow) {
-                // 简单光照衰减（可根据需要调整）
-                double attenuation = 1.0 / (1.0 + 0.1 * distanceToLight);
-
-                // 漫反射贡献
-                Vector3 sampleColor = base_color * diff * light.intensity * attenuation;
-
-                // 高光贡献
-                if (spec > 0.0) {
-                    sampleColor += Vector3(1, 1, 1) * spec * light.intensity * attenuation;
-                }
-
-                directIllumination += sampleColor;
-                validSamples++;
-            }
+            directIllumination += light_sample_contribution(hit, scene, base_color, light, rng);
         }
 
-        // 平均所有有效样本
-        if (validSamples > 0) {
-            color += directIllumination * (1.0 / validSamples);
-        }
-
-        // 如果没有有效样本（完全在阴影中），可以考虑添加一点环境光
-        // 或者保持为0，这取决于你想要的效果
+        // 平均所有样本
+        color += directIllumination * (1.0 / shadowSamples);
     }
 
     return color;
@@ -190,12 +255,106 @@ Vector3 shade(const Hit &hit, const Scene &scene, std::mt19937& rng, int shadowS
 // 返回一个 std::function<Vector3(const Ray&, int)>，该函数执行完整 shading + reflection + refraction
 using IntersectFn = std::function<bool(const Ray&, const Scene&, Hit&)>;
 
+// 根据加速结构选择相交函数（accel 为空时逐对象遍历）；单精度路径把光线转换为 float 求交，交点再转回 double 着色
+IntersectFn make_intersect_fn(const Accelerator *accel) {
+    if (g_float_path) {
+        return [accel](const Ray &r, const Scene &s, Hit &h) -> bool {
+            Hitf hf;
+            hf.t = static_cast<float>(h.t);
+            if (!(accel ? accel->intersect(Rayf(r), hf, s) : intersect_scene(Rayf(r), s, hf))) return false;
+            h = Hit(hf);
+            return true;
+        };
+    }
+    if (accel) {
+        return [accel](const Ray &r, const Scene &s, Hit &h) -> bool {
+            return accel->intersect(r, h, s);
+        };
+    }
+    return [](const Ray &r, const Scene &s, Hit &h) -> bool {
+        return intersect_scene(r, s, h);
+    };
+}
+
+// 反射 / 折射光线树的剪枝方式（--ray-tree）
+enum class RayTreeMode {
+    FULL,     // 每个交点都追踪反射和折射两条光线，直到 MAX_DEPTH
+    ROULETTE, // 路径权重低于 ROULETTE_THRESHOLD 的分支以 权重 / 阈值 的概率继续，存活者按概率放大（俄罗斯轮盘赌，无偏）
+    BRANCH,   // 同时有反射和折射时按材质权重随机只追踪一条，再叠加轮盘赌
+};
+static RayTreeMode g_ray_tree = RayTreeMode::FULL;
+static constexpr double ROULETTE_THRESHOLD = 0.1;
+
+// 反射 / 折射：追踪次级光线并按材质权重混合，返回次级光线的加权颜色之和；
+// local_weight 为本地着色（shade）在最终颜色中的权重：color = shade * local_weight + 返回值。
+// throughput 为当前光线对像素的累计权重，trace_child(ray, child_throughput) 追踪一条子光线
+template <typename TraceChild>
+Vector3 secondary_bounces(const Ray &ray, const Hit &hit, double throughput, std::mt19937 &rng,
+                          TraceChild &&trace_child, double &local_weight) {
+    Ray refl, refr;
+    double w_refl = 0.0, w_refr = 0.0;
+    local_weight = 1.0;
+
+    // 反射
+    if (hit.material.reflectivity > 0.0) {
+        Vector3 R = ray.dir - hit.normal * 2.0 * ray.dir.dot(hit.normal);
+        refl = spawn_secondary(hit, R.normalized());
+        w_refl = hit.material.reflectivity;
+        local_weight = 1 - hit.material.reflectivity;
+    }
+
+    // 折射：与 (本地 + 反射) 按 refractivity 混合
+    if (hit.material.refractivity > 0.0) {
+        double eta = hit.material.ior;
+        Vector3 N = hit.normal;
+        double cosi = -clamp(ray.dir.dot(N), -1.0, 1.0);
+        if (cosi < 0) { cosi = -cosi; N = -N; eta = 1.0 / eta; }
+        double k = 1 - eta*eta*(1 - cosi*cosi);
+        if (k >= 0) {
+            Vector3 T = ray.dir * eta + N * (eta*cosi - sqrt(k));
+            refr = spawn_secondary(hit, T.normalized());
+            w_refr = hit.material.refractivity;
+            w_refl *= 1 - hit.material.refractivity;
+            local_weight *= 1 - hit.material.refractivity;
+        }
+    }
+
+    Vector3 color{0, 0, 0};
+    std::uniform_real_distribution<> dis(0.0, 1.0);
+    auto branch = [&](const Ray &r, double w, bool refraction) {
+        if (w <= 0.0) return;
+        double child = throughput * w;
+        if (g_ray_tree != RayTreeMode::FULL && child < ROULETTE_THRESHOLD) {
+            double q = child / ROULETTE_THRESHOLD;
+            if (dis(rng) >= q) return;
+            w /= q;
+            child = ROULETTE_THRESHOLD;
+        }
+        if (refraction) RT_STAT(refraction_rays);
+        else RT_STAT(reflection_rays);
+        color += trace_child(r, child) * w;
+    };
+    if (g_ray_tree == RayTreeMode::BRANCH && w_refl > 0.0 && w_refr > 0.0) {
+        double p = w_refl / (w_refl + w_refr);
+        if (dis(rng) < p) branch(refl, w_refl / p, false);
+        else branch(refr, w_refr / (1.0 - p), true);
+    } else {
+        branch(refl, w_refl, false);
+        branch(refr, w_refr, true);
+    }
+    return color;
+}
+
 std::function<Vector3(const Ray&, int)> make_tracer(const Scene &scene, IntersectFn intersect_fn) {
-    // 由于递归 lambda，我们先声明一个 std::function，然后在 lambda 内部捕获并调用它
-    std::function<Vector3(const Ray&, int)> trace_fn;
-    trace_fn = [&](const Ray &ray, int depth) -> Vector3 {
+    // 由于递归 lambda，我们先声明一个 std::function，然后在 lambda 内部捕获并调用它。
+    // trace_fn 放在堆上并按值捕获 intersect_fn：返回后局部变量已销毁，不能按引用捕获。
+    auto trace_fn = std::make_shared<std::function<Vector3(const Ray&, int, double)>>();
+    auto *self = trace_fn.get();
+    *trace_fn = [&scene, intersect_fn, self](const Ray &ray, int depth, double throughput) -> Vector3 {
         if (depth > MAX_DEPTH) return {0,0,0};
 
+        if (g_count_rays) g_trace_rays.fetch_add(1, std::memory_order_relaxed);
+        if (depth == 0) RT_STAT(primary_rays);
         Hit hit;
         if (!intersect_fn(ray, scene, hit)) {
             return scene.background_color;
@@ -206,43 +365,30 @@ std::function<Vector3(const Ray&, int)> make_tracer(const Scene &scene, Intersec
 
         Vector3 color = shade(hit, scene, local_rng, 1);
 
-        // 反射
-        if (hit.material.reflectivity > 0.0) {
-            Vector3 R = ray.dir - hit.normal * 2.0 * ray.dir.dot(hit.normal);
-            Ray refl(hit.pos + hit.normal * 1e-4, R.normalized());
-            Vector3 refl_color = trace_fn(refl, depth + 1);
-            color = color * (1 - hit.material.reflectivity) + refl_color * hit.material.reflectivity;
-        }
-
-        // 折射
-        if (hit.material.refractivity > 0.0) {
-            double eta = hit.material.ior;
-            Vector3 N = hit.normal;
-            double cosi = -clamp(ray.dir.dot(N), -1.0, 1.0);
-            if (cosi < 0) { cosi = -cosi; N = -N; eta = 1.0 / eta; }
-            double k = 1 - eta*eta*(1 - cosi*cosi);
-            if (k >= 0) {
-                Vector3 T = ray.dir * eta + N * (eta*cosi - sqrt(k));
-                Ray refr(hit.pos - hit.normal * 1e-4, T.normalized());
-                Vector3 refr_color = trace_fn(refr, depth + 1);
-                color = color * (1 - hit.material.refractivity) + refr_color * hit.material.refractivity;
-            }
-        }
-
-        return color;
+        // 反射 / 折射
+        double local_weight;
+        Vector3 secondary = secondary_bounces(ray, hit, throughput, local_rng,
+            [&](const Ray &r, double t) { return (*self)(r, depth + 1, t); }, local_weight);
+        return color * local_weight + secondary;
     };
 
-    return trace_fn;
+    return [trace_fn](const Ray &ray, int depth) { return (*trace_fn)(ray, depth, 1.0); };
 }
 
 // ====================== 分布式追踪器生成器 ======================
-std::function<Vector3(const Ray&, int, std::mt19937&)>
-make_distributed_tracer(const Scene &scene, IntersectFn intersect_fn, int shadowSamples = 4) {
+// 返回的函数签名为 (ray, depth, rng, throughput)，throughput 为光线对像素的累计权重（相机光线为 1）
+using DistributedTracer = std::function<Vector3(const Ray&, int, std::mt19937&, double)>;
+
+DistributedTracer make_distributed_tracer(const Scene &scene, IntersectFn intersect_fn, int shadowSamples = 4) {
 
-    std::function<Vector3(const Ray&, int, std::mt19937&)> trace_fn;
-    trace_fn = [&](const Ray &ray, int depth, std::mt19937& rng) -> Vector3 {
+    auto trace_fn = std::make_shared<DistributedTracer>();
+    auto *self = trace_fn.get();
+    *trace_fn = [&scene, intersect_fn, shadowSamples, self](const Ray &ray, int depth, std::mt19937& rng,
+                                                            double throughput) -> Vector3 {
         if (depth > MAX_DEPTH) return {0,0,0};
 
+        if (g_count_rays) g_trace_rays.fetch_add(1, std::memory_order_relaxed);
+        if (depth == 0) RT_STAT(primary_rays);
         Hit hit;
         if (!intersect_fn(ray, scene, hit)) {
             return scene.background_color;
@@ -251,69 +397,40 @@ make_distributed_tracer(const Scene &scene, IntersectFn intersect_fn, int shadow
         // 使用带柔光阴影的shade函数
         Vector3 color = shade(hit, scene, rng, shadowSamples);
 
-        // 反射（暂时保持原来的镜面反射）
-        if (hit.material.reflectivity > 0.0) {
-            Vector3 R = ray.dir - hit.normal * 2.0 * ray.dir.dot(hit.normal);
-            Ray refl(hit.pos + hit.normal * 1e-4, R.normalized());
-            Vector3 refl_color = trace_fn(refl, depth + 1, rng);
-            color = color * (1 - hit.material.reflectivity) + refl_color * hit.material.reflectivity;
-        }
-
-        // 折射（保持不变）
-        if (hit.material.refractivity > 0.0) {
-            double eta = hit.material.ior;
-            Vector3 N = hit.normal;
-            double cosi = -clamp(ray.dir.dot(N), -1.0, 1.0);
-            if (cosi < 0) { cosi = -cosi; N = -N; eta = 1.0 / eta; }
-            double k = 1 - eta*eta*(1 - cosi*cosi);
-            if (k >= 0) {
-                Vector3 T = ray.dir * eta + N * (eta*cosi - sqrt(k));
-                Ray refr(hit.pos - hit.normal * 1e-4, T.normalized());
-                Vector3 refr_color = trace_fn(refr, depth + 1, rng);
-                color = color * (1 - hit.material.refractivity) + refr_color * hit.material.refractivity;
-            }
-        }
-
-        return color;
+        // 反射（镜面反射）/ 折射
+        double local_weight;
+        Vector3 secondary = secondary_bounces(ray, hit, throughput, rng,
+            [&](const Ray &r, double t) { return (*self)(r, depth + 1, rng, t); }, local_weight);
+        return color * local_weight + secondary;
     };
 
-    return trace_fn;
+    return [trace_fn](const Ray &ray, int depth, std::mt19937 &rng, double throughput) {
+        return (*trace_fn)(ray, depth, rng, throughput);
+    };
 }
 
 // ====================== 分布式渲染函数（柔光阴影） ======================
 void render_distributed_soft_shadows(const Camera &cam, const Scene &scene, Image &img,
-                                     bool use_bvh = true, int pixelSamples = 16, int shadowSamples = 8) {
+                                     const Accelerator *accel = nullptr, int pixelSamples = 16, int shadowSamples = 8) {
 
-    // 创建BVH对象（如果需要）
-    std::unique_ptr<BVH> bvh_ptr;
-    if (use_bvh) {
-        bvh_ptr = std::make_unique<BVH>();
-        bvh_ptr->build(scene);
-    }
-
-    IntersectFn intersect_fn;
-    if (use_bvh) {
-        BVH* bvh = bvh_ptr.get();
-        intersect_fn = [bvh](const Ray &r, const Scene &s, Hit &h) -> bool {
-            return bvh->intersect(r, h, s);
-        };
-    } else {
-        intersect_fn = [](const Ray &r, const Scene &s, Hit &h) -> bool {
-            return intersect_scene(r, s, h);
-        };
-    }
+    IntersectFn intersect_fn = make_intersect_fn(accel);
 
     // 创建分布式追踪器
     auto tracer = make_distributed_tracer(scene, intersect_fn, shadowSamples);
 
+    const PixelRange range = pixel_range(cam);
 #pragma omp parallel for schedule(dynamic, 4)
-    for (int y = 0; y < cam.res_y; y++) {
+    for (int y = range.y0; y < range.y1; y++) {
+        TIMELINE_SCOPE("row", y);
+        if (g_render_cancel.load(std::memory_order_relaxed)) continue;
         // 每个线程自己的随机数生成器
         std::random_device rd;
         std::mt19937 rng(rd() + omp_get_thread_num());
         std::uniform_real_distribution<> dis(0.0, 1.0);
 
-        for (int x = 0; x < cam.res_x; x++) {
+        for (int x = range.x0; x < range.x1; x++) {
+            if (!range.contains(x, y)) continue;
+            RT_STAT_PIXEL(x, y);
             Vector3 color_sum{0,0,0};
 
             for (int s = 0; s < pixelSamples; s++) {
@@ -321,18 +438,470 @@ void render_distributed_soft_shadows(const Camera &cam, const Scene &scene, Imag
                 double dy = dis(rng);
 
                 Ray ray = cam.pixel_to_ray(x + 0.5 + dx, y + 0.5 + dy);
-                color_sum += tracer(ray, 0, rng);
+                color_sum += tracer(ray, 0, rng, 1.0);
             }
 
             Vector3 color = color_sum * (1.0 / pixelSamples);
             img.set_pixel(x, y, color);
         }
 
+        if (y % 50 == 0) {
 #pragma omp critical
+            cout << "[Distributed Soft Shadows] row " << y << "/" << cam.res_y
+                 << " (shadowSamples=" << shadowSamples << ")" << endl;
+        }
+    }
+}
+
+// ====================== ReSTIR 直接光照 ======================
+// 基于蓄水池的重要性重采样（Bitterli et al. 2020, "Spatiotemporal reservoir resampling for real-time
+// ray tracing with dynamic direct lighting"）：每个像素每一遍先从 RESTIR_CANDIDATES 个廉价候选
+// （按光源树或强度选光源，再在光源上取一点）中按 目标函数 / 候选 pdf 的权重保留一个，
+// 目标函数为不含阴影的直接光照亮度；然后与上一遍同一像素的蓄水池（时间复用）及邻近像素的蓄水池（空间复用）合并。
+// 候选本身不发射阴影光线，每个像素每遍的阴影光线为：初始样本 1 条（可见性复用，被遮挡的样本在复用前清零）、
+// 最终样本 1 条，空间复用按论文的无偏方式归一化（见下方 Z）时每个参与合并的邻居再 1 条，
+// 即最多 2 + RESTIR_NEIGHBOURS 条；不复用时只有最终样本 1 条。反射 / 折射和次级交点的着色与分布式追踪器相同。
+// 时间复用把上一遍同一像素的历史视为同一表面；法线夹角或深度相差过大的邻居不参与合并
+struct Reservoir {
+    int light = -1;      // 选中样本的光源下标，-1 表示空
+    Vector3 pos;         // 选中样本在光源上的位置
+    double target = 0.0; // 选中样本在所属像素处的目标函数值
+    double w_sum = 0.0;
+    double M = 0.0;      // 已处理的候选数（合并时累加）
+    double W = 0.0;      // 贡献权重：w_sum / (M * target)
+    // 所属像素交点的法线和深度，用于时间复用时判断是否为同一表面
+    Vector3 normal;
+    double depth = 0.0;
+
+    // 加入一个权重为 w 的候选（M 由调用方维护）
+    void update(int l, const Vector3 &p, double t, double w, double u) {
+        w_sum += w;
+        if (w > 0.0 && u * w_sum < w) {
+            light = l;
+            pos = p;
+            target = t;
+        }
+    }
+    // 合并另一个蓄水池：t 为其样本在当前像素处的目标函数值
+    void merge(const Reservoir &r, double t, double u) {
+        if (r.light >= 0) update(r.light, r.pos, t, t * r.W * r.M, u);
+        M += r.M;
+    }
+    void finalize() { W = (light >= 0 && target > 0.0) ? w_sum / (M * target) : 0.0; }
+};
+
+static constexpr int RESTIR_CANDIDATES = 32; // 每个像素每遍的初始候选数
+static constexpr int RESTIR_NEIGHBOURS = 5;  // 空间复用的邻居数
+// 时间复用时历史 M 的上限（相对初始候选数）。实时渲染常取 20，但这里各遍结果要累加平均：
+// 历史过长时相邻各遍选中同一样本，结果高度相关，平均后噪声几乎不再下降，因此只保留约一遍的历史
+static constexpr double RESTIR_MAX_HISTORY = 1.0;
+
+
+// reuse = false 时只做每像素的初始重采样（不复用），用于对比
+void render_restir(const Camera &cam, const Scene &scene, Image &img, const Accelerator *accel = nullptr,
+                   int passes = 16, int shadowSamples = 4, bool reuse = true) {
+    IntersectFn intersect_fn = make_intersect_fn(accel);
+    auto tracer = make_distributed_tracer(scene, intersect_fn, shadowSamples);
+
+    const int w = cam.res_x, h = cam.res_y;
+    const size_t n = (size_t)w * h;
+    std::vector<Hit> gbuffer(n);
+    std::vector<Vector3> base(n), accum(n, Vector3(0, 0, 0));
+    std::vector<double> local_weight(n, 0.0);
+    std::vector<Reservoir> reservoirs(n), history(n);
+    MemScope buffers(MemTag::RENDER_BUFFERS, n * (sizeof(Hit) + 2 * sizeof(Vector3) + sizeof(double) + 2 * sizeof(Reservoir)));
+    const int radius = std::max(3, w / 64); // 1080p 下约 30 像素
+    // 裁剪渲染时把区域（含掩码）向外膨胀 radius 个像素一起追踪，区域边缘的空间复用与整幅渲染相同；只写回区域内的像素
+    const RenderRegion traced = dilate_region(g_region, radius, w, h);
+    const PixelRange range = pixel_range(cam, traced), out_range = pixel_range(cam);
+
+    // 候选光源：启用光源树时按重要性选择，否则按强度比例
+    std::vector<double> cdf;
+    double total_power = 0.0;
+    for (const auto &l : scene.lights) cdf.push_back(total_power += l.intensity);
+    auto pick_light = [&](const Hit &hit, double u, double &pdf) -> int {
+        if (g_light_tree) return g_light_tree->sample(hit.pos, hit.normal, u, pdf);
+        if (total_power <= 0.0) return -1;
+        int li = (int)(std::upper_bound(cdf.begin(), cdf.end(), u * total_power) - cdf.begin());
+        li = std::min(li, (int)scene.lights.size() - 1);
+        pdf = scene.lights[li].intensity / total_power;
+        return li;
+    };
+    auto target_at = [&](size_t idx, int light, const Vector3 &pos) {
+        return luminance(direct_light(gbuffer[idx], scene, base[idx], scene.lights[light], pos));
+    };
+    // 法线夹角小于 25°、深度相差不超过 10% 视为同一表面
+    auto similar = [](const Vector3 &n0, double d0, const Vector3 &n1, double d1) {
+        return n0.dot(n1) > 0.906 && std::abs(d0 - d1) <= 0.1 * d0;
+    };
+
+    for (int pass = 0; pass < passes; pass++) {
+        // 1. 主光线、次级光线和每像素初始重采样（含时间复用）
+#pragma omp parallel
         {
-            if (y % 50 == 0)
-                cout << "[Distributed Soft Shadows] row " << y << "/" << cam.res_y
-                     << " (shadowSamples=" << shadowSamples << ")" << endl;
+            std::mt19937 rng(std::random_device{}() + omp_get_thread_num());
+            std::uniform_real_distribution<> dis(0.0, 1.0);
+#pragma omp for schedule(dynamic, 4)
+            for (int y = range.y0; y < range.y1; y++) {
+                TIMELINE_SCOPE("restir.initial", y);
+                if (g_render_cancel.load(std::memory_order_relaxed)) continue;
+                for (int x = range.x0; x < range.x1; x++) {
+                    if (!range.contains(x, y)) continue;
+                    RT_STAT_PIXEL(x, y);
+                    const size_t idx = (size_t)y * w + x;
+                    Reservoir r;
+                    Ray ray = cam.pixel_to_ray(x + 0.5 + dis(rng), y + 0.5 + dis(rng));
+                    if (g_count_rays) g_trace_rays.fetch_add(1, std::memory_order_relaxed);
+                    RT_STAT(primary_rays);
+                    Hit &hit = gbuffer[idx];
+                    hit = Hit();
+                    if (!intersect_fn(ray, scene, hit)) {
+                        accum[idx] += scene.background_color;
+                        reservoirs[idx] = r;
+                        continue;
+                    }
+                    base[idx] = surface_color(hit);
+                    accum[idx] += secondary_bounces(ray, hit, 1.0, rng,
+                        [&](const Ray &child, double t) { return tracer(child, 1, rng, t); }, local_weight[idx]);
+                    accum[idx] += scene.ambient_light * base[idx] * local_weight[idx];
+                    r.normal = hit.normal;
+                    r.depth = hit.t;
+
+                    for (int c = 0; c < RESTIR_CANDIDATES; c++) {
+                        double pdf;
+                        int li = pick_light(hit, dis(rng), pdf);
+                        if (li < 0) break;
+                        Vector3 pos = scene.lights[li].sample_position(rng);
+                        double t = target_at(idx, li, pos);
+                        r.update(li, pos, t, t / pdf, dis(rng));
+                    }
+                    r.M = RESTIR_CANDIDATES;
+                    r.finalize();
+
+                    // 可见性复用：被遮挡的样本在复用前清零，避免传播到邻居
+                    if (reuse && r.light >= 0 && !light_visible(hit, scene, r.pos)) r.W = 0.0;
+
+                    const Reservoir &prev = history[idx];
+                    if (reuse && pass > 0 && prev.M > 0.0 && similar(r.normal, r.depth, prev.normal, prev.depth)) {
+                        Reservoir merged;
+                        merged.normal = r.normal;
+                        merged.depth = r.depth;
+                        merged.merge(r, r.target, dis(rng));
+                        Reservoir capped = prev;
+                        capped.M = std::min(prev.M, RESTIR_MAX_HISTORY * RESTIR_CANDIDATES);
+                        merged.merge(capped, prev.light >= 0 ? target_at(idx, prev.light, prev.pos) : 0.0, dis(rng));
+                        merged.finalize();
+                        r = merged;
+                    }
+                    reservoirs[idx] = r;
+                }
+            }
+        }
+
+        // 2. 空间复用 + 着色：最终样本 1 条阴影光线，无偏归一化再为每个合并的邻居各 1 条
+#pragma omp parallel
+        {
+            std::mt19937 rng(std::random_device{}() + omp_get_thread_num());
+            std::uniform_real_distribution<> dis(0.0, 1.0);
+#pragma omp for schedule(dynamic, 4)
+            for (int y = range.y0; y < range.y1; y++) {
+                TIMELINE_SCOPE("restir.reuse", y);
+                if (g_render_cancel.load(std::memory_order_relaxed)) continue;
+                for (int x = range.x0; x < range.x1; x++) {
+                    if (!range.contains(x, y)) continue;
+                    RT_STAT_PIXEL(x, y);
+                    const size_t idx = (size_t)y * w + x;
+                    const Reservoir &own = reservoirs[idx];
+                    if (own.M <= 0.0) {
+                        history[idx] = Reservoir();
+                        continue;
+                    }
+                    Reservoir r = own;
+                    int merged[RESTIR_NEIGHBOURS];
+                    int merged_count = 0;
+                    if (reuse) {
+                        r = Reservoir();
+                        r.normal = own.normal;
+                        r.depth = own.depth;
+                        r.merge(own, own.target, dis(rng));
+                        for (int k = 0; k < RESTIR_NEIGHBOURS; k++) {
+                            int qx = std::clamp(x + (int)std::lround((2.0 * dis(rng) - 1.0) * radius), 0, w - 1);
+                            int qy = std::clamp(y + (int)std::lround((2.0 * dis(rng) - 1.0) * radius), 0, h - 1);
+                            const size_t qi = (size_t)qy * w + qx;
+                            const Reservoir &q = reservoirs[qi];
+                            if (qi == idx || q.M <= 0.0 || !similar(own.normal, own.depth, q.normal, q.depth))
+                                continue;
+                            r.merge(q, q.light >= 0 ? target_at(idx, q.light, q.pos) : 0.0, dis(rng));
+                            merged[merged_count++] = (int)qi;
+                        }
+                    }
+
+                    // 着色：最终样本被遮挡时贡献为 0，写回历史的权重也清零（可见性复用）
+                    bool visible = r.light >= 0 && r.target > 0.0 && light_visible(gbuffer[idx], scene, r.pos);
+                    if (!visible) {
+                        r.W = 0.0;
+                        history[idx] = r;
+                        continue;
+                    }
+                    // 无偏归一化：邻居的蓄水池只含其可见的样本，只有在邻居处目标函数非零且可见时，
+                    // 其 M 才计入归一化因子（否则按 1/M 归一化会在阴影边缘偏暗）
+                    double Z = own.M;
+                    for (int k = 0; k < merged_count; k++) {
+                        const int qi = merged[k];
+                        if (target_at(qi, r.light, r.pos) > 0.0 && light_visible(gbuffer[qi], scene, r.pos))
+                            Z += reservoirs[qi].M;
+                    }
+                    r.W = r.w_sum / (Z * r.target);
+                    history[idx] = r;
+
+                    Vector3 c = direct_light(gbuffer[idx], scene, base[idx], scene.lights[r.light], r.pos);
+                    accum[idx] += c * (r.W * local_weight[idx]);
+                }
+            }
+        }
+
+        if (pass % 4 == 0)
+            cout << "[ReSTIR] pass " << pass << "/" << passes << endl;
+    }
+
+    for (int y = out_range.y0; y < out_range.y1; y++)
+        for (int x = out_range.x0; x < out_range.x1; x++)
+            if (out_range.contains(x, y)) img.set_pixel(x, y, accum[(size_t)y * w + x] * (1.0 / passes));
+}
+
+// ====================== 路径追踪（BSDF 重要性采样 + 光源采样 + MIS） ======================
+// 材质按权重拆成三个波瓣，与 Whitted 追踪器的混合方式一致：
+//   漫反射 (1 - reflectivity)(1 - refractivity)：Lambert，cosineSampleHemisphere 采样；
+//   光泽反射 reflectivity (1 - refractivity)：GGX 微表面（roughness），ggxSampleHemisphere 采样，
+//     roughness < PATH_MIRROR_ROUGHNESS 时退化为理想镜面；
+//   折射 refractivity：理想折射（全反射时该权重不生效，与 secondary_bounces 相同）。
+// 每个非镜面交点做一次光源采样（按光源树选光源，在光源上取一点），BSDF 采样的方向若穿过面光源圆盘，
+// 两种策略的贡献用幂启发式（Veach 1995）合并。面光源的辐亮度按 shade 的光照模型反推：
+// 对圆盘均匀采样时 NEE 的估计恰为 π · intensity · 衰减 · f · cosθ（Lambert 的 f = base / π，
+// 与 shade 的漫反射亮度一致），点光源只能由光源采样得到。
+// 与其他追踪器相同，光源对相机和理想镜面 / 折射路径不可见，也不遮挡光线；未击中场景的光线取背景色。
+// 间接光照由路径本身计算，不再加环境光项
+enum class PathMode {
+    NAIVE, // 均匀半球采样，不做光源采样：只能靠随机方向击中面光源
+    BSDF,  // BSDF 重要性采样，不做光源采样
+    NEE,   // 只用光源采样计算直接光照（BSDF 方向击中光源不计）
+    MIS,   // 光源采样 + BSDF 采样，幂启发式合并
+};
+static constexpr double PATH_MIRROR_ROUGHNESS = 0.05;
+static constexpr int PATH_ROULETTE_DEPTH = 2; // 从第几次反弹开始按路径权重做俄罗斯轮盘赌
+static constexpr int PATH_MAX_LIGHT_HITS = 8;
+
+// 交点处的 BSDF：n 为朝向入射一侧的法线，p_* 为各波瓣的选择概率（= 波瓣权重，三者之和为 1）
+struct PathBSDF {
+    Vector3 n;
+    Vector3 base;
+    double roughness = 0.0;
+    bool mirror = false;
+    double p_diffuse = 0.0, p_glossy = 0.0, p_refract = 0.0;
+    Ray refracted;
+
+    PathBSDF(const Ray &ray, const Hit &hit) {
+        const Material &m = hit.material;
+        n = hit.normal.dot(ray.dir) > 0.0 ? -hit.normal : hit.normal;
+        base = surface_color(hit);
+        roughness = m.roughness;
+        mirror = m.roughness < PATH_MIRROR_ROUGHNESS;
+        p_diffuse = 1.0 - m.reflectivity;
+        p_glossy = m.reflectivity;
+        if (m.refractivity > 0.0) {
+            double eta = m.ior;
+            Vector3 N = hit.normal;
+            double cosi = -std::clamp(ray.dir.dot(N), -1.0, 1.0);
+            if (cosi < 0) { cosi = -cosi; N = -N; eta = 1.0 / eta; }
+            double k = 1 - eta * eta * (1 - cosi * cosi);
+            if (k >= 0) {
+                refracted = spawn_secondary(hit, (ray.dir * eta + N * (eta * cosi - sqrt(k))).normalized());
+                p_refract = m.refractivity;
+                p_diffuse *= 1.0 - m.refractivity;
+                p_glossy *= 1.0 - m.refractivity;
+            }
+        }
+    }
+
+    // 非镜面部分（漫反射 + 粗糙光泽）是否存在：决定是否做光源采样
+    bool has_smooth_lobes() const { return p_diffuse > 0.0 || (p_glossy > 0.0 && !mirror); }
+
+    // 非镜面波瓣的 f(wo, wi)，dir_in 为入射光线方向（指向交点），wi 指向外
+    Vector3 eval(const Vector3 &dir_in, const Vector3 &wi) const {
+        double cos_i = n.dot(wi);
+        if (cos_i <= 0.0) return {0, 0, 0};
+        Vector3 f = base * (p_diffuse / M_PI);
+        if (p_glossy > 0.0 && !mirror) {
+            Vector3 h = (wi - dir_in).normalized();
+            double cos_o = -n.dot(dir_in);
+            double g = ggxD(n, h, roughness) * ggxSmithG1(n, -dir_in, roughness) * ggxSmithG1(n, wi, roughness)
+                       / (4.0 * cos_o * cos_i);
+            f += Vector3(1, 1, 1) * (p_glossy * g);
+        }
+        return f;
+    }
+
+    // 按 sample 的波瓣选择生成 wi 的 pdf（只含非镜面波瓣，立体角测度）
+    double pdf(const Vector3 &dir_in, const Vector3 &wi, PathMode mode) const {
+        if (n.dot(wi) <= 0.0) return 0.0;
+        if (mode == PathMode::NAIVE) return (p_diffuse + (mirror ? 0.0 : p_glossy)) / (2.0 * M_PI);
+        double p = p_diffuse * cosineHemispherePdf(n, wi);
+        if (p_glossy > 0.0 && !mirror) p += p_glossy * ggxPdf(n, dir_in, wi, roughness);
+        return p;
+    }
+};
+
+// 面光源圆盘（假设在 XY 平面）上一点对 dir 方向的立体角 pdf 换算：面积 pdf 1/A 乘以 d² / |cosθ|
+inline double disk_solid_angle_factor(const PointLight &light, const Vector3 &dir, double dist) {
+    double cos_l = std::abs(dir.z);
+    if (cos_l <= 1e-8) return 1e30;
+    return dist * dist / (M_PI * light.radius * light.radius * cos_l);
+}
+
+inline double power_heuristic(double a, double b) { return a * a / (a * a + b * b); }
+
+// 一条相机路径的辐亮度
+Vector3 trace_path(Ray ray, const Scene &scene, const IntersectFn &intersect_fn, const LightTree &lights,
+                   std::mt19937 &rng, PathMode mode) {
+    std::uniform_real_distribution<> dis(0.0, 1.0);
+    Vector3 radiance{0, 0, 0};
+    Vector3 throughput{1, 1, 1};
+    // 上一个交点的非镜面 BSDF 采样信息：光线击中面光源时计算 MIS 权重
+    bool from_smooth = false;
+    double prev_pdf = 0.0;
+    Vector3 prev_pos, prev_n;
+    bool refracting = false;
+
+    for (int depth = 0; depth <= MAX_DEPTH; depth++) {
+        if (g_count_rays) g_trace_rays.fetch_add(1, std::memory_order_relaxed);
+        if (depth == 0) RT_STAT(primary_rays);
+        else if (refracting) RT_STAT(refraction_rays);
+        else RT_STAT(reflection_rays);
+        Hit hit;
+        bool found = intersect_fn(ray, scene, hit);
+
+        // BSDF 采样的方向穿过面光源：辐亮度 L = π · intensity · 衰减 · d² / (A |cosθ_l|)
+        if (from_smooth && mode != PathMode::NEE) {
+            LightTree::DiskHit hits[PATH_MAX_LIGHT_HITS];
+            int count = lights.intersect_disks(ray, found ? hit.t : 1e30, scene.lights, hits, PATH_MAX_LIGHT_HITS);
+            for (int k = 0; k < count; k++) {
+                const PointLight &l = scene.lights[hits[k].light];
+                double factor = disk_solid_angle_factor(l, ray.dir, hits[k].t);
+                double Le = M_PI * l.intensity * light_attenuation(hits[k].t) * factor;
+                double w = 1.0;
+                if (mode == PathMode::MIS)
+                    w = power_heuristic(prev_pdf, lights.pdf(prev_pos, prev_n, hits[k].light) * factor);
+                radiance += throughput * (Le * w);
+            }
+        }
+
+        if (!found) {
+            radiance += throughput * scene.background_color;
+            break;
+        }
+
+        PathBSDF bsdf(ray, hit);
+
+        // 光源采样（NEE）：选一个光源，在光源上取一点，发一条阴影光线
+        if (bsdf.has_smooth_lobes() && (mode == PathMode::NEE || mode == PathMode::MIS)) {
+            double select_pdf;
+            int li = lights.sample(hit.pos, bsdf.n, dis(rng), select_pdf);
+            if (li >= 0) {
+                const PointLight &l = scene.lights[li];
+                Vector3 lightSamplePos = l.sample_position(rng);
+                Vector3 wi = lightSamplePos - hit.pos;
+                double dist = wi.length();
+                wi = wi * (1.0 / dist);
+                Vector3 f = bsdf.eval(ray.dir, wi);
+                const bool lit = f.x > 0.0 || f.y > 0.0 || f.z > 0.0;
+                if (!lit) RT_STAT(shadow_early_outs);
+                if (lit && light_visible(hit, scene, lightSamplePos)) {
+                    double w = 1.0;
+                    if (mode == PathMode::MIS && l.radius > 0.0)
+                        w = power_heuristic(select_pdf * disk_solid_angle_factor(l, wi, dist),
+                                            bsdf.pdf(ray.dir, wi, mode));
+                    double Li = M_PI * l.intensity * light_attenuation(dist) * bsdf.n.dot(wi) * w / select_pdf;
+                    radiance += throughput * f * Li;
+                }
+            }
+        }
+
+        // BSDF 采样下一个方向：按波瓣权重选一个波瓣，非镜面波瓣的权重为 f cosθ / (混合 pdf)
+        double u = dis(rng);
+        from_smooth = false;
+        refracting = u < bsdf.p_refract;
+        if (refracting) {
+            ray = bsdf.refracted;
+        } else if (bsdf.mirror && u < bsdf.p_refract + bsdf.p_glossy) {
+            Vector3 R = ray.dir - bsdf.n * 2.0 * ray.dir.dot(bsdf.n);
+            ray = spawn_secondary(hit, R.normalized());
+        } else {
+            Vector3 wi;
+            if (mode == PathMode::NAIVE) {
+                wi = uniformSampleSphere();
+                if (wi.dot(bsdf.n) < 0.0) wi = -wi;
+            } else {
+                // 在非镜面波瓣之间按权重再选一次（u 重新缩放到 [0,1)）
+                double smooth = bsdf.p_diffuse + (bsdf.mirror ? 0.0 : bsdf.p_glossy);
+                double v = (u - (1.0 - smooth)) / smooth;
+                wi = v * smooth < bsdf.p_diffuse ? cosineSampleHemisphere(bsdf.n)
+                                                 : ggxSampleHemisphere(bsdf.n, ray.dir, bsdf.roughness);
+            }
+            double pdf = bsdf.pdf(ray.dir, wi, mode);
+            if (pdf <= 0.0) break;
+            Vector3 f = bsdf.eval(ray.dir, wi);
+            // pdf 已含波瓣选择概率，是该方向由本次采样生成的总概率密度；f 已含波瓣权重
+            throughput = throughput * f * (bsdf.n.dot(wi) / pdf);
+            from_smooth = true;
+            prev_pdf = pdf;
+            prev_pos = hit.pos;
+            prev_n = bsdf.n;
+            ray = spawn_secondary(hit, wi);
+        }
+
+        // 俄罗斯轮盘赌：路径权重越低越容易终止，存活者按概率放大
+        if (depth >= PATH_ROULETTE_DEPTH) {
+            double q = std::min(1.0, std::max({throughput.x, throughput.y, throughput.z}));
+            if (q <= 0.0 || dis(rng) >= q) break;
+            throughput = throughput * (1.0 / q);
+        }
+    }
+    return radiance;
+}
+
+void render_path_tracing(const Camera &cam, const Scene &scene, Image &img, const Accelerator *accel = nullptr,
+                         int pixelSamples = 16, PathMode mode = PathMode::MIS) {
+    IntersectFn intersect_fn = make_intersect_fn(accel);
+
+    // 光源采样和 MIS 需要选择概率与光线-圆盘求交，未启用 --light-tree 时在这里构建一棵
+    LightTree local_tree;
+    if (!g_light_tree) local_tree.build(scene.lights);
+    MemScope tree_bytes(MemTag::LIGHT_TREE, local_tree.memory_bytes());
+    const LightTree &lights = g_light_tree ? *g_light_tree : local_tree;
+
+    const PixelRange range = pixel_range(cam);
+#pragma omp parallel for schedule(dynamic, 4)
+    for (int y = range.y0; y < range.y1; y++) {
+        TIMELINE_SCOPE("row", y);
+        if (g_render_cancel.load(std::memory_order_relaxed)) continue;
+        std::random_device rd;
+        std::mt19937 rng(rd() + omp_get_thread_num());
+        std::uniform_real_distribution<> dis(0.0, 1.0);
+
+        for (int x = range.x0; x < range.x1; x++) {
+            if (!range.contains(x, y)) continue;
+            RT_STAT_PIXEL(x, y);
+            Vector3 color_sum{0, 0, 0};
+            for (int s = 0; s < pixelSamples; s++) {
+                Ray ray = cam.pixel_to_ray(x + 0.5 + dis(rng), y + 0.5 + dis(rng));
+                color_sum += trace_path(ray, scene, intersect_fn, lights, rng, mode);
+            }
+            img.set_pixel(x, y, color_sum * (1.0 / pixelSamples));
+        }
+
+        if (y % 50 == 0) {
+#pragma omp critical
+            cout << "[Path Tracing] row " << y << "/" << cam.res_y << " (spp=" << pixelSamples << ")" << endl;
         }
     }
 }
@@ -342,20 +911,23 @@ void render_no_bvh(const Camera &cam, const Scene &scene, Image &img) {
     const int SAMPLES = 16;
 
     // intersect_fn 使用原有的直接场景相交函数
-    IntersectFn intersect_fn = [](const Ray &r, const Scene &s, Hit &h) -> bool {
-        return intersect_scene(r, s, h);
-    };
+    IntersectFn intersect_fn = make_intersect_fn(nullptr);
 
     auto tracer = make_tracer(scene, intersect_fn);
 
+    const PixelRange range = pixel_range(cam);
     #pragma omp parallel for schedule(dynamic, 4)
-    for (int y = 0; y < cam.res_y; y++) {
+    for (int y = range.y0; y < range.y1; y++) {
+        TIMELINE_SCOPE("row", y);
+        if (g_render_cancel.load(std::memory_order_relaxed)) continue;
         // 每个线程有随机数生成器
         std::random_device rd;
         std::mt19937 gen(rd() + omp_get_thread_num());
         std::uniform_real_distribution<> dis(0.0, 1.0);
 
-        for (int x = 0; x < cam.res_x; x++) {
+        for (int x = range.x0; x < range.x1; x++) {
+            if (!range.contains(x, y)) continue;
+            RT_STAT_PIXEL(x, y);
             Vector3 color_sum{0,0,0};
             for (int s = 0; s < SAMPLES; s++) {
                 double dx = dis(gen);
@@ -367,38 +939,34 @@ void render_no_bvh(const Camera &cam, const Scene &scene, Image &img) {
             img.set_pixel(x, y, color);
         }
 
-        #pragma omp critical
-        {
-            if (y % 50 == 0)
-                cout << "[No BVH Parallel] row " << y << "/" << cam.res_y << endl;
+        if (y % 50 == 0) {
+            #pragma omp critical
+            cout << "[No BVH Parallel] row " << y << "/" << cam.res_y << endl;
         }
     }
 }
 
-// ====================== 渲染（使用 BVH） ======================
-void render_bvh(const Camera &cam, const Scene &scene, Image &img) {
-    BVH bvh;
-    bvh.build(scene);
-
+// ====================== 渲染（使用加速结构） ======================
+void render_bvh(const Camera &cam, const Scene &scene, Image &img, const Accelerator &accel) {
     const int SAMPLES = 16;
 
-    // intersect_fn 使用 BVH 的相交接口
-    IntersectFn intersect_fn = [&bvh](const Ray &r, const Scene &s, Hit &h) -> bool {
-        // 假定你的 BVH::intersect 接口是: bool intersect(const Ray&, Hit&, const Scene&)
-        // 但你原先在 lambda 中调用的是 bvh.intersect(r, h, scene)
-        // 如果签名不同，请根据你的 BVH 接口调整这一行顺序或参数。
-        return bvh.intersect(r, h, s);
-    };
+    // intersect_fn 使用加速结构（BVH / 网格 / kd 树）的相交接口
+    IntersectFn intersect_fn = make_intersect_fn(&accel);
 
     auto tracer = make_tracer(scene, intersect_fn);
 
+    const PixelRange range = pixel_range(cam);
     #pragma omp parallel for schedule(dynamic, 4)
-    for (int y = 0; y < cam.res_y; y++) {
+    for (int y = range.y0; y < range.y1; y++) {
+        TIMELINE_SCOPE("row", y);
+        if (g_render_cancel.load(std::memory_order_relaxed)) continue;
         std::random_device rd;
         std::mt19937 gen(rd() + omp_get_thread_num());
         std::uniform_real_distribution<> dis(0.0, 1.0);
 
-        for (int x = 0; x < cam.res_x; x++) {
+        for (int x = range.x0; x < range.x1; x++) {
+            if (!range.contains(x, y)) continue;
+            RT_STAT_PIXEL(x, y);
             Vector3 color_sum{0,0,0};
             for (int s = 0; s < SAMPLES; s++) {
                 double dx = dis(gen);
@@ -410,50 +978,672 @@ void render_bvh(const Camera &cam, const Scene &scene, Image &img) {
             img.set_pixel(x, y, color);
         }
 
-        #pragma omp critical
+        if (y % 50 == 0) {
+            #pragma omp critical
+            cout << "[BVH Parallel] row " << y << "/" << cam.res_y << endl;
+        }
+    }
+}
+
+// ====================== 单 / 双精度对比 ======================
+// 同一加速结构上分别走双精度和单精度路径：先追踪固定光线集（像素中心主光线 + 每个交点一条随机反弹光线），
+// 比较吞吐量和交点差异；再各渲染一幅图像，比较时间和相对双精度图像的误差。
+// 着色的随机数每次运行都不同，因此双精度渲染两次，两幅之间的误差作为噪声基线
+static double image_rmse(const Image &a, const Image &b, double &max_abs) {
+    double sum = 0.0;
+    max_abs = 0.0;
+    for (size_t i = 0; i < a.pixels.size(); i++) {
+        const double ca[3] = {a.pixels[i].r, a.pixels[i].g, a.pixels[i].b};
+        const double cb[3] = {b.pixels[i].r, b.pixels[i].g, b.pixels[i].b};
+        for (int k = 0; k < 3; k++) {
+            double d = std::clamp(ca[k], 0.0, 1.0) - std::clamp(cb[k], 0.0, 1.0);
+            sum += d * d;
+            max_abs = std::max(max_abs, std::abs(d));
+        }
+    }
+    return std::sqrt(sum / std::max<size_t>(1, a.pixels.size() * 3));
+}
+
+void report_precision(const Camera &cam, const Scene &scene, BVH &bvh, const Accelerator &accel) {
+    bvh.use_float_nodes = true;
+    bvh.update_float_nodes();
+
+    // 反弹光线按 float 交点的误差偏移，两条路径都不会自相交
+    std::vector<Ray> rays;
+    for (int y = 0; y < cam.res_y; y++)
+        for (int x = 0; x < cam.res_x; x++) rays.push_back(cam.pixel_to_ray(x + 0.5, y + 0.5));
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    const size_t primary = rays.size();
+    for (size_t i = 0; i < primary; i++) {
+        Hit h;
+        if (!accel.intersect(rays[i], h, scene)) continue;
+        double z = 2.0 * u(rng) - 1.0, phi = 2.0 * M_PI * u(rng), r = std::sqrt(1.0 - z * z);
+        Vector3 dir(r * std::cos(phi), r * std::sin(phi), z);
+        Rayf rf = spawn_ray(Vector3f(h.pos), Vector3f(h.normal), Vector3f(dir));
+        rays.emplace_back(Vector3(rf.origin), dir);
+    }
+
+    std::vector<double> t_double(rays.size()), t_float(rays.size());
+    auto trace = [&](bool use_float, std::vector<double> &t_out) {
+        double best = 1e30;
+        for (int rep = 0; rep < 3; rep++) {
+            auto t0 = chrono::high_resolution_clock::now();
+#pragma omp parallel for schedule(dynamic, 256)
+            for (int i = 0; i < (int)rays.size(); i++) {
+                if (use_float) {
+                    Hitf h;
+                    t_out[i] = accel.intersect(Rayf(rays[i]), h, scene) ? h.t : -1.0;
+                } else {
+                    Hit h;
+                    t_out[i] = accel.intersect(rays[i], h, scene) ? h.t : -1.0;
+                }
+            }
+            auto t1 = chrono::high_resolution_clock::now();
+            best = std::min(best, chrono::duration<double, std::milli>(t1 - t0).count());
+        }
+        return best;
+    };
+    double ms_double = trace(false, t_double);
+    double ms_float = trace(true, t_float);
+
+    long long mismatches = 0, far_off = 0, both = 0;
+    double err_sum = 0.0, err_max = 0.0;
+    for (size_t i = 0; i < rays.size(); i++) {
+        if ((t_double[i] < 0.0) != (t_float[i] < 0.0)) {
+            mismatches++;
+            continue;
+        }
+        if (t_double[i] < 0.0) continue;
+        double err = std::abs(t_float[i] - t_double[i]) / t_double[i];
+        err_sum += err;
+        err_max = std::max(err_max, err);
+        if (err > 1e-3) far_off++;
+        both++;
+    }
+
+    cout << "\n=== Float vs Double Precision (" << accel.name() << ", " << rays.size() << " rays) ===" << endl;
+    cout << std::left << std::setw(8) << "path" << std::setw(12) << "trace_ms" << std::setw(10) << "Mrays/s"
+         << "node_bytes" << endl;
+    cout << std::left << std::setw(8) << "double" << std::setw(12) << std::fixed << std::setprecision(3) << ms_double
+         << std::setw(10) << std::setprecision(2) << rays.size() / ms_double / 1000.0
+         << bvh.nodes.size() * sizeof(BVHNode) << endl;
+    cout << std::left << std::setw(8) << "float" << std::setw(12) << std::setprecision(3) << ms_float
+         << std::setw(10) << std::setprecision(2) << rays.size() / ms_float / 1000.0
+         << bvh.float_nodes.size() * sizeof(BVHNodef) << endl;
+    cout.unsetf(std::ios::floatfield);
+    cout << "Hit/miss mismatches: " << mismatches << " (" << 100.0 * mismatches / rays.size() << "%)"
+         << ", t relative error: mean " << (both ? err_sum / both : 0.0) << ", max " << err_max
+         << ", > 1e-3 (different surface): " << far_off << endl;
+
+    // 整幅渲染
+    struct Run { const char *name; bool use_float; double seconds; Image img; };
+    std::vector<Run> runs{{"double", false, 0.0, {}}, {"double", false, 0.0, {}}, {"float", true, 0.0, {}}};
+    const bool saved = g_float_path;
+    for (auto &run : runs) {
+        g_float_path = run.use_float;
+        run.img = Image(cam.res_x, cam.res_y);
+        auto t0 = chrono::high_resolution_clock::now();
+        render_bvh(cam, scene, run.img, accel);
+        auto t1 = chrono::high_resolution_clock::now();
+        run.seconds = chrono::duration<double>(t1 - t0).count();
+    }
+    g_float_path = saved;
+
+    cout << "\n" << std::left << std::setw(8) << "render" << std::setw(10) << "time_s" << std::setw(12) << "rmse"
+         << "max_abs  (vs. first double render; second double render = noise floor)" << endl;
+    for (size_t i = 0; i < runs.size(); i++) {
+        double max_abs = 0.0;
+        double rmse = i == 0 ? 0.0 : image_rmse(runs[0].img, runs[i].img, max_abs);
+        cout << std::left << std::setw(8) << runs[i].name << std::setw(10) << std::fixed << std::setprecision(3)
+             << runs[i].seconds << std::setw(12) << std::setprecision(5) << rmse << max_abs << endl;
+    }
+    cout.unsetf(std::ios::floatfield);
+}
+
+// ====================== 多光源采样对比 ======================
+// 把场景中的每个光源复制为 k 个（在原位置附近随机散开，强度除以 k，总强度不变），
+// 在固定的一组着色点（主光线交点）上分别用逐光源采样和光源树采样计算 shade，比较每个着色点的耗时和误差。
+// 误差以逐光源采样的结果为参考；逐光源采样再运行一次，两次之间的误差作为噪声基线
+void report_light_sampling(const Camera &cam, const Scene &scene, const BVH &bvh, const Accelerator &accel,
+                           int shadowSamples) {
+    if (scene.lights.empty()) {
+        cout << "Light sampling report: scene has no lights" << endl;
+        return;
+    }
+
+    // 着色点：最多 64 x 64 个像素中心的主光线交点
+    std::vector<Hit> points;
+    const int nx = std::min(cam.res_x, 64), ny = std::min(cam.res_y, 64);
+    for (int y = 0; y < ny; y++) {
+        for (int x = 0; x < nx; x++) {
+            Hit h;
+            Ray ray = cam.pixel_to_ray((x + 0.5) * cam.res_x / nx, (y + 0.5) * cam.res_y / ny);
+            if (accel.intersect(ray, h, scene)) points.push_back(h);
+        }
+    }
+    if (points.empty()) {
+        cout << "Light sampling report: no primary ray hits the scene" << endl;
+        return;
+    }
+
+    const AABB root = bvh.nodes.empty() ? AABB() : bvh.nodes[0].box;
+    const double spread = bvh.nodes.empty() ? 1.0 : 0.1 * (root.bmax - root.bmin).length();
+    const int base = (int)scene.lights.size();
+    std::vector<int> scales{1};
+    for (int target : {16, 64, 256}) {
+        int k = std::max(1, target / base);
+        if (k > scales.back()) scales.push_back(k);
+    }
+
+    auto shade_all = [&](const Scene &s, std::vector<Vector3> &out) {
+        auto t0 = chrono::high_resolution_clock::now();
+#pragma omp parallel
         {
-            if (y % 50 == 0)
-                cout << "[BVH Parallel] row " << y << "/" << cam.res_y << endl;
+            std::mt19937 rng(std::random_device{}() + omp_get_thread_num());
+#pragma omp for schedule(dynamic, 16)
+            for (int i = 0; i < (int)points.size(); i++) out[i] = shade(points[i], s, rng, shadowSamples);
+        }
+        auto t1 = chrono::high_resolution_clock::now();
+        return chrono::duration<double, std::micro>(t1 - t0).count() / points.size();
+    };
+    auto rmse = [&](const std::vector<Vector3> &a, const std::vector<Vector3> &b) {
+        double sum = 0.0;
+        for (size_t i = 0; i < a.size(); i++) {
+            Vector3 d = a[i] - b[i];
+            sum += d.dot(d);
+        }
+        return std::sqrt(sum / (3.0 * a.size()));
+    };
+    auto mean = [](const std::vector<Vector3> &a) {
+        double sum = 0.0;
+        for (const auto &c : a) sum += (c.x + c.y + c.z) / 3.0;
+        return sum / a.size();
+    };
+
+    cout << "\n=== Light Sampling (" << points.size() << " shading points, " << shadowSamples
+         << " shadow samples) ===" << endl;
+    cout << std::left << std::setw(8) << "lights" << std::setw(12) << "all_us/pt" << std::setw(12) << "tree_us/pt"
+         << std::setw(9) << "speedup" << std::setw(11) << "mean_all" << std::setw(11) << "mean_tree"
+         << std::setw(11) << "rmse_tree" << "rmse_all (noise floor)" << endl;
+
+    const LightTree *saved = g_light_tree;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<> u(-1.0, 1.0);
+    for (int k : scales) {
+        Scene s = scene;
+        s.lights.clear();
+        for (const auto &l : scene.lights) {
+            for (int c = 0; c < k; c++) {
+                Vector3 offset = k == 1 ? Vector3(0, 0, 0) : Vector3(u(rng), u(rng), u(rng)) * spread;
+                s.lights.emplace_back(l.pos + offset, l.intensity / k, l.radius);
+            }
         }
+        LightTree tree;
+        tree.build(s.lights);
+
+        std::vector<Vector3> ref(points.size()), again(points.size()), est(points.size());
+        g_light_tree = nullptr;
+        double us_all = shade_all(s, ref);
+        shade_all(s, again);
+        g_light_tree = &tree;
+        double us_tree = shade_all(s, est);
+
+        cout << std::left << std::setw(8) << s.lights.size() << std::fixed << std::setprecision(2)
+             << std::setw(12) << us_all << std::setw(12) << us_tree << std::setw(9) << us_all / us_tree
+             << std::setprecision(4) << std::setw(11) << mean(ref) << std::setw(11) << mean(est)
+             << std::setw(11) << rmse(ref, est) << rmse(ref, again) << endl;
     }
+    g_light_tree = saved;
+    cout.unsetf(std::ios::floatfield);
 }
 
-// ====================== 渲染使用特效 ======================
-void render_with_effects(const Camera &cam, const Scene &scene, Image &img, bool use_bvh = true) {
-    const int SAMPLES = 16;
+// ====================== ReSTIR 与分布式阴影对比 ======================
+// 参考图像：分布式追踪，像素采样 4 倍、每个光源 16 个阴影样本。
+// 依次渲染：分布式柔光阴影、只做初始重采样（不复用）、ReSTIR（时间 + 空间复用）、与分布式等时间的 ReSTIR，
+// 比较渲染时间和相对参考图像的误差
+void report_restir(const Camera &cam, const Scene &scene, const Accelerator *accel, int pixelSamples, int shadowSamples) {
+    auto timed = [](const std::function<void()> &fn) {
+        auto t0 = chrono::high_resolution_clock::now();
+        fn();
+        auto t1 = chrono::high_resolution_clock::now();
+        return chrono::duration<double>(t1 - t0).count();
+    };
+
+    Image reference(cam.res_x, cam.res_y);
+    double ref_seconds = timed([&] {
+        render_distributed_soft_shadows(cam, scene, reference, accel, pixelSamples * 4, 16);
+    });
+
+    // 每次运行同时统计每像素的阴影光线数（ReSTIR 的可见性复用和无偏归一化也发射阴影光线）
+    const double pixels = (double)cam.res_x * cam.res_y;
+    struct Run { std::string name; double seconds; double shadow_per_pixel; Image img; };
+    std::vector<Run> runs;
+    auto add = [&](const std::string &name, const std::function<void(Image &)> &render) {
+        Run run{name, 0.0, 0.0, Image(cam.res_x, cam.res_y)};
+        g_shadow_rays = 0;
+        g_count_rays = true;
+        run.seconds = timed([&] { render(run.img); });
+        g_count_rays = false;
+        run.shadow_per_pixel = g_shadow_rays / pixels;
+        runs.push_back(std::move(run));
+    };
+    add("distributed ss" + std::to_string(shadowSamples), [&](Image &out) {
+        render_distributed_soft_shadows(cam, scene, out, accel, pixelSamples, shadowSamples);
+    });
+    add("ris (no reuse)", [&](Image &out) { render_restir(cam, scene, out, accel, pixelSamples, shadowSamples, false); });
+    add("restir", [&](Image &out) { render_restir(cam, scene, out, accel, pixelSamples, shadowSamples, true); });
+    // 等时间：按 ReSTIR 每遍的耗时估算分布式渲染时间内能完成的遍数
+    int equal_passes = (int)std::lround(pixelSamples * runs[0].seconds / runs[2].seconds);
+    if (equal_passes > pixelSamples) {
+        add("restir (equal time)", [&](Image &out) {
+            render_restir(cam, scene, out, accel, equal_passes, shadowSamples, true);
+        });
+    }
 
-    // 创建BVH对象（如果需要）
-    std::unique_ptr<BVH> bvh_ptr;
-    if (use_bvh) {
-        bvh_ptr = std::make_unique<BVH>();
-        bvh_ptr->build(scene);
+    cout << "\n=== ReSTIR vs Distributed Soft Shadows (" << cam.res_x << "x" << cam.res_y << ", "
+         << pixelSamples << " samples per pixel; reference: " << pixelSamples * 4 << " spp x 16 shadow samples, "
+         << std::fixed << std::setprecision(1) << ref_seconds << " s) ===" << endl;
+    cout << std::left << std::setw(22) << "mode" << std::setw(10) << "time_s" << std::setw(13) << "shadow/px"
+         << std::setw(12) << "rmse" << "max_abs" << endl;
+    for (const auto &run : runs) {
+        double max_abs = 0.0;
+        double rmse = image_rmse(reference, run.img, max_abs);
+        cout << std::left << std::setw(22) << run.name << std::setw(10) << std::setprecision(3) << run.seconds
+             << std::setw(13) << std::setprecision(1) << run.shadow_per_pixel
+             << std::setw(12) << std::setprecision(5) << rmse << max_abs << endl;
     }
+    if (equal_passes > pixelSamples) cout << "(equal time: " << equal_passes << " passes)" << endl;
+    cout.unsetf(std::ios::floatfield);
+}
+
+// ====================== 光线树剪枝对比 ======================
+// 分布式柔光阴影渲染下比较三种光线树（完整 / 轮盘赌 / 单分支 + 轮盘赌）：每像素的追踪光线与阴影光线数、渲染时间，
+// 以及相对参考图像（完整光线树，像素采样 4 倍）的误差；完整光线树再渲染一次，作为同等采样下的噪声基线
+void report_ray_tree(const Camera &cam, const Scene &scene, const Accelerator *accel, int pixelSamples, int shadowSamples) {
+    const RayTreeMode saved = g_ray_tree;
+    Image reference(cam.res_x, cam.res_y);
+    g_ray_tree = RayTreeMode::FULL;
+    render_distributed_soft_shadows(cam, scene, reference, accel, pixelSamples * 4, shadowSamples);
+
+    struct Run { const char *name; RayTreeMode mode; };
+    const Run runs[] = {{"full", RayTreeMode::FULL}, {"full", RayTreeMode::FULL},
+                        {"roulette", RayTreeMode::ROULETTE}, {"branch", RayTreeMode::BRANCH}};
+    const double pixels = (double)cam.res_x * cam.res_y;
+
+    std::ostringstream table;
+    table << std::left << std::setw(10) << "ray tree" << std::setw(10) << "time_s" << std::setw(12) << "rays/px"
+          << std::setw(13) << "shadow/px" << std::setw(10) << "rmse" << "max_abs" << "\n";
+    for (const auto &run : runs) {
+        g_ray_tree = run.mode;
+        g_trace_rays = 0;
+        g_shadow_rays = 0;
+        g_count_rays = true;
+        Image img(cam.res_x, cam.res_y);
+        auto t0 = chrono::high_resolution_clock::now();
+        render_distributed_soft_shadows(cam, scene, img, accel, pixelSamples, shadowSamples);
+        auto t1 = chrono::high_resolution_clock::now();
+        g_count_rays = false;
+
+        double max_abs = 0.0;
+        double rmse = image_rmse(reference, img, max_abs);
+        table << std::left << std::setw(10) << run.name << std::fixed << std::setprecision(3)
+              << std::setw(10) << chrono::duration<double>(t1 - t0).count() << std::setprecision(1)
+              << std::setw(12) << g_trace_rays / pixels << std::setw(13) << g_shadow_rays / pixels
+              << std::setprecision(5) << std::setw(10) << rmse << max_abs << "\n";
+    }
+    g_ray_tree = saved;
+
+    cout << "\n=== Ray Tree Termination (" << cam.res_x << "x" << cam.res_y << ", " << pixelSamples
+         << " spp, " << shadowSamples << " shadow samples; roulette threshold " << ROULETTE_THRESHOLD
+         << "; reference: full tree at " << pixelSamples * 4 << " spp; second full run = noise floor) ===" << endl;
+    cout << table.str();
+}
 
-    IntersectFn intersect_fn;
-    if (use_bvh) {
-        BVH* bvh = bvh_ptr.get();
-        intersect_fn = [bvh](const Ray &r, const Scene &s, Hit &h) -> bool {
-            return bvh->intersect(r, h, s);
+// ====================== 路径追踪采样策略对比 ======================
+// 同样的每像素采样数下比较四种策略（均匀半球 / BSDF 重要性采样 / 只用光源采样 / MIS）的渲染时间和
+// 相对参考图像（MIS，像素采样 8 倍）的误差；MIS 再渲染一次作为同等采样下的噪声基线。
+// 点光源只能由光源采样得到，naive / bsdf 两行在含点光源的场景中会偏暗，误差同时包含这部分偏差
+void report_path_tracing(const Camera &cam, const Scene &scene, const Accelerator *accel, int pixelSamples) {
+    Image reference(cam.res_x, cam.res_y);
+    render_path_tracing(cam, scene, reference, accel, pixelSamples * 8, PathMode::MIS);
+
+    struct Run { const char *name; PathMode mode; };
+    const Run runs[] = {{"naive", PathMode::NAIVE}, {"bsdf", PathMode::BSDF}, {"nee", PathMode::NEE},
+                        {"mis", PathMode::MIS}, {"mis", PathMode::MIS}};
+
+    std::ostringstream table;
+    table << std::left << std::setw(10) << "strategy" << std::setw(10) << "time_s" << std::setw(12) << "rmse"
+          << "max_abs" << "\n";
+    for (const auto &run : runs) {
+        Image img(cam.res_x, cam.res_y);
+        auto t0 = chrono::high_resolution_clock::now();
+        render_path_tracing(cam, scene, img, accel, pixelSamples, run.mode);
+        auto t1 = chrono::high_resolution_clock::now();
+        double max_abs = 0.0;
+        double rmse = image_rmse(reference, img, max_abs);
+        table << std::left << std::setw(10) << run.name << std::fixed << std::setprecision(3)
+              << std::setw(10) << chrono::duration<double>(t1 - t0).count() << std::setprecision(5)
+              << std::setw(12) << rmse << max_abs << "\n";
+    }
+
+    cout << "\n=== Path Tracing Sampling Strategies (" << cam.res_x << "x" << cam.res_y << ", " << pixelSamples
+         << " spp; reference: mis at " << pixelSamples * 8 << " spp; second mis run = noise floor) ===" << endl;
+    cout << table.str();
+}
+
+// ====================== 渲染吞吐量与线程扩展 ======================
+// 进程的内存峰值（字节）：只增不减，按场景从小到大运行时即为目前最大场景的峰值
+static size_t peak_memory_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (size_t)usage.ru_maxrss * 1024; // Linux 下单位为 KiB
+#endif
+}
+
+// 对每个场景大小生成程序化场景（写到 scene_dir，与 Output 同级的 Textures 目录提供纹理；再经 load_scene_txt 加载，与正常渲染路径相同），
+// 在 1, 2, 4, ... 直到全部核心下依次用四种模式渲染，报告每秒光线数（追踪 + 阴影光线）、
+// 相对单线程的并行效率和进程内存峰值。采样数固定：whitted 为 render_bvh 自带的 16 spp，其余为 BENCH_SPP
+void report_throughput(const std::vector<int> &sizes, SceneGenOptions gen, const std::string &scene_dir) {
+    const int BENCH_SPP = 4, BENCH_SHADOW = 1;
+    std::vector<int> threads;
+    const int cores = omp_get_num_procs();
+    for (int t = 1; t < cores; t *= 2) threads.push_back(t);
+    threads.push_back(cores);
+
+    std::ostringstream table;
+    table << std::left << std::setw(9) << "objects" << std::setw(13) << "mode" << std::setw(9) << "threads"
+          << std::setw(10) << "time_s" << std::setw(10) << "Mrays/s" << std::setw(12) << "efficiency"
+          << std::setw(11) << "build_ms" << "peak_MiB" << "\n";
+    for (int size : sizes) {
+        gen.objects = size;
+        const std::string path = scene_dir + "/generated_" + std::to_string(size) + ".txt";
+        if (!write_generated_scene(path, gen)) return;
+        Scene scene = load_scene_txt(path);
+        Camera cam = *scene.camera;
+        cam.compute_basis();
+
+        auto b0 = chrono::high_resolution_clock::now();
+        BVH bvh;
+        bvh.build(scene);
+        auto b1 = chrono::high_resolution_clock::now();
+        const double build_ms = chrono::duration<double, std::milli>(b1 - b0).count();
+        std::unique_ptr<Accelerator> accel = make_accelerator(AcceleratorType::BVH, scene, bvh, BVHBuilder::SAH);
+        g_shadow_accel = accel.get();
+
+        struct Mode { const char *name; std::function<void(Image &)> render; };
+        const Mode modes[] = {
+            {"whitted", [&](Image &out) { render_bvh(cam, scene, out, *accel); }},
+            {"distributed", [&](Image &out) {
+                render_distributed_soft_shadows(cam, scene, out, accel.get(), BENCH_SPP, BENCH_SHADOW);
+            }},
+            {"restir", [&](Image &out) { render_restir(cam, scene, out, accel.get(), BENCH_SPP, BENCH_SHADOW); }},
+            {"path", [&](Image &out) { render_path_tracing(cam, scene, out, accel.get(), BENCH_SPP); }},
         };
+        for (const auto &mode : modes) {
+            double single = 0.0;
+            for (int t : threads) {
+                omp_set_num_threads(t);
+                g_trace_rays = 0;
+                g_shadow_rays = 0;
+                g_count_rays = true;
+                Image img(cam.res_x, cam.res_y);
+                auto t0 = chrono::high_resolution_clock::now();
+                mode.render(img);
+                auto t1 = chrono::high_resolution_clock::now();
+                g_count_rays = false;
+                const double seconds = chrono::duration<double>(t1 - t0).count();
+                if (t == 1) single = seconds;
+                table << std::left << std::setw(9) << size << std::setw(13) << mode.name << std::setw(9) << t
+                      << std::fixed << std::setprecision(3) << std::setw(10) << seconds << std::setprecision(2)
+                      << std::setw(10) << (g_trace_rays + g_shadow_rays) / seconds * 1e-6
+                      << std::setw(12) << single / (t * seconds) << std::setprecision(1) << std::setw(11) << build_ms
+                      << peak_memory_bytes() / (1024.0 * 1024.0) << "\n";
+                table.unsetf(std::ios::floatfield);
+            }
+        }
+    }
+    omp_set_num_threads(cores);
+    g_shadow_accel = nullptr;
+
+    cout << "\n=== Rendering Throughput (" << gen.res_x << "x" << gen.res_y << "; whitted 16 spp, others "
+         << BENCH_SPP << " spp, " << BENCH_SHADOW << " shadow sample; efficiency = t1 / (threads x tN)) ===" << endl;
+    cout << table.str();
+}
+
+#ifdef RT_STATS
+// ====================== 遍历代价热力图 ======================
+// 每像素遍历代价（节点访问 + 包围盒测试 + 图元求交，含该像素的全部次级光线和阴影光线）按对数映射到
+// 蓝 -> 青 -> 绿 -> 黄 -> 红，最大值取 99% 分位数，少数极端像素不会压暗整幅图
+void write_cost_heatmap(const std::vector<double> &costs, int width, int height, const std::string &path) {
+    std::vector<double> sorted(costs);
+    std::sort(sorted.begin(), sorted.end());
+    const double hi = std::log1p(sorted.empty() ? 0.0 : sorted[(size_t)((sorted.size() - 1) * 0.99)]);
+    const Vector3 ramp[] = {{0, 0, 0.5}, {0, 0.6, 1}, {0, 0.8, 0.2}, {1, 0.9, 0}, {1, 0, 0}};
+
+    Image heat(width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double v = hi > 0.0 ? std::min(std::log1p(costs[(size_t)y * width + x]) / hi, 1.0) : 0.0;
+            double s = v * 4.0;
+            int i = std::min((int)s, 3);
+            double f = s - i;
+            heat.set_pixel(x, y, ramp[i] * (1.0 - f) + ramp[i + 1] * f);
+        }
+    }
+    heat.write_ppm(path);
+
+    double total = 0.0;
+    for (double c : costs) total += c;
+    cout << "Cost heatmap: " << path << " (mean " << (costs.empty() ? 0.0 : total / costs.size())
+         << ", p99 " << std::expm1(hi) << ", max " << (sorted.empty() ? 0.0 : sorted.back()) << " per pixel)" << endl;
+}
+#endif
+
+// ====================== 收敛效率：误差 vs 时间 ======================
+// 与参考图像比较的误差。两幅图都按 write_ppm 的方式量化到 8 位（参考图像本身以 PPM 缓存），
+// 完全相同的渲染误差为 0。SSIM 在亮度上按 8x8 窗口、步长 4 计算（Wang et al. 2004）
+struct ImageError {
+    double rmse = 0.0;
+    double relmse = 0.0; // (x - r)^2 / (r^2 + 0.01) 的均值，暗部误差权重更高
+    double ssim = 0.0;
+};
+
+static double display_value(double v) { return std::clamp(int(v * 255.0), 0, 255) / 255.0; }
+
+static ImageError image_error(const Image &ref, const Image &img) {
+    const int w = ref.width, h = ref.height;
+    std::vector<double> lum_ref((size_t)w * h), lum_img((size_t)w * h);
+    double se = 0.0, rel = 0.0;
+#pragma omp parallel for reduction(+:se, rel)
+    for (int i = 0; i < w * h; i++) {
+        const double r[3] = {ref.pixels[i].r, ref.pixels[i].g, ref.pixels[i].b};
+        const double x[3] = {display_value(img.pixels[i].r), display_value(img.pixels[i].g),
+                             display_value(img.pixels[i].b)};
+        for (int k = 0; k < 3; k++) {
+            double d = x[k] - r[k];
+            se += d * d;
+            rel += d * d / (r[k] * r[k] + 0.01);
+        }
+        lum_ref[i] = luminance(Vector3(r[0], r[1], r[2]));
+        lum_img[i] = luminance(Vector3(x[0], x[1], x[2]));
+    }
+
+    const int WIN = 8, STEP = 4;
+    const double C1 = 0.01 * 0.01, C2 = 0.03 * 0.03;
+    double ssim_sum = 0.0;
+    long long windows = 0;
+#pragma omp parallel for reduction(+:ssim_sum, windows)
+    for (int y0 = 0; y0 <= h - WIN; y0 += STEP) {
+        for (int x0 = 0; x0 <= w - WIN; x0 += STEP) {
+            double ma = 0, mb = 0, va = 0, vb = 0, cov = 0;
+            for (int y = y0; y < y0 + WIN; y++) {
+                for (int x = x0; x < x0 + WIN; x++) {
+                    double a = lum_ref[(size_t)y * w + x], b = lum_img[(size_t)y * w + x];
+                    ma += a; mb += b; va += a * a; vb += b * b; cov += a * b;
+                }
+            }
+            const double n = WIN * WIN;
+            ma /= n; mb /= n;
+            va = va / n - ma * ma; vb = vb / n - mb * mb; cov = cov / n - ma * mb;
+            ssim_sum += ((2 * ma * mb + C1) * (2 * cov + C2)) / ((ma * ma + mb * mb + C1) * (va + vb + C2));
+            windows++;
+        }
+    }
+
+    ImageError e;
+    const double n = 3.0 * std::max(1, w * h);
+    e.rmse = std::sqrt(se / n);
+    e.relmse = rel / n;
+    e.ssim = windows > 0 ? ssim_sum / windows : 1.0;
+    return e;
+}
+
+// 由 CSV 中同一场景的全部记录重新生成 log-log 图（横轴秒，纵轴 RMSE），每个配置一条折线
+static void write_convergence_svg(const std::string &csv_path, const std::string &svg_path, const std::string &scene_key) {
+    std::ifstream in(csv_path);
+    std::map<std::string, std::vector<std::pair<double, double>>> series;
+    std::string line;
+    std::getline(in, line); // 表头
+    while (std::getline(in, line)) {
+        // scene,config,spp,seconds,rmse,relmse,ssim；config 两侧有引号，内部不含引号
+        size_t q0 = line.find('"'), q1 = line.find('"', q0 + 1);
+        if (q0 == std::string::npos || q1 == std::string::npos || line.substr(0, q0 - 1) != scene_key) continue;
+        double spp, seconds, rmse;
+        if (std::sscanf(line.c_str() + q1 + 1, ",%lf,%lf,%lf", &spp, &seconds, &rmse) != 3) continue;
+        if (seconds > 0.0 && rmse > 0.0) series[line.substr(q0 + 1, q1 - q0 - 1)].push_back({seconds, rmse});
+    }
+    if (series.empty()) return;
+
+    double x0 = 1e300, x1 = -1e300, y0 = 1e300, y1 = -1e300;
+    for (const auto &[name, points] : series) {
+        for (const auto &[s, e] : points) {
+            x0 = std::min(x0, std::log10(s)); x1 = std::max(x1, std::log10(s));
+            y0 = std::min(y0, std::log10(e)); y1 = std::max(y1, std::log10(e));
+        }
+    }
+    x0 = std::floor(x0); x1 = std::max(std::ceil(x1), x0 + 1);
+    y0 = std::floor(y0); y1 = std::max(std::ceil(y1), y0 + 1);
+    const double W = 640, H = 400, L = 60, B = 40, R = 220, T = 20;
+    auto px = [&](double v) { return L + (v - x0) / (x1 - x0) * (W - L - R); };
+    auto py = [&](double v) { return H - B - (v - y0) / (y1 - y0) * (H - B - T); };
+
+    std::ofstream out(svg_path);
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << W << "\" height=\"" << H
+        << "\" font-family=\"sans-serif\" font-size=\"11\">\n<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+    for (double v = x0; v <= x1; v += 1)
+        out << "<line x1=\"" << px(v) << "\" y1=\"" << T << "\" x2=\"" << px(v) << "\" y2=\"" << H - B
+            << "\" stroke=\"#ddd\"/><text x=\"" << px(v) << "\" y=\"" << H - B + 15 << "\" text-anchor=\"middle\">1e"
+            << v << " s</text>\n";
+    for (double v = y0; v <= y1; v += 1)
+        out << "<line x1=\"" << L << "\" y1=\"" << py(v) << "\" x2=\"" << W - R << "\" y2=\"" << py(v)
+            << "\" stroke=\"#ddd\"/><text x=\"" << L - 5 << "\" y=\"" << py(v) + 4 << "\" text-anchor=\"end\">1e"
+            << v << "</text>\n";
+    out << "<text x=\"" << (L + W - R) / 2 << "\" y=\"" << H - 5 << "\" text-anchor=\"middle\">render time</text>\n"
+        << "<text x=\"12\" y=\"" << (T + H - B) / 2 << "\" transform=\"rotate(-90 12 " << (T + H - B) / 2
+        << ")\" text-anchor=\"middle\">RMSE</text>\n";
+    const char *colors[] = {"#1f77b4", "#d62728", "#2ca02c", "#ff7f0e", "#9467bd", "#8c564b", "#e377c2", "#17becf"};
+    int index = 0;
+    for (auto &[name, points] : series) {
+        std::sort(points.begin(), points.end());
+        const char *color = colors[index % 8];
+        out << "<polyline fill=\"none\" stroke=\"" << color << "\" stroke-width=\"2\" points=\"";
+        for (const auto &[s, e] : points) out << px(std::log10(s)) << "," << py(std::log10(e)) << " ";
+        out << "\"/>\n<text x=\"" << W - R + 10 << "\" y=\"" << T + 15 * (index + 1) << "\" fill=\"" << color
+            << "\">" << (name.empty() ? "(default)" : name) << "</text>\n";
+        index++;
+    }
+    out << "</svg>\n";
+}
+
+// 参考图像按 场景内容哈希 + 渲染模式 + 分辨率 + 参考采样数 缓存在 Output 中，只在第一次渲染；
+// 同一模式下改变 --light-tree、--ray-tree 等子选项的运行共用同一参考（这些选项不改变期望值），便于直接比较。
+// 随后按 1, 2, 4, ... max_spp 的采样数渲染当前配置，记录时间和误差，追加到 CSV 并重新生成 SVG 图
+void report_convergence(const std::function<void(Image &, int)> &render, const Camera &cam,
+                        const std::string &scene_path, const std::string &mode, const std::string &config,
+                        int max_spp, int reference_spp) {
+    char scene_key[32];
+    std::snprintf(scene_key, sizeof(scene_key), "%016llx", (unsigned long long)hash_file(scene_path));
+    const std::string reference_path = "../Output/reference_" + mode + "_" + scene_key + "_" + std::to_string(cam.res_x)
+                                       + "x" + std::to_string(cam.res_y) + "_ps" + std::to_string(reference_spp) + ".ppm";
+    Image reference;
+    if (fs::exists(reference_path) && reference.load_ppm(reference_path) &&
+        reference.width == cam.res_x && reference.height == cam.res_y) {
+        cout << "Reference (cached): " << reference_path << endl;
     } else {
-        intersect_fn = [](const Ray &r, const Scene &s, Hit &h) -> bool {
-            return intersect_scene(r, s, h);
-        };
+        cout << "Rendering reference at " << reference_spp << " spp ..." << endl;
+        Image img(cam.res_x, cam.res_y);
+        auto t0 = chrono::high_resolution_clock::now();
+        render(img, reference_spp);
+        auto t1 = chrono::high_resolution_clock::now();
+        img.write_ppm(reference_path);
+        if (!reference.load_ppm(reference_path)) throw std::runtime_error("Cannot read back " + reference_path);
+        cout << "Reference written: " << reference_path << " (" << chrono::duration<double>(t1 - t0).count()
+             << " s)" << endl;
     }
 
+    const std::string csv_path = "../Output/convergence.csv", svg_path = "../Output/convergence.svg";
+    const bool new_csv = !fs::exists(csv_path);
+    std::ofstream csv(csv_path, std::ios::app);
+    if (!csv) throw std::runtime_error("Cannot open " + csv_path);
+    if (new_csv) csv << "scene,config,spp,seconds,rmse,relmse,ssim\n";
+
+    std::ostringstream table;
+    table << std::left << std::setw(8) << "spp" << std::setw(10) << "time_s" << std::setw(11) << "rmse"
+          << std::setw(11) << "relmse" << std::setw(9) << "ssim" << "rmse^2*s" << "\n";
+    for (int spp = 1; spp <= max_spp; spp *= 2) {
+        Image img(cam.res_x, cam.res_y);
+        auto t0 = chrono::high_resolution_clock::now();
+        render(img, spp);
+        auto t1 = chrono::high_resolution_clock::now();
+        const double seconds = chrono::duration<double>(t1 - t0).count();
+        ImageError e = image_error(reference, img);
+        // rmse^2 x 时间：方差与时间的乘积，越小越高效；无偏估计器的该值不随采样数变化
+        table << std::left << std::setw(8) << spp << std::fixed << std::setprecision(3) << std::setw(10) << seconds
+              << std::setprecision(5) << std::setw(11) << e.rmse << std::setw(11) << e.relmse << std::setprecision(4)
+              << std::setw(9) << e.ssim << std::scientific << std::setprecision(3) << e.rmse * e.rmse * seconds << "\n";
+        table.unsetf(std::ios::floatfield);
+        csv << scene_key << ",\"" << config << "\"," << spp << "," << seconds << "," << e.rmse << "," << e.relmse
+            << "," << e.ssim << "\n";
+    }
+    csv.close();
+    write_convergence_svg(csv_path, svg_path, scene_key);
+
+    cout << "\n=== Convergence (" << mode << (config.empty() ? "" : " " + config) << ", " << cam.res_x << "x"
+         << cam.res_y << "; reference " << reference_spp << " spp) ===" << endl;
+    cout << table.str();
+    cout << "Appended to " << csv_path << ", plot: " << svg_path << endl;
+}
+
+// ====================== 渲染使用特效 ======================
+void render_with_effects(const Camera &cam, const Scene &scene, Image &img, const Accelerator *accel = nullptr) {
+    const int SAMPLES = 16;
+
+    IntersectFn intersect_fn = make_intersect_fn(accel);
+
     auto tracer = make_tracer(scene, intersect_fn);
 
     // 计算透镜半径
     Camera& mutable_cam = const_cast<Camera&>(cam);
     mutable_cam.compute_lens_radius();
 
+    const PixelRange range = pixel_range(cam);
     #pragma omp parallel for schedule(dynamic, 4)
-    for (int y = 0; y < cam.res_y; y++) {
+    for (int y = range.y0; y < range.y1; y++) {
+        TIMELINE_SCOPE("row", y);
+        if (g_render_cancel.load(std::memory_order_relaxed)) continue;
         std::random_device rd;
         std::mt19937 gen(rd() + omp_get_thread_num());
         std::uniform_real_distribution<> dis(0.0, 1.0);
 
-        for (int x = 0; x < cam.res_x; x++) {
+        for (int x = range.x0; x < range.x1; x++) {
+            if (!range.contains(x, y)) continue;
+            RT_STAT_PIXEL(x, y);
             Vector3 color_sum{0,0,0};
 
             for (int s = 0; s < SAMPLES; s++) {
@@ -488,27 +1678,10 @@ void render_with_effects(const Camera &cam, const Scene &scene, Image &img, bool
 
 // ====================== 分布式渲染 + 动态模糊函数 ======================
 void render_distributed_with_motion_blur(const Camera &cam, const Scene &scene, Image &img,
-                                         bool use_bvh = true, int pixelSamples = 16,
+                                         const Accelerator *accel = nullptr, int pixelSamples = 16,
                                          int shadowSamples = 8) {
 
-    // 创建BVH对象（如果需要）
-    std::unique_ptr<BVH> bvh_ptr;
-    if (use_bvh) {
-        bvh_ptr = std::make_unique<BVH>();
-        bvh_ptr->build(scene);
-    }
-
-    IntersectFn intersect_fn;
-    if (use_bvh) {
-        BVH* bvh = bvh_ptr.get();
-        intersect_fn = [bvh](const Ray &r, const Scene &s, Hit &h) -> bool {
-            return bvh->intersect(r, h, s);
-        };
-    } else {
-        intersect_fn = [](const Ray &r, const Scene &s, Hit &h) -> bool {
-            return intersect_scene(r, s, h);
-        };
-    }
+    IntersectFn intersect_fn = make_intersect_fn(accel);
 
     // 创建分布式追踪器
     auto tracer = make_distributed_tracer(scene, intersect_fn, shadowSamples);
@@ -517,14 +1690,19 @@ void render_distributed_with_motion_blur(const Camera &cam, const Scene &scene,
     Camera& mutable_cam = const_cast<Camera&>(cam);
     mutable_cam.compute_lens_radius();
 
+    const PixelRange range = pixel_range(cam);
 #pragma omp parallel for schedule(dynamic, 4)
-    for (int y = 0; y < cam.res_y; y++) {
+    for (int y = range.y0; y < range.y1; y++) {
+        TIMELINE_SCOPE("row", y);
+        if (g_render_cancel.load(std::memory_order_relaxed)) continue;
         // 每个线程自己的随机数生成器
         std::random_device rd;
         std::mt19937 rng(rd() + omp_get_thread_num());
         std::uniform_real_distribution<> dis(0.0, 1.0);
 
-        for (int x = 0; x < cam.res_x; x++) {
+        for (int x = range.x0; x < range.x1; x++) {
+            if (!range.contains(x, y)) continue;
+            RT_STAT_PIXEL(x, y);
             Vector3 color_sum{0,0,0};
 
             for (int s = 0; s < pixelSamples; s++) {
@@ -551,35 +1729,290 @@ void render_distributed_with_motion_blur(const Camera &cam, const Scene &scene,
                 );
 
                 // 使用分布式追踪器追踪光线
-                color_sum += tracer(ray, 0, rng);
+                color_sum += tracer(ray, 0, rng, 1.0);
             }
 
             Vector3 color = color_sum * (1.0 / pixelSamples);
             img.set_pixel(x, y, color);
         }
 
+        if (y % 50 == 0) {
 #pragma omp critical
+            cout << "[Distributed + Motion Blur] row " << y << "/" << cam.res_y
+                 << " (samples=" << pixelSamples << ")" << endl;
+        }
+    }
+}
+
+// ====================== 多相机批量渲染 ======================
+// 按模式名（whitted / distributed / restir / path）构造渲染函数，批量渲染和渲染服务器共用；cam 按引用捕获
+std::function<void(Image &)> make_mode_render(const std::string &mode, const Camera &cam, const Scene &scene,
+                                              const Accelerator *accel, int spp, int shadow) {
+    if (mode == "whitted") return [&cam, &scene, accel](Image &out) {
+        if (accel) render_bvh(cam, scene, out, *accel);
+        else render_no_bvh(cam, scene, out);
+    };
+    if (mode == "distributed") return [&cam, &scene, accel, spp, shadow](Image &out) {
+        render_distributed_soft_shadows(cam, scene, out, accel, spp, shadow);
+    };
+    if (mode == "restir") return [&cam, &scene, accel, spp, shadow](Image &out) {
+        render_restir(cam, scene, out, accel, spp, shadow);
+    };
+    if (mode == "path") return [&cam, &scene, accel, spp](Image &out) {
+        render_path_tracing(cam, scene, out, accel, spp);
+    };
+    throw std::runtime_error("unknown mode " + mode);
+}
+
+struct BatchJob {
+    size_t camera;      // scene.cameras 下标
+    std::string mode;   // 空表示命令行选择的模式
+    int spp = 0;        // <= 0 表示命令行的采样数
+    std::string output;
+};
+
+// 任务列表：每行 "<相机名或下标> [模式|-] [采样数|-] [输出文件]"，# 开头为注释。
+// 省略输出文件时为 ../Output/batch_<行号>_<相机>_<模式>.ppm
+std::vector<BatchJob> load_batch_jobs(const std::string &path, const Scene &scene) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Cannot open job list " + path);
+    std::vector<BatchJob> jobs;
+    std::string line;
+    int line_no = 0;
+    while (std::getline(in, line)) {
+        line_no++;
+        std::istringstream iss(line);
+        std::string camera, mode = "-", spp = "-";
+        if (!(iss >> camera) || camera[0] == '#') continue;
+        BatchJob job;
+        iss >> mode >> spp >> job.output;
+        auto it = std::find_if(scene.cameras.begin(), scene.cameras.end(),
+                               [&](const auto &c) { return c->name == camera; });
+        if (it != scene.cameras.end()) job.camera = it - scene.cameras.begin();
+        else if (std::all_of(camera.begin(), camera.end(), ::isdigit) && std::stoul(camera) < scene.cameras.size())
+            job.camera = std::stoul(camera);
+        else throw std::runtime_error(path + ":" + std::to_string(line_no) + ": unknown camera " + camera);
+        if (mode != "-") job.mode = mode;
+        if (spp != "-") job.spp = std::stoi(spp);
+        if (job.output.empty())
+            job.output = "../Output/batch_" + std::to_string(line_no) + "_" + scene.cameras[job.camera]->name + "_" +
+                         (job.mode.empty() ? "default" : job.mode) + ".ppm";
+        jobs.push_back(job);
+    }
+    if (jobs.empty()) throw std::runtime_error("Job list " + path + " is empty");
+    return jobs;
+}
+
+// 依次渲染各任务：场景、纹理、BVH 和 OpenMP 线程池在全部任务间共享，只切换相机和模式。
+// 上一幅图像在后台线程写出的同时开始渲染下一个任务（同 render_sequence）。
+// cam / pixel_samples 是 default_render 按引用捕获的变量，未指定模式的任务通过修改它们复用命令行的渲染设置
+void render_batch(const Scene &scene, const Accelerator *accel, const std::vector<BatchJob> &jobs, Camera &cam,
+                  int &pixel_samples, int shadow_samples, const std::function<void(Image &)> &default_render) {
+    const int default_spp = pixel_samples;
+    std::future<void> pending_write;
+    std::ostringstream table;
+    table << std::left << std::setw(5) << "job" << std::setw(16) << "camera" << std::setw(13) << "mode"
+          << std::setw(6) << "spp" << std::setw(11) << "res" << std::setw(10) << "render_s" << "output" << "\n";
+    auto batch_start = chrono::high_resolution_clock::now();
+    for (size_t j = 0; j < jobs.size(); j++) {
+        const BatchJob &job = jobs[j];
+        TIMELINE_SCOPE("batch.job", (int)j);
+        cam = *scene.cameras[job.camera];
+        cam.compute_basis();
+        cam.compute_lens_radius();
+        pixel_samples = job.spp > 0 ? job.spp : default_spp;
+        std::function<void(Image &)> render =
+            job.mode.empty() ? default_render : make_mode_render(job.mode, cam, scene, accel, pixel_samples, shadow_samples);
+
+        auto img = std::make_shared<Image>(cam.res_x, cam.res_y);
+        const long long frame_bytes = (long long)img->memory_bytes();
+        mem_add(MemTag::FRAMEBUFFER, frame_bytes);
+        auto t0 = chrono::high_resolution_clock::now();
+        render(*img);
+        auto t1 = chrono::high_resolution_clock::now();
+
+        if (pending_write.valid()) {
+            TIMELINE_SCOPE("image.write.wait", (int)j);
+            pending_write.get();
+        }
+        std::string name = job.output;
+        pending_write = std::async(std::launch::async, [img, name, j, frame_bytes]() {
+            TIMELINE_SCOPE("image.write", (int)j);
+            img->write_ppm(name);
+            mem_add(MemTag::FRAMEBUFFER, -frame_bytes);
+        });
+
+        const double seconds = chrono::duration<double>(t1 - t0).count();
+        cout << "[Batch] job " << j << ": " << cam.name << " " << (job.mode.empty() ? "default" : job.mode) << " "
+             << seconds << " s -> " << name << endl;
+        table << std::left << std::setw(5) << j << std::setw(16) << cam.name << std::setw(13)
+              << (job.mode.empty() ? "default" : job.mode) << std::setw(6) << pixel_samples << std::setw(11)
+              << (std::to_string(cam.res_x) + "x" + std::to_string(cam.res_y)) << std::fixed << std::setprecision(3)
+              << std::setw(10) << seconds << name << "\n";
+        table.unsetf(std::ios::floatfield);
+    }
+    if (pending_write.valid()) pending_write.get();
+    pixel_samples = default_spp;
+
+    auto batch_end = chrono::high_resolution_clock::now();
+    cout << "\n=== Batch Complete (" << jobs.size() << " jobs, "
+         << chrono::duration<double>(batch_end - batch_start).count() << " s) ===" << endl;
+    cout << table.str();
+}
+
+// ====================== 多帧序列渲染 ======================
+// 场景、纹理和 OpenMP 线程池在各帧之间保持常驻：每帧先按关键帧移动物体，
+// 然后更新加速结构：BVH 自底向上 refit，SAH 代价劣化超过 BVHAccelerator::REBUILD_RATIO 倍时才完整重建，
+// 网格和 kd 树每帧重建。第 N 帧在后台线程写盘，同时渲染第 N+1 帧。
+
+std::string frame_filename(const std::string &base, int frame) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_frame%04d", frame);
+    fs::path p(base);
+    return (p.parent_path() / (p.stem().string() + suffix + p.extension().string())).string();
+}
+
+void render_sequence(Scene &scene, Accelerator &accel,
+                     int frame_start, int frame_count, const std::string &output_base,
+                     const std::function<void(Image &)> &render_frame, const std::string &composite_path = "") {
+    const Camera &cam = *scene.camera;
+    std::future<void> pending_write;
+
+    auto seq_start = chrono::high_resolution_clock::now();
+    for (int f = frame_start; f < frame_start + frame_count; f++) {
+        TIMELINE_SCOPE("frame", f);
+        auto t0 = chrono::high_resolution_clock::now();
+
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < (int)scene.objects.size(); i++) {
+            scene.objects[i]->animate(f);
+        }
+
+        std::string accel_action;
         {
-            if (y % 50 == 0)
-                cout << "[Distributed + Motion Blur] row " << y << "/" << cam.res_y
-                     << " (samples=" << pixelSamples << ")" << endl;
+            TIMELINE_SCOPE("accel.update", f);
+            accel_action = accel.update(scene);
         }
+        auto t1 = chrono::high_resolution_clock::now();
+
+        auto img = std::make_shared<Image>(cam.res_x, cam.res_y);
+        // 帧缓冲在后台写完后才释放：渲染下一帧时同时存在两份
+        const long long frame_bytes = (long long)img->memory_bytes();
+        mem_add(MemTag::FRAMEBUFFER, frame_bytes);
+        render_frame(*img);
+        auto t2 = chrono::high_resolution_clock::now();
+
+        // 等待上一帧写完，再把这一帧交给后台线程
+        if (pending_write.valid()) {
+            TIMELINE_SCOPE("image.write.wait", f);
+            pending_write.get();
+        }
+        // 区域渲染的每一帧都裁剪输出，或合成进同一幅整幅图像（各帧分别写出）
+        const std::string frame_name = frame_filename(output_base, f);
+        const std::string name = g_region.cropped ? region_output_name(frame_name, composite_path) : frame_name;
+        pending_write = std::async(std::launch::async, [img, frame_name, composite_path, f, frame_bytes]() {
+            TIMELINE_SCOPE("image.write", f);
+            if (g_region.cropped) write_region_output(*img, frame_name, composite_path);
+            else img->write_ppm(frame_name);
+            mem_add(MemTag::FRAMEBUFFER, -frame_bytes);
+        });
+
+        cout << "[Sequence] frame " << f << ": update " << chrono::duration<double, std::milli>(t1 - t0).count()
+             << " ms (" << accel.name() << " " << accel_action << "), render " << chrono::duration<double>(t2 - t1).count()
+             << " s -> " << name << endl;
     }
+    if (pending_write.valid()) pending_write.get();
+
+    auto seq_end = chrono::high_resolution_clock::now();
+    cout << "\n=== Sequence Complete ===" << endl;
+    cout << "Frames: " << frame_count << endl;
+    cout << "Time: " << chrono::duration<double>(seq_end - seq_start).count() << " seconds" << endl;
 }
 
 // ====================== Main ======================
+// ====================== 场景加载 ======================
+// 场景 + BVH：优先从二进制缓存内存映射加载，未命中时解析文本、构建 BVH 并写回缓存；返回是否命中缓存。
+// bvh 的 unbounded_fraction / use_float_nodes 须在调用前设置
+bool load_scene_and_bvh(const std::string &path, Scene &scene, BVH &bvh, BVHBuilder builder, bool use_cache) {
+    const string cache_path = scene_cache_path(path);
+    auto load_start = chrono::high_resolution_clock::now();
+    bool cache_hit;
+    {
+        TIMELINE_SCOPE("scene.cache_load");
+        cache_hit = use_cache && load_scene_cache(cache_path, scene, bvh, builder);
+    }
+    if (cache_hit) {
+        cout << "Scene cache hit: " << cache_path << endl;
+        cout << "Scene loaded: " << scene.objects.size() << " objects, "
+             << scene.lights.size() << " lights, " << scene.textures.size() << " textures." << endl;
+    } else {
+        cout << "Loading scene: " << path << " ..." << endl;
+        {
+            TIMELINE_SCOPE("scene.parse");
+            scene = load_scene_txt(path);
+        }
+        bvh.build(scene, builder);
+    }
+    auto load_end = chrono::high_resolution_clock::now();
+    cout << "Startup (" << (cache_hit ? "warm, from cache" : "cold, text + BVH build") << "): "
+         << chrono::duration<double>(load_end - load_start).count() << " seconds" << endl;
+
+    if (use_cache && !cache_hit) {
+        TIMELINE_SCOPE("scene.cache_write");
+        if (write_scene_cache(cache_path, path, scene, bvh, builder))
+            cout << "Scene cache written: " << cache_path << endl;
+    }
+    return cache_hit;
+}
+
 int main(int argc, char* argv[]) {
     try {
         // 默认参数设置
         bool use_bvh = true;
         bool use_motion_blur = false;
         bool use_distributed = false;
+        bool use_scene_cache = true;
+        std::string trace_path;              // 非空时记录时间线并在退出时写出 Chrome trace JSON
+        bool watch = false;                  // --watch：渐进渲染并在场景文件改变时热重载
+        bool batch = false;                  // --batch：渲染场景中的每个相机，或 batch_path 任务列表中的每个任务
+        std::string batch_path;
+        std::string crop_arg, mask_path;    // 裁剪矩形 x0,y0,x1,y1 / 逐像素掩码（PPM，亮度 > 0.5 的像素追踪）
+        std::string composite_path;          // 非空时把区域合成到这幅整幅图像中输出，否则输出裁剪后的图像
+        std::string server_socket;           // 非空时作为常驻渲染服务器运行
+        bool memory_report = false;          // 渲染结束后输出按子系统的内存占用
+        std::string memory_json;             // 非空时同时写出 JSON
+        bool bvh_report = false;
+        int instancing_demo = 0; // >0 时运行合成实例化演示
+        BVHBuilder bvh_builder = BVHBuilder::SAH;
+        AcceleratorType accel_type = AcceleratorType::BVH;
+        double bvh_unbounded = 0.0; // >0 时大图元放入无界列表
+        int frame_count = 0;     // >0 时渲染多帧序列
+        int frame_start = 0;
         int shadow_samples = 4;  // 分布式渲染的阴影采样数
         int pixel_samples = 16;  // 每个像素的采样数
+        bool precision_report = false;
+        bool use_light_tree = false;
+        bool use_restir = false;
+        bool ray_tree_report = false;
+        bool restir_report = false;
+        bool light_report = false;
+        bool use_path_tracing = false;
+        bool path_report = false;
+        PathMode path_mode = PathMode::MIS;
+        SceneGenOptions gen_options;
+        std::string generate_path;           // 非空时写出程序化场景后退出
+        std::vector<int> throughput_sizes;   // 非空时运行吞吐量基准后退出
+        bool print_stats = false;            // 渲染后输出统计计数和代价热力图（需要 RT_STATS 构建）
+        int convergence_spp = 0;             // >0 时运行收敛效率测试（最大采样数）后退出
+        int convergence_reference = 1024;
+        std::string config_label;            // 收敛测试中标记配置：除收敛参数外的全部命令行参数
 
         // 解析命令行参数
         for (int i = 1; i < argc; i++) {
             std::string arg = argv[i];
+            if (arg.rfind("--convergence", 0) != 0 && !(i > 1 && std::string(argv[i - 1]).rfind("--convergence", 0) == 0
+                                                       && std::isdigit(static_cast<unsigned char>(arg[0]))))
+                config_label += (config_label.empty() ? "" : " ") + arg;
 
             if (arg == "--no-bvh") {
                 use_bvh = false;
@@ -597,6 +2030,190 @@ int main(int argc, char* argv[]) {
                 use_distributed = true;
                 std::cout << "Distributed rendering enabled" << std::endl;
             }
+            else if (arg == "--stats") {
+                print_stats = true;
+            }
+            else if (arg == "--watch") {
+                watch = true;
+            }
+            else if (arg == "--batch") {
+                batch = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-') batch_path = argv[++i];
+            }
+            else if (arg == "--crop" && i + 1 < argc) {
+                crop_arg = argv[++i];
+            }
+            else if (arg == "--mask" && i + 1 < argc) {
+                mask_path = argv[++i];
+            }
+            else if (arg == "--composite" && i + 1 < argc) {
+                composite_path = argv[++i];
+            }
+            else if (arg == "--server" && i + 1 < argc) {
+                server_socket = argv[++i];
+            }
+            else if (arg == "--memory-report") {
+                memory_report = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-') memory_json = argv[++i];
+            }
+            else if (arg == "--trace" && i + 1 < argc) {
+                trace_path = argv[++i];
+            }
+            else if (arg == "--no-cache") {
+                use_scene_cache = false;
+                std::cout << "Scene cache disabled" << std::endl;
+            }
+            else if (arg == "--bvh-builder" && i + 1 < argc) {
+                std::string name = argv[++i];
+                if (name == "sah") bvh_builder = BVHBuilder::SAH;
+                else if (name == "lbvh") bvh_builder = BVHBuilder::LBVH;
+                else if (name == "sbvh") bvh_builder = BVHBuilder::SBVH;
+                else {
+                    std::cerr << "Unknown BVH builder: " << name << " (expected sah, lbvh or sbvh)" << std::endl;
+                    return 1;
+                }
+                std::cout << "BVH builder: " << name << std::endl;
+            }
+            else if (arg == "--accel" && i + 1 < argc) {
+                std::string name = argv[++i];
+                if (!parse_accelerator(name, accel_type)) {
+                    std::cerr << "Unknown accelerator: " << name << " (expected bvh, grid, kdtree, brute or auto)" << std::endl;
+                    return 1;
+                }
+                use_bvh = accel_type != AcceleratorType::BRUTE;
+                std::cout << "Accelerator: " << name << std::endl;
+            }
+            else if (arg == "--bvh-unbounded") {
+                bvh_unbounded = 0.1;
+                if (i + 1 < argc && (std::isdigit(static_cast<unsigned char>(argv[i + 1][0])) || argv[i + 1][0] == '.'))
+                    bvh_unbounded = std::stod(argv[++i]);
+                std::cout << "BVH unbounded list: primitives larger than " << bvh_unbounded
+                          << " of the scene surface area" << std::endl;
+            }
+            else if (arg == "--frames" && i + 1 < argc) {
+                frame_count = std::stoi(argv[++i]);
+                std::cout << "Frames: " << frame_count << std::endl;
+            }
+            else if (arg == "--frame-start" && i + 1 < argc) {
+                frame_start = std::stoi(argv[++i]);
+            }
+            else if (arg == "--precision" && i + 1 < argc) {
+                std::string name = argv[++i];
+                if (name != "float" && name != "double") {
+                    std::cerr << "Unknown precision: " << name << " (expected float or double)" << std::endl;
+                    return 1;
+                }
+                g_float_path = name == "float";
+                std::cout << "Intersection precision: " << name << std::endl;
+            }
+            else if (arg == "--precision-report") {
+                precision_report = true;
+            }
+            else if (arg == "--light-tree") {
+                use_light_tree = true;
+                std::cout << "Light tree sampling enabled" << std::endl;
+            }
+            else if (arg == "--ray-tree" && i + 1 < argc) {
+                std::string name = argv[++i];
+                if (name == "full") g_ray_tree = RayTreeMode::FULL;
+                else if (name == "roulette") g_ray_tree = RayTreeMode::ROULETTE;
+                else if (name == "branch") g_ray_tree = RayTreeMode::BRANCH;
+                else {
+                    std::cerr << "Unknown ray tree mode: " << name << " (expected full, roulette or branch)" << std::endl;
+                    return 1;
+                }
+                std::cout << "Ray tree: " << name << std::endl;
+            }
+            else if (arg == "--ray-tree-report") {
+                ray_tree_report = true;
+            }
+            else if (arg == "--restir") {
+                use_restir = true;
+                std::cout << "ReSTIR direct lighting enabled" << std::endl;
+            }
+            else if (arg == "--restir-report") {
+                restir_report = true;
+            }
+            else if (arg == "--path-trace") {
+                use_path_tracing = true;
+                if (i + 1 < argc && argv[i + 1][0] != '-') {
+                    std::string name = argv[++i];
+                    if (name == "naive") path_mode = PathMode::NAIVE;
+                    else if (name == "bsdf") path_mode = PathMode::BSDF;
+                    else if (name == "nee") path_mode = PathMode::NEE;
+                    else if (name == "mis") path_mode = PathMode::MIS;
+                    else {
+                        std::cerr << "Unknown path sampling strategy: " << name
+                                  << " (expected naive, bsdf, nee or mis)" << std::endl;
+                        return 1;
+                    }
+                }
+                std::cout << "Path tracing enabled" << std::endl;
+            }
+            else if (arg == "--path-report") {
+                path_report = true;
+            }
+            else if (arg == "--generate-scene" && i + 1 < argc) {
+                generate_path = argv[++i];
+            }
+            else if (arg == "--gen-objects" && i + 1 < argc) {
+                gen_options.objects = std::stoi(argv[++i]);
+            }
+            else if (arg == "--gen-lights" && i + 1 < argc) {
+                gen_options.lights = std::stoi(argv[++i]);
+            }
+            else if (arg == "--gen-textured" && i + 1 < argc) {
+                gen_options.textured_fraction = std::stod(argv[++i]);
+            }
+            else if (arg == "--gen-materials" && i + 1 < argc) {
+                // 反射比例,折射比例
+                std::string spec = argv[++i];
+                if (std::sscanf(spec.c_str(), "%lf,%lf", &gen_options.reflective_fraction,
+                                &gen_options.refractive_fraction) != 2) {
+                    std::cerr << "Invalid material mix: " << spec << " (expected R,T, e.g. 0.3,0.1)" << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--gen-shapes" && i + 1 < argc) {
+                // 球,长方体,四边形 的权重
+                std::string spec = argv[++i];
+                if (std::sscanf(spec.c_str(), "%lf,%lf,%lf", &gen_options.sphere_weight, &gen_options.cube_weight,
+                                &gen_options.plane_weight) != 3) {
+                    std::cerr << "Invalid shape mix: " << spec << " (expected S,C,P, e.g. 5,3,2)" << std::endl;
+                    return 1;
+                }
+            }
+            else if (arg == "--gen-seed" && i + 1 < argc) {
+                gen_options.seed = (unsigned)std::stoul(argv[++i]);
+            }
+            else if (arg == "--throughput-bench") {
+                throughput_sizes = {100, 1000, 10000};
+                if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0]))) {
+                    throughput_sizes.clear();
+                    std::stringstream list(argv[++i]);
+                    std::string item;
+                    while (std::getline(list, item, ',')) throughput_sizes.push_back(std::stoi(item));
+                }
+            }
+            else if (arg == "--convergence") {
+                convergence_spp = 64;
+                if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+                    convergence_spp = std::stoi(argv[++i]);
+            }
+            else if (arg == "--convergence-ref" && i + 1 < argc) {
+                convergence_reference = std::stoi(argv[++i]);
+            }
+            else if (arg == "--light-report") {
+                light_report = true;
+            }
+            else if (arg == "--bvh-report") {
+                bvh_report = true;
+            }
+            else if (arg == "--instancing-demo") {
+                instancing_demo = 100000;
+                if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+                    instancing_demo = std::stoi(argv[++i]);
+            }
             else if (arg == "--shadow-samples" && i + 1 < argc) {
                 shadow_samples = std::stoi(argv[++i]);
                 std::cout << "Shadow samples: " << shadow_samples << std::endl;
@@ -608,6 +2225,53 @@ int main(int argc, char* argv[]) {
                           << "  --motion-blur        Enable motion blur effects\n"
                           << "  --distributed        Enable distributed rendering with soft shadows\n"
                           << "  --shadow-samples N   Number of shadow samples (default: 4)\n"
+                          << "  --ray-tree M         Reflection/refraction tree: full (default), roulette (Russian roulette on\n"
+                          << "                       low-weight branches) or branch (one branch per hit by material weight)\n"
+                          << "  --ray-tree-report    Compare ray tree modes: rays per pixel, render time and image error, then exit\n"
+                          << "  --restir             Direct light by reservoir resampling with spatial/temporal reuse (one pass per pixel sample)\n"
+                          << "  --restir-report      Compare ReSTIR and distributed soft shadows against a reference at equal time, then exit\n"
+                          << "  --path-trace [S]     Path tracing with indirect light; S: mis (default, light + BSDF sampling),\n"
+                          << "                       nee (light sampling only), bsdf or naive (no light sampling)\n"
+                          << "  --path-report        Compare path tracing sampling strategies at equal spp, then exit\n"
+                          << "  --light-tree         Pick one light per shadow sample by importance (light BVH) instead of sampling every light\n"
+                          << "  --light-report       Compare per-light and light-tree sampling cost and error as the light count grows, then exit\n"
+                          << "  --generate-scene F   Write a procedural scene to F and exit; shaped by --gen-objects N,\n"
+                          << "                       --gen-lights N, --gen-textured F, --gen-materials R,T (reflective,\n"
+                          << "                       refractive fractions), --gen-shapes S,C,P (weights) and --gen-seed S\n"
+                          << "  --throughput-bench [N,N,...] Render generated scenes of N objects (default 100,1000,10000)\n"
+                          << "                       in every mode at 1..all threads: Mrays/s, parallel efficiency, peak memory\n"
+                          << "  --convergence [N]    Render the selected mode (--distributed, --restir or --path-trace) at\n"
+                          << "                       1, 2, 4 .. N spp (default 64): RMSE, relMSE and SSIM vs. time against a\n"
+                          << "                       cached reference; appends to Output/convergence.csv and plots convergence.svg\n"
+                          << "  --convergence-ref N  Reference samples per pixel (default 1024)\n"
+                          << "  --stats              Print per-ray counters (rays by type, BVH nodes, AABB and primitive tests,\n"
+                          << "                       shadow early-outs) and write a traversal-cost heatmap *_cost.ppm;\n"
+                          << "                       needs a build configured with -DRT_STATS=ON\n"
+                          << "  --watch              Progressive render that restarts when the scene file, its textures\n"
+                          << "                       or meshes change; only changed objects are updated in the BVH\n"
+                          << "  --batch [JOBS]       Render every camera in the scene, or each line of JOBS:\n"
+                          << "                       <camera name|index> [mode|-] [spp|-] [output.ppm]\n"
+                          << "                       (mode: whitted, distributed, restir, path; - = command-line mode)\n"
+                          << "  --crop X0,Y0,X1,Y1   Only trace pixels in [X0,X1) x [Y0,Y1) of the full-frame projection\n"
+                          << "  --mask FILE.ppm      Only trace pixels whose mask luminance is > 0.5 (full-frame size)\n"
+                          << "  --composite F.ppm    Paste the rendered region into full frame F instead of writing a crop\n"
+                          << "  --server SOCKET      Run as a resident render server on a Unix socket: scenes, BVHs and\n"
+                          << "                       accelerators stay loaded; jobs (scene, camera overrides, mode, spp,\n"
+                          << "                       region) are queued and finished tiles streamed back (protocol in main.cpp)\n"
+                          << "  --memory-report [F]  After the render print current / peak bytes per subsystem (scene objects,\n"
+                          << "                       BVH, textures, meshes, framebuffer, render buffers, caches); F = JSON file\n"
+                          << "  --trace FILE         Record load / BVH build / per-row render / write phases of every thread\n"
+                          << "                       and write them as Chrome trace-event JSON (chrome://tracing, Perfetto)\n"
+                          << "  --no-cache           Ignore and do not write the binary scene cache\n"
+                          << "  --accel A            Acceleration structure: bvh (default), grid, kdtree, brute or auto\n"
+                          << "  --bvh-builder B      BVH builder: sah (default), lbvh (fastest build) or sbvh (spatial splits)\n"
+                          << "  --bvh-unbounded [F]  Test primitives larger than F of the scene area before traversal (default 0.1)\n"
+                          << "  --precision P        Intersection precision: double (default) or float\n"
+                          << "  --precision-report   Compare float and double paths (trace speed, hit and image error), then exit\n"
+                          << "  --frames N           Render an N-frame keyframed sequence (BVH refit between frames)\n"
+                          << "  --frame-start F      First frame number of the sequence (default: 0)\n"
+                          << "  --bvh-report         Report BVH build time, SAH cost and trace speed, then exit\n"
+                          << "  --instancing-demo [N] Synthetic N-instance scene (default 100000): memory and trace speed\n"
                           << "  --help               Show this help message\n";
                 return 0;
             }
@@ -618,11 +2282,64 @@ int main(int argc, char* argv[]) {
             }
         }
 
+        if (instancing_demo > 0) {
+            report_instancing(instancing_demo);
+            return 0;
+        }
+
         const string input_path  = "../ASCII/scene.txt";
+        // 时间线：任何返回路径（含各报告）退出 main 时写出
+        struct TimelineExport {
+            std::string path;
+            ~TimelineExport() {
+                if (path.empty()) return;
+                if (timeline_write_chrome(path)) cout << "Timeline written: " << path << endl;
+                else cerr << "Error: cannot write timeline " << path << endl;
+            }
+        } timeline_export{trace_path};
+        if (!trace_path.empty()) timeline_enable();
+
+#ifndef RT_STATS
+        if (print_stats) {
+            cerr << "Error: --stats needs a build with render statistics (cmake -DRT_STATS=ON)" << endl;
+            return 1;
+        }
+#endif
         fs::create_directories("../Output");
 
-        cout << "Loading scene: " << input_path << " ..." << endl;
-        Scene scene = load_scene_txt(input_path);
+        if (!generate_path.empty()) {
+            if (!write_generated_scene(generate_path, gen_options)) return 1;
+            cout << "Scene written: " << generate_path << " (" << gen_options.objects << " objects, "
+                 << gen_options.lights << " lights)" << endl;
+            return 0;
+        }
+
+        if (!throughput_sizes.empty()) {
+            report_throughput(throughput_sizes, gen_options, "../Output");
+            return 0;
+        }
+
+        if (!server_socket.empty()) {
+            ServerOptions server_opt;
+            server_opt.builder = bvh_builder;
+            server_opt.accel = use_bvh ? accel_type : AcceleratorType::BRUTE;
+            server_opt.bvh_unbounded = bvh_unbounded;
+            server_opt.use_scene_cache = use_scene_cache;
+            return run_render_server(server_socket, server_opt);
+        }
+
+        Scene scene;
+        BVH bvh;
+        bvh.unbounded_fraction = bvh_unbounded;
+        bvh.use_float_nodes = g_float_path;
+        load_scene_and_bvh(input_path, scene, bvh, bvh_builder, use_scene_cache);
+        mem_account_scene(scene);
+        mem_set(MemTag::BVH, bvh.memory_bytes());
+
+        if (bvh_report) {
+            report_bvh_build(scene);
+            return 0;
+        }
 
         if (!scene.camera) {
             cerr << "Error: No camera in scene file." << endl;
@@ -633,23 +2350,109 @@ int main(int argc, char* argv[]) {
         cam.compute_basis();
         cout << "Camera loaded: " << cam.name << " (" << cam.res_x << "x" << cam.res_y << ")" << endl;
 
+        if (!crop_arg.empty() || !mask_path.empty()) {
+            setup_render_region(cam, crop_arg, mask_path);
+            cout << "Render region: [" << g_region.x0 << ", " << g_region.x1 << ") x [" << g_region.y0 << ", "
+                 << g_region.y1 << ")" << (g_region.mask.empty() ? "" : " (masked)") << endl;
+        }
+
         // 检查相机是否支持动态模糊
         bool camera_supports_motion_blur = (cam.shutter_speed > 0.0);
         if (!camera_supports_motion_blur && (use_motion_blur)) {
             cout << "Warning: Camera does not support motion blur (shutter_speed = 0)" << endl;
             cout << "Motion blur will have no effect" << endl;
         }
+        if (!bvh.motion_boxes.empty()) {
+            cout << "Motion BVH: node bounds interpolated over " << bvh.shutter_time << " s shutter" << endl;
+        }
+
+        // 加速结构：--no-bvh 等价于 --accel brute；auto 在采样光线上比较各候选
+        if (!use_bvh) accel_type = AcceleratorType::BRUTE;
+        std::unique_ptr<Accelerator> accel;
+        {
+            TIMELINE_SCOPE("accel.build");
+            accel = make_accelerator(accel_type, scene, bvh, bvh_builder);
+        }
+        const Accelerator *accel_ptr = use_bvh ? accel.get() : nullptr;
+        if (accel->type() != AcceleratorType::BVH) mem_set(MemTag::ACCELERATOR, accel->memory_bytes());
+        g_shadow_accel = accel_ptr;
+        cout << "Accelerator: " << accel->name() << " (" << accel->memory_bytes() / 1024 << " KiB)" << endl;
+
+        if (precision_report) {
+            report_precision(cam, scene, bvh, *accel);
+            return 0;
+        }
+
+        if (light_report) {
+            report_light_sampling(cam, scene, bvh, *accel, shadow_samples);
+            return 0;
+        }
+
+        // 光源树：光源不参与动画，整个渲染（含多帧序列）只需构建一次
+        LightTree light_tree;
+        if (use_light_tree) {
+            TIMELINE_SCOPE("light_tree.build");
+            light_tree.build(scene.lights);
+            mem_set(MemTag::LIGHT_TREE, light_tree.memory_bytes());
+            g_light_tree = &light_tree;
+            cout << "Light tree: " << scene.lights.size() << " lights, " << light_tree.nodes.size() << " nodes" << endl;
+        }
+
+        if (ray_tree_report) {
+            report_ray_tree(cam, scene, accel_ptr, pixel_samples, shadow_samples);
+            return 0;
+        }
+
+        if (restir_report) {
+            report_restir(cam, scene, accel_ptr, pixel_samples, shadow_samples);
+            return 0;
+        }
+
+        if (path_report) {
+            report_path_tracing(cam, scene, accel_ptr, pixel_samples);
+            return 0;
+        }
 
         srand((unsigned int)time(nullptr));
 
-        Image img(cam.res_x, cam.res_y);
         std::string output_filename;
         std::string description;
-
-        auto start_time = chrono::high_resolution_clock::now();
+        std::function<void(Image &)> render_frame;
 
         // 根据命令行参数选择合适的渲染方式
-        if (use_motion_blur && use_distributed) {
+        if (use_path_tracing) {
+            description = "Path Tracing";
+            output_filename = "../Output/output_path";
+            output_filename += (use_bvh ? "_bvh" : "_nobvh");
+            output_filename += "_ps" + std::to_string(pixel_samples);
+            output_filename += ".ppm";
+
+            cout << "\n=== " << description << " ===" << endl;
+            cout << "BVH: " << (use_bvh ? "enabled" : "disabled") << endl;
+            cout << "Pixel samples: " << pixel_samples << endl;
+            if (use_motion_blur) cout << "Warning: motion blur is not supported in path tracing mode and will be ignored" << endl;
+
+            render_frame = [&](Image &out) {
+                render_path_tracing(cam, scene, out, accel_ptr, pixel_samples, path_mode);
+            };
+        }
+        else if (use_restir) {
+            description = "ReSTIR Direct Lighting";
+            output_filename = "../Output/output_restir";
+            output_filename += (use_bvh ? "_bvh" : "_nobvh");
+            output_filename += "_ps" + std::to_string(pixel_samples);
+            output_filename += ".ppm";
+
+            cout << "\n=== " << description << " ===" << endl;
+            cout << "BVH: " << (use_bvh ? "enabled" : "disabled") << endl;
+            cout << "Passes: " << pixel_samples << endl;
+            if (use_motion_blur) cout << "Warning: motion blur is not supported in ReSTIR mode and will be ignored" << endl;
+
+            render_frame = [&](Image &out) {
+                render_restir(cam, scene, out, accel_ptr, pixel_samples, shadow_samples);
+            };
+        }
+        else if (use_motion_blur && use_distributed) {
             description = "Combined Distributed + Motion Blur";
             output_filename = "../Output/output_combined";
             output_filename += (use_bvh ? "_bvh" : "_nobvh");
@@ -663,7 +2466,9 @@ int main(int argc, char* argv[]) {
             cout << "Shadow samples: " << shadow_samples << endl;
             cout << "Motion blur: " << (camera_supports_motion_blur ? "supported" : "not supported") << endl;
 
-            render_distributed_with_motion_blur(cam, scene, img, use_bvh, pixel_samples, shadow_samples);
+            render_frame = [&](Image &out) {
+                render_distributed_with_motion_blur(cam, scene, out, accel_ptr, pixel_samples, shadow_samples);
+            };
         }
         else if (use_distributed) {
             description = "Distributed Soft Shadows";
@@ -678,7 +2483,9 @@ int main(int argc, char* argv[]) {
             cout << "Pixel samples: " << pixel_samples << endl;
             cout << "Shadow samples: " << shadow_samples << endl;
 
-            render_distributed_soft_shadows(cam, scene, img, use_bvh, pixel_samples, shadow_samples);
+            render_frame = [&](Image &out) {
+                render_distributed_soft_shadows(cam, scene, out, accel_ptr, pixel_samples, shadow_samples);
+            };
         }
         else if (use_motion_blur) {
             description = "Motion Blur Effects";
@@ -690,31 +2497,121 @@ int main(int argc, char* argv[]) {
             cout << "BVH: " << (use_bvh ? "enabled" : "disabled") << endl;
             cout << "Motion blur: " << (camera_supports_motion_blur ? "supported" : "not supported") << endl;
 
-            render_with_effects(cam, scene, img, use_bvh);
+            render_frame = [&](Image &out) { render_with_effects(cam, scene, out, accel_ptr); };
         }
         else if (use_bvh) {
             description = "Standard with BVH";
             output_filename = "../Output/output_bvh.ppm";
 
             cout << "\n=== " << description << " ===" << endl;
-            render_bvh(cam, scene, img);
+            render_frame = [&](Image &out) { render_bvh(cam, scene, out, *accel); };
         }
         else {
             description = "Standard without BVH";
             output_filename = "../Output/output_no_bvh.ppm";
 
             cout << "\n=== " << description << " ===" << endl;
-            render_no_bvh(cam, scene, img);
+            render_frame = [&](Image &out) { render_no_bvh(cam, scene, out); };
         }
 
+        if (convergence_spp > 0) {
+            if (!use_distributed && !use_restir && !use_path_tracing) {
+                cerr << "Error: --convergence needs a sampled mode (--distributed, --restir or --path-trace)" << endl;
+                return 1;
+            }
+            std::string mode = description;
+            std::transform(mode.begin(), mode.end(), mode.begin(), [](unsigned char c) {
+                return std::isalnum(c) ? (char)std::tolower(c) : '_';
+            });
+            report_convergence([&](Image &out, int spp) {
+                pixel_samples = spp;
+                render_frame(out);
+            }, cam, input_path, mode, config_label, convergence_spp, convergence_reference);
+            return 0;
+        }
+
+        auto finish_memory_report = [&]() {
+            if (!memory_report) return;
+            print_memory_report(cout, peak_memory_bytes());
+            if (memory_json.empty()) return;
+            if (write_memory_json(memory_json, peak_memory_bytes())) cout << "Memory report written: " << memory_json << endl;
+            else cerr << "Error: cannot write " << memory_json << endl;
+        };
+
+        if (watch) {
+            if (frame_count > 0 || batch || g_region.cropped) {
+                cerr << "Error: --watch cannot be combined with --frames, --batch, --crop or --mask" << endl;
+                return 1;
+            }
+            run_watch(input_path, scene, bvh, *accel, light_tree, cam, pixel_samples,
+                      use_distributed || use_restir || use_path_tracing, render_frame, output_filename);
+            finish_memory_report();
+            return 0;
+        }
+
+        if (batch) {
+            if (frame_count > 0 || g_region.cropped) {
+                cerr << "Error: --batch cannot be combined with --frames, --crop or --mask" << endl;
+                return 1;
+            }
+            std::vector<BatchJob> jobs;
+            if (!batch_path.empty()) jobs = load_batch_jobs(batch_path, scene);
+            else {
+                // 每个相机用命令行的模式渲染，输出文件名加上相机名
+                std::string stem = output_filename;
+                if (stem.size() > 4 && stem.substr(stem.size() - 4) == ".ppm") stem.resize(stem.size() - 4);
+                for (size_t c = 0; c < scene.cameras.size(); c++)
+                    jobs.push_back({c, "", 0, stem + "_" + scene.cameras[c]->name + ".ppm"});
+            }
+            cout << "\n=== Batch: " << jobs.size() << " jobs over " << scene.cameras.size() << " cameras ===" << endl;
+            render_batch(scene, accel_ptr, jobs, cam, pixel_samples, shadow_samples, render_frame);
+            finish_memory_report();
+            return 0;
+        }
+
+        if (frame_count > 0) {
+            render_sequence(scene, *accel, frame_start, frame_count, output_filename, render_frame, composite_path);
+            finish_memory_report();
+            return 0;
+        }
+
+        // 单帧输出图像；批量、序列和 --watch 各自分配并登记自己的帧缓冲
+        Image img(cam.res_x, cam.res_y);
+        mem_set(MemTag::FRAMEBUFFER, img.memory_bytes());
+#ifdef RT_STATS
+        if (print_stats) {
+            reset_render_counters();
+            begin_pixel_costs(img.width, img.height);
+        }
+#endif
+        auto start_time = chrono::high_resolution_clock::now();
+        {
+            TIMELINE_SCOPE("render");
+            render_frame(img);
+        }
         auto end_time = chrono::high_resolution_clock::now();
+#ifdef RT_STATS
+        if (print_stats) {
+            print_render_counters(cout, merge_render_counters(), (long long)img.width * img.height,
+                                  chrono::duration<double>(end_time - start_time).count());
+            std::string heat_path = output_filename;
+            if (heat_path.size() > 4 && heat_path.substr(heat_path.size() - 4) == ".ppm")
+                heat_path.resize(heat_path.size() - 4);
+            write_cost_heatmap(pixel_costs(), img.width, img.height, heat_path + "_cost.ppm");
+        }
+#endif
 
-        // 保存图像
-        img.write_ppm(output_filename);
+        // 保存图像：裁剪渲染输出区域图像，或合成进已有的整幅图像
+        if (g_region.cropped) output_filename = write_region_output(img, output_filename, composite_path);
+        else {
+            TIMELINE_SCOPE("image.write");
+            img.write_ppm(output_filename);
+        }
         cout << "\n=== Render Complete ===" << endl;
         cout << "Mode: " << description << endl;
         cout << "Output: " << output_filename << endl;
         cout << "Time: " << chrono::duration<double>(end_time - start_time).count() << " seconds" << endl;
+        finish_memory_report();
 
     } catch (const exception &e) {
         cerr << "Error: " << e.what() << endl;